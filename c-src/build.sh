@@ -21,3 +21,4 @@ cmake --build build
 echo "Copying executables to /bin..."
 mkdir -p ../bin
 cp -f build/bin/Debug/*.exe ../bin/
+cp -f build/lib/Debug/ximacro.node ../bin/ 2>/dev/null || echo "ximacro.node not built, skipping"
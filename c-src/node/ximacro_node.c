@@ -0,0 +1,308 @@
+#include <stdlib.h>
+#include <string.h>
+
+#define NAPI_VERSION 8
+#include <node_api.h>
+
+#include "ximacro.h"
+#include "xm_text.h"
+
+/**
+ * ximacro.node - N-API binding over libximacro.
+ *
+ * Files are read straight into Node Buffers and patched in place, so the
+ * main process never needs to spawn ximacro_e/ximacro_i or round-trip JSON.
+ *
+ *   readFile(path)                          -> Buffer
+ *   writeFile(path, buffer)                 -> undefined
+ *   fieldSpan(buffer, macro, line)          -> [offset, length] (line -1 = name)
+ *   getField(buffer, macro, line)           -> string (text up to the first NUL)
+ *   setField(buffer, macro, line, value)    -> boolean (true if any byte changed)
+ *
+ * Field strings are text as xm_text.h decodes and encodes it.
+ *   updateHeader(buffer)                    -> boolean (true if the header MD5 changed)
+ *   fileName(index)                         -> "mcr.dat" | "mcrN.dat"
+ *   macroCount(size)                        -> number
+ *   layout                                  -> { LINE_SIZE, NAME_SIZE, ... }
+ */
+
+#define THROW_IF(cond, msg)                        \
+    do                                             \
+    {                                              \
+        if (cond)                                  \
+        {                                          \
+            napi_throw_error(env, NULL, (msg));    \
+            return NULL;                           \
+        }                                          \
+    } while (0)
+
+// -------------------------------------------------------------------
+// Argument helpers
+// -------------------------------------------------------------------
+static int get_args(napi_env env, napi_callback_info info, size_t want, napi_value *argv)
+{
+    size_t argc = want;
+    if (napi_get_cb_info(env, info, &argc, argv, NULL, NULL) != napi_ok || argc < want)
+    {
+        napi_throw_type_error(env, NULL, "Wrong number of arguments");
+        return 0;
+    }
+    return 1;
+}
+
+// Caller frees the returned string
+static char *get_string(napi_env env, napi_value value)
+{
+    size_t len;
+    if (napi_get_value_string_utf8(env, value, NULL, 0, &len) != napi_ok)
+    {
+        napi_throw_type_error(env, NULL, "Expected a string");
+        return NULL;
+    }
+    char *s = malloc(len + 1);
+    if (!s)
+    {
+        napi_throw_error(env, NULL, "Out of memory");
+        return NULL;
+    }
+    napi_get_value_string_utf8(env, value, s, len + 1, &len);
+    return s;
+}
+
+static int get_bytes(napi_env env, napi_value value, uint8_t **data, size_t *size)
+{
+    void *ptr;
+    if (napi_get_buffer_info(env, value, &ptr, size) != napi_ok)
+    {
+        napi_throw_type_error(env, NULL, "Expected a Buffer");
+        return 0;
+    }
+    *data = ptr;
+    return 1;
+}
+
+static int get_int(napi_env env, napi_value value, int *out)
+{
+    if (napi_get_value_int32(env, value, out) != napi_ok)
+    {
+        napi_throw_type_error(env, NULL, "Expected a number");
+        return 0;
+    }
+    return 1;
+}
+
+static napi_value make_uint(napi_env env, size_t value)
+{
+    napi_value result;
+    napi_create_double(env, (double)value, &result);
+    return result;
+}
+
+// -------------------------------------------------------------------
+// Exports
+// -------------------------------------------------------------------
+static napi_value read_file(napi_env env, napi_callback_info info)
+{
+    napi_value argv[1];
+    if (!get_args(env, info, 1, argv))
+        return NULL;
+
+    char *path = get_string(env, argv[0]);
+    if (!path)
+        return NULL;
+
+    // Read directly into the Buffer's backing store; Electron doesn't allow
+    // external buffers, so this is the only copy the data ever takes.
+    long size = xm_file_size(path);
+    if (size < 0)
+    {
+        free(path);
+        napi_throw_error(env, NULL, xm_strerror((int)size));
+        return NULL;
+    }
+
+    void *data;
+    napi_value buffer;
+    if (napi_create_buffer(env, (size_t)size, &data, &buffer) != napi_ok)
+    {
+        free(path);
+        return NULL;
+    }
+
+    size_t bytes_read;
+    int err = xm_read_file_into(path, data, (size_t)size, &bytes_read);
+    free(path);
+    THROW_IF(err != XM_OK, xm_strerror(err));
+    THROW_IF(bytes_read != (size_t)size, "File changed while reading");
+    return buffer;
+}
+
+static napi_value write_file(napi_env env, napi_callback_info info)
+{
+    napi_value argv[2];
+    if (!get_args(env, info, 2, argv))
+        return NULL;
+
+    uint8_t *data;
+    size_t size;
+    if (!get_bytes(env, argv[1], &data, &size))
+        return NULL;
+
+    char *path = get_string(env, argv[0]);
+    if (!path)
+        return NULL;
+
+    int err = xm_write_file(path, data, size);
+    free(path);
+    THROW_IF(err != XM_OK, xm_strerror(err));
+    return NULL;
+}
+
+static int get_field_args(napi_env env, napi_callback_info info, size_t want, napi_value *argv,
+                          uint8_t **data, size_t *size, int *macro, int *line)
+{
+    return get_args(env, info, want, argv) &&
+           get_bytes(env, argv[0], data, size) &&
+           get_int(env, argv[1], macro) &&
+           get_int(env, argv[2], line);
+}
+
+static napi_value field_span(napi_env env, napi_callback_info info)
+{
+    napi_value argv[3];
+    uint8_t *data;
+    size_t size, offset, len;
+    int macro, line;
+    if (!get_field_args(env, info, 3, argv, &data, &size, &macro, &line))
+        return NULL;
+
+    THROW_IF(xm_field_span(size, macro, line, &offset, &len) != XM_OK, "Field out of range");
+
+    napi_value result;
+    napi_create_array_with_length(env, 2, &result);
+    napi_set_element(env, result, 0, make_uint(env, offset));
+    napi_set_element(env, result, 1, make_uint(env, len));
+    return result;
+}
+
+static napi_value get_field(napi_env env, napi_callback_info info)
+{
+    napi_value argv[3];
+    uint8_t *data;
+    size_t size, offset, len;
+    int macro, line;
+    if (!get_field_args(env, info, 3, argv, &data, &size, &macro, &line))
+        return NULL;
+
+    THROW_IF(xm_field_span(size, macro, line, &offset, &len) != XM_OK, "Field out of range");
+
+    xm_buf text;
+    xm_buf_init(&text);
+    xm_text_decode(&text, &data[offset], len);
+    THROW_IF(text.failed, "Out of memory");
+
+    napi_value result;
+    napi_create_string_utf8(env, text.data ? text.data : "", text.len, &result);
+    xm_buf_free(&text);
+    return result;
+}
+
+static napi_value set_field(napi_env env, napi_callback_info info)
+{
+    napi_value argv[4];
+    uint8_t *data;
+    size_t size;
+    int macro, line;
+    if (!get_field_args(env, info, 4, argv, &data, &size, &macro, &line))
+        return NULL;
+
+    char *text = get_string(env, argv[3]);
+    if (!text)
+        return NULL;
+
+    int changed;
+    int err = xm_text_set_field(data, size, macro, line, text, strlen(text), &changed);
+    free(text);
+    THROW_IF(err != XM_OK, "Field out of range");
+
+    napi_value result;
+    napi_get_boolean(env, changed, &result);
+    return result;
+}
+
+static napi_value update_header(napi_env env, napi_callback_info info)
+{
+    napi_value argv[1];
+    uint8_t *data;
+    size_t size;
+    if (!get_args(env, info, 1, argv) || !get_bytes(env, argv[0], &data, &size))
+        return NULL;
+
+    int res = xm_header_update(data, size);
+    THROW_IF(res < 0, "File too short for a header");
+
+    napi_value result;
+    napi_get_boolean(env, res, &result);
+    return result;
+}
+
+static napi_value file_name(napi_env env, napi_callback_info info)
+{
+    napi_value argv[1];
+    int index;
+    if (!get_args(env, info, 1, argv) || !get_int(env, argv[0], &index))
+        return NULL;
+
+    char name[32];
+    THROW_IF(xm_file_name(index, name, sizeof(name)) != XM_OK, "File index out of range");
+
+    napi_value result;
+    napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &result);
+    return result;
+}
+
+static napi_value macro_count(napi_env env, napi_callback_info info)
+{
+    napi_value argv[1];
+    int size;
+    if (!get_args(env, info, 1, argv) || !get_int(env, argv[0], &size))
+        return NULL;
+    THROW_IF(size < 0, "Size must not be negative");
+    return make_uint(env, xm_macro_count((size_t)size));
+}
+
+static void set_uint_property(napi_env env, napi_value obj, const char *name, size_t value)
+{
+    napi_set_named_property(env, obj, name, make_uint(env, value));
+}
+
+static napi_value init(napi_env env, napi_value exports)
+{
+    napi_property_descriptor methods[] = {
+        {"readFile", NULL, read_file, NULL, NULL, NULL, napi_default, NULL},
+        {"writeFile", NULL, write_file, NULL, NULL, NULL, napi_default, NULL},
+        {"fieldSpan", NULL, field_span, NULL, NULL, NULL, napi_default, NULL},
+        {"getField", NULL, get_field, NULL, NULL, NULL, napi_default, NULL},
+        {"setField", NULL, set_field, NULL, NULL, NULL, napi_default, NULL},
+        {"updateHeader", NULL, update_header, NULL, NULL, NULL, napi_default, NULL},
+        {"fileName", NULL, file_name, NULL, NULL, NULL, napi_default, NULL},
+        {"macroCount", NULL, macro_count, NULL, NULL, NULL, napi_default, NULL},
+    };
+    napi_define_properties(env, exports, sizeof(methods) / sizeof(methods[0]), methods);
+
+    napi_value layout;
+    napi_create_object(env, &layout);
+    set_uint_property(env, layout, "API_VERSION", (size_t)xm_api_version());
+    set_uint_property(env, layout, "LINES_PER_MACRO", XM_LINES_PER_MACRO);
+    set_uint_property(env, layout, "LINE_SIZE", XM_LINE_SIZE);
+    set_uint_property(env, layout, "NAME_SIZE", XM_NAME_SIZE);
+    set_uint_property(env, layout, "MACRO_SIZE", XM_MACRO_SIZE);
+    set_uint_property(env, layout, "MACRO_START", XM_MACRO_START);
+    set_uint_property(env, layout, "MACROS_PER_FILE", XM_MACROS_PER_FILE);
+    set_uint_property(env, layout, "MAX_FILE_INDEX", XM_MAX_FILE_INDEX);
+    napi_set_named_property(env, exports, "layout", layout);
+
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
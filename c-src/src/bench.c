@@ -0,0 +1,872 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "ximacro.h"
+#include "xm_bin.h"
+#include "cJSON.h"
+
+// -------------------------------------------------------------------
+// ximacro_bench: generates a synthetic USER/<char>/mcr*.dat corpus and
+// times the native tools against it the way the app runs them, one
+// process per call.
+//
+//   ximacro_bench [--dir=DIR] [--tools=DIR] [--chars=N] [--fill=F]
+//                 [--line-fill=F] [--line-len=MIN-MAX]
+//                 [--line-dist=uniform|short|long] [--seed=N] [--runs=N]
+//                 [--only=CASE,...] [--compare=FILE] [--threshold=PCT]
+//                 [--generate-only]
+//
+// Every case is timed cold (page cache of the corpus evicted where the
+// OS allows it, tool caches bypassed) and warm (after an untimed run, tool
+// caches enabled). Results go to stdout as JSON; with --compare, medians
+// are checked against an earlier run and the exit code is 2 if any case
+// got slower by more than the threshold.
+// -------------------------------------------------------------------
+
+#define FILE_SIZE (XM_MACRO_START - 4 + XM_MACROS_PER_FILE * XM_MACRO_SIZE)
+#define TTL_SIZE (0x18 + 20 * 16)
+#define MAX_CHARS 1000
+#define MAX_RUNS 1000
+
+typedef enum
+{
+    DIST_UNIFORM,
+    DIST_SHORT, // skewed to short lines, like most real macros
+    DIST_LONG
+} line_dist;
+
+typedef struct
+{
+    int chars;
+    double fill;      // chance a macro is used
+    double line_fill; // chance a line of a used macro is set
+    int min_len;
+    int max_len;
+    line_dist dist;
+    uint64_t seed;
+} corpus_opts;
+
+typedef struct
+{
+    long files;
+    long long bytes;
+    long lines;
+} corpus_stats;
+
+// -------------------------------------------------------------------
+// Deterministic random numbers (splitmix64), so a seed always gives the
+// same corpus
+// -------------------------------------------------------------------
+static uint64_t rng_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static int rng_below(uint64_t *state, int n)
+{
+    return n > 0 ? (int)(rng_next(state) % (uint64_t)n) : 0;
+}
+
+static double rng_unit(uint64_t *state)
+{
+    return (double)(rng_next(state) >> 11) / (double)(1ULL << 53);
+}
+
+// -------------------------------------------------------------------
+// Corpus generation
+// -------------------------------------------------------------------
+static const char *const COMMANDS[] = {
+    "/ma \"Cure IV\" <t>", "/ma \"Haste\" <stpt>", "/ja \"Provoke\" <t>",
+    "/ws \"Savage Blade\" <t>", "/equip main \"Naegling\"", "/equipset 12",
+    "/wait 2", "/echo", "/p", "/l", "/item \"Echo Drops\" <me>", "/ta <bt>",
+    "/lockstyleset 3", "/console gs c cycle OffenseMode", "/attack <bt>",
+};
+static const char *const WORDS[] = {
+    "ready", "<t>", "<me>", "<pet>", "Magic", "Burst", "skillchain", "TP",
+    "1000", "go", "now", "->", "<call14>", "pull", "-", "done",
+};
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+static int draw_len(uint64_t *rng, const corpus_opts *o)
+{
+    int span = o->max_len - o->min_len + 1;
+    int a = rng_below(rng, span);
+    int b = rng_below(rng, span);
+    if (o->dist == DIST_SHORT)
+        a = a < b ? a : b;
+    else if (o->dist == DIST_LONG)
+        a = a > b ? a : b;
+    return o->min_len + a;
+}
+
+// A command, then words, auto-translate phrases (0xFD ... 0xFD) and
+// Shift-JIS kana; multi-byte units are never cut at the target length
+static size_t gen_line(uint64_t *rng, const corpus_opts *o, uint8_t *out)
+{
+    size_t target = (size_t)draw_len(rng, o);
+    size_t len = 0;
+    int first = 1;
+    while (len < target)
+    {
+        uint8_t unit[48];
+        size_t n;
+        int split = 1;
+        double u = rng_unit(rng);
+        if (first)
+            n = (size_t)snprintf((char *)unit, sizeof(unit), "%s", COMMANDS[rng_below(rng, COUNT_OF(COMMANDS))]);
+        else if (u < 0.05)
+        {
+            const uint8_t phrase[6] = {0xFD, 0x02, 0x02, (uint8_t)(1 + rng_below(rng, 32)),
+                                       (uint8_t)(1 + rng_below(rng, 200)), 0xFD};
+            memcpy(unit, phrase, sizeof(phrase));
+            n = sizeof(phrase);
+            split = 0;
+        }
+        else if (u < 0.10)
+        {
+            unit[0] = 0x82;
+            unit[1] = (uint8_t)(0x9F + rng_below(rng, 0x53));
+            n = 2;
+            split = 0;
+        }
+        else
+            n = (size_t)snprintf((char *)unit, sizeof(unit), " %s", WORDS[rng_below(rng, COUNT_OF(WORDS))]);
+        first = 0;
+
+        if (len + n > target)
+        {
+            if (!split)
+                break;
+            n = target - len;
+        }
+        memcpy(out + len, unit, n);
+        len += n;
+    }
+    return len;
+}
+
+static void gen_file(uint64_t *rng, const corpus_opts *o, uint8_t *data, corpus_stats *stats)
+{
+    memset(data, 0, FILE_SIZE);
+    data[0] = 1; // version
+
+    for (int m = 0; m < XM_MACROS_PER_FILE; m++)
+    {
+        if (rng_unit(rng) >= o->fill)
+            continue;
+        for (int line = 0; line < XM_LINES_PER_MACRO; line++)
+        {
+            if (rng_unit(rng) >= o->line_fill)
+                continue;
+            uint8_t text[XM_LINE_SIZE];
+            size_t len = gen_line(rng, o, text);
+            xm_set_field(data, FILE_SIZE, m, line, (const char *)text, len, NULL);
+            stats->lines++;
+        }
+        char name[12];
+        int len = snprintf(name, sizeof(name), "%s%d", WORDS[rng_below(rng, COUNT_OF(WORDS))], m);
+        xm_set_field(data, FILE_SIZE, m, XM_FIELD_NAME, name, (size_t)len, NULL);
+    }
+    xm_header_update(data, FILE_SIZE);
+}
+
+static int gen_ttl(const char *path, int first_book)
+{
+    uint8_t data[TTL_SIZE] = {0};
+    for (int i = 0; i < 20; i++)
+        snprintf((char *)data + 0x18 + i * 16, 16, "Book %d", first_book + i);
+    return xm_write_file(path, data, sizeof(data));
+}
+
+static int gen_character(uint64_t *rng, const corpus_opts *o, const char *dir, corpus_stats *stats)
+{
+    uint8_t data[FILE_SIZE];
+    char path[1024];
+    int err = xm_ensure_dir(dir);
+    for (int i = 0; err == XM_OK && i < XM_FILE_COUNT; i++)
+    {
+        gen_file(rng, o, data, stats);
+        if ((err = xm_file_path(dir, i, path, sizeof(path))) == XM_OK)
+            err = xm_write_file(path, data, FILE_SIZE);
+        stats->files++;
+        stats->bytes += FILE_SIZE;
+    }
+    for (int t = 0; err == XM_OK && t < 2; t++)
+    {
+        snprintf(path, sizeof(path), "%s" XM_PATH_SEP_STR "%s", dir, t == 0 ? "mcr.ttl" : "mcr_2.ttl");
+        err = gen_ttl(path, 1 + t * 20);
+    }
+    return err;
+}
+
+static int write_buf(const char *path, const xm_buf *b)
+{
+    if (b->failed)
+        return XM_ERR_NOMEM;
+    return xm_write_file(path, (const uint8_t *)b->data, b->len);
+}
+
+// Two full contents for the "import" folder, as JSON and binary import
+// input, plus a one-line patch of each. Importing them in turn rewrites
+// every file each time.
+static int gen_import_inputs(uint64_t *rng, const corpus_opts *o, corpus_stats *stats)
+{
+    static uint8_t files[2][XM_FILE_COUNT][FILE_SIZE];
+    corpus_stats ignored = {0};
+    char path[1024];
+    int err = xm_ensure_dir("import");
+
+    for (int set = 0; set < 2; set++)
+    {
+        for (int i = 0; i < XM_FILE_COUNT; i++)
+            gen_file(rng, o, files[set][i], set == 0 ? stats : &ignored);
+    }
+
+    // On disk: set 0 (and the page cache warm, as after a save)
+    for (int i = 0; err == XM_OK && i < XM_FILE_COUNT; i++)
+    {
+        if ((err = xm_file_path("import", i, path, sizeof(path))) == XM_OK)
+            err = xm_write_file(path, files[0][i], FILE_SIZE);
+    }
+
+    for (int set = 0; err == XM_OK && set < 2; set++)
+    {
+        xm_buf json, bin, patch;
+        xm_buf_init(&json);
+        xm_buf_init(&bin);
+        xm_buf_init(&patch);
+
+        xm_buf_putc(&json, '[');
+        xm_bin_header(&bin, "import");
+        for (int i = 0; i < XM_FILE_COUNT; i++)
+        {
+            xm_file_path("import", i, path, sizeof(path));
+            if (i > 0)
+                xm_buf_putc(&json, ',');
+            xm_json_file(&json, path, files[set][i], FILE_SIZE);
+            xm_bin_file(&bin, i, files[set][i], FILE_SIZE);
+        }
+        xm_buf_putc(&json, ']');
+        xm_bin_end(&bin);
+        xm_buf_printf(&patch, "{\"dir\":\"import\",\"edits\":[[1,0,0,\"/echo patch %c\"]]}", 'a' + set);
+
+        char name[32];
+        snprintf(name, sizeof(name), "input%d.json", set);
+        err = write_buf(name, &json);
+        snprintf(name, sizeof(name), "input%d.xmb", set);
+        if (err == XM_OK)
+            err = write_buf(name, &bin);
+        snprintf(name, sizeof(name), "patch%d.json", set);
+        if (err == XM_OK)
+            err = write_buf(name, &patch);
+
+        xm_buf_free(&json);
+        xm_buf_free(&bin);
+        xm_buf_free(&patch);
+    }
+    return err;
+}
+
+static int generate_corpus(const corpus_opts *o, corpus_stats *stats)
+{
+    uint64_t rng = o->seed;
+    char dir[64];
+    int err = xm_ensure_dir("USER");
+    for (int c = 0; err == XM_OK && c < o->chars; c++)
+    {
+        snprintf(dir, sizeof(dir), "USER" XM_PATH_SEP_STR "char%03d", c);
+        err = gen_character(&rng, o, dir, stats);
+    }
+    if (err == XM_OK)
+        err = gen_import_inputs(&rng, o, stats);
+    if (err == XM_OK)
+        err = xm_ensure_dir("out");
+    return err;
+}
+
+// -------------------------------------------------------------------
+// Page cache eviction, for cold runs. Dirty pages are flushed first so
+// freshly imported files can be dropped too.
+// -------------------------------------------------------------------
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+#define HAVE_EVICT 1
+static void evict_file(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+#else
+#define HAVE_EVICT 0
+static void evict_file(const char *path)
+{
+    (void)path;
+}
+#endif
+
+static void evict_dir(const char *dir)
+{
+    char path[1024];
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        if (xm_file_path(dir, i, path, sizeof(path)) == XM_OK)
+            evict_file(path);
+    }
+    snprintf(path, sizeof(path), "%s" XM_PATH_SEP_STR "mcr.ttl", dir);
+    evict_file(path);
+    snprintf(path, sizeof(path), "%s" XM_PATH_SEP_STR "mcr_2.ttl", dir);
+    evict_file(path);
+}
+
+static void evict_corpus(int chars)
+{
+    char dir[64];
+    for (int c = 0; c < chars; c++)
+    {
+        snprintf(dir, sizeof(dir), "USER" XM_PATH_SEP_STR "char%03d", c);
+        evict_dir(dir);
+    }
+    evict_dir("import");
+}
+
+// -------------------------------------------------------------------
+// Running a tool: one process, stdin and stdout redirected to files
+// (or the null device), stderr discarded. Returns its exit status.
+// -------------------------------------------------------------------
+static char g_tools[1024];
+
+#if defined(_WIN32)
+#define EXE_SUFFIX ".exe"
+#define NULL_DEVICE "NUL"
+#else
+#define EXE_SUFFIX ""
+#define NULL_DEVICE "/dev/null"
+#endif
+
+static void tool_path(const char *name, char *out, size_t cap)
+{
+    snprintf(out, cap, "%s" XM_PATH_SEP_STR "%s" EXE_SUFFIX, g_tools, name);
+}
+
+static int run_tool(char *const argv[], const char *in, const char *out)
+{
+    in = in ? in : NULL_DEVICE;
+    out = out ? out : NULL_DEVICE;
+#if defined(_WIN32)
+    // cmd strips the outer pair of quotes
+    char cmd[4096];
+    size_t len = (size_t)snprintf(cmd, sizeof(cmd), "\"\"%s\"", argv[0]);
+    for (int i = 1; argv[i] && len < sizeof(cmd); i++)
+        len += (size_t)snprintf(cmd + len, sizeof(cmd) - len, " \"%s\"", argv[i]);
+    if (len < sizeof(cmd))
+        len += (size_t)snprintf(cmd + len, sizeof(cmd) - len, " < \"%s\" > \"%s\" 2> NUL\"", in, out);
+    if (len >= sizeof(cmd))
+        return -1;
+    return system(cmd);
+#else
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+    {
+        int fd_in = open(in, O_RDONLY);
+        int fd_out = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int fd_err = open(NULL_DEVICE, O_WRONLY);
+        if (fd_in < 0 || fd_out < 0 || fd_err < 0)
+            _exit(127);
+        dup2(fd_in, STDIN_FILENO);
+        dup2(fd_out, STDOUT_FILENO);
+        dup2(fd_err, STDERR_FILENO);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0)
+        return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+// -------------------------------------------------------------------
+// Cases. 'setup' fills in one call for a cold or warm run; 'seq' counts
+// runs of the case, so imports can alternate between their two inputs.
+// -------------------------------------------------------------------
+typedef struct
+{
+    char exe[1100];
+    char args[4][1100];
+    char *argv[8];
+    char in[64];
+    char out[64];
+} invocation;
+
+typedef void (*case_setup)(invocation *inv, int cold, int seq);
+
+typedef struct
+{
+    const char *name;
+    const char *tool;
+    case_setup setup;
+} bench_case;
+
+static void set_args(invocation *inv, const char *tool, int count, ...)
+{
+    va_list ap;
+    va_start(ap, count);
+    tool_path(tool, inv->exe, sizeof(inv->exe));
+    inv->argv[0] = inv->exe;
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(inv->args[i], sizeof(inv->args[i]), "%s", va_arg(ap, const char *));
+        inv->argv[i + 1] = inv->args[i];
+    }
+    inv->argv[count + 1] = NULL;
+    va_end(ap);
+}
+
+#define FIRST_CHAR "USER" XM_PATH_SEP_STR "char000"
+
+static void setup_export(invocation *inv, int cold, int seq)
+{
+    (void)seq;
+    set_args(inv, "ximacro_e", 2, cold ? "--no-cache" : "--cache=macro_cache", FIRST_CHAR);
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "export.json");
+}
+
+static void setup_export_verify(invocation *inv, int cold, int seq)
+{
+    (void)cold;
+    (void)seq;
+    set_args(inv, "ximacro_e", 3, "--no-cache", "--verify", FIRST_CHAR);
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "export.json");
+}
+
+static void setup_export_bin(invocation *inv, int cold, int seq)
+{
+    (void)seq;
+    set_args(inv, "ximacro_e", 3, cold ? "--no-cache" : "--cache=macro_cache", "--format=bin", FIRST_CHAR);
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "export.xmb");
+}
+
+// One book, as the app opens a character
+static void setup_export_book(invocation *inv, int cold, int seq)
+{
+    (void)seq;
+    set_args(inv, "ximacro_e", 4, cold ? "--no-cache" : "--cache=macro_cache", "--format=bin", "--book=0",
+             FIRST_CHAR);
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "export-book.xmb");
+}
+
+// The folder starts out holding input 0, so the first import writes input 1
+static int g_import_seq = 1;
+
+static void setup_import_json(invocation *inv, int cold, int seq)
+{
+    (void)cold;
+    (void)seq;
+    set_args(inv, "ximacro_i", 0);
+    snprintf(inv->in, sizeof(inv->in), "input%d.json", g_import_seq++ & 1);
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "import.json");
+}
+
+static void setup_import_bin(invocation *inv, int cold, int seq)
+{
+    (void)cold;
+    (void)seq;
+    set_args(inv, "ximacro_i", 1, "--format=bin");
+    snprintf(inv->in, sizeof(inv->in), "input%d.xmb", g_import_seq++ & 1);
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "import.json");
+}
+
+static void setup_import_edit(invocation *inv, int cold, int seq)
+{
+    (void)cold;
+    set_args(inv, "ximacro_i", 1, "--patch");
+    snprintf(inv->in, sizeof(inv->in), "patch%d.json", seq & 1);
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "patch.json");
+}
+
+static void setup_books(invocation *inv, int cold, int seq)
+{
+    (void)cold;
+    (void)seq;
+    set_args(inv, "ximacro_b", 2, FIRST_CHAR XM_PATH_SEP_STR "mcr.ttl", FIRST_CHAR XM_PATH_SEP_STR "mcr_2.ttl");
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "books.json");
+}
+
+static void setup_list(invocation *inv, int cold, int seq)
+{
+    (void)cold;
+    (void)seq;
+    set_args(inv, "ximacro_c", 1, "USER");
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "list.json");
+}
+
+static void setup_scan(invocation *inv, int cold, int seq)
+{
+    (void)seq;
+    set_args(inv, "ximacro_c", 3, "--scan", cold ? "--no-index" : "--index=macro_cache/characters.idx", "USER");
+    snprintf(inv->out, sizeof(inv->out), "out" XM_PATH_SEP_STR "scan.json");
+}
+
+static const bench_case CASES[] = {
+    {"export", "ximacro_e", setup_export},
+    {"export-verify", "ximacro_e", setup_export_verify},
+    {"export-bin", "ximacro_e", setup_export_bin},
+    {"export-book", "ximacro_e", setup_export_book},
+    {"import", "ximacro_i", setup_import_json},
+    {"import-bin", "ximacro_i", setup_import_bin},
+    {"import-edit", "ximacro_i", setup_import_edit},
+    {"books", "ximacro_b", setup_books},
+    {"list", "ximacro_c", setup_list},
+    {"scan", "ximacro_c", setup_scan},
+};
+#define CASE_COUNT ((int)COUNT_OF(CASES))
+
+// -------------------------------------------------------------------
+// Timing and results
+// -------------------------------------------------------------------
+typedef struct
+{
+    const char *name;
+    int cold;
+    int runs;
+    int failed;
+    double min_ms, median_ms, mean_ms, max_ms;
+    long long bytes_out;
+    double baseline_ms; // < 0: no baseline
+    int regressed;
+} case_result;
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(const bench_case *c, int cold, int runs, int chars, case_result *r)
+{
+    double times[MAX_RUNS];
+    invocation inv;
+    int seq = 0;
+
+    memset(r, 0, sizeof(*r));
+    r->name = c->name;
+    r->cold = cold;
+    r->runs = runs;
+    r->baseline_ms = -1;
+
+    if (!cold)
+    {
+        // Untimed: fills the page cache and the tool's own cache
+        memset(&inv, 0, sizeof(inv));
+        c->setup(&inv, cold, seq++);
+        run_tool(inv.argv, inv.in[0] ? inv.in : NULL, NULL);
+    }
+
+    for (int i = 0; i < runs; i++)
+    {
+        memset(&inv, 0, sizeof(inv));
+        c->setup(&inv, cold, seq++);
+        if (cold)
+            evict_corpus(chars);
+
+        double start = xm_now_ms();
+        int status = run_tool(inv.argv, inv.in[0] ? inv.in : NULL, inv.out[0] ? inv.out : NULL);
+        times[i] = xm_now_ms() - start;
+
+        if (status != 0)
+        {
+            fprintf(stderr, "[bench] %s (%s) run %d exited with %d\n", c->name, cold ? "cold" : "warm", i + 1, status);
+            r->failed++;
+        }
+        if (inv.out[0])
+            r->bytes_out = xm_file_size(inv.out);
+    }
+
+    qsort(times, (size_t)runs, sizeof(double), cmp_double);
+    r->min_ms = times[0];
+    r->max_ms = times[runs - 1];
+    r->median_ms = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    for (int i = 0; i < runs; i++)
+        r->mean_ms += times[i] / runs;
+}
+
+// Matches results to an earlier run's by case and cache state
+static int compare_baseline(const char *path, case_result *results, int count, double threshold)
+{
+    uint8_t *data = NULL;
+    size_t size = 0;
+    int err = xm_read_file(path, &data, &size);
+    if (err != XM_OK)
+    {
+        fprintf(stderr, "[bench] Could not read baseline '%s': %s\n", path, xm_strerror(err));
+        return -1;
+    }
+    cJSON *root = cJSON_ParseWithLength((const char *)data, size);
+    free(data);
+    cJSON *list = cJSON_GetObjectItemCaseSensitive(root, "results");
+    if (!cJSON_IsArray(list))
+    {
+        fprintf(stderr, "[bench] '%s' is not a ximacro_bench result.\n", path);
+        cJSON_Delete(root);
+        return -1;
+    }
+
+    int regressed = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, list)
+    {
+        const cJSON *name = cJSON_GetObjectItemCaseSensitive(item, "case");
+        const cJSON *cache = cJSON_GetObjectItemCaseSensitive(item, "cache");
+        const cJSON *median = cJSON_GetObjectItemCaseSensitive(item, "medianMs");
+        if (!cJSON_IsString(name) || !cJSON_IsString(cache) || !cJSON_IsNumber(median))
+            continue;
+        for (int i = 0; i < count; i++)
+        {
+            case_result *r = &results[i];
+            if (strcmp(r->name, name->valuestring) != 0 || strcmp(r->cold ? "cold" : "warm", cache->valuestring) != 0)
+                continue;
+            r->baseline_ms = median->valuedouble;
+            r->regressed = r->median_ms > r->baseline_ms * (1.0 + threshold / 100.0);
+            regressed += r->regressed;
+        }
+    }
+    cJSON_Delete(root);
+    return regressed;
+}
+
+static void print_results(const corpus_opts *o, const corpus_stats *stats, const case_result *results, int count)
+{
+    static const char *const DIST_NAMES[] = {"uniform", "short", "long"};
+    xm_buf out;
+    xm_buf_init(&out);
+
+    xm_buf_printf(&out, "{\"corpus\":{\"characters\":%d,\"files\":%ld,\"bytes\":%lld,\"lines\":%ld,"
+                        "\"fill\":%.3f,\"lineFill\":%.3f,\"lineLen\":[%d,%d],\"lineDist\":\"%s\",\"seed\":%llu},",
+                  o->chars, stats->files, stats->bytes, stats->lines, o->fill, o->line_fill,
+                  o->min_len, o->max_len, DIST_NAMES[o->dist], (unsigned long long)o->seed);
+    xm_buf_printf(&out, "\"eviction\":\"%s\",\"results\":[", HAVE_EVICT ? "fadvise" : "none");
+    for (int i = 0; i < count; i++)
+    {
+        const case_result *r = &results[i];
+        if (i > 0)
+            xm_buf_putc(&out, ',');
+        xm_buf_printf(&out, "\n{\"case\":\"%s\",\"cache\":\"%s\",\"runs\":%d,\"failed\":%d,"
+                            "\"minMs\":%.3f,\"medianMs\":%.3f,\"meanMs\":%.3f,\"maxMs\":%.3f,\"bytesOut\":%lld",
+                      r->name, r->cold ? "cold" : "warm", r->runs, r->failed,
+                      r->min_ms, r->median_ms, r->mean_ms, r->max_ms, r->bytes_out);
+        if (r->baseline_ms >= 0)
+            xm_buf_printf(&out, ",\"baselineMs\":%.3f,\"change\":%.3f,\"regressed\":%s",
+                          r->baseline_ms, r->baseline_ms > 0 ? r->median_ms / r->baseline_ms - 1.0 : 0.0,
+                          r->regressed ? "true" : "false");
+        xm_buf_putc(&out, '}');
+    }
+    xm_buf_puts(&out, "\n]}\n");
+    xm_buf_write(&out, stdout);
+    xm_buf_free(&out);
+}
+
+// -------------------------------------------------------------------
+// main
+// -------------------------------------------------------------------
+static int selected(const char *only, const char *name)
+{
+    if (!only)
+        return 1;
+    size_t len = strlen(name);
+    for (const char *p = only; (p = strstr(p, name)) != NULL; p += len)
+    {
+        if ((p == only || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+// The tools directory as an absolute path, since the benchmark runs in --dir
+static int resolve_tools(const char *dir)
+{
+#if defined(_WIN32)
+    return _fullpath(g_tools, dir, sizeof(g_tools)) ? XM_OK : XM_ERR_OPEN;
+#else
+    char *full = realpath(dir, NULL);
+    if (!full)
+        return XM_ERR_OPEN;
+    snprintf(g_tools, sizeof(g_tools), "%s", full);
+    free(full);
+    return XM_OK;
+#endif
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--dir=DIR] [--tools=DIR] [--chars=N] [--fill=F] [--line-fill=F]\n"
+                    "       [--line-len=MIN-MAX] [--line-dist=uniform|short|long] [--seed=N] [--runs=N]\n"
+                    "       [--only=CASE,...] [--compare=FILE] [--threshold=PCT] [--generate-only]\n"
+                    "Cases: export export-verify export-bin import import-bin import-edit books list scan\n",
+            prog);
+}
+
+int main(int argc, char *argv[])
+{
+    corpus_opts opts = {8, 0.6, 0.5, 4, XM_LINE_SIZE - 1, DIST_SHORT, 1};
+    const char *work = "bench_work";
+    const char *tools = NULL;
+    const char *only = NULL;
+    const char *compare = NULL;
+    double threshold = 10.0;
+    int runs = 5;
+    int generate_only = 0;
+    int bad = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *a = argv[i];
+        if (strncmp(a, "--dir=", 6) == 0 && a[6])
+            work = a + 6;
+        else if (strncmp(a, "--tools=", 8) == 0 && a[8])
+            tools = a + 8;
+        else if (strncmp(a, "--chars=", 8) == 0)
+            bad |= (opts.chars = atoi(a + 8)) < 1 || opts.chars > MAX_CHARS;
+        else if (strncmp(a, "--fill=", 7) == 0)
+            bad |= (opts.fill = atof(a + 7)) < 0 || opts.fill > 1;
+        else if (strncmp(a, "--line-fill=", 12) == 0)
+            bad |= (opts.line_fill = atof(a + 12)) < 0 || opts.line_fill > 1;
+        else if (strncmp(a, "--line-len=", 11) == 0)
+            bad |= sscanf(a + 11, "%d-%d", &opts.min_len, &opts.max_len) != 2 ||
+                   opts.min_len < 1 || opts.min_len > opts.max_len || opts.max_len > XM_LINE_SIZE - 1;
+        else if (strcmp(a, "--line-dist=uniform") == 0)
+            opts.dist = DIST_UNIFORM;
+        else if (strcmp(a, "--line-dist=short") == 0)
+            opts.dist = DIST_SHORT;
+        else if (strcmp(a, "--line-dist=long") == 0)
+            opts.dist = DIST_LONG;
+        else if (strncmp(a, "--seed=", 7) == 0)
+            opts.seed = strtoull(a + 7, NULL, 10);
+        else if (strncmp(a, "--runs=", 7) == 0)
+            bad |= (runs = atoi(a + 7)) < 1 || runs > MAX_RUNS;
+        else if (strncmp(a, "--only=", 7) == 0 && a[7])
+            only = a + 7;
+        else if (strncmp(a, "--compare=", 10) == 0 && a[10])
+            compare = a + 10;
+        else if (strncmp(a, "--threshold=", 12) == 0)
+            bad |= (threshold = atof(a + 12)) < 0;
+        else if (strcmp(a, "--generate-only") == 0)
+            generate_only = 1;
+        else
+            bad = 1;
+    }
+    if (bad)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Tools default to the directory this binary is in
+    char self_dir[1024];
+    if (!tools)
+    {
+        snprintf(self_dir, sizeof(self_dir), "%s", argv[0]);
+        char *sep = strrchr(self_dir, '/');
+#if defined(_WIN32)
+        char *bsep = strrchr(self_dir, '\\');
+        if (!sep || (bsep && bsep > sep))
+            sep = bsep;
+#endif
+        if (sep)
+            *sep = '\0';
+        else
+            snprintf(self_dir, sizeof(self_dir), ".");
+        tools = self_dir;
+    }
+    if (resolve_tools(tools) != XM_OK)
+    {
+        fprintf(stderr, "[bench] Tools directory '%s' not found.\n", tools);
+        return 1;
+    }
+    char compare_path[1024];
+    if (compare)
+    {
+        // Relative to where we were started, not --dir
+#if defined(_WIN32)
+        if (!_fullpath(compare_path, compare, sizeof(compare_path)))
+#else
+        if (!realpath(compare, compare_path))
+#endif
+        {
+            fprintf(stderr, "[bench] Baseline '%s' not found.\n", compare);
+            return 1;
+        }
+        compare = compare_path;
+    }
+
+    if (xm_ensure_dir(work) != XM_OK ||
+#if defined(_WIN32)
+        _chdir(work) != 0
+#else
+        chdir(work) != 0
+#endif
+    )
+    {
+        fprintf(stderr, "[bench] Could not use work directory '%s'.\n", work);
+        return 1;
+    }
+
+    corpus_stats stats = {0};
+    double start = xm_now_ms();
+    int err = generate_corpus(&opts, &stats);
+    if (err != XM_OK)
+    {
+        fprintf(stderr, "[bench] Could not generate the corpus in '%s': %s\n", work, xm_strerror(err));
+        return 1;
+    }
+    fprintf(stderr, "[bench] Generated %ld files (%d characters) in %.1f ms\n",
+            stats.files, opts.chars, xm_now_ms() - start);
+
+    case_result results[CASE_COUNT * 2];
+    int count = 0;
+    for (int i = 0; i < CASE_COUNT && !generate_only; i++)
+    {
+        if (!selected(only, CASES[i].name))
+            continue;
+
+        char path[1100];
+        tool_path(CASES[i].tool, path, sizeof(path));
+        if (xm_file_size(path) < 0)
+        {
+            fprintf(stderr, "[bench] %s not found; build it or pass --tools=DIR.\n", path);
+            return 1;
+        }
+        for (int cold = 1; cold >= 0; cold--)
+            run_case(&CASES[i], cold, runs, opts.chars, &results[count++]);
+    }
+    if (generate_only)
+        return 0;
+
+    int regressed = 0;
+    if (compare && (regressed = compare_baseline(compare, results, count, threshold)) < 0)
+        return 1;
+
+    print_results(&opts, &stats, results, count);
+    return regressed > 0 ? 2 : 0;
+}
@@ -3,100 +3,255 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "./vendor/cJSON/cJSON.h"
+#include "ximacro.h"
+#include "xm_text.h"
+#include "xm_trace.h"
+
 #define NAME_OFFSET 0x18 // 24 decimal
 #define NAME_SIZE 0x10   // 16 decimal
+#define BOOKS_PER_FILE 20
+#define MAX_INPUT (1024 * 1024)
+
+// -------------------------------------------------------------------
+// Usage:
+//   ximacro_b <file.ttl>...          list the titles of every file
+//   ximacro_b --set <file.ttl>...    patch titles read from stdin as
+//                                    [{"book":N,"title":"..."}, ...],
+//                                    then list as above
+//
+// Output: [{"book":N,"title":"..."}, ...], where 'book' is the absolute
+// 0-based book index, and titles are text as xm_text.h decodes it.
+// mcr.ttl holds books 0-19 and mcr_<n>.ttl books
+// (n-1)*20 onwards; any other file name takes its place in the argument
+// list instead. A file that can't be read is reported on stderr and
+// skipped, and the exit status is 1.
+// -------------------------------------------------------------------
+typedef struct
+{
+    const char *path;
+    int first_book;
+    uint8_t *data;
+    size_t size;
+} ttl_file;
 
-/**
- * Trims trailing null ('\0') bytes from a buffer in-place.
- */
-static void trim_trailing_nulls(char *s, size_t len)
+static int ttl_first_book(const char *path, int position)
 {
-    for (size_t i = len; i > 0; i--)
+    const char *name = xm_basename(path);
+    if (strcmp(name, "mcr.ttl") == 0)
+        return 0;
+
+    if (strncmp(name, "mcr_", 4) == 0)
     {
-        if (s[i - 1] == '\0')
-            s[i - 1] = '\0';
-        else
-            break;
+        char *end;
+        long n = strtol(name + 4, &end, 10);
+        if (end != name + 4 && n >= 1 && n <= 100 && strcmp(end, ".ttl") == 0)
+            return (int)(n - 1) * BOOKS_PER_FILE;
     }
+    return position * BOOKS_PER_FILE;
 }
 
-int main(int argc, char *argv[])
+// Number of (possibly truncated) title slots in a file of 'size' bytes.
+static int ttl_slots(size_t size)
+{
+    if (size <= NAME_OFFSET)
+        return 0;
+    size_t slots = (size - NAME_OFFSET + NAME_SIZE - 1) / NAME_SIZE;
+    return slots < BOOKS_PER_FILE ? (int)slots : BOOKS_PER_FILE;
+}
+
+static ttl_file *file_for_book(ttl_file *files, int count, int book)
 {
-    if (argc < 2)
+    for (int i = 0; i < count; i++)
     {
-        fprintf(stderr, "Usage: %s <binaryfile>\n", argv[0]);
-        return 1;
+        if (files[i].data && book >= files[i].first_book &&
+            book < files[i].first_book + ttl_slots(files[i].size))
+            return &files[i];
     }
+    return NULL;
+}
+
+static char *read_stdin(size_t *size)
+{
+    char *buf = malloc(MAX_INPUT + 1);
+    if (!buf)
+        return NULL;
+    *size = fread(buf, 1, MAX_INPUT, stdin);
+    buf[*size] = '\0';
+    return buf;
+}
 
-    FILE *fp = fopen(argv[1], "rb");
-    if (!fp)
+// -------------------------------------------------------------------
+// Applies each edit to the in-memory copy of its file, then writes the
+// span from the first to the last changed slot back with one write.
+// Untouched files aren't opened for writing at all.
+// -------------------------------------------------------------------
+static int set_titles(ttl_file *files, int count, const cJSON *edits)
+{
+    int status = 0;
+    size_t *lo = calloc((size_t)count, sizeof *lo);
+    size_t *hi = calloc((size_t)count, sizeof *hi);
+    if (!lo || !hi)
     {
-        fprintf(stderr, "Could not open %s\n", argv[1]);
+        free(lo);
+        free(hi);
+        fprintf(stderr, "Out of memory\n");
         return 1;
     }
 
-    // Move to offset 0x18
-    if (fseek(fp, NAME_OFFSET, SEEK_SET) != 0)
+    const cJSON *edit;
+    cJSON_ArrayForEach(edit, edits)
     {
-        fprintf(stderr, "Error: Could not seek to 0x%X in file.\n", NAME_OFFSET);
-        fclose(fp);
-        return 1;
-    }
+        const cJSON *book = cJSON_GetObjectItemCaseSensitive(edit, "book");
+        const cJSON *title = cJSON_GetObjectItemCaseSensitive(edit, "title");
+        if (!cJSON_IsNumber(book) || !cJSON_IsString(title))
+        {
+            fprintf(stderr, "Edit needs a numeric \"book\" and a string \"title\"\n");
+            status = 1;
+            continue;
+        }
 
-    printf("[\n");
+        ttl_file *f = file_for_book(files, count, book->valueint);
+        if (!f)
+        {
+            fprintf(stderr, "No title file holds book %d\n", book->valueint);
+            status = 1;
+            continue;
+        }
 
-    int count = 0;
-    while (1)
+        size_t offset = NAME_OFFSET + (size_t)(book->valueint - f->first_book) * NAME_SIZE;
+        int changed = 0;
+        xm_text_write_field(f->data, f->size, offset, title->valuestring, strlen(title->valuestring),
+                            NAME_SIZE, &changed);
+        if (!changed)
+            continue;
+
+        size_t i = (size_t)(f - files);
+        size_t end = offset + NAME_SIZE < f->size ? offset + NAME_SIZE : f->size;
+        if (hi[i] == 0 || offset < lo[i])
+            lo[i] = offset;
+        if (end > hi[i])
+            hi[i] = end;
+    }
+
+    for (int i = 0; i < count; i++)
     {
-        // Read 16 bytes for one name
-        char nameBuf[NAME_SIZE];
-        size_t bytesRead = fread(nameBuf, 1, NAME_SIZE, fp);
-        if (bytesRead == 0)
+        if (hi[i] == 0)
+            continue;
+
+        FILE *fp = fopen(files[i].path, "r+b");
+        if (!fp || fseek(fp, (long)lo[i], SEEK_SET) != 0 ||
+            fwrite(files[i].data + lo[i], 1, hi[i] - lo[i], fp) != hi[i] - lo[i] || fflush(fp) != 0)
         {
-            // No more data
-            break;
+            fprintf(stderr, "Could not write %s\n", files[i].path);
+            status = 1;
         }
-
-        // If partial read, fill leftover with 0
-        if (bytesRead < NAME_SIZE)
+        if (fp)
         {
-            memset(nameBuf + bytesRead, 0, NAME_SIZE - bytesRead);
+            fclose(fp);
+            XM_COUNT(XM_CTR_FILES_OPENED, 1);
+            XM_COUNT(XM_CTR_BYTES_WRITTEN, hi[i] - lo[i]);
         }
+    }
 
-        // Trim trailing null bytes
-        trim_trailing_nulls(nameBuf, NAME_SIZE);
+    free(lo);
+    free(hi);
+    return status;
+}
 
-        // If the entire name is empty after trimming, we can decide to stop or continue
-        // For now, we accept empty strings as valid
-        // If you prefer to stop reading after an empty name, you could break here.
+static void print_titles(const ttl_file *files, int count)
+{
+    xm_buf out;
+    xm_buf_init(&out);
+    xm_buf_putc(&out, '[');
 
-        // Print comma before subsequent entries
-        if (count > 0)
+    int first = 1;
+    for (int i = 0; i < count; i++)
+    {
+        const ttl_file *f = &files[i];
+        int slots = f->data ? ttl_slots(f->size) : 0;
+        for (int slot = 0; slot < slots; slot++)
         {
-            printf(",\n");
+            size_t offset = NAME_OFFSET + (size_t)slot * NAME_SIZE;
+            size_t len = f->size - offset < NAME_SIZE ? f->size - offset : NAME_SIZE;
+            xm_buf_printf(&out, "%s{\"book\":%d,\"title\":\"", first ? "" : ",",
+                          f->first_book + slot);
+            xm_json_text(&out, f->data + offset, len);
+            xm_buf_puts(&out, "\"}");
+            first = 0;
         }
+    }
+
+    xm_buf_puts(&out, "]\n");
+    xm_buf_write(&out, stdout);
+    fflush(stdout);
+    xm_buf_free(&out);
+}
 
-        // Print JSON string. For safety, we do minimal escaping of quotes/backslashes
-        // If you have exotic characters, you may want more robust JSON escaping
-        printf("  \"");
+int main(int argc, char *argv[])
+{
+    XM_TRACE_INIT("ximacro_b");
 
-        for (char *p = nameBuf; *p; p++)
+    int set = argc > 1 && strcmp(argv[1], "--set") == 0;
+    int count = argc - 1 - set;
+    if (count < 1)
+    {
+        fprintf(stderr, "Usage: %s [--set] <file.ttl>...\n", argv[0]);
+        return 1;
+    }
+
+    ttl_file *files = calloc((size_t)count, sizeof *files);
+    if (!files)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    int status = 0;
+    XM_SPAN("read")
+    {
+        for (int i = 0; i < count; i++)
         {
-            if (*p == '\"')
-                printf("\\\"");
-            else if (*p == '\\')
-                printf("\\\\");
-            else
-                putchar(*p);
+            ttl_file *f = &files[i];
+            f->path = argv[1 + set + i];
+            f->first_book = ttl_first_book(f->path, i);
+
+            // The whole file in one read; it is only a few hundred bytes
+            if (xm_read_file(f->path, &f->data, &f->size) != XM_OK)
+            {
+                fprintf(stderr, "Could not open %s\n", f->path);
+                f->data = NULL;
+                status = 1;
+            }
         }
+    }
 
-        printf("\"");
-        count++;
+    if (set)
+    {
+        size_t size;
+        char *input = read_stdin(&size);
+        cJSON *edits = input ? cJSON_ParseWithLength(input, size) : NULL;
+        if (!cJSON_IsArray(edits))
+        {
+            fprintf(stderr, "Expected a JSON array of {\"book\",\"title\"} edits on stdin\n");
+            status = 1;
+        }
+        else
+        {
+            XM_SPAN("write")
+            {
+                if (set_titles(files, count, edits) != 0)
+                    status = 1;
+            }
+        }
+        cJSON_Delete(edits);
+        free(input);
     }
 
-    printf("\n]\n");
-    fflush(stdout);
+    print_titles(files, count);
 
-    fclose(fp);
-    return 0;
+    for (int i = 0; i < count; i++)
+        xm_free(files[i].data);
+    free(files);
+    return status;
 }
@@ -1,73 +1,799 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include "./vendor/dirent/dirent.h" // For opendir, readdir, closedir
-#include <sys/stat.h>               // For stat
-#include <string.h>                 // For strlen, etc.
+#include <stdint.h>
+#include <string.h> // For strlen, etc.
 #include <errno.h>
 
-/**
- * Prints a JSON array of subdirectories in the specified path.
- * Usage: listdirs <dirpath>
- */
-int main(int argc, char *argv[])
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>   // For opendir, readdir, closedir
+#include <fcntl.h>    // For openat
+#include <sys/stat.h> // For fstatat
+#include <unistd.h>
+#endif
+
+#include "ximacro.h"
+#include "xm_text.h"
+#include "xm_trace.h"
+
+// -------------------------------------------------------------------
+// Directory walking
+//
+// One entry of a directory listing. 'size' and 'mtime_ns' are only
+// filled in when the caller asked for them; 'is_dir' always is.
+// -------------------------------------------------------------------
+typedef struct
+{
+    const char *name;
+    int is_dir;
+    long long size;
+    long long mtime_ns;
+} dir_item;
+
+// Returns nonzero if the walk should stat 'name' (when the listing alone
+// doesn't carry size and time).
+typedef int (*want_fn)(const char *name);
+typedef void (*item_fn)(void *ctx, const dir_item *item);
+
+#if defined(_WIN32)
+// FindFirstFileEx returns size and time with each entry, so a walk costs
+// the same whether or not 'want' asks for them.
+static int walk_dir(const char *path, want_fn want, item_fn fn, void *ctx)
 {
-    if (argc < 2)
+    (void)want;
+    char pattern[1024];
+    snprintf(pattern, sizeof(pattern), "%s\\*", path);
+
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileExA(pattern, FindExInfoBasic, &fd, FindExSearchNameMatch,
+                                NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (h == INVALID_HANDLE_VALUE)
+        return XM_ERR_OPEN;
+
+    do
     {
-        fprintf(stderr, "Usage: %s <directory>\n", argv[0]);
-        return 1;
-    }
+        if (strcmp(fd.cFileName, ".") == 0 || strcmp(fd.cFileName, "..") == 0)
+            continue;
+        ULARGE_INTEGER t;
+        t.LowPart = fd.ftLastWriteTime.dwLowDateTime;
+        t.HighPart = fd.ftLastWriteTime.dwHighDateTime;
+
+        dir_item item;
+        item.name = fd.cFileName;
+        item.is_dir = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        item.size = ((long long)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+        // 100 ns ticks since 1601 -> ns since 1970
+        item.mtime_ns = ((long long)t.QuadPart - 116444736000000000LL) * 100;
+        fn(ctx, &item);
+    } while (FindNextFileA(h, &fd));
 
-    const char *dirpath = argv[1];
-    DIR *dp = opendir(dirpath);
+    FindClose(h);
+    return XM_OK;
+}
+#else
+// readdir() supplies d_type on most filesystems; only entries that 'want'
+// picks (or whose type is unknown) cost an fstatat() against the open
+// directory, which skips re-resolving the path each time.
+static int walk_dir(const char *path, want_fn want, item_fn fn, void *ctx)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+        return XM_ERR_OPEN;
+    DIR *dp = fdopendir(fd);
     if (!dp)
     {
-        fprintf(stderr, "Error: could not open directory '%s': %s\n",
-                dirpath, strerror(errno));
-        return 1;
+        close(fd);
+        return XM_ERR_OPEN;
     }
 
-    // We'll collect subdirectory names in an array of strings
-    // for demonstration. For large directories, you might want
-    // a more dynamic approach, but this is a minimal example.
-    // Instead, we can print them directly as we find them.
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        dir_item item = {entry->d_name, 0, 0, 0};
+        int known = 0;
+#if defined(DT_DIR)
+        if (entry->d_type == DT_DIR || entry->d_type == DT_REG)
+        {
+            item.is_dir = entry->d_type == DT_DIR;
+            known = 1;
+        }
+#endif
+        if (!known || (want && want(entry->d_name)))
+        {
+            struct stat st;
+            if (fstatat(dirfd(dp), entry->d_name, &st, 0) != 0)
+                continue;
+            item.is_dir = S_ISDIR(st.st_mode);
+            item.size = (long long)st.st_size;
+#if defined(__APPLE__)
+            item.mtime_ns = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+            item.mtime_ns = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+        }
+        fn(ctx, &item);
+    }
 
-    printf("[");
+    closedir(dp);
+    return XM_OK;
+}
+#endif
+
+// -------------------------------------------------------------------
+// Per-character summary, as cached in the index.
+//
+// A file is only re-read when its size or mtime no longer match the
+// stamp it was summarized from.
+// -------------------------------------------------------------------
+#define TTL_COUNT 2
+#define TTL_NAME_OFFSET 0x18
+#define TTL_NAME_SIZE 0x10
+#define TTL_MAX 4096
+
+static const char *const TTL_NAMES[TTL_COUNT] = {"mcr.ttl", "mcr_2.ttl"};
+
+typedef struct
+{
+    long long size; // -1: absent
+    long long mtime_ns;
+} file_stamp;
+
+typedef struct
+{
+    char name[256];
+    int seen; // found by this scan
+    file_stamp pages[XM_FILE_COUNT];
+    uint8_t macros[XM_FILE_COUNT]; // non-empty macros per page
+    file_stamp ttl[TTL_COUNT];
+    uint16_t ttl_len[TTL_COUNT];
+    uint8_t ttl_data[TTL_COUNT][TTL_MAX];
+} char_entry;
+
+typedef struct
+{
+    char_entry **chars;
+    int count;
+    int cap;
+    int files_read;
+    int files_cached;
+    int dirty; // differs from the index on disk
+} scan_index;
+
+static char_entry *new_entry(const char *name)
+{
+    char_entry *c = malloc(sizeof(*c));
+    if (!c)
+        return NULL;
+    memset(c, 0, sizeof(*c));
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+        c->pages[i].size = -1;
+    for (int i = 0; i < TTL_COUNT; i++)
+        c->ttl[i].size = -1;
+    return c;
+}
+
+static int add_entry(scan_index *idx, char_entry *c)
+{
+    if (idx->count == idx->cap)
+    {
+        int cap = idx->cap ? idx->cap * 2 : 32;
+        char_entry **grown = realloc(idx->chars, (size_t)cap * sizeof(*grown));
+        if (!grown)
+            return XM_ERR_NOMEM;
+        idx->chars = grown;
+        idx->cap = cap;
+    }
+    idx->chars[idx->count++] = c;
+    return XM_OK;
+}
+
+static char_entry *find_entry(const scan_index *idx, const char *name)
+{
+    for (int i = 0; i < idx->count; i++)
+    {
+        if (strcmp(idx->chars[i]->name, name) == 0)
+            return idx->chars[i];
+    }
+    return NULL;
+}
+
+static void free_index(scan_index *idx)
+{
+    for (int i = 0; i < idx->count; i++)
+        free(idx->chars[i]);
+    free(idx->chars);
+}
+
+static int ttl_slot(const char *name)
+{
+    for (int i = 0; i < TTL_COUNT; i++)
+    {
+        if (strcmp(name, TTL_NAMES[i]) == 0)
+            return i;
+    }
+    return -1;
+}
 
+static int count_macros(const uint8_t *data, size_t size)
+{
     int count = 0;
-    struct dirent *entry;
-    while ((entry = readdir(dp)) != NULL)
+    size_t macros = xm_macro_count(size);
+    for (size_t m = 0; m < macros; m++)
     {
-        // Skip "." and ".."
-        if (strcmp(entry->d_name, ".") == 0 ||
-            strcmp(entry->d_name, "..") == 0)
+        for (int field = XM_FIELD_NAME; field < XM_LINES_PER_MACRO; field++)
         {
+            size_t offset, len;
+            if (xm_field_span(size, (int)m, field, &offset, &len) == XM_OK && len > 0 && data[offset])
+            {
+                count++;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// -------------------------------------------------------------------
+// Index file, little-endian; any mismatch just means a full rescan:
+//   "XMCI" u32 version u32 chars
+//   per char: u16 name_len, name,
+//             u16 pages, per page {u16 index, i64 size, i64 mtime, u8 macros}
+//             per ttl {i64 size, i64 mtime, u16 len, bytes}
+//   u64[2] xm_hash128 of everything before it
+// -------------------------------------------------------------------
+#define INDEX_MAGIC "XMCI"
+#define INDEX_VERSION 1
+#define INDEX_DEFAULT_PATH "macro_cache/chars.idx"
+
+static void put_le(xm_buf *b, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        xm_buf_putc(b, (char)(v >> (8 * i)));
+}
+
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    int bad;
+} reader;
+
+static uint64_t get_le(reader *r, int bytes)
+{
+    if (r->end - r->p < bytes)
+    {
+        r->bad = 1;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)r->p[i] << (8 * i);
+    r->p += bytes;
+    return v;
+}
+
+static const uint8_t *get_bytes(reader *r, size_t n)
+{
+    if ((size_t)(r->end - r->p) < n)
+    {
+        r->bad = 1;
+        return NULL;
+    }
+    const uint8_t *p = r->p;
+    r->p += n;
+    return p;
+}
+
+static int load_index(const char *path, scan_index *idx)
+{
+    uint8_t *data;
+    size_t size;
+    if (xm_read_file(path, &data, &size) != XM_OK)
+        return XM_ERR_OPEN;
+
+    uint64_t hash[2];
+    reader r = {data, data + size, size < 12 + 16};
+    if (!r.bad)
+    {
+        xm_hash128(data, size - 16, hash);
+        r.end -= 16;
+        r.bad = memcmp(data, INDEX_MAGIC, 4) != 0 ||
+                memcmp(r.end, hash, 16) != 0;
+        r.p += 4;
+    }
+    if (!r.bad && get_le(&r, 4) != INDEX_VERSION)
+        r.bad = 1;
+
+    uint32_t chars = r.bad ? 0 : (uint32_t)get_le(&r, 4);
+    for (uint32_t i = 0; i < chars && !r.bad; i++)
+    {
+        size_t name_len = (size_t)get_le(&r, 2);
+        const uint8_t *name = get_bytes(&r, name_len);
+        if (r.bad || name_len >= sizeof(((char_entry *)0)->name))
+            break;
+
+        char buf[256];
+        memcpy(buf, name, name_len);
+        buf[name_len] = '\0';
+        char_entry *c = new_entry(buf);
+        if (!c || add_entry(idx, c) != XM_OK)
+        {
+            free(c);
+            break;
+        }
+
+        int pages = (int)get_le(&r, 2);
+        for (int p = 0; p < pages && !r.bad; p++)
+        {
+            int index = (int)get_le(&r, 2);
+            file_stamp st;
+            st.size = (long long)get_le(&r, 8);
+            st.mtime_ns = (long long)get_le(&r, 8);
+            uint8_t macros = (uint8_t)get_le(&r, 1);
+            if (index >= XM_FILE_COUNT)
+                r.bad = 1;
+            else
+            {
+                c->pages[index] = st;
+                c->macros[index] = macros;
+            }
+        }
+        for (int t = 0; t < TTL_COUNT && !r.bad; t++)
+        {
+            c->ttl[t].size = (long long)get_le(&r, 8);
+            c->ttl[t].mtime_ns = (long long)get_le(&r, 8);
+            c->ttl_len[t] = (uint16_t)get_le(&r, 2);
+            const uint8_t *bytes = c->ttl_len[t] <= TTL_MAX ? get_bytes(&r, c->ttl_len[t]) : NULL;
+            if (bytes)
+                memcpy(c->ttl_data[t], bytes, c->ttl_len[t]);
+            else
+                r.bad = 1;
+        }
+    }
+
+    xm_free(data);
+    if (r.bad)
+    {
+        // Stale or damaged: start over
+        fprintf(stderr, "Ignoring unreadable index '%s'.\n", path);
+        free_index(idx);
+        memset(idx, 0, sizeof(*idx));
+        return XM_ERR_FORMAT;
+    }
+    return XM_OK;
+}
+
+static int save_index(const char *path, const scan_index *idx)
+{
+    xm_buf b;
+    xm_buf_init(&b);
+    xm_buf_append(&b, INDEX_MAGIC, 4);
+    put_le(&b, INDEX_VERSION, 4);
+
+    int seen = 0;
+    for (int i = 0; i < idx->count; i++)
+        seen += idx->chars[i]->seen;
+    put_le(&b, (uint64_t)seen, 4);
+
+    for (int i = 0; i < idx->count; i++)
+    {
+        const char_entry *c = idx->chars[i];
+        if (!c->seen)
+            continue; // character folder is gone
+        size_t name_len = strlen(c->name);
+        put_le(&b, name_len, 2);
+        xm_buf_append(&b, c->name, name_len);
+
+        int pages = 0;
+        for (int p = 0; p < XM_FILE_COUNT; p++)
+            pages += c->pages[p].size >= 0;
+        put_le(&b, (uint64_t)pages, 2);
+        for (int p = 0; p < XM_FILE_COUNT; p++)
+        {
+            if (c->pages[p].size < 0)
+                continue;
+            put_le(&b, (uint64_t)p, 2);
+            put_le(&b, (uint64_t)c->pages[p].size, 8);
+            put_le(&b, (uint64_t)c->pages[p].mtime_ns, 8);
+            put_le(&b, c->macros[p], 1);
+        }
+        for (int t = 0; t < TTL_COUNT; t++)
+        {
+            put_le(&b, (uint64_t)c->ttl[t].size, 8);
+            put_le(&b, (uint64_t)c->ttl[t].mtime_ns, 8);
+            put_le(&b, c->ttl_len[t], 2);
+            xm_buf_append(&b, c->ttl_data[t], c->ttl_len[t]);
+        }
+    }
+
+    uint64_t hash[2];
+    xm_hash128(b.data, b.len, hash);
+    xm_buf_append(&b, hash, sizeof(hash));
+
+    // Written aside and renamed so a reader never sees half an index
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    int err = b.failed ? XM_ERR_NOMEM : xm_write_file(temp, (const uint8_t *)b.data, b.len);
+    if (err == XM_OK)
+    {
+        remove(path); // rename() doesn't replace on Windows
+        if (rename(temp, path) != 0)
+            err = XM_ERR_WRITE;
+    }
+    xm_buf_free(&b);
+    return err;
+}
+
+// -------------------------------------------------------------------
+// Scanning
+// -------------------------------------------------------------------
+typedef struct
+{
+    const char *dir;
+    char_entry *c;
+    scan_index *idx;
+    file_stamp found[XM_FILE_COUNT];
+    file_stamp found_ttl[TTL_COUNT];
+} char_scan;
+
+static int is_char_file(const char *name)
+{
+    return xm_file_index(name) >= 0 || ttl_slot(name) >= 0;
+}
+
+static void on_char_file(void *ctx, const dir_item *item)
+{
+    char_scan *s = ctx;
+    if (item->is_dir)
+        return;
+    file_stamp st = {item->size, item->mtime_ns};
+    int index = xm_file_index(item->name);
+    int slot = ttl_slot(item->name);
+    if (index >= 0)
+        s->found[index] = st;
+    else if (slot >= 0)
+        s->found_ttl[slot] = st;
+}
+
+static int same_stamp(const file_stamp *a, const file_stamp *b)
+{
+    return a->size == b->size && a->mtime_ns == b->mtime_ns;
+}
+
+static void refresh_page(char_scan *s, int index)
+{
+    char_entry *c = s->c;
+    const file_stamp *st = &s->found[index];
+    if (st->size < 0)
+    {
+        s->idx->dirty |= c->pages[index].size >= 0;
+        c->pages[index].size = -1;
+        c->macros[index] = 0;
+        return;
+    }
+    if (same_stamp(&c->pages[index], st))
+    {
+        s->idx->files_cached++;
+        return;
+    }
+
+    char path[1024];
+    uint8_t *data;
+    size_t size;
+    c->pages[index] = *st;
+    c->macros[index] = 0;
+    if (xm_file_path(s->dir, index, path, sizeof(path)) == XM_OK &&
+        xm_read_file(path, &data, &size) == XM_OK)
+    {
+        c->macros[index] = (uint8_t)count_macros(data, size);
+        xm_free(data);
+    }
+    s->idx->files_read++;
+    s->idx->dirty = 1;
+}
+
+static void refresh_ttl(char_scan *s, int slot)
+{
+    char_entry *c = s->c;
+    const file_stamp *st = &s->found_ttl[slot];
+    if (st->size < 0)
+    {
+        s->idx->dirty |= c->ttl[slot].size >= 0;
+        c->ttl[slot].size = -1;
+        c->ttl_len[slot] = 0;
+        return;
+    }
+    if (same_stamp(&c->ttl[slot], st))
+    {
+        s->idx->files_cached++;
+        return;
+    }
+
+    char path[1024];
+    size_t size = 0;
+    snprintf(path, sizeof(path), "%s" XM_PATH_SEP_STR "%s", s->dir, TTL_NAMES[slot]);
+    c->ttl[slot] = *st;
+    if (xm_read_file_into(path, c->ttl_data[slot], TTL_MAX, &size) != XM_OK)
+        size = 0;
+    c->ttl_len[slot] = (uint16_t)size;
+    s->idx->files_read++;
+    s->idx->dirty = 1;
+}
+
+static int scan_character(scan_index *idx, const char *root, const char *name)
+{
+    char dir[768];
+    snprintf(dir, sizeof(dir), "%s" XM_PATH_SEP_STR "%s", root, name);
+
+    char_scan *s = malloc(sizeof(*s));
+    if (!s)
+        return XM_ERR_NOMEM;
+    s->dir = dir;
+    s->idx = idx;
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+        s->found[i].size = -1;
+    for (int i = 0; i < TTL_COUNT; i++)
+        s->found_ttl[i].size = -1;
+
+    int err = walk_dir(dir, is_char_file, on_char_file, s);
+    if (err == XM_OK)
+    {
+        s->c = find_entry(idx, name);
+        if (!s->c && (s->c = new_entry(name)) != NULL)
+        {
+            idx->dirty = 1;
+            if (add_entry(idx, s->c) != XM_OK)
+            {
+                free(s->c);
+                s->c = NULL;
+            }
+        }
+        if (!s->c)
+            err = XM_ERR_NOMEM;
+    }
+    if (err == XM_OK)
+    {
+        s->c->seen = 1;
+        for (int i = 0; i < XM_FILE_COUNT; i++)
+            refresh_page(s, i);
+        for (int i = 0; i < TTL_COUNT; i++)
+            refresh_ttl(s, i);
+    }
+    free(s);
+    return err;
+}
+
+typedef struct
+{
+    scan_index *idx;
+    const char *root;
+} root_scan;
+
+static void on_character(void *ctx, const dir_item *item)
+{
+    root_scan *rs = ctx;
+    if (item->is_dir && scan_character(rs->idx, rs->root, item->name) != XM_OK)
+        fprintf(stderr, "Could not scan '%s'.\n", item->name);
+}
+
+// -------------------------------------------------------------------
+// Output:
+//   [{"name":..,"mtime":<unix s>,"macros":N,"pages":[file indices],
+//     "books":[titles from mcr.ttl then mcr_2.ttl]}]
+// -------------------------------------------------------------------
+static void json_character(xm_buf *b, const char_entry *c)
+{
+    long long newest = -1;
+    int macros = 0;
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        if (c->pages[i].size < 0)
             continue;
+        macros += c->macros[i];
+        if (c->pages[i].mtime_ns > newest)
+            newest = c->pages[i].mtime_ns;
+    }
+    for (int t = 0; t < TTL_COUNT; t++)
+    {
+        if (c->ttl[t].size >= 0 && c->ttl[t].mtime_ns > newest)
+            newest = c->ttl[t].mtime_ns;
+    }
+
+    xm_buf_puts(b, "{\"name\":\"");
+    xm_json_escape(b, (const uint8_t *)c->name, strlen(c->name));
+    xm_buf_printf(b, "\",\"mtime\":%lld,\"macros\":%d,\"pages\":[",
+                  newest < 0 ? 0 : newest / 1000000000LL, macros);
+    int first = 1;
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        if (c->pages[i].size < 0)
+            continue;
+        xm_buf_printf(b, first ? "%d" : ",%d", i);
+        first = 0;
+    }
+
+    xm_buf_puts(b, "],\"books\":[");
+    first = 1;
+    for (int t = 0; t < TTL_COUNT; t++)
+    {
+        for (size_t off = TTL_NAME_OFFSET; off < c->ttl_len[t]; off += TTL_NAME_SIZE)
+        {
+            size_t len = c->ttl_len[t] - off < TTL_NAME_SIZE ? c->ttl_len[t] - off : TTL_NAME_SIZE;
+            xm_buf_puts(b, first ? "\"" : ",\"");
+            xm_json_text(b, &c->ttl_data[t][off], len);
+            xm_buf_putc(b, '"');
+            first = 0;
         }
+    }
+    xm_buf_puts(b, "]}");
+}
+
+static int compare_chars(const void *a, const void *b)
+{
+    return strcmp((*(char_entry *const *)a)->name, (*(char_entry *const *)b)->name);
+}
+
+/**
+ * --scan: summarizes every character folder under 'root' in one walk,
+ * reusing what the index at 'index_path' already knows.
+ */
+static int scan_characters(const char *root, const char *index_path, int stats)
+{
+    double start = xm_now_ms();
+    scan_index idx = {0};
+    int cached = 0;
+    XM_SPAN("index")
+    {
+        cached = index_path && load_index(index_path, &idx) == XM_OK;
+    }
+
+    root_scan rs = {&idx, root};
+    int walked = XM_OK;
+    XM_SPAN("walk")
+    {
+        walked = walk_dir(root, NULL, on_character, &rs);
+    }
+    if (walked != XM_OK)
+    {
+        fprintf(stderr, "Error: could not open directory '%s': %s\n", root, strerror(errno));
+        free_index(&idx);
+        return 1;
+    }
 
-        // Build full path to check if it's a directory
-        char fullpath[1024];
-        snprintf(fullpath, sizeof(fullpath), "%s/%s", dirpath, entry->d_name);
+    if (idx.count > 1)
+        qsort(idx.chars, idx.count, sizeof(*idx.chars), compare_chars);
 
-        struct stat sb;
-        if (stat(fullpath, &sb) == 0 && S_ISDIR(sb.st_mode))
+    xm_buf out;
+    xm_buf_init(&out);
+    xm_buf_putc(&out, '[');
+    int first = 1;
+    for (int i = 0; i < idx.count; i++)
+    {
+        if (!idx.chars[i]->seen)
+            continue;
+        if (!first)
+            xm_buf_putc(&out, ',');
+        json_character(&out, idx.chars[i]);
+        first = 0;
+    }
+    xm_buf_puts(&out, "]\n");
+    xm_buf_write(&out, stdout);
+    fflush(stdout);
+    xm_buf_free(&out);
+
+    // Only rewrite the index when the scan found changes
+    int err = XM_OK;
+    for (int i = 0; i < idx.count; i++)
+        idx.dirty |= !idx.chars[i]->seen;
+    if (index_path && (idx.dirty || !cached))
+    {
+        char dir[1024];
+        snprintf(dir, sizeof(dir), "%s", index_path);
+        char *base = (char *)xm_basename(dir);
+        if (base > dir)
         {
-            // It's a directory; print it in JSON
-            // Comma-separate entries after the first
-            if (count > 0)
-                printf(",");
-            // Minimal JSON-escaping in case of quotes/backslashes is omitted.
-            // If you have unusual directory names, you may need more robust escaping.
-            printf("\n  \"%s\"", entry->d_name);
-
-            count++;
+            base[-1] = '\0';
+            xm_ensure_dir(dir);
         }
+        if ((err = save_index(index_path, &idx)) != XM_OK)
+            fprintf(stderr, "Could not write index '%s': %s.\n", index_path, xm_strerror(err));
     }
 
-    closedir(dp);
+    if (stats)
+        fprintf(stderr, "chars=%d files_read=%d files_cached=%d index=%s total_ms=%.2f\n",
+                idx.count, idx.files_read, idx.files_cached,
+                index_path ? (cached ? "hit" : "miss") : "off", xm_now_ms() - start);
+    free_index(&idx);
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// Default mode: JSON array of the subdirectory names
+// -------------------------------------------------------------------
+typedef struct
+{
+    xm_buf *out;
+    int count;
+} dir_list;
+
+static void on_subdir(void *ctx, const dir_item *item)
+{
+    dir_list *list = ctx;
+    if (!item->is_dir)
+        return;
+    // Comma-separate entries after the first
+    xm_buf_puts(list->out, list->count++ > 0 ? ",\n  \"" : "\n  \"");
+    xm_json_escape(list->out, (const uint8_t *)item->name, strlen(item->name));
+    xm_buf_putc(list->out, '"');
+}
 
-    if (count > 0)
-        printf("\n");
-    printf("]\n");
+static int list_subdirs(const char *dirpath)
+{
+    xm_buf out;
+    xm_buf_init(&out);
+    xm_buf_putc(&out, '[');
+
+    dir_list list = {&out, 0};
+    if (walk_dir(dirpath, NULL, on_subdir, &list) != XM_OK)
+    {
+        fprintf(stderr, "Error: could not open directory '%s': %s\n",
+                dirpath, strerror(errno));
+        xm_buf_free(&out);
+        return 1;
+    }
 
+    if (list.count > 0)
+        xm_buf_putc(&out, '\n');
+    xm_buf_puts(&out, "]\n");
+    xm_buf_write(&out, stdout);
+    xm_buf_free(&out);
     return 0;
 }
+
+/**
+ * Prints a JSON array of subdirectories in the specified path, or with
+ * --scan a summary of each character folder in it (see json_character).
+ * Usage: ximacro_c <directory>
+ *        ximacro_c --scan [--index=PATH | --no-index] [--stats] <USER dir>
+ */
+int main(int argc, char *argv[])
+{
+    int scan = 0;
+    int stats = 0;
+    int bad = 0;
+    const char *index_path = INDEX_DEFAULT_PATH;
+    const char *dirpath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--scan") == 0)
+            scan = 1;
+        else if (strncmp(argv[i], "--index=", 8) == 0 && argv[i][8])
+            index_path = argv[i] + 8;
+        else if (strcmp(argv[i], "--no-index") == 0)
+            index_path = NULL;
+        else if (strcmp(argv[i], "--stats") == 0)
+            stats = 1;
+        else if (!dirpath && strncmp(argv[i], "--", 2) != 0)
+            dirpath = argv[i];
+        else
+            bad = 1;
+    }
+
+    if (!dirpath || bad)
+    {
+        fprintf(stderr, "Usage: %s <directory>\n"
+                        "       %s --scan [--index=PATH | --no-index] [--stats] <USER directory>\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+
+    XM_TRACE_INIT("ximacro_c");
+    return scan ? scan_characters(dirpath, index_path, stats) : list_subdirs(dirpath);
+}
@@ -3,12 +3,20 @@
 #include <stdint.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 
-#define LINES_PER_MACRO 6
-#define LINE_SIZE 0x3D
-#define NAME_SIZE 0x0E
-#define MACRO_SIZE ((LINES_PER_MACRO * LINE_SIZE) + NAME_SIZE)
-#define MACRO_START 0x1C
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "ximacro.h"
+#include "xm_bin.h"
+#include "xm_io.h"
+#include "xm_text.h"
+#include "xm_thread.h"
+#include "xm_trace.h"
+#include "xm_watch.h"
 
 // Trim leading and trailing spaces from a string
 static void trim_whitespace(char *str)
@@ -27,167 +35,919 @@ static void trim_whitespace(char *str)
     *(end + 1) = 0;
 }
 
-static void print_data(const uint8_t *ptr, size_t max_len)
+// Stops the C runtime from translating "\n" in --format=bin output
+static void set_binary_mode(FILE *fp)
+{
+#if defined(_WIN32)
+    _setmode(_fileno(fp), _O_BINARY);
+#else
+    (void)fp;
+#endif
+}
+
+// -------------------------------------------------------------------
+// One mcr*.dat in output order, and where its JSON object comes from:
+// the parse cache, or a chunk buffer it was just encoded into.
+// -------------------------------------------------------------------
+typedef enum
+{
+    FILE_MISSING, // could not be loaded; not exported or cached
+    FILE_CACHED,  // size and mtime matched the cache
+    FILE_REHASHED, // read again, but the content hash matched the cache
+    FILE_ENCODED
+} file_state;
+
+typedef struct
+{
+    int index;
+    long long size;
+    long long mtime_ns;
+    uint64_t hash[2];
+    file_state state;
+    const char *json; // no separators; empty for files too short to hold macros.
+                      // With --format=bin, the file's binary record instead
+    size_t json_len;
+    const xm_buf *buf; // FILE_ENCODED: json is at buf->data + json_off
+    size_t json_off;
+    int checksum; // --verify: 1 header MD5 matches, -1 it doesn't, 0 not checked
+    int chunk;    // the chunk that loads it; -1 if the cache served it
+} export_file;
+
+static const char *file_json(const export_file *f)
+{
+    return f->state == FILE_ENCODED ? f->buf->data + f->json_off : f->json;
+}
+
+// -------------------------------------------------------------------
+// Parse cache: the encoded JSON (or, for --format=bin, the binary record)
+// of every file of one folder, keyed by size, mtime and content hash. Each
+// format has its own cache file. Little-endian:
+//   "XMEC" u32 version u32 api_version i64 written (ns since 1970)
+//   u32 dir_len, dir
+//   u32 files, per file {u16 index, i64 size, i64 mtime,
+//                        u64 hash[2], u32 json_len, json}
+//   u64[2] xm_hash128 of everything before it
+// -------------------------------------------------------------------
+#define CACHE_MAGIC "XMEC"
+#define CACHE_VERSION 2 // 2: field text decoded by xm_json_text()
+#define CACHE_DEFAULT_DIR "macro_cache"
+
+// A file written this close to the cache itself may have changed again
+// within the same mtime tick, so its stamp alone is not trusted.
+#define CACHE_RACY_NS 2000000000LL
+
+typedef struct
+{
+    int present;
+    long long size;
+    long long mtime_ns;
+    uint64_t hash[2];
+    const char *json;
+    size_t json_len;
+} cache_entry;
+
+typedef struct
 {
-    for (size_t i = 0; i < max_len && ptr[i] != 0; i++)
+    char path[1024];
+    uint8_t *blob; // backs every 'json' pointer
+    long long written_ns;
+    cache_entry files[XM_FILE_COUNT];
+} export_cache;
+
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    int bad;
+} reader;
+
+static uint64_t get_le(reader *r, int bytes)
+{
+    if (r->end - r->p < bytes)
     {
-        char c = ptr[i];
-        switch (c)
-        {
-        case '\"':
-            printf("\\\"");
-            break;
-        case '\\':
-            printf("\\\\");
-            break;
-        case '\b':
-            printf("\\b");
-            break;
-        case '\f':
-            printf("\\f");
-            break;
-        case '\n':
-            printf("\\n");
-            break;
-        case '\r':
-            printf("\\r");
-            break;
-        case '\t':
-            printf("\\t");
-            break;
-        default:
-            if (c >= 32 && c <= 126)
-                printf("%c", c);
-            else
-                printf("\\u%04X", (unsigned char)c);
-        }
+        r->bad = 1;
+        return 0;
     }
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint64_t)r->p[i] << (8 * i);
+    r->p += bytes;
+    return v;
 }
 
-static void print_macro(const uint8_t *macro_ptr, size_t start_offset, size_t chunk_size)
+static const uint8_t *get_bytes(reader *r, size_t n)
 {
-    printf("{\"offset\":\"0x%04zX\",\"lines\":[", start_offset);
+    if ((size_t)(r->end - r->p) < n)
+    {
+        r->bad = 1;
+        return NULL;
+    }
+    const uint8_t *p = r->p;
+    r->p += n;
+    return p;
+}
 
-    for (int line = 0; line < LINES_PER_MACRO; line++)
+static void put_le(xm_buf *b, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        xm_buf_putc(b, (char)(v >> (8 * i)));
+}
+
+/**
+ * Names the cache of 'dir' under 'cache_dir' (e-<key>.bin for JSON,
+ * b-<key>.bin for binary records) and loads it if it is intact and was
+ * written for the same folder string by this encoder version.
+ */
+static int load_cache(export_cache *cache, const char *cache_dir, const char *dir, int binary)
+{
+    uint64_t key[2];
+    char hex[33];
+    xm_hash128(dir, strlen(dir), key);
+    xm_hash128_hex(key, hex);
+    snprintf(cache->path, sizeof(cache->path), "%s/%c-%s.bin", cache_dir, binary ? 'b' : 'e', hex);
+
+    size_t size;
+    if (xm_read_file(cache->path, &cache->blob, &size) != XM_OK)
+        return XM_ERR_OPEN;
+
+    uint64_t hash[2];
+    reader r = {cache->blob, cache->blob + size, size < 24 + 16};
+    if (!r.bad)
     {
-        size_t line_offset_in_file = start_offset + (line * LINE_SIZE);
-        size_t offset_in_macro_ptr = line * LINE_SIZE;
-        size_t bytes_left_in_this_macro = chunk_size - offset_in_macro_ptr;
-        if (bytes_left_in_this_macro == 0)
-            break;
+        r.end -= 16;
+        xm_hash128(cache->blob, size - 16, hash);
+        r.bad = memcmp(r.end, hash, 16) != 0 || memcmp(cache->blob, CACHE_MAGIC, 4) != 0;
+        r.p += 4;
+    }
+    if (!r.bad && (get_le(&r, 4) != CACHE_VERSION || get_le(&r, 4) != XM_API_VERSION))
+        r.bad = 1;
+    cache->written_ns = (long long)get_le(&r, 8);
 
-        size_t can_print = (bytes_left_in_this_macro < LINE_SIZE) ? bytes_left_in_this_macro : LINE_SIZE;
+    size_t dir_len = (size_t)get_le(&r, 4);
+    const uint8_t *dir_bytes = get_bytes(&r, dir_len);
+    if (!r.bad && (dir_len != strlen(dir) || memcmp(dir_bytes, dir, dir_len) != 0))
+        r.bad = 1;
 
-        if (line > 0)
-            printf(",");
-        printf("{\"offset\":\"0x%04zX\",\"data\":\"", line_offset_in_file);
-        print_data(&macro_ptr[offset_in_macro_ptr], can_print);
-        printf("\"}");
+    uint32_t files = (uint32_t)get_le(&r, 4);
+    for (uint32_t i = 0; i < files && !r.bad; i++)
+    {
+        int index = (int)get_le(&r, 2);
+        cache_entry e;
+        e.present = 1;
+        e.size = (long long)get_le(&r, 8);
+        e.mtime_ns = (long long)get_le(&r, 8);
+        e.hash[0] = get_le(&r, 8);
+        e.hash[1] = get_le(&r, 8);
+        e.json_len = (size_t)get_le(&r, 4);
+        e.json = (const char *)get_bytes(&r, e.json_len);
+        if (index > XM_MAX_FILE_INDEX)
+            r.bad = 1;
+        else if (!r.bad)
+            cache->files[index] = e;
     }
 
-    printf("]");
-    size_t name_start = LINES_PER_MACRO * LINE_SIZE;
-    if (chunk_size > name_start)
+    if (r.bad)
     {
-        size_t name_len_available = chunk_size - name_start;
-        size_t name_len = (name_len_available < NAME_SIZE) ? name_len_available : NAME_SIZE;
+        memset(cache->files, 0, sizeof(cache->files));
+        xm_free(cache->blob);
+        cache->blob = NULL;
+        return XM_ERR_FORMAT;
+    }
+    return XM_OK;
+}
 
-        printf(",\"name\":\"");
-        print_data(&macro_ptr[name_start], name_len);
-        printf("\"}");
+/**
+ * Writes the cache for 'files', the export of indexes 'lo'..'hi'. Entries
+ * of the old cache outside that range are kept as they were, so a partial
+ * export doesn't cost the next full one its hits.
+ */
+static int save_cache(const export_cache *cache, const char *cache_dir, const char *dir,
+                      const export_file *files, int count, int lo, int hi)
+{
+    xm_buf b;
+    xm_buf_init(&b);
+    xm_buf_append(&b, CACHE_MAGIC, 4);
+    put_le(&b, CACHE_VERSION, 4);
+    put_le(&b, XM_API_VERSION, 4);
+    put_le(&b, (uint64_t)time(NULL) * 1000000000ULL, 8);
+    put_le(&b, strlen(dir), 4);
+    xm_buf_puts(&b, dir);
+
+    int cached = 0;
+    for (int i = 0; i < count; i++)
+        cached += files[i].state != FILE_MISSING;
+    for (int i = 0; i <= XM_MAX_FILE_INDEX; i++)
+        cached += (i < lo || i > hi) && cache->files[i].present;
+    put_le(&b, (uint64_t)cached, 4);
+
+    for (int i = 0, next = 0; i <= XM_MAX_FILE_INDEX; i++)
+    {
+        cache_entry e = cache->files[i];
+        if (i >= lo && i <= hi)
+        {
+            while (next < count && files[next].index < i)
+                next++;
+            const export_file *f = next < count && files[next].index == i ? &files[next] : NULL;
+            e.present = f && f->state != FILE_MISSING;
+            if (e.present)
+            {
+                e.size = f->size;
+                e.mtime_ns = f->mtime_ns;
+                e.hash[0] = f->hash[0];
+                e.hash[1] = f->hash[1];
+                e.json = file_json(f);
+                e.json_len = f->json_len;
+            }
+        }
+        if (!e.present)
+            continue;
+        put_le(&b, (uint64_t)i, 2);
+        put_le(&b, (uint64_t)e.size, 8);
+        put_le(&b, (uint64_t)e.mtime_ns, 8);
+        put_le(&b, e.hash[0], 8);
+        put_le(&b, e.hash[1], 8);
+        put_le(&b, e.json_len, 4);
+        xm_buf_append(&b, e.json, e.json_len);
     }
-    else
+
+    uint64_t hash[2];
+    xm_hash128(b.data, b.len, hash);
+    xm_buf_append(&b, hash, sizeof(hash));
+
+    // Written aside and renamed so a concurrent run never reads half a cache
+    char temp[1024 + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", cache->path);
+    int err = xm_ensure_dir(cache_dir);
+    if (err == XM_OK)
+        err = b.failed ? XM_ERR_NOMEM : xm_write_file(temp, (const uint8_t *)b.data, b.len);
+    if (err == XM_OK)
     {
-        printf("}");
+        remove(cache->path); // rename() doesn't replace on Windows
+        if (rename(temp, cache->path) != 0)
+            err = XM_ERR_WRITE;
     }
+    xm_buf_free(&b);
+    return err;
 }
 
-static void process_macro_file(const char *filename, int *printed_any_macro)
+/**
+ * Serves 'f' from the cache when its stamp matches and isn't racy.
+ */
+static int cache_lookup(const export_cache *cache, export_file *f)
 {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp)
-        return;
+    const cache_entry *e = &cache->files[f->index];
+    if (!e->present || e->size != f->size || e->mtime_ns != f->mtime_ns ||
+        f->mtime_ns >= cache->written_ns - CACHE_RACY_NS)
+        return 0;
 
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
+    f->state = FILE_CACHED;
+    f->hash[0] = e->hash[0];
+    f->hash[1] = e->hash[1];
+    f->json = e->json;
+    f->json_len = e->json_len;
+    return 1;
+}
+
+/**
+ * Files are loaded and encoded in chunks, one chunk per pool task, each
+ * into its own buffer. Only files the cache could not serve are loaded.
+ * Output is then written in file order, so it matches a single-threaded,
+ * uncached run byte for byte.
+ */
+typedef struct
+{
+    xm_buf out;
+    xm_io_backend used;
+    size_t bytes_in;
+    double load_ms;
+    double encode_ms;
+} export_chunk;
 
-    if (file_size <= MACRO_START)
+typedef struct
+{
+    const char *dir;
+    xm_io_backend backend;
+    xm_view *views;
+    export_file **targets; // targets[i] receives views[i]
+    int count;
+    int per_chunk;
+    export_chunk *chunks;
+    const export_cache *cache;
+    int binary; // --format=bin
+    int verify; // --verify
+} export_job;
+
+static void export_chunk_task(void *ctx, int task)
+{
+    export_job *job = ctx;
+    export_chunk *chunk = &job->chunks[task];
+    int first = task * job->per_chunk;
+    int n = job->count - first < job->per_chunk ? job->count - first : job->per_chunk;
+    xm_view *views = job->views + first;
+
+    double t0 = xm_now_ms();
+    XM_SPAN("load")
     {
-        fclose(fp);
-        return;
+        chunk->used = xm_io_load(job->backend, job->dir, views, n);
     }
+    double t1 = xm_now_ms();
 
-    uint8_t *buffer = malloc(file_size);
-    if (!buffer)
+    // Header checksums of the whole chunk, hashed several files at a time
+    if (job->verify)
     {
-        fclose(fp);
-        return;
+        XM_SPAN("verify")
+        {
+            const uint8_t *data[XM_FILE_COUNT];
+            size_t sizes[XM_FILE_COUNT];
+            int ok[XM_FILE_COUNT];
+            int loaded = 0;
+            for (int i = 0; i < n; i++)
+            {
+                if (!views[i].data)
+                    continue;
+                data[loaded] = views[i].data;
+                sizes[loaded++] = views[i].size;
+            }
+            xm_header_check_many(data, sizes, (size_t)loaded, ok);
+            for (int i = 0, j = 0; i < n; i++)
+            {
+                if (views[i].data)
+                    job->targets[first + i]->checksum = ok[j++] ? 1 : -1;
+            }
+        }
     }
-    size_t bytes_read = fread(buffer, 1, file_size, fp);
-    fclose(fp);
-    if (bytes_read < MACRO_START)
+
+    char filename[768];
+    XM_SPAN("encode")
     {
-        free(buffer);
-        return;
+        for (int i = 0; i < n; i++)
+        {
+            export_file *f = job->targets[first + i];
+            if (!views[i].data || xm_file_path(job->dir, views[i].index, filename, sizeof(filename)) != XM_OK)
+                continue;
+            chunk->bytes_in += views[i].size;
+
+            // Touched but unchanged (or stamped too recently to trust): the
+            // cached encoding still holds
+            const cache_entry *e = job->cache ? &job->cache->files[f->index] : NULL;
+            xm_hash128(views[i].data, views[i].size, f->hash);
+            f->size = (long long)views[i].size;
+            if (e && e->present && e->size == f->size &&
+                e->hash[0] == f->hash[0] && e->hash[1] == f->hash[1])
+            {
+                f->state = FILE_REHASHED;
+                f->json = e->json;
+                f->json_len = e->json_len;
+                continue;
+            }
+
+            f->state = FILE_ENCODED;
+            f->buf = &chunk->out;
+            f->json_off = chunk->out.len;
+            if (job->binary)
+                xm_bin_file(&chunk->out, views[i].index, views[i].data, views[i].size);
+            else if (views[i].size > XM_MACRO_START)
+                xm_json_file(&chunk->out, filename, views[i].data, views[i].size);
+            f->json_len = chunk->out.len - f->json_off;
+        }
     }
+    xm_io_release(views, n);
 
-    if (*printed_any_macro)
-        printf(",");
+    chunk->load_ms = t1 - t0;
+    chunk->encode_ms = xm_now_ms() - t1;
+}
 
-    printf("{\"fileName\":\"");
-    print_data((const uint8_t *)filename, strlen(filename));
-    printf("\",\"fileSize\":%ld,\"macros\":[", file_size);
+// -------------------------------------------------------------------
+// --book=N and --pages=A-B export only part of a folder: book N (0-based)
+// is pages N*10 to N*10+9, and pages are file indexes (mcr.dat is 0).
+// Every JSON object is tagged with its "index", "book" and "page"; binary
+// records carry the index already.
+// -------------------------------------------------------------------
+#define PAGES_PER_BOOK 10
 
-    int macro_index = 0;
-    for (size_t offset = MACRO_START; offset < bytes_read; offset += MACRO_SIZE)
+static int parse_pages(const char *arg, int *lo, int *hi)
+{
+    char *end;
+    long a = strtol(arg, &end, 10);
+    long b = a;
+    if (end != arg && *end == '-')
     {
-        if (macro_index > 0)
-            printf(",");
-        macro_index++;
-        size_t remain = bytes_read - offset;
-        size_t chunk_size = (remain < MACRO_SIZE) ? remain : MACRO_SIZE;
-        print_macro(&buffer[offset], offset, chunk_size);
+        const char *second = end + 1;
+        b = strtol(second, &end, 10);
+        if (end == second)
+            return -1;
     }
+    if (end == arg || *end || a < 0 || a > b || b > XM_MAX_FILE_INDEX)
+        return -1;
+    *lo = (int)a;
+    *hi = (int)b;
+    return 0;
+}
 
-    printf("]}");
+/**
+ * Writes the JSON object of 'f' with its position ahead of the members of
+ * the (possibly cached) encoding. Returns the bytes written, or -1.
+ */
+static long write_tagged(const export_file *f, FILE *out)
+{
+    char tag[64];
+    int n = snprintf(tag, sizeof(tag), "{\"index\":%d,\"book\":%d,\"page\":%d,", f->index,
+                     f->index / PAGES_PER_BOOK, f->index % PAGES_PER_BOOK);
+    if (fwrite(tag, 1, (size_t)n, out) != (size_t)n ||
+        fwrite(file_json(f) + 1, 1, f->json_len - 1, out) != f->json_len - 1)
+        return -1;
+    return (long)(n + f->json_len - 1);
+}
 
-    *printed_any_macro = 1;
+// -------------------------------------------------------------------
+// --format=ndjson: one tagged JSON object per line, in file order, each
+// written and flushed as soon as it and every file before it is ready.
+// Files the cache serves go out at once; the rest are encoded a batch of
+// chunks (one per thread, at most a book each) at a time, so the first
+// book reaches the reader before the last is read.
+// -------------------------------------------------------------------
+typedef struct
+{
+    export_job *job;
+    int first;
+} chunk_batch;
 
-    free(buffer);
+static void batch_chunk_task(void *ctx, int task)
+{
+    chunk_batch *batch = ctx;
+    export_chunk_task(batch->job, batch->first + task);
+}
+
+static int stream_ndjson(export_job *job, int chunk_count, int threads,
+                         const export_file *files, int count, size_t *bytes_out)
+{
+    int res = XM_OK;
+    int next = 0;
+    for (int done = 0; res == XM_OK;)
+    {
+        // Everything up to the first file of an unfinished chunk is ready
+        for (; next < count && files[next].chunk < done; next++)
+        {
+            const export_file *f = &files[next];
+            if (f->state == FILE_MISSING || f->json_len == 0)
+                continue;
+            if (f->chunk >= 0 && job->chunks[f->chunk].out.failed)
+            {
+                res = XM_ERR_NOMEM;
+                break;
+            }
+            long n = write_tagged(f, stdout);
+            if (n < 0 || fputc('\n', stdout) == EOF)
+            {
+                res = XM_ERR_WRITE;
+                break;
+            }
+            *bytes_out += (size_t)n + 1;
+        }
+        if (res == XM_OK && fflush(stdout) != 0)
+            res = XM_ERR_WRITE; // reader went away
+        if (done >= chunk_count || next >= count)
+            break;
+
+        chunk_batch batch = {job, done};
+        int n = chunk_count - done < threads ? chunk_count - done : threads;
+        xm_parallel_for(n, threads, batch_chunk_task, &batch);
+        done += n;
+    }
+    return res;
+}
+
+// -------------------------------------------------------------------
+// --watch: one NDJSON event per changed file, for as long as it runs:
+//   {"event":"ready","backend":"inotify"|"poll"}
+//   {"event":"change","index":N,"file":{..as in the export..}}
+//   {"event":"remove","index":N}
+//   {"event":"books","ttl":0|1,"titles":[..]}   mcr.ttl / mcr_2.ttl
+// Files rewritten with the same bytes produce no event.
+// -------------------------------------------------------------------
+#define TTL_NAME_OFFSET 0x18
+#define TTL_NAME_SIZE 0x10
+
+static void emit_watch_event(xm_buf *out, const char *dir, int slot,
+                             const uint8_t *data, size_t size)
+{
+    if (slot >= XM_WATCH_TTL_SLOT)
+    {
+        xm_buf_printf(out, "{\"event\":\"books\",\"ttl\":%d,\"titles\":[", slot - XM_WATCH_TTL_SLOT);
+        for (size_t off = TTL_NAME_OFFSET; data && off < size; off += TTL_NAME_SIZE)
+        {
+            size_t len = size - off < TTL_NAME_SIZE ? size - off : TTL_NAME_SIZE;
+            xm_buf_puts(out, off > TTL_NAME_OFFSET ? ",\"" : "\"");
+            xm_json_text(out, data + off, len);
+            xm_buf_putc(out, '"');
+        }
+        xm_buf_puts(out, "]}\n");
+    }
+    else if (!data)
+    {
+        xm_buf_printf(out, "{\"event\":\"remove\",\"index\":%d}\n", slot);
+    }
+    else
+    {
+        char filename[768];
+        xm_file_path(dir, slot, filename, sizeof(filename));
+        xm_buf_printf(out, "{\"event\":\"change\",\"index\":%d,\"file\":", slot);
+        if (size > XM_MACRO_START)
+            xm_json_file(out, filename, data, size);
+        else
+            xm_buf_puts(out, "null");
+        xm_buf_puts(out, "}\n");
+    }
+}
+
+static int watch_folder(const char *dir, int poll_ms, int debounce_ms)
+{
+    xm_watch *w = xm_watch_open(dir, poll_ms > 0 ? XM_WATCH_POLL : XM_WATCH_INOTIFY, poll_ms);
+    if (!w)
+    {
+        fprintf(stderr, "Could not watch '%s'\n", dir);
+        return 1;
+    }
+
+    // Content hashes of what the client has seen; absent files are all zero
+    static uint64_t hashes[XM_WATCH_SLOTS][2];
+    static uint8_t present[XM_WATCH_SLOTS];
+    char path[1024];
+    for (int slot = 0; slot < XM_WATCH_SLOTS; slot++)
+    {
+        uint8_t *data;
+        size_t size;
+        if (xm_watch_slot_path(dir, slot, path, sizeof(path)) == XM_OK &&
+            xm_read_file(path, &data, &size) == XM_OK)
+        {
+            xm_hash128(data, size, hashes[slot]);
+            present[slot] = 1;
+            xm_free(data);
+        }
+    }
+
+    xm_buf out;
+    xm_buf_init(&out);
+    printf("{\"event\":\"ready\",\"backend\":\"%s\"}\n", xm_watch_backend_name(xm_watch_backend_used(w)));
+    fflush(stdout);
+
+    uint8_t changed[XM_WATCH_SLOTS];
+    int res;
+    while ((res = xm_watch_next(w, debounce_ms, changed)) >= 0)
+    {
+        out.len = 0;
+        for (int slot = 0; slot < XM_WATCH_SLOTS; slot++)
+        {
+            if (!changed[slot])
+                continue;
+
+            uint8_t *data = NULL;
+            size_t size = 0;
+            uint64_t hash[2] = {0, 0};
+            int now_present = xm_watch_slot_path(dir, slot, path, sizeof(path)) == XM_OK &&
+                              xm_read_file(path, &data, &size) == XM_OK;
+            if (now_present)
+                xm_hash128(data, size, hash);
+
+            if (now_present != present[slot] || hash[0] != hashes[slot][0] || hash[1] != hashes[slot][1])
+            {
+                emit_watch_event(&out, dir, slot, data, size);
+                present[slot] = (uint8_t)now_present;
+                hashes[slot][0] = hash[0];
+                hashes[slot][1] = hash[1];
+            }
+            xm_free(data);
+        }
+        if (out.len > 0 && (xm_buf_write(&out, stdout) != XM_OK || fflush(stdout) != 0))
+            break; // client went away
+    }
+
+    if (res < 0)
+        fprintf(stderr, "Stopped watching '%s': %s\n", dir, xm_strerror(res));
+    xm_buf_free(&out);
+    xm_watch_close(w);
+    return res < 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [--io=mmap|uring|stdio] [--threads=N] [--cache=DIR | --no-cache] "
+                    "[--format=json|bin|ndjson] [--book=N | --pages=A-B] [--verify] [--stats] <directory_prefix>\n"
+                    "       %s --watch [--poll=MS] [--debounce=MS] <directory_prefix>\n",
+            prog, prog);
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc < 2)
+    XM_TRACE_INIT("ximacro_e");
+
+    xm_io_backend backend = XM_IO_MMAP;
+    int stats = 0;
+    int verify = 0;
+    int threads = 0; // 0 = one per CPU
+    const char *cache_dir = CACHE_DEFAULT_DIR;
+    const char *dir_arg = NULL;
+    int watch = 0;
+    int poll_ms = 0; // 0 = kernel notifications where available
+    int debounce_ms = 200;
+    int binary = 0;
+    int ndjson = 0;
+    int lo = 0;
+    int hi = XM_MAX_FILE_INDEX;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--io=", 5) == 0)
+        {
+            if (xm_io_parse_backend(argv[i] + 5, &backend) != XM_OK)
+            {
+                fprintf(stderr, "Unknown I/O backend '%s'\n", argv[i] + 5);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            threads = atoi(argv[i] + 10);
+            if (threads < 1)
+            {
+                fprintf(stderr, "Invalid thread count '%s'\n", argv[i] + 10);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--cache=", 8) == 0 && argv[i][8])
+            cache_dir = argv[i] + 8;
+        else if (strcmp(argv[i], "--no-cache") == 0)
+            cache_dir = NULL;
+        else if (strcmp(argv[i], "--stats") == 0)
+            stats = 1;
+        else if (strcmp(argv[i], "--verify") == 0)
+            verify = 1;
+        else if (strcmp(argv[i], "--watch") == 0)
+            watch = 1;
+        else if (strncmp(argv[i], "--poll=", 7) == 0 && atoi(argv[i] + 7) > 0)
+            poll_ms = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--debounce=", 11) == 0 && atoi(argv[i] + 11) >= 0)
+            debounce_ms = atoi(argv[i] + 11);
+        else if (strncmp(argv[i], "--format=", 9) == 0)
+        {
+            const char *format = argv[i] + 9;
+            binary = strcmp(format, "bin") == 0;
+            ndjson = strcmp(format, "ndjson") == 0;
+            if (!binary && !ndjson && strcmp(format, "json") != 0)
+            {
+                fprintf(stderr, "Unknown format '%s'\n", format);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--book=", 7) == 0 || strncmp(argv[i], "--pages=", 8) == 0)
+        {
+            int book = argv[i][2] == 'b';
+            const char *value = argv[i] + (book ? 7 : 8);
+            if (parse_pages(value, &lo, &hi) != 0 || (book && lo != hi) ||
+                (book && lo > XM_MAX_FILE_INDEX / PAGES_PER_BOOK))
+            {
+                fprintf(stderr, "Invalid %s '%s'\n", book ? "book" : "page range", value);
+                return 1;
+            }
+            if (book)
+            {
+                lo *= PAGES_PER_BOOK;
+                hi = lo + PAGES_PER_BOOK - 1 < XM_MAX_FILE_INDEX ? lo + PAGES_PER_BOOK - 1 : XM_MAX_FILE_INDEX;
+            }
+        }
+        else
+            dir_arg = argv[i];
+    }
+
+    int partial = lo > 0 || hi < XM_MAX_FILE_INDEX;
+    if (!dir_arg || (watch && (binary || ndjson || partial)))
     {
-        fprintf(stderr, "Usage: %s <directory_prefix>\n", argv[0]);
+        usage(argv[0]);
         return 1;
     }
 
     char directory_prefix[512];
 #ifdef _MSC_VER
-    strncpy_s(directory_prefix, sizeof(directory_prefix), argv[1], _TRUNCATE);
+    strncpy_s(directory_prefix, sizeof(directory_prefix), dir_arg, _TRUNCATE);
 #else
-    strncpy(directory_prefix, argv[1], sizeof(directory_prefix) - 1);
+    strncpy(directory_prefix, dir_arg, sizeof(directory_prefix) - 1);
     directory_prefix[sizeof(directory_prefix) - 1] = '\0';
 #endif
     trim_whitespace(directory_prefix);
 
-    printf("[");
-    int printed_any_macro = 0;
+    if (watch)
+        return watch_folder(directory_prefix, poll_ms, debounce_ms);
 
-    char filename[768];
-    snprintf(filename, sizeof(filename), "%s\\mcr.dat", directory_prefix);
-    process_macro_file(filename, &printed_any_macro);
+    double t_start = xm_now_ms();
 
-    for (int i = 1; i <= 400; i++)
+    // One directory enumeration instead of probing all 401 names. If the
+    // folder can't be listed, fall back to trying every index.
+    uint8_t present[XM_FILE_COUNT];
+    XM_SPAN("scan")
     {
-        snprintf(filename, sizeof(filename), "%s\\mcr%d.dat", directory_prefix, i);
-        process_macro_file(filename, &printed_any_macro);
+        int found = xm_scan_macro_dir(directory_prefix, present);
+        if (found < 0)
+            memset(present, 1, sizeof(present));
+        memset(present, 0, (size_t)lo);
+        memset(present + hi + 1, 0, (size_t)(XM_MAX_FILE_INDEX - hi));
     }
 
-    printf("]");
-    fflush(stdout);
-    return 0;
+    // --verify needs the bytes of every file, so the cache can't serve any
+    // (it's still loaded for its path, and rewritten afterwards)
+    static export_cache cache;
+    int cache_loaded = cache_dir && load_cache(&cache, cache_dir, directory_prefix, binary) == XM_OK && !verify;
+
+    // Stamp every file; whatever the cache can't serve gets loaded
+    static export_file files[XM_FILE_COUNT];
+    static xm_view views[XM_FILE_COUNT];
+    static export_file *targets[XM_FILE_COUNT];
+    int count = 0;
+    int to_load = 0;
+    char path[768];
+    for (int i = 0; i <= XM_MAX_FILE_INDEX; i++)
+    {
+        if (!present[i])
+            continue;
+        export_file *f = &files[count++];
+        f->index = i;
+        f->chunk = -1;
+        f->size = -1;
+        f->mtime_ns = 0;
+        if (cache_dir && xm_file_path(directory_prefix, i, path, sizeof(path)) == XM_OK)
+            xm_file_stamp(path, &f->size, &f->mtime_ns);
+        if (cache_loaded && f->size >= 0 && cache_lookup(&cache, f))
+            continue;
+        views[to_load].index = i;
+        targets[to_load++] = f;
+    }
+
+    if (threads == 0)
+        threads = xm_cpu_count();
+
+    // A single thread keeps one chunk (one batched load); otherwise a few
+    // chunks per thread even out slow files.
+    int chunk_count = threads == 1 ? 1 : threads * 4;
+    if (chunk_count > to_load)
+        chunk_count = to_load > 0 ? to_load : 1;
+
+    export_job job = {directory_prefix, backend, views, targets, to_load, 0, NULL,
+                      cache_loaded ? &cache : NULL, binary, verify};
+    job.per_chunk = (to_load + chunk_count - 1) / chunk_count;
+    if (ndjson && job.per_chunk > PAGES_PER_BOOK)
+        job.per_chunk = PAGES_PER_BOOK;
+    if (job.per_chunk > 0)
+        chunk_count = (to_load + job.per_chunk - 1) / job.per_chunk;
+    for (int i = 0; i < to_load; i++)
+        targets[i]->chunk = i / job.per_chunk;
+    job.chunks = calloc(chunk_count, sizeof(*job.chunks));
+    if (!job.chunks)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < chunk_count; i++)
+    {
+        xm_buf_init(&job.chunks[i].out);
+        job.chunks[i].used = backend;
+    }
+
+    // NDJSON is written while files are still being encoded; otherwise
+    // everything is encoded first and written out in one go
+    double t_scanned = xm_now_ms();
+    size_t bytes_out = 0;
+    int write_res = XM_OK;
+    if (ndjson)
+        write_res = stream_ndjson(&job, chunk_count, threads, files, count, &bytes_out);
+    else if (to_load > 0)
+        xm_parallel_for(chunk_count, threads, export_chunk_task, &job);
+    double t_encoded = xm_now_ms();
+
+    // Write the files out in order, from the cache or their chunk
+    xm_io_backend used = job.chunks[0].used;
+    size_t bytes_in = 0;
+    double load_ms = 0;
+    double encode_ms = 0;
+    for (int i = 0; i < chunk_count; i++)
+    {
+        export_chunk *chunk = &job.chunks[i];
+        bytes_in += chunk->bytes_in;
+        load_ms += chunk->load_ms;
+        encode_ms += chunk->encode_ms;
+        if (chunk->out.failed)
+            write_res = XM_ERR_NOMEM;
+    }
+
+    int hits = 0;
+    int rehashed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        hits += files[i].state == FILE_CACHED;
+        rehashed += files[i].state == FILE_REHASHED;
+    }
+
+    if (!ndjson)
+    {
+        XM_SPAN("write")
+        {
+            // Binary records frame themselves; JSON objects go into an array
+            xm_buf frame;
+            xm_buf_init(&frame);
+            if (binary)
+            {
+                set_binary_mode(stdout);
+                xm_bin_header(&frame, directory_prefix);
+            }
+            else
+            {
+                xm_buf_putc(&frame, '[');
+            }
+            if (xm_buf_write(&frame, stdout) != XM_OK)
+                write_res = XM_ERR_WRITE;
+            bytes_out = frame.len;
+
+            int printed_any_macro = 0;
+            for (int i = 0; i < count; i++)
+            {
+                const export_file *f = &files[i];
+                if (f->state == FILE_MISSING || f->json_len == 0)
+                    continue;
+
+                if (printed_any_macro++ && !binary)
+                {
+                    if (fputc(',', stdout) == EOF)
+                        write_res = XM_ERR_WRITE;
+                    bytes_out++;
+                }
+                long n = f->json_len;
+                if (binary && fwrite(file_json(f), 1, f->json_len, stdout) != f->json_len)
+                    n = -1;
+                else if (!binary)
+                    n = write_tagged(f, stdout);
+                if (n < 0)
+                    write_res = XM_ERR_WRITE;
+                else
+                    bytes_out += (size_t)n;
+            }
+
+            frame.len = 0;
+            if (binary)
+                xm_bin_end(&frame);
+            else
+                xm_buf_putc(&frame, ']');
+            if (xm_buf_write(&frame, stdout) != XM_OK || fflush(stdout) != 0)
+                write_res = XM_ERR_WRITE;
+            bytes_out += frame.len;
+            xm_buf_free(&frame);
+        }
+    }
+    double t_done = xm_now_ms();
+
+    // Only rewrite the cache when it no longer describes the folder
+    int dirty = !cache_loaded || hits != count;
+    for (int i = lo; cache_loaded && !dirty && i <= hi; i++)
+        dirty = cache.files[i].present && !present[i];
+    if (cache_dir && dirty && write_res == XM_OK)
+    {
+        int err = save_cache(&cache, cache_dir, directory_prefix, files, count, lo, hi);
+        if (err != XM_OK)
+            fprintf(stderr, "Could not write cache '%s': %s\n", cache.path, xm_strerror(err));
+    }
+
+    if (verify)
+    {
+        int verified = 0;
+        int mismatched = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (files[i].checksum == 0)
+                continue;
+            verified++;
+            if (files[i].checksum > 0)
+                continue;
+            mismatched++;
+            if (xm_file_path(directory_prefix, files[i].index, path, sizeof(path)) == XM_OK)
+                fprintf(stderr, "checksum mismatch: %s\n", path);
+        }
+        fprintf(stderr, "verified=%d mismatched=%d\n", verified, mismatched);
+    }
+
+    if (stats)
+    {
+        // load_ms/encode_ms add up the time spent in each stage across all
+        // threads; work_ms is the wall time of both stages together.
+        fprintf(stderr,
+                "io=%s threads=%d chunks=%d files=%d bytes_in=%zu bytes_out=%zu "
+                "cache=%s hits=%d rehashed=%d misses=%d scan_ms=%.3f "
+                "load_ms=%.3f encode_ms=%.3f work_ms=%.3f write_ms=%.3f total_ms=%.3f\n",
+                xm_io_backend_name(used), threads, chunk_count, count, bytes_in, bytes_out,
+                cache_dir ? (cache_loaded ? "hit" : "miss") : "off", hits, rehashed,
+                count - hits - rehashed, t_scanned - t_start, load_ms, encode_ms,
+                t_encoded - t_scanned, t_done - t_encoded, t_done - t_start);
+    }
+
+    for (int i = 0; i < chunk_count; i++)
+        xm_buf_free(&job.chunks[i].out);
+    free(job.chunks);
+    xm_free(cache.blob);
+    return write_res == XM_OK ? 0 : 1;
 }
@@ -0,0 +1,916 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include "./vendor/dirent/dirent.h"
+#else
+#include <dirent.h>
+#endif
+
+#include "ximacro.h"
+#include "xm_io.h"
+#include "xm_text.h"
+
+// -------------------------------------------------------------------
+// Trigram index over every macro line and name of every character
+// folder under USER.
+//
+// Each non-empty field (line 0-5 or name) is one document. Its text,
+// ASCII-lowercased and prefixed with START_MARK, is split into byte
+// trigrams; a trigram's posting list holds the ids of the fields that
+// contain it. A query intersects the lists of its own trigrams and then
+// checks each candidate's text, so hits are exact. The marker makes a
+// prefix query just a substring query that starts with it.
+//
+// The index keeps the text of every field, so refreshing it re-reads
+// only the mcr*.dat files whose size or mtime changed; postings are then
+// rebuilt in memory from the stored text.
+// -------------------------------------------------------------------
+#define START_MARK '\x01'
+#define INDEX_DEFAULT_PATH "macro_cache/search.idx"
+#define INDEX_MAGIC "XMFI"
+#define INDEX_VERSION 1
+#define DEFAULT_LIMIT 1000
+
+// A file written this close to the index itself may have changed again
+// within the same mtime tick, so its stamp alone is not trusted.
+#define INDEX_RACY_NS 2000000000LL
+
+typedef struct
+{
+    uint16_t chr;
+    uint16_t index;
+    uint32_t first_field;
+    int64_t size;
+    int64_t mtime_ns;
+    uint32_t field_count;
+    uint32_t reserved;
+} idx_file;
+
+typedef struct
+{
+    uint32_t file;
+    uint32_t text_off;
+    uint16_t text_len;
+    uint8_t macro;
+    int8_t field; // 0-5, or XM_FIELD_NAME
+} idx_field;
+
+typedef struct
+{
+    uint32_t key; // three lowercased bytes
+    uint32_t off; // into postings
+    uint32_t count;
+} idx_gram;
+
+// On disk every section follows the header in this order, each padded
+// to 8 bytes, then an xm_hash128 of all of it. Host byte order: the
+// index is a local cache, rebuilt whenever it doesn't check out.
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t chars;
+    uint32_t files;
+    uint32_t fields;
+    uint32_t grams;
+    int64_t written_ns;
+    uint64_t names_bytes; // NUL-terminated character folder names
+    uint64_t postings;
+    uint64_t text_bytes;
+} idx_header;
+
+typedef struct
+{
+    uint8_t *blob; // loaded index file, if the arrays point into it
+    long long written_ns;
+
+    int chars;
+    char **names;
+    int files;
+    idx_file *file;
+    int fields;
+    idx_field *field;
+    int grams;
+    idx_gram *gram;
+    uint32_t *postings;
+    const uint8_t *text;
+    size_t text_bytes;
+} search_index;
+
+// 'owned': the arrays and names were built here rather than loaded
+static void free_index(search_index *ix, int owned)
+{
+    if (owned && ix->names)
+    {
+        for (int i = 0; i < ix->chars; i++)
+            free(ix->names[i]);
+    }
+    free(ix->names);
+    if (owned)
+    {
+        free(ix->file);
+        free(ix->field);
+        free(ix->gram);
+        free(ix->postings);
+        free((void *)ix->text);
+    }
+    xm_free(ix->blob);
+    memset(ix, 0, sizeof(*ix));
+}
+
+static uint8_t fold(uint8_t c)
+{
+    return c >= 'A' && c <= 'Z' ? (uint8_t)(c + 32) : c;
+}
+
+static size_t pad8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+// -------------------------------------------------------------------
+// Loading and saving
+// -------------------------------------------------------------------
+static int load_index(const char *path, search_index *ix)
+{
+    size_t size;
+    memset(ix, 0, sizeof(*ix));
+    if (xm_read_file(path, &ix->blob, &size) != XM_OK)
+        return XM_ERR_OPEN;
+
+    idx_header h;
+    uint64_t hash[2];
+    int bad = size < sizeof(h) + 16;
+    if (!bad)
+    {
+        memcpy(&h, ix->blob, sizeof(h));
+        xm_hash128(ix->blob, size - 16, hash);
+        bad = memcmp(ix->blob + size - 16, hash, 16) != 0 ||
+              memcmp(h.magic, INDEX_MAGIC, 4) != 0 || h.version != INDEX_VERSION;
+    }
+
+    size_t need = bad ? 0
+                      : pad8(sizeof(h)) + pad8(h.names_bytes) + pad8((size_t)h.files * sizeof(idx_file)) +
+                            pad8((size_t)h.fields * sizeof(idx_field)) + pad8((size_t)h.grams * sizeof(idx_gram)) +
+                            pad8(h.postings * 4) + pad8(h.text_bytes) + 16;
+    if (bad || need != size)
+    {
+        free_index(ix, 0);
+        return XM_ERR_FORMAT;
+    }
+
+    uint8_t *p = ix->blob + pad8(sizeof(h));
+    const char *names = (const char *)p;
+    p += pad8(h.names_bytes);
+    ix->file = (idx_file *)p;
+    p += pad8((size_t)h.files * sizeof(idx_file));
+    ix->field = (idx_field *)p;
+    p += pad8((size_t)h.fields * sizeof(idx_field));
+    ix->gram = (idx_gram *)p;
+    p += pad8((size_t)h.grams * sizeof(idx_gram));
+    ix->postings = (uint32_t *)p;
+    p += pad8(h.postings * 4);
+    ix->text = p;
+
+    ix->chars = (int)h.chars;
+    ix->files = (int)h.files;
+    ix->fields = (int)h.fields;
+    ix->grams = (int)h.grams;
+    ix->text_bytes = h.text_bytes;
+    ix->written_ns = h.written_ns;
+
+    ix->names = malloc((h.chars ? h.chars : 1) * sizeof(*ix->names));
+    if (!ix->names)
+    {
+        free_index(ix, 0);
+        return XM_ERR_NOMEM;
+    }
+    const char *end = names + h.names_bytes;
+    for (uint32_t i = 0; i < h.chars; i++)
+    {
+        const char *nul = memchr(names, '\0', (size_t)(end - names));
+        if (!nul)
+        {
+            free_index(ix, 0);
+            return XM_ERR_FORMAT;
+        }
+        ix->names[i] = (char *)names;
+        names = nul + 1;
+    }
+    return XM_OK;
+}
+
+static void append_padded(xm_buf *b, const void *data, size_t n)
+{
+    static const char zeros[8] = {0};
+    xm_buf_append(b, data, n);
+    xm_buf_append(b, zeros, pad8(n) - n);
+}
+
+static int save_index(const char *path, const search_index *ix)
+{
+    xm_buf b;
+    xm_buf_init(&b);
+
+    idx_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INDEX_MAGIC, 4);
+    h.version = INDEX_VERSION;
+    h.chars = (uint32_t)ix->chars;
+    h.files = (uint32_t)ix->files;
+    h.fields = (uint32_t)ix->fields;
+    h.grams = (uint32_t)ix->grams;
+    h.written_ns = (int64_t)time(NULL) * 1000000000LL;
+    for (int i = 0; i < ix->chars; i++)
+        h.names_bytes += strlen(ix->names[i]) + 1;
+    h.postings = ix->grams ? ix->gram[ix->grams - 1].off + ix->gram[ix->grams - 1].count : 0;
+    h.text_bytes = ix->text_bytes;
+
+    append_padded(&b, &h, sizeof(h));
+    for (int i = 0; i < ix->chars; i++)
+        xm_buf_append(&b, ix->names[i], strlen(ix->names[i]) + 1);
+    while (b.len % 8)
+        xm_buf_putc(&b, '\0');
+    append_padded(&b, ix->file, (size_t)ix->files * sizeof(idx_file));
+    append_padded(&b, ix->field, (size_t)ix->fields * sizeof(idx_field));
+    append_padded(&b, ix->gram, (size_t)ix->grams * sizeof(idx_gram));
+    append_padded(&b, ix->postings, h.postings * 4);
+    append_padded(&b, ix->text, ix->text_bytes);
+
+    uint64_t hash[2];
+    xm_hash128(b.data, b.len, hash);
+    xm_buf_append(&b, hash, sizeof(hash));
+
+    // Written aside and renamed so a concurrent query never reads half an index
+    char temp[1024];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    int err = b.failed ? XM_ERR_NOMEM : xm_write_file(temp, (const uint8_t *)b.data, b.len);
+    if (err == XM_OK)
+    {
+        remove(path); // rename() doesn't replace on Windows
+        if (rename(temp, path) != 0)
+            err = XM_ERR_WRITE;
+    }
+    xm_buf_free(&b);
+    return err;
+}
+
+// -------------------------------------------------------------------
+// Refresh: one pass over USER, reusing the stored text of every file
+// whose stamp still matches
+// -------------------------------------------------------------------
+typedef struct
+{
+    int files_read;
+    int files_cached;
+    double refresh_ms;
+    double build_ms;
+    double query_ms;
+} find_stats;
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Character folders under 'root' (any folder holding an mcr*.dat), sorted
+static int list_characters(const char *root, char ***out, int *count)
+{
+    DIR *dp = opendir(root);
+    if (!dp)
+        return XM_ERR_OPEN;
+
+    xm_buf names;
+    xm_buf_init(&names);
+    char path[1024];
+    uint8_t present[XM_FILE_COUNT];
+    struct dirent *entry;
+    *count = 0;
+    while ((entry = readdir(dp)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s" XM_PATH_SEP_STR "%s", root, entry->d_name);
+        if (xm_scan_macro_dir(path, present) <= 0)
+            continue;
+        char *name = strdup(entry->d_name);
+        if (name)
+        {
+            xm_buf_append(&names, &name, sizeof(name));
+            (*count)++;
+        }
+    }
+    closedir(dp);
+
+    *out = (char **)names.data;
+    if (names.failed)
+    {
+        xm_buf_free(&names);
+        return XM_ERR_NOMEM;
+    }
+    if (*count > 1)
+        qsort(*out, (size_t)*count, sizeof(**out), compare_names);
+    return XM_OK;
+}
+
+static int old_character(const search_index *old, const char *name)
+{
+    int lo = 0, hi = old->chars - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        int c = strcmp(old->names[mid], name);
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+static void add_field(xm_buf *fields, xm_buf *text, uint32_t file, int macro, int field,
+                      const uint8_t *src, size_t len)
+{
+    idx_field f;
+    f.file = file;
+    f.text_off = (uint32_t)text->len;
+    f.text_len = (uint16_t)len;
+    f.macro = (uint8_t)macro;
+    f.field = (int8_t)field;
+    xm_buf_append(fields, &f, sizeof(f));
+    xm_buf_append(text, src, len);
+}
+
+// Lines 0-5 then the name of every macro, skipping empty ones
+static void read_fields(xm_buf *fields, xm_buf *text, uint32_t file, const uint8_t *data, size_t size)
+{
+    int macros = (int)xm_macro_count(size);
+    for (int m = 0; m < macros; m++)
+    {
+        for (int f = 0; f <= XM_LINES_PER_MACRO; f++)
+        {
+            int field = f < XM_LINES_PER_MACRO ? f : XM_FIELD_NAME;
+            size_t off, len;
+            if (xm_field_span(size, m, field, &off, &len) != XM_OK)
+                continue;
+            const uint8_t *nul = memchr(data + off, '\0', len);
+            if (nul)
+                len = (size_t)(nul - (data + off));
+            if (len > 0)
+                add_field(fields, text, file, m, field, data + off, len);
+        }
+    }
+}
+
+/**
+ * Builds the file, field and text tables of 'ix' for 'root', copying
+ * from 'old' what is still current. Sets '*dirty' if anything differs.
+ */
+static int refresh(const char *root, const search_index *old, search_index *ix, int *dirty, find_stats *st)
+{
+    int err = list_characters(root, &ix->names, &ix->chars);
+    if (err != XM_OK)
+        return err;
+    *dirty = ix->chars != old->chars;
+
+    xm_buf files, fields, text;
+    xm_buf_init(&files);
+    xm_buf_init(&fields);
+    xm_buf_init(&text);
+
+    char dir[1024], path[1024];
+    uint8_t present[XM_FILE_COUNT];
+    for (int c = 0; c < ix->chars && err == XM_OK; c++)
+    {
+        snprintf(dir, sizeof(dir), "%s" XM_PATH_SEP_STR "%s", root, ix->names[c]);
+        if (xm_scan_macro_dir(dir, present) < 0)
+            continue;
+
+        // The old entries of this character, in index order
+        int oc = old_character(old, ix->names[c]);
+        *dirty |= oc != c;
+        int of = 0;
+        while (oc >= 0 && of < old->files && old->file[of].chr != oc)
+            of++;
+
+        for (int index = 0; index < XM_FILE_COUNT; index++)
+        {
+            while (oc >= 0 && of < old->files && old->file[of].chr == oc && old->file[of].index < index)
+            {
+                of++;
+                *dirty = 1; // a file that's gone
+            }
+            const idx_file *prev = oc >= 0 && of < old->files && old->file[of].chr == oc &&
+                                           old->file[of].index == index
+                                       ? &old->file[of++]
+                                       : NULL;
+            if (!present[index])
+            {
+                *dirty |= prev != NULL;
+                continue;
+            }
+
+            idx_file f;
+            memset(&f, 0, sizeof(f));
+            f.chr = (uint16_t)c;
+            f.index = (uint16_t)index;
+            f.first_field = (uint32_t)(fields.len / sizeof(idx_field));
+            long long size, mtime_ns;
+            if (xm_file_path(dir, index, path, sizeof(path)) != XM_OK ||
+                xm_file_stamp(path, &size, &mtime_ns) != XM_OK)
+            {
+                *dirty = 1;
+                continue;
+            }
+            f.size = size;
+            f.mtime_ns = mtime_ns;
+            uint32_t file_id = (uint32_t)(files.len / sizeof(idx_file));
+
+            if (prev && prev->size == size && prev->mtime_ns == mtime_ns &&
+                mtime_ns < old->written_ns - INDEX_RACY_NS)
+            {
+                for (uint32_t i = 0; i < prev->field_count; i++)
+                {
+                    const idx_field *of2 = &old->field[prev->first_field + i];
+                    add_field(&fields, &text, file_id, of2->macro, of2->field,
+                              old->text + of2->text_off, of2->text_len);
+                }
+                st->files_cached++;
+            }
+            else
+            {
+                uint8_t *data;
+                size_t len;
+                if (xm_read_file(path, &data, &len) != XM_OK)
+                {
+                    fprintf(stderr, "Could not read '%s'.\n", path);
+                    *dirty = 1;
+                    continue;
+                }
+                read_fields(&fields, &text, file_id, data, len);
+                xm_free(data);
+                st->files_read++;
+                *dirty = 1;
+            }
+            f.field_count = (uint32_t)(fields.len / sizeof(idx_field)) - f.first_field;
+            xm_buf_append(&files, &f, sizeof(f));
+        }
+        while (oc >= 0 && of < old->files && old->file[of].chr == oc)
+        {
+            of++;
+            *dirty = 1;
+        }
+    }
+
+    if (files.failed || fields.failed || text.failed)
+        err = XM_ERR_NOMEM;
+    else if (text.len > UINT32_MAX)
+        err = XM_ERR_RANGE;
+    ix->file = (idx_file *)files.data;
+    ix->files = (int)(files.len / sizeof(idx_file));
+    ix->field = (idx_field *)fields.data;
+    ix->fields = (int)(fields.len / sizeof(idx_field));
+    ix->text = (const uint8_t *)text.data;
+    ix->text_bytes = text.len;
+    return err;
+}
+
+// -------------------------------------------------------------------
+// Postings
+// -------------------------------------------------------------------
+static uint32_t gram_key(uint8_t a, uint8_t b, uint8_t c)
+{
+    return ((uint32_t)a << 16) | ((uint32_t)b << 8) | c;
+}
+
+/**
+ * Emits a (trigram << 32 | field) pair for each trigram of each field,
+ * sorts them by trigram with a stable 3-pass radix sort (field ids stay
+ * ascending within a trigram) and folds runs into posting lists.
+ */
+static int build_postings(search_index *ix)
+{
+    size_t pairs = 0;
+    for (int i = 0; i < ix->fields; i++)
+        pairs += ix->field[i].text_len >= 2 ? ix->field[i].text_len - 1 : 0;
+
+    uint64_t *a = malloc((pairs ? pairs : 1) * sizeof(*a));
+    uint64_t *b = malloc((pairs ? pairs : 1) * sizeof(*b));
+    if (!a || !b)
+    {
+        free(a);
+        free(b);
+        return XM_ERR_NOMEM;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < ix->fields; i++)
+    {
+        const idx_field *f = &ix->field[i];
+        const uint8_t *t = ix->text + f->text_off;
+        uint8_t p0 = START_MARK, p1 = f->text_len ? fold(t[0]) : 0;
+        for (uint16_t k = 1; k < f->text_len; k++)
+        {
+            uint8_t p2 = fold(t[k]);
+            a[n++] = ((uint64_t)gram_key(p0, p1, p2) << 32) | (uint32_t)i;
+            p0 = p1;
+            p1 = p2;
+        }
+    }
+
+    for (int shift = 32; shift < 56; shift += 8)
+    {
+        size_t counts[257] = {0};
+        for (size_t i = 0; i < n; i++)
+            counts[((a[i] >> shift) & 0xFF) + 1]++;
+        for (int d = 0; d < 256; d++)
+            counts[d + 1] += counts[d];
+        for (size_t i = 0; i < n; i++)
+            b[counts[(a[i] >> shift) & 0xFF]++] = a[i];
+        uint64_t *t = a;
+        a = b;
+        b = t;
+    }
+    free(b);
+
+    // A field repeating a trigram lists it once
+    uint32_t *postings = malloc((n ? n : 1) * sizeof(*postings));
+    idx_gram *grams = malloc((n ? n : 1) * sizeof(*grams));
+    if (!postings || !grams)
+    {
+        free(a);
+        free(postings);
+        free(grams);
+        return XM_ERR_NOMEM;
+    }
+    uint32_t count = 0;
+    int gram_count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (i > 0 && a[i] == a[i - 1])
+            continue;
+        uint32_t key = (uint32_t)(a[i] >> 32);
+        if (gram_count == 0 || grams[gram_count - 1].key != key)
+        {
+            grams[gram_count].key = key;
+            grams[gram_count].off = count;
+            grams[gram_count].count = 0;
+            gram_count++;
+        }
+        grams[gram_count - 1].count++;
+        postings[count++] = (uint32_t)a[i];
+    }
+    free(a);
+
+    ix->postings = postings;
+    ix->gram = grams;
+    ix->grams = gram_count;
+    return XM_OK;
+}
+
+// -------------------------------------------------------------------
+// Query
+// -------------------------------------------------------------------
+static const idx_gram *find_gram(const search_index *ix, uint32_t key)
+{
+    int lo = 0, hi = ix->grams - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (ix->gram[mid].key == key)
+            return &ix->gram[mid];
+        if (ix->gram[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return NULL;
+}
+
+static int compare_gram_counts(const void *a, const void *b)
+{
+    uint32_t x = (*(const idx_gram *const *)a)->count;
+    uint32_t y = (*(const idx_gram *const *)b)->count;
+    return (x > y) - (x < y);
+}
+
+// Keeps the ids of 'cand' that are also in 'list' (both ascending)
+static uint32_t intersect(uint32_t *cand, uint32_t n, const uint32_t *list, uint32_t m)
+{
+    uint32_t out = 0, j = 0;
+    for (uint32_t i = 0; i < n && j < m; i++)
+    {
+        while (j < m && list[j] < cand[i])
+            j++;
+        if (j < m && list[j] == cand[i])
+            cand[out++] = cand[i];
+    }
+    return out;
+}
+
+static int text_matches(const uint8_t *text, size_t len, const uint8_t *q, size_t qlen,
+                        int prefix, int match_case)
+{
+    if (qlen > len)
+        return 0;
+    size_t last = prefix ? 0 : len - qlen;
+    for (size_t s = 0; s <= last; s++)
+    {
+        size_t k = 0;
+        if (match_case)
+        {
+            while (k < qlen && text[s + k] == q[k])
+                k++;
+        }
+        else
+        {
+            while (k < qlen && fold(text[s + k]) == fold(q[k]))
+                k++;
+        }
+        if (k == qlen)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Collects the ids of every field matching 'query' in ascending order.
+ * Returns the count, or a negative XM_ERR_* code.
+ */
+static long search(const search_index *ix, const char *query, int prefix, int match_case, uint32_t **out)
+{
+    size_t qlen = strlen(query);
+    const uint8_t *q = (const uint8_t *)query;
+    *out = NULL;
+    if (qlen == 0 || qlen > XM_LINE_SIZE)
+        return 0;
+
+    // Trigrams of the query as the index saw it: folded, marker in front
+    // for a prefix query
+    uint8_t folded[XM_LINE_SIZE + 1];
+    size_t flen = 0;
+    if (prefix)
+        folded[flen++] = START_MARK;
+    for (size_t i = 0; i < qlen; i++)
+        folded[flen++] = fold(q[i]);
+
+    const idx_gram *grams[XM_LINE_SIZE];
+    int gram_count = 0;
+    for (size_t i = 0; i + 2 < flen; i++)
+    {
+        const idx_gram *g = find_gram(ix, gram_key(folded[i], folded[i + 1], folded[i + 2]));
+        if (!g)
+            return 0;
+        grams[gram_count++] = g;
+    }
+
+    uint32_t *cand = malloc((ix->fields ? (size_t)ix->fields : 1) * sizeof(*cand));
+    if (!cand)
+        return XM_ERR_NOMEM;
+    uint32_t n;
+    if (gram_count == 0)
+    {
+        // Too short for a trigram: every field is a candidate
+        n = (uint32_t)ix->fields;
+        for (uint32_t i = 0; i < n; i++)
+            cand[i] = i;
+    }
+    else
+    {
+        // Rarest first, so the candidate set starts (and stays) small
+        qsort(grams, (size_t)gram_count, sizeof(*grams), compare_gram_counts);
+        n = grams[0]->count;
+        memcpy(cand, ix->postings + grams[0]->off, n * sizeof(*cand));
+        for (int g = 1; g < gram_count && n > 0; g++)
+            n = intersect(cand, n, ix->postings + grams[g]->off, grams[g]->count);
+    }
+
+    uint32_t hits = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const idx_field *f = &ix->field[cand[i]];
+        if (text_matches(ix->text + f->text_off, f->text_len, q, qlen, prefix, match_case))
+            cand[hits++] = cand[i];
+    }
+    *out = cand;
+    return hits;
+}
+
+static void json_hit(xm_buf *b, const search_index *ix, uint32_t id)
+{
+    const idx_field *f = &ix->field[id];
+    const idx_file *file = &ix->file[f->file];
+    char name[32];
+    xm_file_name(file->index, name, sizeof(name));
+
+    xm_buf_puts(b, "{\"character\":\"");
+    xm_json_escape(b, (const uint8_t *)ix->names[file->chr], strlen(ix->names[file->chr]));
+    xm_buf_printf(b, "\",\"file\":\"%s\",\"book\":%d,\"page\":%d,\"macro\":%d,\"line\":",
+                  name, file->index / 10, file->index % 10, f->macro);
+    if (f->field == XM_FIELD_NAME)
+        xm_buf_puts(b, "\"name\"");
+    else
+        xm_buf_printf(b, "%d", f->field);
+    xm_buf_puts(b, ",\"text\":\"");
+    xm_json_text(b, ix->text + f->text_off, f->text_len);
+    xm_buf_puts(b, "\"}");
+}
+
+// -------------------------------------------------------------------
+// Main
+// -------------------------------------------------------------------
+typedef struct
+{
+    const char *root;
+    const char *index_path;
+    const char *query;
+    int refresh;
+    int prefix;
+    int match_case;
+    long limit;
+    int stats;
+} find_options;
+
+static int ensure_parent(const char *path)
+{
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *base = (char *)xm_basename(dir);
+    if (base <= dir)
+        return XM_OK;
+    base[-1] = '\0';
+    return xm_ensure_dir(dir);
+}
+
+static int run(const find_options *opt)
+{
+    find_stats st = {0};
+    double start = xm_now_ms();
+
+    search_index old, fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    int loaded = opt->index_path && load_index(opt->index_path, &old) == XM_OK;
+    if (!loaded)
+    {
+        memset(&old, 0, sizeof(old));
+        if (opt->index_path && xm_file_size(opt->index_path) >= 0)
+            fprintf(stderr, "Ignoring unreadable index '%s'.\n", opt->index_path);
+    }
+    if (!loaded && !opt->refresh)
+    {
+        fprintf(stderr, "Error: no index at '%s'.\n", opt->index_path ? opt->index_path : "");
+        return 1;
+    }
+
+    // Either the loaded index is used as is, or a refreshed one replaces it
+    const search_index *ix = &old;
+    int dirty = 0;
+    if (opt->refresh)
+    {
+        int err = refresh(opt->root, &old, &fresh, &dirty, &st);
+        if (err == XM_OK)
+        {
+            st.refresh_ms = xm_now_ms() - start;
+            if (dirty || !loaded)
+            {
+                double t = xm_now_ms();
+                err = build_postings(&fresh);
+                st.build_ms = xm_now_ms() - t;
+            }
+        }
+        if (err != XM_OK)
+        {
+            fprintf(stderr, "Error: could not index '%s': %s.\n", opt->root, xm_strerror(err));
+            free_index(&fresh, 1);
+            free_index(&old, 0);
+            return 1;
+        }
+
+        if (dirty || !loaded)
+        {
+            ix = &fresh;
+            if (opt->index_path)
+            {
+                ensure_parent(opt->index_path);
+                if ((err = save_index(opt->index_path, &fresh)) != XM_OK)
+                    fprintf(stderr, "Could not write index '%s': %s.\n", opt->index_path, xm_strerror(err));
+            }
+        }
+    }
+
+    int status = 0;
+    xm_buf out;
+    xm_buf_init(&out);
+    if (opt->query)
+    {
+        // Fields hold encoded text, so the query is matched encoded too;
+        // one byte over a line is enough to tell it can't match
+        char query[XM_LINE_SIZE + 2];
+        size_t query_len = xm_text_encode(opt->query, strlen(opt->query), (uint8_t *)query,
+                                          XM_LINE_SIZE + 1, NULL);
+        query[query_len] = '\0';
+
+        double t = xm_now_ms();
+        uint32_t *ids;
+        long hits = search(ix, query, opt->prefix, opt->match_case, &ids);
+        st.query_ms = xm_now_ms() - t;
+        if (hits < 0)
+        {
+            fprintf(stderr, "Error: %s.\n", xm_strerror((int)hits));
+            status = 1;
+        }
+        else
+        {
+            xm_buf_puts(&out, "{\"query\":\"");
+            xm_json_text(&out, (const uint8_t *)query, query_len);
+            xm_buf_printf(&out, "\",\"total\":%ld,\"hits\":[", hits);
+            long shown = hits < opt->limit ? hits : opt->limit;
+            for (long i = 0; i < shown; i++)
+            {
+                if (i > 0)
+                    xm_buf_putc(&out, ',');
+                json_hit(&out, ix, ids[i]);
+            }
+            xm_buf_puts(&out, "]}\n");
+        }
+        free(ids);
+    }
+    else
+    {
+        xm_buf_printf(&out, "{\"characters\":%d,\"files\":%d,\"fields\":%d,\"trigrams\":%d}\n",
+                      ix->chars, ix->files, ix->fields, ix->grams);
+    }
+    xm_buf_write(&out, stdout);
+    fflush(stdout);
+    xm_buf_free(&out);
+
+    if (opt->stats)
+        fprintf(stderr, "chars=%d files_read=%d files_cached=%d fields=%d trigrams=%d index=%s "
+                        "refresh_ms=%.2f build_ms=%.2f query_ms=%.2f total_ms=%.2f\n",
+                ix->chars, st.files_read, st.files_cached, ix->fields, ix->grams,
+                !opt->index_path ? "off" : !loaded ? "miss" : dirty ? "updated" : "hit",
+                st.refresh_ms, st.build_ms, st.query_ms, xm_now_ms() - start);
+
+    free_index(&fresh, 1);
+    free_index(&old, 0);
+    return status;
+}
+
+/**
+ * Full-text search over the macros of every character folder in USER.
+ * Refreshes the index first (only changed files are re-read), then
+ * prints the hits for 'query', or just the index counts without one.
+ * Usage: ximacro_f [--index=PATH | --no-index] [--no-refresh] [--prefix]
+ *                  [--case] [--limit=N] [--stats] <USER dir> [query]
+ */
+int main(int argc, char *argv[])
+{
+    find_options opt = {0};
+    opt.index_path = INDEX_DEFAULT_PATH;
+    opt.refresh = 1;
+    opt.limit = DEFAULT_LIMIT;
+    int bad = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--index=", 8) == 0 && argv[i][8])
+            opt.index_path = argv[i] + 8;
+        else if (strcmp(argv[i], "--no-index") == 0)
+            opt.index_path = NULL;
+        else if (strcmp(argv[i], "--no-refresh") == 0)
+            opt.refresh = 0;
+        else if (strcmp(argv[i], "--prefix") == 0)
+            opt.prefix = 1;
+        else if (strcmp(argv[i], "--case") == 0)
+            opt.match_case = 1;
+        else if (strncmp(argv[i], "--limit=", 8) == 0)
+            opt.limit = atol(argv[i] + 8);
+        else if (strcmp(argv[i], "--stats") == 0)
+            opt.stats = 1;
+        else if (strcmp(argv[i], "--") == 0 && i + 1 < argc && opt.root && !opt.query)
+            opt.query = argv[++i];
+        else if (strncmp(argv[i], "--", 2) == 0)
+            bad = 1;
+        else if (!opt.root)
+            opt.root = argv[i];
+        else if (!opt.query)
+            opt.query = argv[i];
+        else
+            bad = 1;
+    }
+
+    if (!opt.root || bad || opt.limit < 0 || (!opt.refresh && !opt.index_path))
+    {
+        fprintf(stderr, "Usage: %s [--index=PATH | --no-index] [--no-refresh] [--prefix] [--case] "
+                        "[--limit=N] [--stats] <USER directory> [query]\n",
+                argv[0]);
+        return 1;
+    }
+    return run(&opt);
+}
@@ -1,402 +1,2495 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
 #include <stdint.h>
-#include <errno.h>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 #include "./vendor/cJSON/cJSON.h"
+#include "./vendor/cJSON/cJSON_Utils.h"
+#include "ximacro.h"
+#include "xm_bin.h"
+#include "xm_io.h"
+#include "xm_txn.h"
+#include "xm_store.h"
+#include "xm_text.h"
+#include "xm_thread.h"
+#include "xm_trace.h"
+
+// -------------------------------------------------------------------
+// Write a block of text at offset, encoded into at most max_bytes
+// -------------------------------------------------------------------
+static void overwrite_block_in_buffer(
+    uint8_t *buffer,
+    size_t buffer_size,
+    size_t offset,
+    const char *text_to_write,
+    size_t text_len,
+    size_t max_bytes)
+{
+    XM_LOG(XM_LOG_TRACE, "  overwrite_block_in_buffer: offset=0x%zX, text=\"%.*s\", max_bytes=%zu\n",
+           offset, (int)text_len, text_to_write, max_bytes);
+
+    if (xm_text_write_field(buffer, buffer_size, offset, text_to_write,
+                            text_len, max_bytes, NULL) != XM_OK)
+    {
+        XM_LOG(XM_LOG_TRACE, "    -> offset=0x%zX beyond file size=%zu, skipping.\n",
+               offset, buffer_size);
+    }
+}
+
+// -------------------------------------------------------------------
+// Overwrite lines + name for one macro object
+// {
+//   "offset": "0x1C",
+//   "lines": [ {"offset":"0x1C","data":"..."}, ... ],
+//   "name":"...",
+//   "nameOffset":"0x2C" // optional
+// }
+// -------------------------------------------------------------------
+static void process_macro_object(cJSON *macroObj, uint8_t *buffer, size_t buffer_size)
+{
+    if (!cJSON_IsObject(macroObj))
+    {
+        XM_LOG(XM_LOG_TRACE, "  skipping macroObj - not an object.\n");
+        return;
+    }
+
+    cJSON *offsetItem = cJSON_GetObjectItemCaseSensitive(macroObj, "offset");
+    if (!cJSON_IsString(offsetItem))
+    {
+        XM_LOG(XM_LOG_TRACE, "  macro has no valid 'offset' string.\n");
+        return;
+    }
+    size_t macro_offset = strtoul(offsetItem->valuestring, NULL, 16);
+
+    XM_LOG(XM_LOG_TRACE, "  Macro offset=0x%zX\n", macro_offset);
+
+    // Overwrite lines
+    cJSON *lines = cJSON_GetObjectItemCaseSensitive(macroObj, "lines");
+    if (cJSON_IsArray(lines))
+    {
+        cJSON *lineObj = NULL;
+        cJSON_ArrayForEach(lineObj, lines)
+        {
+            cJSON *lineOffsetItem = cJSON_GetObjectItemCaseSensitive(lineObj, "offset");
+            cJSON *dataItem = cJSON_GetObjectItemCaseSensitive(lineObj, "data");
+            if (!cJSON_IsString(lineOffsetItem) || !cJSON_IsString(dataItem))
+            {
+                XM_LOG(XM_LOG_TRACE, "   -> skipping lineObj with missing offset/data.\n");
+                continue;
+            }
+            size_t line_offset = strtoul(lineOffsetItem->valuestring, NULL, 16);
+            XM_LOG(XM_LOG_TRACE, "   -> Overwriting line at 0x%zX with \"%s\"\n",
+                   line_offset, dataItem->valuestring);
+
+            overwrite_block_in_buffer(buffer, buffer_size, line_offset, dataItem->valuestring,
+                                      strlen(dataItem->valuestring), XM_LINE_SIZE);
+        }
+    }
+    else
+    {
+        XM_LOG(XM_LOG_TRACE, "  macro has no 'lines' array.\n");
+    }
+
+    // Overwrite name
+    cJSON *nameItem = cJSON_GetObjectItemCaseSensitive(macroObj, "name");
+    if (cJSON_IsString(nameItem))
+    {
+        cJSON *nameOffsetItem = cJSON_GetObjectItemCaseSensitive(macroObj, "nameOffset");
+        size_t name_offset = 0;
+        if (cJSON_IsString(nameOffsetItem))
+        {
+            name_offset = strtoul(nameOffsetItem->valuestring, NULL, 16);
+            XM_LOG(XM_LOG_TRACE, "    -> nameOffset=0x%zX from JSON\n", name_offset);
+        }
+        else
+        {
+            name_offset = macro_offset + (XM_LINES_PER_MACRO * XM_LINE_SIZE);
+            XM_LOG(XM_LOG_TRACE, "    -> nameOffset fallback=0x%zX\n", name_offset);
+        }
+        XM_LOG(XM_LOG_TRACE, "    -> Overwriting name at 0x%zX with \"%s\"\n",
+               name_offset, nameItem->valuestring);
+        overwrite_block_in_buffer(buffer, buffer_size, name_offset, nameItem->valuestring,
+                                  strlen(nameItem->valuestring), XM_NAME_SIZE);
+    }
+    else
+    {
+        XM_LOG(XM_LOG_TRACE, "  macro has no 'name' field.\n");
+    }
+}
+
+// -------------------------------------------------------------------
+// Per-run summary, printed as JSON on stdout when the import finishes
+// -------------------------------------------------------------------
+typedef struct
+{
+    int written;
+    int skipped;
+    int failed;
+    int rejected; // patch edits refused as malformed or out of range
+    xm_buf touched; // JSON array body of written file names
+    xm_buf backups; // JSON array body of backup store save ids
+    int saves;
+    xm_buf report; // mode-specific members printed ahead of the counts
+} import_summary;
+
+static import_summary g_summary;
+
+static void record_written(const char *filename)
+{
+    if (g_summary.written++ > 0)
+        xm_buf_putc(&g_summary.touched, ',');
+    xm_buf_putc(&g_summary.touched, '"');
+    xm_json_escape(&g_summary.touched, (const uint8_t *)filename, strlen(filename));
+    xm_buf_putc(&g_summary.touched, '"');
+}
+
+static void print_summary(void)
+{
+    printf("{");
+    if (g_summary.report.len > 0)
+    {
+        xm_buf_write(&g_summary.report, stdout);
+        printf(",");
+    }
+    printf("\"written\":%d,\"skipped\":%d,\"failed\":%d,\"rejected\":%d,\"touched\":[",
+           g_summary.written, g_summary.skipped, g_summary.failed, g_summary.rejected);
+    xm_buf_write(&g_summary.touched, stdout);
+    printf("],\"backups\":[");
+    xm_buf_write(&g_summary.backups, stdout);
+    printf("]}\n");
+    fflush(stdout);
+}
+
+static void free_summary(void)
+{
+    xm_buf_free(&g_summary.touched);
+    xm_buf_free(&g_summary.backups);
+    xm_buf_free(&g_summary.report);
+}
+
+// -------------------------------------------------------------------
+// All rewrites of a run are staged into one transaction and published
+// together by commit_import(); see xm_txn.h. --undo=N reverts the last N.
+// -------------------------------------------------------------------
+static xm_txn *g_txn;
+
+// -------------------------------------------------------------------
+// Stages a patched file if any byte differs from 'original'. Unchanged
+// files are left alone and counted as skipped.
+// -------------------------------------------------------------------
+static void commit_file(const char *filename, const uint8_t *original,
+                        const uint8_t *buffer, size_t size)
+{
+    const uint8_t *staged;
+    size_t staged_size;
+    int restaged = xm_txn_staged(g_txn, filename, &staged, &staged_size);
+
+    if (memcmp(original, buffer, size) == 0)
+    {
+        XM_LOG(XM_LOG_DEBUG, "  -> No changes, skipping rewrite.\n");
+        if (!restaged)
+            g_summary.skipped++;
+        return;
+    }
+
+    XM_LOG(XM_LOG_DEBUG, "  -> Staging rewrite of '%s'...\n", filename);
+    int stage_res = xm_txn_stage(g_txn, filename, original, size, buffer, size);
+    if (stage_res != XM_OK)
+    {
+        XM_LOG(XM_LOG_ERROR, "Could not stage '%s': %s.\n", filename, xm_strerror(stage_res));
+        g_summary.failed++;
+    }
+}
+
+// -------------------------------------------------------------------
+// Publishes every staged file at once and records what was written.
+// Imports regenerate each file's header checksum; a restore puts back
+// the exact bytes it saved. The before/after contents go to the backup store (see xm_store.h) as
+// one save; a file whose backup fails is still written.
+// -------------------------------------------------------------------
+static void commit_import(int update_headers)
+{
+    int count = xm_txn_count(g_txn);
+    XM_LOG(XM_LOG_DEBUG, "Committing %d files...\n", count);
+
+    // The game checks each file's header MD5, so it follows the new records
+    double start = xm_now_ms();
+    int updated = 0;
+    XM_SPAN("checksum")
+    {
+        updated = update_headers ? xm_txn_update_headers(g_txn) : 0;
+    }
+    if (updated < 0)
+        XM_LOG(XM_LOG_WARN, "Could not update checksums: %s.\n", xm_strerror(updated));
+    xm_store_save *save = count > 0 ? xm_store_save_begin(XM_STORE_ROOT) : NULL;
+    XM_SPAN("backup")
+    {
+        for (int i = 0; save && i < count; i++)
+        {
+            const uint8_t *before, *after;
+            size_t before_size, after_size;
+            xm_txn_data(g_txn, i, &before, &before_size, &after, &after_size);
+            int backup_res = xm_store_save_add(save, xm_txn_path(g_txn, i), before, before_size, after, after_size);
+            if (backup_res != XM_OK)
+                XM_LOG(XM_LOG_WARN, "Could not backup '%s': %s.\n",
+                       xm_txn_path(g_txn, i), xm_strerror(backup_res));
+        }
+    }
+
+    int res = XM_OK;
+    XM_SPAN("publish")
+    {
+        res = xm_txn_commit(g_txn);
+    }
+    if (res != XM_OK)
+        XM_LOG(XM_LOG_ERROR, "Commit incomplete: %s.\n", xm_strerror(res));
+
+    for (int i = 0; i < count; i++)
+    {
+        const char *filename = xm_txn_path(g_txn, i);
+        int status = xm_txn_status(g_txn, i);
+        if (status == XM_OK)
+        {
+            record_written(filename);
+        }
+        else
+        {
+            XM_LOG(XM_LOG_ERROR, "Could not write '%s': %s.\n", filename, xm_strerror(status));
+            g_summary.failed++;
+            if (save)
+                xm_store_save_forget(save, filename);
+        }
+    }
+
+    char id[XM_STORE_ID_SIZE];
+    if (save && xm_store_save_commit(save, id) == XM_OK && id[0])
+    {
+        if (g_summary.saves++ > 0)
+            xm_buf_putc(&g_summary.backups, ',');
+        xm_buf_printf(&g_summary.backups, "\"%s\"", id);
+    }
+    xm_store_save_free(save);
+    XM_LOG(XM_LOG_DEBUG, "Commit took %.2f ms.\n", xm_now_ms() - start);
+}
+
+// -------------------------------------------------------------------
+// Reads a file into '*buffer' to be patched, plus a copy of the on-disk
+// bytes in '*original' to tell whether the import changes anything.
+// Counts the file as failed and returns -1 if it can't be loaded.
+// -------------------------------------------------------------------
+static int load_file(const char *filename, uint8_t **buffer, uint8_t **original, size_t *size)
+{
+    // A file named twice in one run builds on its staged contents
+    const uint8_t *staged;
+    int read_res = XM_OK;
+    if (xm_txn_staged(g_txn, filename, &staged, size))
+    {
+        *buffer = malloc(*size + 1);
+        if (*buffer)
+            memcpy(*buffer, staged, *size);
+        else
+            read_res = XM_ERR_NOMEM;
+    }
+    else
+    {
+        read_res = xm_read_file(filename, buffer, size);
+    }
+    if (read_res != XM_OK)
+    {
+        XM_LOG(XM_LOG_ERROR, "Could not read '%s': %s.\n", filename, xm_strerror(read_res));
+        g_summary.failed++;
+        return -1;
+    }
+
+    XM_LOG(XM_LOG_DEBUG, "  -> bytes_read=%zu\n", *size);
+    if (*size == 0)
+    {
+        xm_free(*buffer);
+        XM_LOG(XM_LOG_ERROR, "File '%s' is empty or invalid.\n", filename);
+        g_summary.failed++;
+        return -1;
+    }
+
+    *original = malloc(*size);
+    if (!*original)
+    {
+        xm_free(*buffer);
+        XM_LOG(XM_LOG_ERROR, "Out of memory importing '%s'.\n", filename);
+        g_summary.failed++;
+        return -1;
+    }
+    memcpy(*original, *buffer, *size);
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// For one file object:
+//   1) loads into memory
+//   2) overwrites macros
+//   3) if any byte changed: stages the rewrite; otherwise leaves the
+//      file alone
+// -------------------------------------------------------------------
+static void import_one_file_object(cJSON *fileObj)
+{
+    if (!cJSON_IsObject(fileObj))
+    {
+        XM_LOG(XM_LOG_DEBUG, "skipping fileObj - not object.\n");
+        return;
+    }
+
+    cJSON *fileNameItem = cJSON_GetObjectItemCaseSensitive(fileObj, "fileName");
+    if (!cJSON_IsString(fileNameItem))
+    {
+        XM_LOG(XM_LOG_DEBUG, "fileObj missing 'fileName' string.\n");
+        return;
+    }
+    const char *filename = fileNameItem->valuestring;
+
+    XM_LOG(XM_LOG_DEBUG, "\nImporting file: '%s'\n", filename);
+
+    uint8_t *buffer;
+    uint8_t *original;
+    size_t bytes_read;
+    if (load_file(filename, &buffer, &original, &bytes_read) != 0)
+        return;
+
+    // Overwrite macros from JSON
+    cJSON *macrosArray = cJSON_GetObjectItemCaseSensitive(fileObj, "macros");
+    if (!cJSON_IsArray(macrosArray))
+    {
+        XM_LOG(XM_LOG_DEBUG, "  -> no 'macros' array in fileObj.\n");
+    }
+    else
+    {
+        XM_LOG(XM_LOG_DEBUG, "  -> Parsing macros array...\n");
+        cJSON *macroObj = NULL;
+        cJSON_ArrayForEach(macroObj, macrosArray)
+        {
+            process_macro_object(macroObj, buffer, bytes_read);
+        }
+    }
+
+    commit_file(filename, original, buffer, bytes_read);
+    free(original);
+    xm_free(buffer);
+}
+
+// -------------------------------------------------------------------
+// Positional patch mode (--patch):
+// {
+//   "dir": "C:\\...\\USER\\<id>",
+//   "edits": [
+//     [3, 0, 1, "/echo hi"],                 // file, macro, line, data
+//     [3, 0, "name", "Hi"],                  // file, macro, "name", name
+//     {"file": 3, "macro": 0, "line": 1, "data": "/echo hi"},
+//     {"file": "mcr3.dat", "macro": 0, "name": "Hi"}
+//   ]
+// }
+// Offsets are derived from the record layout, never taken from input.
+// -------------------------------------------------------------------
+typedef struct
+{
+    int file;  // 0 = mcr.dat, N = mcrN.dat
+    int macro; // 0..19
+    int field; // line 0..5 or XM_FIELD_NAME
+    const char *text;
+    int seq; // input order, kept between edits to the same file
+} patch_edit;
+
+static int json_int(const cJSON *item, int *out)
+{
+    if (!cJSON_IsNumber(item) || item->valuedouble != (double)item->valueint)
+        return -1;
+    *out = item->valueint;
+    return 0;
+}
+
+static int json_file_index(const cJSON *item, int *out)
+{
+    if (cJSON_IsString(item))
+    {
+        *out = xm_file_index(xm_basename(item->valuestring));
+        return *out < 0 ? -1 : 0;
+    }
+    return json_int(item, out);
+}
+
+static int parse_edit(const cJSON *item, patch_edit *edit)
+{
+    const cJSON *file, *macro, *field, *text;
+
+    if (cJSON_IsArray(item))
+    {
+        if (cJSON_GetArraySize(item) != 4)
+            return -1;
+        file = cJSON_GetArrayItem(item, 0);
+        macro = cJSON_GetArrayItem(item, 1);
+        field = cJSON_GetArrayItem(item, 2);
+        text = cJSON_GetArrayItem(item, 3);
+    }
+    else if (cJSON_IsObject(item))
+    {
+        file = cJSON_GetObjectItemCaseSensitive(item, "file");
+        macro = cJSON_GetObjectItemCaseSensitive(item, "macro");
+        text = cJSON_GetObjectItemCaseSensitive(item, "name");
+        if (text)
+            field = NULL;
+        else
+        {
+            field = cJSON_GetObjectItemCaseSensitive(item, "line");
+            text = cJSON_GetObjectItemCaseSensitive(item, "data");
+            if (!field)
+                return -1;
+        }
+    }
+    else
+    {
+        return -1;
+    }
+
+    if (json_file_index(file, &edit->file) != 0 || json_int(macro, &edit->macro) != 0 ||
+        !cJSON_IsString(text))
+        return -1;
+
+    if (!field || (cJSON_IsString(field) && strcmp(field->valuestring, "name") == 0))
+        edit->field = XM_FIELD_NAME;
+    else if (json_int(field, &edit->field) != 0 || edit->field < 0)
+        return -1;
+
+    if (edit->file < 0 || edit->file > XM_MAX_FILE_INDEX || edit->macro < 0 ||
+        edit->macro >= XM_MACROS_PER_FILE || edit->field >= XM_LINES_PER_MACRO)
+        return -1;
+
+    edit->text = text->valuestring;
+    return 0;
+}
+
+static int compare_edits(const void *a, const void *b)
+{
+    const patch_edit *ea = a;
+    const patch_edit *eb = b;
+    if (ea->file != eb->file)
+        return ea->file < eb->file ? -1 : 1;
+    return ea->seq < eb->seq ? -1 : (ea->seq > eb->seq);
+}
+
+static int import_patch(cJSON *root)
+{
+    cJSON *dirItem = cJSON_GetObjectItemCaseSensitive(root, "dir");
+    cJSON *editsArray = cJSON_GetObjectItemCaseSensitive(root, "edits");
+    if (!cJSON_IsString(dirItem) || !cJSON_IsArray(editsArray))
+    {
+        XM_LOG(XM_LOG_ERROR, "Patch needs a 'dir' string and an 'edits' array.\n");
+        return 1;
+    }
+
+    int total = cJSON_GetArraySize(editsArray);
+    patch_edit *edits = malloc((total ? total : 1) * sizeof(*edits));
+    if (!edits)
+    {
+        XM_LOG(XM_LOG_ERROR, "Out of memory reading %d edits.\n", total);
+        return 1;
+    }
+
+    int count = 0;
+    int seq = 0;
+    cJSON *item = NULL;
+    cJSON_ArrayForEach(item, editsArray)
+    {
+        if (parse_edit(item, &edits[count]) != 0)
+        {
+            XM_LOG(XM_LOG_DEBUG, "Edit #%d is malformed or out of range; rejected.\n", seq);
+            g_summary.rejected++;
+        }
+        else
+        {
+            edits[count++].seq = seq;
+        }
+        seq++;
+    }
+
+    qsort(edits, count, sizeof(*edits), compare_edits);
+
+    // One read/patch/commit per file, however many edits it gets
+    for (int i = 0; i < count;)
+    {
+        int j = i;
+        while (j < count && edits[j].file == edits[i].file)
+            j++;
+
+        char path[1024];
+        uint8_t *buffer;
+        uint8_t *original;
+        size_t size;
+        if (xm_file_path(dirItem->valuestring, edits[i].file, path, sizeof(path)) != XM_OK)
+        {
+            XM_LOG(XM_LOG_ERROR, "Path too long for file %d.\n", edits[i].file);
+            g_summary.failed++;
+        }
+        else if (load_file(path, &buffer, &original, &size) == 0)
+        {
+            XM_LOG(XM_LOG_DEBUG, "\nPatching file: '%s' (%d edits)\n", path, j - i);
+            for (int k = i; k < j; k++)
+            {
+                const patch_edit *e = &edits[k];
+                size_t text_len = strlen(e->text);
+                size_t offset, field_len;
+                if (xm_field_span(size, e->macro, e->field, &offset, &field_len) != XM_OK ||
+                    xm_text_set_field(buffer, size, e->macro, e->field, e->text, text_len, NULL) != XM_OK)
+                {
+                    XM_LOG(XM_LOG_WARN, "Edit #%d (macro %d) is past the end of '%s'; rejected.\n",
+                           e->seq, e->macro, path);
+                    g_summary.rejected++;
+                    continue;
+                }
+                XM_LOG(XM_LOG_TRACE, "  Edit #%d -> offset=0x%zX, %zu/%zu bytes%s\n", e->seq,
+                       offset, text_len, field_len, text_len > field_len ? " (truncated)" : "");
+            }
+            commit_file(path, original, buffer, size);
+            free(original);
+            xm_free(buffer);
+        }
+        i = j;
+    }
+
+    free(edits);
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// Page and macro transfer mode (--transfer):
+// [
+//   {"op": "copy", "from": {"dir": "...", "file": 3}, "to": {"dir": "...", "file": 7}},
+//   {"op": "move", "from": {"dir": "...", "file": 3, "macro": 0},
+//                  "to": {"dir": "...", "file": 9, "macro": 19}},
+//   {"op": "swap", ...}
+// ]
+// Without "macro" an operation covers the whole page (every record from
+// XM_MACRO_START), with it one record. Bytes are moved as they are, never
+// re-encoded; "move" blanks the source afterwards. Operations apply in
+// order, each on top of the ones before, and commit as one import.
+// -------------------------------------------------------------------
+typedef struct
+{
+    char path[1024];
+    int macro; // -1 for the whole page
+    uint8_t *data;
+    size_t size;
+    uint8_t *original; // NULL if the file doesn't exist yet
+    size_t original_size;
+    int pristine; // 'original' is on disk as is, not staged by this run
+} transfer_file;
+
+static int parse_location(const cJSON *item, transfer_file *f)
+{
+    const cJSON *dir = cJSON_GetObjectItemCaseSensitive(item, "dir");
+    const cJSON *macro = cJSON_GetObjectItemCaseSensitive(item, "macro");
+    int file;
+    if (!cJSON_IsString(dir) || json_file_index(cJSON_GetObjectItemCaseSensitive(item, "file"), &file) != 0 ||
+        file < 0 || file > XM_MAX_FILE_INDEX)
+        return -1;
+
+    f->macro = -1;
+    if (macro && (json_int(macro, &f->macro) != 0 || f->macro < 0 || f->macro >= XM_MACROS_PER_FILE))
+        return -1;
+    return xm_file_path(dir->valuestring, file, f->path, sizeof(f->path)) == XM_OK ? 0 : -1;
+}
+
+// Staged contents if an earlier operation touched the file, else the file
+// on disk. A missing file loads as empty if 'may_be_missing'.
+static int load_transfer_file(transfer_file *f, int may_be_missing)
+{
+    const uint8_t *staged;
+    f->pristine = !xm_txn_staged(g_txn, f->path, &staged, &f->size);
+    int err = XM_OK;
+    if (!f->pristine)
+    {
+        f->data = malloc(f->size + 1);
+        if (f->data)
+            memcpy(f->data, staged, f->size);
+        else
+            err = XM_ERR_NOMEM;
+    }
+    else
+    {
+        err = xm_read_file(f->path, &f->data, &f->size);
+    }
+
+    f->original = NULL;
+    f->original_size = 0;
+    if (err == XM_ERR_OPEN && may_be_missing)
+    {
+        f->data = malloc(1);
+        f->size = 0;
+        return f->data ? 0 : -1;
+    }
+    if (err == XM_OK && f->size <= XM_MACRO_START)
+    {
+        xm_free(f->data);
+        err = XM_ERR_FORMAT;
+    }
+    if (err == XM_OK && !(f->original = malloc(f->size)))
+    {
+        xm_free(f->data);
+        err = XM_ERR_NOMEM;
+    }
+    if (err != XM_OK)
+    {
+        XM_LOG(XM_LOG_ERROR, "Could not read '%s': %s.\n", f->path, xm_strerror(err));
+        return -1;
+    }
+
+    memcpy(f->original, f->data, f->size);
+    f->original_size = f->size;
+    return 0;
+}
+
+static void free_transfer_file(transfer_file *f)
+{
+    xm_free(f->data);
+    free(f->original);
+}
+
+// One record, clipped to the end of the file (the last one is short)
+static size_t record_span(const transfer_file *f, uint8_t **start)
+{
+    size_t offset = XM_MACRO_START + (size_t)f->macro * XM_MACRO_SIZE;
+    *start = f->data;
+    if (offset >= f->size)
+        return 0;
+    *start = f->data + offset;
+    return f->size - offset < XM_MACRO_SIZE ? f->size - offset : XM_MACRO_SIZE;
+}
+
+// Copies the records of 'from' over those of 'to'. A page that doesn't
+// exist yet, or differs in size, becomes a copy of the whole source file.
+static int copy_records(const transfer_file *from, transfer_file *to)
+{
+    if (to->macro < 0 && to->size != from->size)
+    {
+        uint8_t *copy = malloc(from->size + 1);
+        if (!copy)
+            return -1;
+        memcpy(copy, from->data, from->size);
+        xm_free(to->data);
+        to->data = copy;
+        to->size = from->size;
+        return 0;
+    }
+    if (to->macro < 0)
+    {
+        memmove(to->data + XM_MACRO_START, from->data + XM_MACRO_START, from->size - XM_MACRO_START);
+        return 0;
+    }
+
+    uint8_t *src, *dst;
+    size_t src_len = record_span(from, &src);
+    size_t dst_len = record_span(to, &dst);
+    size_t n = src_len < dst_len ? src_len : dst_len;
+    memmove(dst, src, n);
+    memset(dst + n, 0, dst_len - n);
+    return 0;
+}
+
+static int swap_records(transfer_file *a, transfer_file *b)
+{
+    if (a->macro < 0)
+    {
+        if (a->size != b->size)
+            return -1;
+        if (a == b)
+            return 0;
+        for (size_t i = XM_MACRO_START; i < a->size; i++)
+        {
+            uint8_t t = a->data[i];
+            a->data[i] = b->data[i];
+            b->data[i] = t;
+        }
+        return 0;
+    }
+
+    uint8_t tmp[XM_MACRO_SIZE];
+    uint8_t *pa, *pb;
+    size_t len_a = record_span(a, &pa);
+    size_t len_b = record_span(b, &pb);
+    size_t n = len_a < len_b ? len_a : len_b;
+    memcpy(tmp, pa, len_a);
+    memmove(pa, pb, n);
+    memset(pa + n, 0, len_a - n);
+    memcpy(pb, tmp, n);
+    memset(pb + n, 0, len_b - n);
+    return 0;
+}
+
+static void blank_records(transfer_file *f)
+{
+    uint8_t *start;
+    if (f->macro < 0)
+        memset(f->data + XM_MACRO_START, 0, f->size - XM_MACRO_START);
+    else
+        memset(start, 0, record_span(f, &start));
+}
+
+// Stages 'f' if it changed, with its header checksum regenerated. A page
+// that ends up byte for byte the untouched file 'source' is staged as a
+// copy of it, which the commit makes in the kernel.
+static void stage_transfer_file(transfer_file *f, const transfer_file *source)
+{
+    if (f->original && f->size == f->original_size && memcmp(f->data, f->original, f->size) == 0)
+    {
+        const uint8_t *staged;
+        size_t staged_size;
+        if (!xm_txn_staged(g_txn, f->path, &staged, &staged_size))
+            g_summary.skipped++;
+        return;
+    }
+
+    static const uint8_t none[1];
+    const uint8_t *old = f->original ? f->original : none;
+    xm_header_update(f->data, f->size);
+
+    int err;
+    if (source && source->pristine && source->original_size == f->size &&
+        memcmp(source->original, f->data, f->size) == 0)
+        err = xm_txn_stage_copy(g_txn, f->path, old, f->original_size, f->data, f->size, source->path);
+    else
+        err = xm_txn_stage(g_txn, f->path, old, f->original_size, f->data, f->size);
+    if (err != XM_OK)
+    {
+        XM_LOG(XM_LOG_ERROR, "Could not stage '%s': %s.\n", f->path, xm_strerror(err));
+        g_summary.failed++;
+    }
+}
+
+static int transfer_one(const char *op, transfer_file *from, transfer_file *to)
+{
+    int copy = strcmp(op, "copy") == 0;
+    int move = strcmp(op, "move") == 0;
+    int swap = strcmp(op, "swap") == 0;
+    if ((!copy && !move && !swap) || (from->macro < 0) != (to->macro < 0))
+        return -1;
+
+    // Both ends in one file share one buffer
+    int same_file = strcmp(from->path, to->path) == 0;
+    if (load_transfer_file(from, 0) != 0)
+        return -1;
+    if (same_file)
+    {
+        to->data = from->data;
+        to->size = from->size;
+    }
+    else if (load_transfer_file(to, !swap && to->macro < 0) != 0)
+    {
+        free_transfer_file(from);
+        return -1;
+    }
+
+    int same_records = same_file && from->macro == to->macro;
+    int res = same_records ? 0 : swap ? swap_records(from, to) : copy_records(from, to);
+    if (res == 0 && move && !same_records)
+        blank_records(from);
+
+    if (res == 0)
+    {
+        if (!same_file)
+            stage_transfer_file(to, to->macro < 0 ? from : NULL);
+        if (!copy || same_file)
+            stage_transfer_file(from, NULL);
+    }
+    free_transfer_file(from);
+    if (!same_file)
+        free_transfer_file(to);
+    return res;
+}
+
+static int import_transfer(cJSON *root)
+{
+    if (!cJSON_IsArray(root))
+    {
+        XM_LOG(XM_LOG_ERROR, "Transfer input must be an array of operations.\n");
+        return 1;
+    }
+
+    int seq = 0;
+    const cJSON *item = NULL;
+    cJSON_ArrayForEach(item, root)
+    {
+        const cJSON *op = cJSON_GetObjectItemCaseSensitive(item, "op");
+        transfer_file from, to;
+        if (!cJSON_IsString(op) ||
+            parse_location(cJSON_GetObjectItemCaseSensitive(item, "from"), &from) != 0 ||
+            parse_location(cJSON_GetObjectItemCaseSensitive(item, "to"), &to) != 0 ||
+            transfer_one(op->valuestring, &from, &to) != 0)
+        {
+            XM_LOG(XM_LOG_WARN, "Transfer #%d is malformed or can't be applied; rejected.\n", seq);
+            g_summary.rejected++;
+        }
+        seq++;
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// RFC 6902 JSON Patch mode (--json-patch):
+// {
+//   "dir": "C:\\...\\USER\\<id>",
+//   "patch": [
+//     {"op": "test", "path": "/3/macros/0/name", "value": "Cure"},
+//     {"op": "replace", "path": "/3/macros/0/lines/1", "value": "/echo hi"}
+//   ]
+// }
+// The patch is applied to a document holding only the files its paths
+// mention, keyed by file index:
+//   { "3": { "macros": [ { "lines": ["..", x6], "name": ".." }, x20 ] } }
+// and changed fields are written back. The patch applies all-or-nothing;
+// a file whose arrays no longer have the record layout's length (e.g.
+// after "add"/"copy" into "macros", which insert) is rejected.
+// -------------------------------------------------------------------
+static int pointer_file_index(const char *pointer)
+{
+    if (pointer[0] != '/' || pointer[1] < '0' || pointer[1] > '9')
+        return -1;
+
+    int index = 0;
+    const char *p = pointer + 1;
+    while (*p >= '0' && *p <= '9' && index <= XM_MAX_FILE_INDEX)
+        index = index * 10 + (*p++ - '0');
+
+    if ((*p != '/' && *p != '\0') || index > XM_MAX_FILE_INDEX)
+        return -1;
+    return index;
+}
+
+// The field's decoded text, as ximacro_e exports it: "test" ops compare
+// against it, and a field the patch leaves alone encodes back unchanged
+static cJSON *field_to_json(const uint8_t *data, size_t size, int macro, int field)
+{
+    size_t offset, len;
+    xm_field_span(size, macro, field, &offset, &len);
+
+    xm_buf text;
+    xm_buf_init(&text);
+    xm_text_decode(&text, data + offset, len);
+    xm_buf_putc(&text, '\0');
+    cJSON *item = text.failed ? NULL : cJSON_CreateString(text.data);
+    xm_buf_free(&text);
+    return item;
+}
+
+static void field_from_json(const cJSON *item, uint8_t *buffer, const uint8_t *original,
+                            size_t size, int macro, int field)
+{
+    if (!cJSON_IsString(item))
+    {
+        XM_LOG(XM_LOG_WARN, "Macro %d field %d is no longer a string; rejected.\n", macro, field);
+        g_summary.rejected++;
+        return;
+    }
+
+    // Only rewrite fields the patch changed; bytes after a field's NUL
+    // aren't part of the document and must survive untouched.
+    size_t offset, len;
+    xm_field_span(size, macro, field, &offset, &len);
+    const uint8_t *old = original + offset;
+    size_t old_len = 0;
+    while (old_len < len && old[old_len])
+        old_len++;
+
+    uint8_t text[XM_LINE_SIZE];
+    size_t text_len = xm_text_encode(item->valuestring, strlen(item->valuestring), text, len, NULL);
+    if (text_len == old_len && memcmp(text, old, old_len) == 0)
+        return;
+    xm_write_field(buffer, size, offset, (const char *)text, text_len, len, NULL);
+}
+
+static int import_json_patch(cJSON *root)
+{
+    cJSON *dirItem = cJSON_GetObjectItemCaseSensitive(root, "dir");
+    cJSON *patch = cJSON_GetObjectItemCaseSensitive(root, "patch");
+    if (!cJSON_IsString(dirItem) || !cJSON_IsArray(patch))
+    {
+        XM_LOG(XM_LOG_ERROR, "JSON Patch needs a 'dir' string and a 'patch' array.\n");
+        return 1;
+    }
+
+    // Files the patch touches
+    uint8_t wanted[XM_FILE_COUNT] = {0};
+    cJSON *op = NULL;
+    cJSON_ArrayForEach(op, patch)
+    {
+        static const char *const keys[] = {"path", "from"};
+        for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++)
+        {
+            cJSON *pointer = cJSON_GetObjectItemCaseSensitive(op, keys[k]);
+            if (!pointer)
+                continue;
+            int index = cJSON_IsString(pointer) ? pointer_file_index(pointer->valuestring) : -1;
+            if (index < 0)
+            {
+                XM_LOG(XM_LOG_ERROR, "Patch %s must start with a file index: /<0..%d>/...\n",
+                       keys[k], XM_MAX_FILE_INDEX);
+                g_summary.rejected = cJSON_GetArraySize(patch);
+                return 1;
+            }
+            wanted[index] = 1;
+        }
+    }
+
+    static uint8_t *buffers[XM_FILE_COUNT];
+    static uint8_t *originals[XM_FILE_COUNT];
+    static size_t sizes[XM_FILE_COUNT];
+    static char paths[XM_FILE_COUNT][1024];
+    cJSON *doc = cJSON_CreateObject();
+    int rc = 0;
+
+    for (int i = 0; i < XM_FILE_COUNT && doc; i++)
+    {
+        if (!wanted[i])
+            continue;
+        if (xm_file_path(dirItem->valuestring, i, paths[i], sizeof(paths[i])) != XM_OK ||
+            load_file(paths[i], &buffers[i], &originals[i], &sizes[i]) != 0)
+        {
+            buffers[i] = NULL;
+            continue;
+        }
+
+        char key[16];
+        snprintf(key, sizeof(key), "%d", i);
+        cJSON *fileObj = cJSON_AddObjectToObject(doc, key);
+        cJSON *macros = cJSON_AddArrayToObject(fileObj, "macros");
+        size_t macro_count = xm_macro_count(sizes[i]);
+        for (size_t m = 0; m < macro_count && macros; m++)
+        {
+            cJSON *macroObj = cJSON_CreateObject();
+            cJSON *lines = cJSON_AddArrayToObject(macroObj, "lines");
+            for (int l = 0; l < XM_LINES_PER_MACRO; l++)
+                cJSON_AddItemToArray(lines, field_to_json(buffers[i], sizes[i], (int)m, l));
+            cJSON_AddItemToObject(macroObj, "name",
+                                  field_to_json(buffers[i], sizes[i], (int)m, XM_FIELD_NAME));
+            cJSON_AddItemToArray(macros, macroObj);
+        }
+    }
+
+    int patch_res = doc ? cJSONUtils_ApplyPatchesCaseSensitive(doc, patch) : -1;
+    if (patch_res != 0)
+    {
+        XM_LOG(XM_LOG_ERROR, "JSON Patch failed (cJSONUtils error %d); nothing written.\n", patch_res);
+        g_summary.rejected = cJSON_GetArraySize(patch);
+        rc = 1;
+    }
+
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        if (!wanted[i] || !buffers[i])
+            continue;
+
+        if (rc == 0)
+        {
+            char key[16];
+            snprintf(key, sizeof(key), "%d", i);
+            cJSON *fileObj = cJSON_GetObjectItemCaseSensitive(doc, key);
+            cJSON *macros = cJSON_GetObjectItemCaseSensitive(fileObj, "macros");
+            size_t macro_count = xm_macro_count(sizes[i]);
+            if (!cJSON_IsArray(macros) || (size_t)cJSON_GetArraySize(macros) != macro_count)
+            {
+                XM_LOG(XM_LOG_WARN, "Patch changed the macro layout of '%s'; rejected.\n", paths[i]);
+                g_summary.rejected++;
+            }
+            else
+            {
+                int m = 0;
+                cJSON *macroObj = NULL;
+                cJSON_ArrayForEach(macroObj, macros)
+                {
+                    cJSON *lines = cJSON_GetObjectItemCaseSensitive(macroObj, "lines");
+                    if (!cJSON_IsArray(lines) || cJSON_GetArraySize(lines) != XM_LINES_PER_MACRO)
+                    {
+                        XM_LOG(XM_LOG_WARN, "Macro %d of '%s' no longer has %d lines; rejected.\n",
+                               m, paths[i], XM_LINES_PER_MACRO);
+                        g_summary.rejected++;
+                    }
+                    else
+                    {
+                        int l = 0;
+                        cJSON *line = NULL;
+                        cJSON_ArrayForEach(line, lines)
+                        {
+                            field_from_json(line, buffers[i], originals[i], sizes[i], m, l++);
+                        }
+                    }
+                    field_from_json(cJSON_GetObjectItemCaseSensitive(macroObj, "name"),
+                                    buffers[i], originals[i], sizes[i], m, XM_FIELD_NAME);
+                    m++;
+                }
+                commit_file(paths[i], originals[i], buffers[i], sizes[i]);
+            }
+        }
+
+        free(originals[i]);
+        xm_free(buffers[i]);
+    }
+
+    cJSON_Delete(doc);
+    return rc;
+}
+
+// -------------------------------------------------------------------
+// Default mode: the exporter's array of file objects
+// -------------------------------------------------------------------
+static int import_files(cJSON *root)
+{
+    if (!cJSON_IsArray(root))
+    {
+        XM_LOG(XM_LOG_ERROR, "Top-level JSON not an array.\n");
+        return 1;
+    }
+
+    XM_LOG(XM_LOG_DEBUG, "Processing file objects in array...\n");
+
+    cJSON *fileObj = NULL;
+    cJSON_ArrayForEach(fileObj, root)
+    {
+        import_one_file_object(fileObj);
+    }
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// Streaming mode (--stream): the same array of file objects, parsed
+// straight off stdin a window at a time. Each file object is applied as
+// soon as its closing brace arrives; nothing builds a DOM, and memory is
+// bounded by the read window, the edit arena and one folder's staged
+// files. Staged files are committed whenever the input moves on to
+// another character folder, so a multi-character restore publishes (and
+// journals) one character at a time.
+// -------------------------------------------------------------------
+#define STREAM_WINDOW (64 * 1024)
+#define STREAM_ARENA (256 * 1024) // edits of one file object
+#define STREAM_MAX_DEPTH 64
+#define STREAM_NAME_MAX 1024
+
+typedef struct
+{
+    FILE *fp;
+    uint8_t buf[STREAM_WINDOW];
+    size_t pos;
+    size_t len;
+    size_t consumed; // bytes before buf, for error positions
+    int failed;
+} json_stream;
+
+static int stream_peek(json_stream *s)
+{
+    if (s->pos == s->len)
+    {
+        s->consumed += s->len;
+        s->len = fread(s->buf, 1, sizeof(s->buf), s->fp);
+        s->pos = 0;
+        if (s->len == 0)
+            return -1;
+    }
+    return s->buf[s->pos];
+}
+
+static int stream_next(json_stream *s)
+{
+    int c = stream_peek(s);
+    if (c >= 0)
+        s->pos++;
+    return c;
+}
+
+static int stream_fail(json_stream *s, const char *what)
+{
+    if (!s->failed)
+        XM_LOG(XM_LOG_ERROR, "JSON parse error at byte %zu: %s.\n", s->consumed + s->pos, what);
+    s->failed = 1;
+    return -1;
+}
+
+static int stream_skip_ws(json_stream *s)
+{
+    int c;
+    while ((c = stream_peek(s)) == ' ' || c == '\t' || c == '\n' || c == '\r')
+        s->pos++;
+    return c;
+}
+
+static int stream_expect(json_stream *s, int want)
+{
+    if (stream_skip_ws(s) != want)
+        return stream_fail(s, "unexpected character");
+    s->pos++;
+    return 0;
+}
+
+static int hex_value(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static int stream_read_hex4(json_stream *s, unsigned *out)
+{
+    *out = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int v = hex_value(stream_next(s));
+        if (v < 0)
+            return stream_fail(s, "bad \\u escape");
+        *out = (*out << 4) | (unsigned)v;
+    }
+    return 0;
+}
+
+static void put_utf8(char *out, size_t cap, size_t *len, unsigned cp)
+{
+    char tmp[4];
+    size_t n;
+    if (cp < 0x80)
+    {
+        tmp[0] = (char)cp;
+        n = 1;
+    }
+    else if (cp < 0x800)
+    {
+        tmp[0] = (char)(0xC0 | (cp >> 6));
+        tmp[1] = (char)(0x80 | (cp & 0x3F));
+        n = 2;
+    }
+    else if (cp < 0x10000)
+    {
+        tmp[0] = (char)(0xE0 | (cp >> 12));
+        tmp[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        tmp[2] = (char)(0x80 | (cp & 0x3F));
+        n = 3;
+    }
+    else
+    {
+        tmp[0] = (char)(0xF0 | (cp >> 18));
+        tmp[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        tmp[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        tmp[3] = (char)(0x80 | (cp & 0x3F));
+        n = 4;
+    }
+    for (size_t i = 0; i < n; i++, (*len)++)
+    {
+        if (out && *len < cap)
+            out[*len] = tmp[i];
+    }
+}
+
+// -------------------------------------------------------------------
+// Reads a string token, decoding escapes the way cJSON does. Keeps at
+// most 'cap' bytes in 'out' (NULL to discard) but consumes all of it;
+// '*len' is the full decoded length.
+// -------------------------------------------------------------------
+static int stream_read_string(json_stream *s, char *out, size_t cap, size_t *len)
+{
+    *len = 0;
+    if (stream_expect(s, '"') != 0)
+        return -1;
+
+    for (;;)
+    {
+        // Copy the plain run in the current window in one go
+        if (s->pos < s->len)
+        {
+            const uint8_t *start = s->buf + s->pos;
+            const uint8_t *end = s->buf + s->len;
+            const uint8_t *p = start;
+            while (p < end && *p != '"' && *p != '\\' && *p >= 0x20)
+                p++;
+            size_t run = (size_t)(p - start);
+            if (out && *len < cap)
+                memcpy(out + *len, start, run < cap - *len ? run : cap - *len);
+            *len += run;
+            s->pos += run;
+        }
+
+        int c = stream_next(s);
+        if (c < 0)
+            return stream_fail(s, "unterminated string");
+        if (c == '"')
+            return 0;
+        if (c < 0x20)
+            return stream_fail(s, "control character in string");
+        if (c != '\\')
+        {
+            // the window ended mid-run
+            if (out && *len < cap)
+                out[*len] = (char)c;
+            (*len)++;
+            continue;
+        }
+
+        c = stream_next(s);
+        unsigned cp;
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        case '/':
+            cp = (unsigned)c;
+            break;
+        case 'b':
+            cp = '\b';
+            break;
+        case 'f':
+            cp = '\f';
+            break;
+        case 'n':
+            cp = '\n';
+            break;
+        case 'r':
+            cp = '\r';
+            break;
+        case 't':
+            cp = '\t';
+            break;
+        case 'u':
+            if (stream_read_hex4(s, &cp) != 0)
+                return -1;
+            if (cp >= 0xDC00 && cp <= 0xDFFF)
+                return stream_fail(s, "lone low surrogate");
+            if (cp >= 0xD800 && cp <= 0xDBFF)
+            {
+                unsigned low;
+                if (stream_next(s) != '\\' || stream_next(s) != 'u' || stream_read_hex4(s, &low) != 0 ||
+                    low < 0xDC00 || low > 0xDFFF)
+                    return stream_fail(s, "bad surrogate pair");
+                cp = 0x10000 + (((cp & 0x3FF) << 10) | (low & 0x3FF));
+            }
+            break;
+        default:
+            return stream_fail(s, "bad escape");
+        }
+        put_utf8(out, cap, len, cp);
+    }
+}
+
+static int stream_skip_value(json_stream *s, int depth);
+
+// -------------------------------------------------------------------
+// Walks an object's members, handing each key to 'member' positioned at
+// its value. 'member' returns 1 if it consumed the value, 0 to skip it.
+// -------------------------------------------------------------------
+typedef int (*member_fn)(json_stream *s, const char *key, void *ctx, int depth);
+
+static int stream_object(json_stream *s, int depth, member_fn member, void *ctx)
+{
+    if (depth > STREAM_MAX_DEPTH)
+        return stream_fail(s, "nested too deeply");
+    if (stream_expect(s, '{') != 0)
+        return -1;
+    if (stream_skip_ws(s) == '}')
+    {
+        s->pos++;
+        return 0;
+    }
+
+    for (;;)
+    {
+        char key[32];
+        size_t key_len;
+        if (stream_read_string(s, key, sizeof(key) - 1, &key_len) != 0 || stream_expect(s, ':') != 0)
+            return -1;
+        key[key_len < sizeof(key) - 1 ? key_len : 0] = '\0'; // long keys are never ours
+
+        int used = member ? member(s, key, ctx, depth + 1) : 0;
+        if (used < 0 || (!used && stream_skip_value(s, depth + 1) != 0))
+            return -1;
+
+        int c = stream_skip_ws(s);
+        s->pos += c >= 0;
+        if (c == '}')
+            return 0;
+        if (c != ',')
+            return stream_fail(s, "expected ',' or '}'");
+    }
+}
+
+typedef int (*element_fn)(json_stream *s, void *ctx, int depth);
+
+static int stream_array(json_stream *s, int depth, element_fn element, void *ctx)
+{
+    if (depth > STREAM_MAX_DEPTH)
+        return stream_fail(s, "nested too deeply");
+    if (stream_expect(s, '[') != 0)
+        return -1;
+    if (stream_skip_ws(s) == ']')
+    {
+        s->pos++;
+        return 0;
+    }
+
+    for (;;)
+    {
+        if (element(s, ctx, depth + 1) != 0)
+            return -1;
+
+        int c = stream_skip_ws(s);
+        s->pos += c >= 0;
+        if (c == ']')
+            return 0;
+        if (c != ',')
+            return stream_fail(s, "expected ',' or ']'");
+    }
+}
+
+static int skip_element(json_stream *s, void *ctx, int depth)
+{
+    (void)ctx;
+    return stream_skip_value(s, depth);
+}
+
+static int stream_skip_value(json_stream *s, int depth)
+{
+    size_t len;
+    int c = stream_skip_ws(s);
+    switch (c)
+    {
+    case '{':
+        return stream_object(s, depth, NULL, NULL);
+    case '[':
+        return stream_array(s, depth, skip_element, NULL);
+    case '"':
+        return stream_read_string(s, NULL, 0, &len);
+    case -1:
+        return stream_fail(s, "unexpected end of input");
+    default:
+        // numbers and true/false/null
+        if (!strchr("-0123456789tfn", c))
+            return stream_fail(s, "unexpected character");
+        while ((c = stream_peek(s)) >= 0 && strchr("+-.0123456789eEtruefalsn", c))
+            s->pos++;
+        return 0;
+    }
+}
+
+// Reads a string member value, or reports that the value isn't a string
+static int member_string(json_stream *s, char *out, size_t cap, size_t *len, int *is_string)
+{
+    *is_string = stream_skip_ws(s) == '"';
+    if (!*is_string)
+        return 0;
+    if (stream_read_string(s, out, cap - 1, len) != 0)
+        return -1;
+    out[*len < cap - 1 ? *len : cap - 1] = '\0';
+    return 1;
+}
+
+// -------------------------------------------------------------------
+// Edits of the file object being parsed, packed into a fixed arena:
+// { size_t offset; size_t field_size; size_t len; } then 'len' text bytes
+// -------------------------------------------------------------------
+typedef struct
+{
+    size_t offset;
+    size_t field_size;
+    size_t len;
+} stream_edit;
+
+static uint8_t g_arena[STREAM_ARENA];
+static size_t g_arena_used;
+static int g_arena_full;
+
+static void arena_add_edit(size_t offset, size_t field_size, const char *text, size_t len)
+{
+    // Like strlen() on a cJSON string: stop at an embedded NUL
+    const char *nul = memchr(text, 0, len);
+    if (nul)
+        len = (size_t)(nul - text);
+
+    stream_edit edit = {offset, field_size, len};
+    if (STREAM_ARENA - g_arena_used < sizeof(edit) + len)
+    {
+        g_arena_full = 1;
+        return;
+    }
+    memcpy(g_arena + g_arena_used, &edit, sizeof(edit));
+    memcpy(g_arena + g_arena_used + sizeof(edit), text, len);
+    g_arena_used += sizeof(edit) + len;
+}
+
+typedef struct
+{
+    int has_offset;
+    int has_data;
+    size_t offset;
+    char data[XM_TEXT_CAP(XM_LINE_SIZE) + 1];
+    size_t data_len;
+} stream_line;
+
+static int line_member(json_stream *s, const char *key, void *ctx, int depth)
+{
+    stream_line *line = ctx;
+    int is_string;
+    (void)depth;
+
+    if (strcmp(key, "offset") == 0)
+    {
+        char text[32];
+        size_t len;
+        int res = member_string(s, text, sizeof(text), &len, &is_string);
+        if (res > 0)
+        {
+            line->offset = strtoul(text, NULL, 16);
+            line->has_offset = 1;
+        }
+        return res;
+    }
+    if (strcmp(key, "data") == 0)
+    {
+        // Text past XM_TEXT_CAP can't land in the file
+        int res = member_string(s, line->data, sizeof(line->data), &line->data_len, &is_string);
+        if (line->data_len > XM_TEXT_CAP(XM_LINE_SIZE))
+            line->data_len = XM_TEXT_CAP(XM_LINE_SIZE);
+        line->has_data = res > 0;
+        return res;
+    }
+    return 0;
+}
+
+static int line_element(json_stream *s, void *ctx, int depth)
+{
+    (void)ctx;
+    if (stream_skip_ws(s) != '{')
+        return stream_skip_value(s, depth);
+
+    stream_line line = {0};
+    if (stream_object(s, depth, line_member, &line) != 0)
+        return -1;
+    if (line.has_offset && line.has_data)
+        arena_add_edit(line.offset, XM_LINE_SIZE, line.data, line.data_len);
+    else
+        XM_LOG(XM_LOG_TRACE, "   -> skipping lineObj with missing offset/data.\n");
+    return 0;
+}
+
+typedef struct
+{
+    int has_offset;
+    int has_name;
+    int has_name_offset;
+    size_t offset;
+    size_t name_offset;
+    char name[XM_TEXT_CAP(XM_NAME_SIZE) + 1];
+    size_t name_len;
+} stream_macro;
+
+static int macro_member(json_stream *s, const char *key, void *ctx, int depth)
+{
+    stream_macro *macro = ctx;
+    char text[32];
+    size_t len;
+    int is_string;
+
+    if (strcmp(key, "lines") == 0)
+    {
+        if (stream_skip_ws(s) != '[')
+            return 0;
+        return stream_array(s, depth, line_element, NULL) == 0 ? 1 : -1;
+    }
+    if (strcmp(key, "name") == 0)
+    {
+        int res = member_string(s, macro->name, sizeof(macro->name), &macro->name_len, &is_string);
+        if (macro->name_len > XM_TEXT_CAP(XM_NAME_SIZE))
+            macro->name_len = XM_TEXT_CAP(XM_NAME_SIZE);
+        macro->has_name = res > 0;
+        return res;
+    }
+    if (strcmp(key, "offset") == 0 || strcmp(key, "nameOffset") == 0)
+    {
+        int res = member_string(s, text, sizeof(text), &len, &is_string);
+        if (res > 0 && key[0] == 'o')
+        {
+            macro->offset = strtoul(text, NULL, 16);
+            macro->has_offset = 1;
+        }
+        else if (res > 0)
+        {
+            macro->name_offset = strtoul(text, NULL, 16);
+            macro->has_name_offset = 1;
+        }
+        return res;
+    }
+    return 0;
+}
+
+static int macro_element(json_stream *s, void *ctx, int depth)
+{
+    (void)ctx;
+    if (stream_skip_ws(s) != '{')
+        return stream_skip_value(s, depth);
+
+    size_t mark = g_arena_used;
+    stream_macro macro = {0};
+    if (stream_object(s, depth, macro_member, &macro) != 0)
+        return -1;
+
+    // As in process_macro_object(): no offset, no edits from this macro
+    if (!macro.has_offset)
+    {
+        XM_LOG(XM_LOG_TRACE, "  macro has no valid 'offset' string.\n");
+        g_arena_used = mark;
+        return 0;
+    }
+    if (macro.has_name)
+    {
+        size_t name_offset = macro.has_name_offset
+                                 ? macro.name_offset
+                                 : macro.offset + (XM_LINES_PER_MACRO * XM_LINE_SIZE);
+        arena_add_edit(name_offset, XM_NAME_SIZE, macro.name, macro.name_len);
+    }
+    return 0;
+}
+
+typedef struct
+{
+    char file_name[STREAM_NAME_MAX];
+    int has_file_name;
+} stream_file;
+
+static int file_member(json_stream *s, const char *key, void *ctx, int depth)
+{
+    stream_file *file = ctx;
+    if (strcmp(key, "fileName") == 0)
+    {
+        size_t len;
+        int is_string;
+        int res = member_string(s, file->file_name, sizeof(file->file_name), &len, &is_string);
+        file->has_file_name = res > 0 && len < sizeof(file->file_name);
+        return res;
+    }
+    if (strcmp(key, "macros") == 0)
+    {
+        if (stream_skip_ws(s) != '[')
+            return 0;
+        return stream_array(s, depth, macro_element, NULL) == 0 ? 1 : -1;
+    }
+    return 0;
+}
+
+// Commits what's staged and starts a new transaction
+static void commit_batch(void)
+{
+    commit_import(1);
+    xm_txn_free(g_txn);
+    g_txn = xm_txn_begin(XM_JOURNAL_PATH);
+}
+
+static int same_folder(const char *a, const char *b)
+{
+    size_t la = (size_t)(xm_basename(a) - a);
+    size_t lb = (size_t)(xm_basename(b) - b);
+    return la == lb && memcmp(a, b, la) == 0;
+}
+
+static void apply_stream_file(const stream_file *file)
+{
+    static char batch_path[STREAM_NAME_MAX];
+    const char *filename = file->file_name;
+
+    if (g_arena_full)
+    {
+        XM_LOG(XM_LOG_WARN, "Too many edits for '%s'; skipped.\n", filename);
+        g_summary.failed++;
+        return;
+    }
+
+    if (g_txn && xm_txn_count(g_txn) > 0 &&
+        (!same_folder(batch_path, filename) || xm_txn_count(g_txn) >= XM_FILE_COUNT))
+        commit_batch();
+    if (!g_txn)
+    {
+        XM_LOG(XM_LOG_ERROR, "Out of memory importing '%s'.\n", filename);
+        g_summary.failed++;
+        return;
+    }
+    snprintf(batch_path, sizeof(batch_path), "%s", filename);
+
+    XM_LOG(XM_LOG_DEBUG, "\nImporting file: '%s'\n", filename);
+    uint8_t *buffer;
+    uint8_t *original;
+    size_t size;
+    if (load_file(filename, &buffer, &original, &size) != 0)
+        return;
+
+    for (size_t pos = 0; pos < g_arena_used;)
+    {
+        stream_edit edit;
+        memcpy(&edit, g_arena + pos, sizeof(edit));
+        pos += sizeof(edit);
+        overwrite_block_in_buffer(buffer, size, edit.offset, (const char *)g_arena + pos,
+                                  edit.len, edit.field_size);
+        pos += edit.len;
+    }
+
+    commit_file(filename, original, buffer, size);
+    free(original);
+    xm_free(buffer);
+}
+
+static int file_element(json_stream *s, void *ctx, int depth)
+{
+    (void)ctx;
+    if (stream_skip_ws(s) != '{')
+    {
+        XM_LOG(XM_LOG_DEBUG, "skipping fileObj - not object.\n");
+        return stream_skip_value(s, depth);
+    }
+
+    static stream_file file;
+    file.has_file_name = 0;
+    g_arena_used = 0;
+    g_arena_full = 0;
+    if (stream_object(s, depth, file_member, &file) != 0)
+        return -1;
+
+    if (file.has_file_name)
+        apply_stream_file(&file);
+    else
+        XM_LOG(XM_LOG_DEBUG, "fileObj missing 'fileName' string.\n");
+    return 0;
+}
+
+static int import_stream(FILE *fp)
+{
+    static json_stream s;
+    s.fp = fp;
+
+    if (stream_skip_ws(&s) < 0)
+    {
+        XM_LOG(XM_LOG_WARN, "No input received.\n");
+        return 1;
+    }
+    if (stream_skip_ws(&s) != '[')
+    {
+        XM_LOG(XM_LOG_ERROR, "Top-level JSON not an array.\n");
+        return 1;
+    }
 
-// -----------------
-// CONFIGURATION
-// -----------------
-#define DEBUG_PRINT 1 // 0 = OFF, 1 = ON
+    // Files completed before a parse error are still committed
+    int res = stream_array(&s, 0, file_element, NULL);
+    if (res == 0 && stream_skip_ws(&s) >= 0)
+        res = stream_fail(&s, "trailing characters");
+    return res == 0 ? 0 : 1;
+}
 
-// Macros for conditional debug output
-#if DEBUG_PRINT
-#define DBG_PRINTF(...) fprintf(stderr, __VA_ARGS__)
+// -------------------------------------------------------------------
+// --format=bin: applies a binary stream from ximacro_e --format=bin (see
+// xm_bin.h). Every field a record carries is written, so like the JSON
+// import it replaces whole pages; files completed before a malformed
+// record are still committed.
+// -------------------------------------------------------------------
+static void set_binary_mode(FILE *fp)
+{
+#if defined(_WIN32)
+    _setmode(_fileno(fp), _O_BINARY);
 #else
-#define DBG_PRINTF(...) // no-op
+    (void)fp;
 #endif
+}
+
+static int import_binary(const uint8_t *data, size_t size)
+{
+    xm_bin_reader r;
+    char dir[768];
+    if (xm_bin_open(&r, data, size) != XM_OK || r.dir_len >= sizeof(dir))
+    {
+        XM_LOG(XM_LOG_ERROR, "Input is not a supported binary macro stream.\n");
+        return 1;
+    }
+    memcpy(dir, r.dir, r.dir_len);
+    dir[r.dir_len] = '\0';
+
+    xm_bin_record rec;
+    int res;
+    int files = 0;
+    char filename[1024];
+    while ((res = xm_bin_next(&r, &rec)) > 0)
+    {
+        files++;
+        if (xm_file_path(dir, rec.index, filename, sizeof(filename)) != XM_OK)
+        {
+            g_summary.failed++;
+            continue;
+        }
+        XM_LOG(XM_LOG_DEBUG, "\nImporting file: '%s'\n", filename);
 
-// Constants matching your exporter:
-#define LINES_PER_MACRO 6
-#define LINE_SIZE 0x3D
-#define NAME_SIZE 0x0E
-#define MACRO_SIZE ((LINES_PER_MACRO * LINE_SIZE) + NAME_SIZE)
-#define MACRO_START 0x1C
+        uint8_t *buffer;
+        uint8_t *original;
+        size_t bytes_read;
+        if (load_file(filename, &buffer, &original, &bytes_read) != 0)
+            continue;
+        xm_bin_apply(&rec, buffer, bytes_read, NULL);
+        commit_file(filename, original, buffer, bytes_read);
+        free(original);
+        xm_free(buffer);
+    }
+
+    if (res < 0)
+        XM_LOG(XM_LOG_ERROR, "Malformed binary stream after %d files.\n", files);
+    return res < 0;
+}
 
 // -------------------------------------------------------------------
-// Utility to create the "macro_backup" directory if it doesn't exist
+// --replace: find-and-replace over every line and name in the given
+// character folders, straight from their mcr*.dat files.
+//
+// Each file is mapped and searched whole with xm_find(); only the fields
+// a hit lands in are looked at. Within a field, matches are tried at
+// character boundaries only, never inside a Shift-JIS pair or an
+// auto-translate sequence; --find and --with are encoded the way fields
+// are (xm_text.h). A field whose new text wouldn't fit (with its
+// terminating NUL) is left alone and reported under "overflows" rather
+// than truncated. Changed files are committed as one import; --dry-run
+// reports the same changes and writes nothing.
 // -------------------------------------------------------------------
-static int ensure_macro_backup_dir(void)
+typedef struct
+{
+    const uint8_t *find;
+    size_t find_len;
+    const uint8_t *with;
+    size_t with_len;
+    int fold;
+    int dry_run;
+    int matches;
+    int files;
+    int changes;
+    int overflows;
+    xm_buf change_list;   // JSON array bodies
+    xm_buf overflow_list;
+} replace_job;
+
+static int same_text(const uint8_t *a, const uint8_t *b, size_t len, int fold)
+{
+    if (!fold)
+        return memcmp(a, b, len) == 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t x = a[i] >= 'A' && a[i] <= 'Z' ? (uint8_t)(a[i] | 0x20) : a[i];
+        uint8_t y = b[i] >= 'A' && b[i] <= 'Z' ? (uint8_t)(b[i] | 0x20) : b[i];
+        if (x != y)
+            return 0;
+    }
+    return 1;
+}
+
+static void json_field_ref(xm_buf *b, const char *filename, int macro, int field)
+{
+    xm_buf_puts(b, "{\"file\":\"");
+    xm_json_escape(b, (const uint8_t *)filename, strlen(filename));
+    xm_buf_printf(b, "\",\"macro\":%d,\"line\":", macro);
+    if (field == XM_FIELD_NAME)
+        xm_buf_puts(b, "\"name\"");
+    else
+        xm_buf_printf(b, "%d", field);
+}
+
+/**
+ * Applies the replacement to the field at 'offset' ('field_size' bytes)
+ * of 'data'. Returns nonzero if the field was rewritten.
+ */
+static int replace_field(replace_job *job, const char *filename, uint8_t *data, size_t size,
+                         size_t offset, size_t field_size, int macro, int field)
 {
-    struct stat st;
-    if (stat("macro_backup", &st) == 0)
+    const uint8_t *text = data + offset;
+    const uint8_t *nul = memchr(text, '\0', field_size);
+    size_t len = nul ? (size_t)(nul - text) : field_size;
+
+    xm_buf out;
+    xm_buf_init(&out);
+    int count = 0;
+    for (size_t i = 0; i < len;)
     {
-        // already exists
-        if ((st.st_mode & S_IFDIR) != 0)
+        if (i + job->find_len <= len && same_text(text + i, job->find, job->find_len, job->fold))
         {
-            DBG_PRINTF("[DEBUG] 'macro_backup' directory already exists.\n");
-            return 0; // success
+            xm_buf_append(&out, job->with, job->with_len);
+            i += job->find_len;
+            count++;
         }
         else
         {
-            DBG_PRINTF("[DEBUG] 'macro_backup' is not a directory!\n");
-            return -1;
+            size_t n = xm_text_unit(text + i, len - i);
+            xm_buf_append(&out, text + i, n);
+            i += n;
         }
     }
 
-    // Directory does not exist; attempt to create it
-    DBG_PRINTF("[DEBUG] Creating 'macro_backup' directory...\n");
-
-#if defined(_WIN32)
-    // On Windows, use _mkdir
-    if (_mkdir("macro_backup") != 0)
-#else
-    // On Unix-like, use mkdir with mode 0755
-    if (mkdir("macro_backup", 0755) != 0)
-#endif
+    int changed = 0;
+    job->matches += count;
+    int same = out.len == len && memcmp(out.data, text, len) == 0;
+    if (count > 0 && !same && !out.failed)
     {
-        DBG_PRINTF("[DEBUG] Failed to create 'macro_backup' directory: %s\n", strerror(errno));
-        return -2;
-    }
+        size_t limit = field_size - 1;
+        int fits = out.len <= limit;
+        xm_buf *list = fits ? &job->change_list : &job->overflow_list;
+        if ((fits ? job->changes++ : job->overflows++) > 0)
+            xm_buf_putc(list, ',');
+        json_field_ref(list, filename, macro, field);
+        xm_buf_puts(list, ",\"before\":\"");
+        xm_json_text(list, text, len);
+        xm_buf_puts(list, "\",\"after\":\"");
+        xm_json_text(list, (const uint8_t *)out.data, out.len);
+        if (fits)
+            xm_buf_puts(list, "\"}");
+        else
+            xm_buf_printf(list, "\",\"length\":%zu,\"limit\":%zu}", out.len, limit);
 
-    DBG_PRINTF("[DEBUG] Created 'macro_backup' directory.\n");
-    return 0;
+        if (fits)
+            changed = xm_write_field(data, size, offset, out.data, out.len, field_size, NULL) == XM_OK;
+    }
+    xm_buf_free(&out);
+    return changed;
 }
 
-// -------------------------------------------------------------------
-// Writes data from file 'srcFilename' to 'dstFilename' in a naive way
-// Returns 0 on success, nonzero on failure
-// -------------------------------------------------------------------
-static int copy_file(const char *srcFilename, const char *dstFilename)
+static void replace_in_file(replace_job *job, const char *filename, const uint8_t *data, size_t size)
 {
-    FILE *fin = fopen(srcFilename, "rb");
-    if (!fin)
+    uint8_t *buffer = NULL;
+    int changed = 0;
+    size_t pos = XM_MACRO_START;
+    while (pos < size)
     {
-        DBG_PRINTF("[DEBUG] Could not open '%s' for reading.\n", srcFilename);
-        return -1;
+        size_t hit = pos + xm_find(data + pos, size - pos, job->find, job->find_len, job->fold);
+        if (hit >= size)
+            break;
+
+        size_t within = (hit - XM_MACRO_START) % XM_MACRO_SIZE;
+        int macro = (int)((hit - XM_MACRO_START) / XM_MACRO_SIZE);
+        int field = within < XM_LINES_PER_MACRO * XM_LINE_SIZE ? (int)(within / XM_LINE_SIZE) : XM_FIELD_NAME;
+        size_t offset, field_size;
+        if (xm_field_span(size, macro, field, &offset, &field_size) != XM_OK || field_size == 0)
+            break;
+
+        if (!buffer)
+        {
+            if (!(buffer = malloc(size)))
+            {
+                XM_LOG(XM_LOG_ERROR, "Out of memory replacing in '%s'.\n", filename);
+                g_summary.failed++;
+                return;
+            }
+            memcpy(buffer, data, size);
+        }
+        changed |= replace_field(job, filename, buffer, size, offset, field_size, macro, field);
+        pos = offset + field_size;
     }
 
-    FILE *fout = fopen(dstFilename, "wb");
-    if (!fout)
+    if (changed)
     {
-        DBG_PRINTF("[DEBUG] Could not open '%s' for writing.\n", dstFilename);
-        fclose(fin);
-        return -2;
+        job->files++;
+        if (!job->dry_run)
+            commit_file(filename, data, buffer, size);
     }
+    free(buffer);
+}
 
-    char buf[4096];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), fin)) > 0)
+static int replace_text(replace_job *job, const char *const *dirs, int dir_count)
+{
+    int rc = 0;
+    uint8_t present[XM_FILE_COUNT];
+    xm_view views[XM_FILE_COUNT];
+    char filename[1024];
+    for (int d = 0; d < dir_count; d++)
     {
-        if (fwrite(buf, 1, n, fout) != n)
+        int count = 0;
+        if (xm_scan_macro_dir(dirs[d], present) < 0)
+        {
+            XM_LOG(XM_LOG_ERROR, "Could not open directory '%s'.\n", dirs[d]);
+            rc = 1;
+            continue;
+        }
+        for (int i = 0; i < XM_FILE_COUNT; i++)
+        {
+            if (present[i])
+                views[count++].index = i;
+        }
+
+        xm_io_load(XM_IO_MMAP, dirs[d], views, count);
+        for (int i = 0; i < count; i++)
         {
-            DBG_PRINTF("[DEBUG] Error writing to '%s'.\n", dstFilename);
-            fclose(fin);
-            fclose(fout);
-            return -3;
+            xm_file_path(dirs[d], views[i].index, filename, sizeof(filename));
+            if (views[i].err != XM_OK)
+            {
+                XM_LOG(XM_LOG_ERROR, "Could not read '%s': %s.\n", filename, xm_strerror(views[i].err));
+                g_summary.failed++;
+                continue;
+            }
+            // A folder named twice is only processed once
+            const uint8_t *staged;
+            size_t staged_size;
+            if (!xm_txn_staged(g_txn, filename, &staged, &staged_size))
+                replace_in_file(job, filename, views[i].data, views[i].size);
         }
+        xm_io_release(views, count);
     }
-    fclose(fin);
-    fclose(fout);
-    return 0;
+
+    xm_buf *r = &g_summary.report;
+    xm_buf_printf(r, "\"dryRun\":%s,\"matches\":%d,\"files\":%d,\"changes\":[",
+                  job->dry_run ? "true" : "false", job->matches, job->files);
+    xm_buf_append(r, job->change_list.data, job->change_list.len);
+    xm_buf_puts(r, "],\"overflows\":[");
+    xm_buf_append(r, job->overflow_list.data, job->overflow_list.len);
+    xm_buf_putc(r, ']');
+    xm_buf_free(&job->change_list);
+    xm_buf_free(&job->overflow_list);
+    return rc;
 }
 
 // -------------------------------------------------------------------
-// Extract just the filename from a path. E.g. "C:\foo\bar.dat" -> "bar.dat"
-// (We handle either '\' or '/' as a separator for convenience.)
+// --clone-book=N --from=DIR <dir>...: copies book N (0-39), its ten
+// pages and its title, from the character folder DIR to every target
+// folder. A page the source doesn't have is blank there, so the
+// target's copy of it is blanked too.
+//
+// Targets are read and prepared on a worker pool, then each is committed
+// as its own import: one that can't be read or written holds back none
+// of the others, and never ends up with half a book. A target's pages are
+// published as copies of the source files, which the filesystem can
+// share rather than duplicate.
 // -------------------------------------------------------------------
-static const char *get_basename(const char *path)
+#define BOOK_COUNT 40
+#define PAGES_PER_BOOK 10
+#define BOOKS_PER_TITLE_FILE 20
+#define TITLE_OFFSET 0x18
+#define TITLE_SIZE 0x10
+#define BOOK_FILES (PAGES_PER_BOOK + 1) // the pages, then the title file
+
+typedef struct
 {
-    const char *base = path;
-    // forward slash
-    const char *p = strrchr(path, '/');
-    if (p && *(p + 1))
-        base = p + 1;
+    char path[1024];
+    uint8_t *old_data; // NULL for a page the target doesn't have yet
+    size_t old_size;
+    uint8_t *new_data;
+    size_t new_size;
+} book_file;
 
-    // backslash
-    p = strrchr(base, '\\');
-    if (p && *(p + 1))
-        base = p + 1;
+typedef struct
+{
+    const char *dir;
+    book_file files[BOOK_FILES];
+    int err;
+} book_target;
+
+typedef struct
+{
+    int book;
+    book_file source[BOOK_FILES];
+    book_target *targets;
+} book_clone;
 
-    return base;
+static int title_file_path(const char *dir, int book, char *out, size_t cap)
+{
+    const char *name = book < BOOKS_PER_TITLE_FILE ? "mcr.ttl" : "mcr_2.ttl";
+    int n = snprintf(out, cap, "%s%s%s", dir, XM_PATH_SEP_STR, name);
+    return n >= 0 && (size_t)n < cap ? XM_OK : XM_ERR_RANGE;
 }
 
-// -------------------------------------------------------------------
-// Backup the file into macro_backup/<basename>
-// Returns 0 on success, nonzero on failure
-// -------------------------------------------------------------------
-static int backup_file(const char *filename)
+static size_t title_offset(int book)
 {
-    // Ensure macro_backup directory
-    if (ensure_macro_backup_dir() != 0)
-    {
-        DBG_PRINTF("[DEBUG] Could not prepare macro_backup directory.\n");
-        return -1;
-    }
+    return TITLE_OFFSET + (size_t)(book % BOOKS_PER_TITLE_FILE) * TITLE_SIZE;
+}
 
-    // Build backup path
-    const char *bn = get_basename(filename);
-    char backup_path[1024];
-    snprintf(backup_path, sizeof(backup_path), "macro_backup/%s", bn);
+// Paths of the book's files in 'dir'; returns the first error
+static int book_paths(const char *dir, int book, book_file files[BOOK_FILES])
+{
+    int err = XM_OK;
+    for (int i = 0; i < PAGES_PER_BOOK && err == XM_OK; i++)
+        err = xm_file_path(dir, book * PAGES_PER_BOOK + i, files[i].path, sizeof(files[i].path));
+    if (err == XM_OK)
+        err = title_file_path(dir, book, files[PAGES_PER_BOOK].path, sizeof(files[0].path));
+    return err;
+}
 
-    DBG_PRINTF("[DEBUG] Backing up '%s' -> '%s'\n", filename, backup_path);
-    return copy_file(filename, backup_path);
+static void free_book_files(book_file files[BOOK_FILES])
+{
+    for (int i = 0; i < BOOK_FILES; i++)
+    {
+        xm_free(files[i].old_data);
+        free(files[i].new_data);
+    }
 }
 
-// -------------------------------------------------------------------
-// Write a block of data at offset, up to max_bytes
-// -------------------------------------------------------------------
-static void overwrite_block_in_buffer(
-    uint8_t *buffer,
-    size_t buffer_size,
-    size_t offset,
-    const char *text_to_write,
-    size_t max_bytes)
+static int load_book_source(book_clone *clone, const char *dir)
 {
-    DBG_PRINTF("  [DEBUG] overwrite_block_in_buffer: offset=0x%zX, text=\"%s\", max_bytes=%zu\n",
-               offset, text_to_write, max_bytes);
+    book_file *files = clone->source;
+    int err = book_paths(dir, clone->book, files);
+    for (int i = 0; i < BOOK_FILES && err == XM_OK; i++)
+    {
+        err = xm_read_file(files[i].path, &files[i].old_data, &files[i].old_size);
+        if (err != XM_OK)
+        {
+            files[i].old_data = NULL;
+            if (err == XM_ERR_OPEN && i < PAGES_PER_BOOK)
+                err = XM_OK;
+            else
+                XM_LOG(XM_LOG_ERROR, "Could not read '%s': %s.\n", files[i].path, xm_strerror(err));
+        }
+    }
 
-    if (offset >= buffer_size)
+    if (err == XM_OK && title_offset(clone->book) + TITLE_SIZE > files[PAGES_PER_BOOK].old_size)
     {
-        DBG_PRINTF("  [DEBUG]   -> offset=0x%zX beyond file size=%zu, skipping.\n",
-                   offset, buffer_size);
-        return;
+        XM_LOG(XM_LOG_ERROR, "'%s' has no title for book %d.\n", files[PAGES_PER_BOOK].path, clone->book);
+        err = XM_ERR_FORMAT;
     }
+    return err;
+}
+
+// Reads the target's copy of the book and builds its new contents. Runs
+// on the worker pool, so it touches nothing but 'target'.
+static void prepare_book_target(void *ctx, int task)
+{
+    book_clone *clone = ctx;
+    book_target *target = &clone->targets[task];
+    book_file *files = target->files;
+    int err = book_paths(target->dir, clone->book, files);
 
-    size_t text_len = strlen(text_to_write);
-    size_t space_available = buffer_size - offset;
-    size_t to_copy = (text_len < max_bytes) ? text_len : max_bytes;
-    if (to_copy > space_available)
+    for (int i = 0; i < BOOK_FILES && err == XM_OK; i++)
     {
-        to_copy = space_available;
+        err = xm_read_file(files[i].path, &files[i].old_data, &files[i].old_size);
+        if (err != XM_OK)
+        {
+            files[i].old_data = NULL;
+            // A page the target never saved is created; its titles are not
+            if (err == XM_ERR_OPEN && i < PAGES_PER_BOOK)
+                err = XM_OK;
+        }
     }
 
-    DBG_PRINTF("  [DEBUG]   -> copying %zu bytes to offset=0x%zX.\n", to_copy, offset);
-    memcpy(&buffer[offset], text_to_write, to_copy);
+    const book_file *title = &clone->source[PAGES_PER_BOOK];
+    size_t offset = title_offset(clone->book);
+    if (err == XM_OK && offset + TITLE_SIZE > files[PAGES_PER_BOOK].old_size)
+        err = XM_ERR_FORMAT;
 
-    // Zero-fill if there's leftover in this field
-    if (to_copy < max_bytes && (to_copy < space_available))
+    for (int i = 0; i < BOOK_FILES && err == XM_OK; i++)
     {
-        size_t fill = max_bytes - to_copy;
-        if (fill > (space_available - to_copy))
+        book_file *f = &files[i];
+        const book_file *src = &clone->source[i];
+        const uint8_t *from = i < PAGES_PER_BOOK && src->old_data ? src->old_data : f->old_data;
+        f->new_size = from == src->old_data ? src->old_size : f->old_size;
+        if (!from)
+            continue; // missing on both sides
+        if (!(f->new_data = malloc(f->new_size)))
         {
-            fill = space_available - to_copy;
+            err = XM_ERR_NOMEM;
+            break;
         }
-        memset(&buffer[offset + to_copy], 0, fill);
-        DBG_PRINTF("  [DEBUG]   -> zero-filled %zu bytes after data.\n", fill);
+        memcpy(f->new_data, from, f->new_size);
+        if (i == PAGES_PER_BOOK)
+            memcpy(f->new_data + offset, title->old_data + offset, TITLE_SIZE);
+        else if (!src->old_data && f->new_size > XM_MACRO_START)
+            memset(f->new_data + XM_MACRO_START, 0, f->new_size - XM_MACRO_START);
     }
+    target->err = err;
 }
 
-// -------------------------------------------------------------------
-// Overwrite lines + name for one macro object
-// {
-//   "offset": "0x1C",
-//   "lines": [ {"offset":"0x1C","data":"..."}, ... ],
-//   "name":"...",
-//   "nameOffset":"0x2C" // optional
-// }
-// -------------------------------------------------------------------
-static void process_macro_object(cJSON *macroObj, uint8_t *buffer, size_t buffer_size)
+// Stages and commits one prepared target; returns the files it wrote
+static int commit_book_target(const book_clone *clone, book_target *target)
 {
-    if (!cJSON_IsObject(macroObj))
+    static const uint8_t none[1];
+    int written = g_summary.written;
+    int failed = g_summary.failed;
+
+    for (int i = 0; i < BOOK_FILES && target->err == XM_OK; i++)
     {
-        DBG_PRINTF("  [DEBUG] skipping macroObj - not an object.\n");
-        return;
+        const book_file *f = &target->files[i];
+        if (!f->new_data)
+            continue;
+        if (f->old_data && f->old_size == f->new_size && memcmp(f->old_data, f->new_data, f->new_size) == 0)
+        {
+            g_summary.skipped++;
+            continue;
+        }
+
+        const uint8_t *old = f->old_data ? f->old_data : none;
+        if (i < PAGES_PER_BOOK && clone->source[i].old_data)
+            target->err = xm_txn_stage_copy(g_txn, f->path, old, f->old_size, f->new_data, f->new_size,
+                                            clone->source[i].path);
+        else
+            target->err = xm_txn_stage(g_txn, f->path, old, f->old_size, f->new_data, f->new_size);
+        if (target->err != XM_OK)
+            XM_LOG(XM_LOG_ERROR, "Could not stage '%s': %s.\n", f->path, xm_strerror(target->err));
     }
 
-    cJSON *offsetItem = cJSON_GetObjectItemCaseSensitive(macroObj, "offset");
-    if (!cJSON_IsString(offsetItem))
+    // All of the target's files or none of them
+    if (target->err == XM_OK)
     {
-        DBG_PRINTF("  [DEBUG] macro has no valid 'offset' string.\n");
-        return;
+        commit_batch();
     }
-    size_t macro_offset = strtoul(offsetItem->valuestring, NULL, 16);
-
-    DBG_PRINTF("  [DEBUG] Macro offset=0x%zX\n", macro_offset);
+    else
+    {
+        g_summary.failed++;
+        xm_txn_free(g_txn);
+        g_txn = xm_txn_begin(XM_JOURNAL_PATH);
+    }
+    if (g_summary.failed > failed && target->err == XM_OK)
+        target->err = XM_ERR_WRITE;
+    return g_summary.written - written;
+}
 
-    // Overwrite lines
-    cJSON *lines = cJSON_GetObjectItemCaseSensitive(macroObj, "lines");
-    if (cJSON_IsArray(lines))
+static int clone_book(int book, const char *source_dir, const char *const *dirs, int dir_count)
+{
+    book_clone clone;
+    memset(&clone, 0, sizeof(clone));
+    clone.book = book;
+    clone.targets = calloc((size_t)dir_count, sizeof(*clone.targets));
+    if (!clone.targets)
     {
-        cJSON *lineObj = NULL;
-        cJSON_ArrayForEach(lineObj, lines)
-        {
-            cJSON *lineOffsetItem = cJSON_GetObjectItemCaseSensitive(lineObj, "offset");
-            cJSON *dataItem = cJSON_GetObjectItemCaseSensitive(lineObj, "data");
-            if (!cJSON_IsString(lineOffsetItem) || !cJSON_IsString(dataItem))
-            {
-                DBG_PRINTF("  [DEBUG]  -> skipping lineObj with missing offset/data.\n");
-                continue;
-            }
-            size_t line_offset = strtoul(lineOffsetItem->valuestring, NULL, 16);
-            DBG_PRINTF("  [DEBUG]  -> Overwriting line at 0x%zX with \"%s\"\n",
-                       line_offset, dataItem->valuestring);
+        XM_LOG(XM_LOG_ERROR, "Out of memory cloning book %d.\n", book);
+        return 1;
+    }
 
-            overwrite_block_in_buffer(buffer, buffer_size, line_offset,
-                                      dataItem->valuestring, LINE_SIZE);
-        }
+    int source_err = XM_OK;
+    XM_SPAN("load")
+    {
+        source_err = load_book_source(&clone, source_dir);
     }
-    else
+    if (source_err == XM_OK)
     {
-        DBG_PRINTF("  [DEBUG] macro has no 'lines' array.\n");
+        XM_SPAN("prepare")
+        {
+            for (int i = 0; i < dir_count; i++)
+                clone.targets[i].dir = dirs[i];
+            xm_parallel_for(dir_count, xm_cpu_count(), prepare_book_target, &clone);
+        }
     }
 
-    // Overwrite name
-    cJSON *nameItem = cJSON_GetObjectItemCaseSensitive(macroObj, "name");
-    if (cJSON_IsString(nameItem))
+    xm_buf *r = &g_summary.report;
+    xm_buf_printf(r, "\"book\":%d,\"targets\":[", book);
+    int rc = source_err != XM_OK;
+    int failed = 0;
+    for (int i = 0; !rc && i < dir_count; i++)
     {
-        cJSON *nameOffsetItem = cJSON_GetObjectItemCaseSensitive(macroObj, "nameOffset");
-        size_t name_offset = 0;
-        if (cJSON_IsString(nameOffsetItem))
+        book_target *target = &clone.targets[i];
+        int written = 0;
+        if (target->err != XM_OK)
         {
-            name_offset = strtoul(nameOffsetItem->valuestring, NULL, 16);
-            DBG_PRINTF("  [DEBUG]   -> nameOffset=0x%zX from JSON\n", name_offset);
+            XM_LOG(XM_LOG_ERROR, "Could not read book %d of '%s': %s.\n", book, target->dir,
+                   xm_strerror(target->err));
+            g_summary.failed++;
         }
         else
         {
-            name_offset = macro_offset + (LINES_PER_MACRO * LINE_SIZE);
-            DBG_PRINTF("  [DEBUG]   -> nameOffset fallback=0x%zX\n", name_offset);
+            written = commit_book_target(&clone, target);
         }
-        DBG_PRINTF("  [DEBUG]   -> Overwriting name at 0x%zX with \"%s\"\n",
-                   name_offset, nameItem->valuestring);
-        overwrite_block_in_buffer(buffer, buffer_size, name_offset,
-                                  nameItem->valuestring, NAME_SIZE);
+
+        xm_buf_printf(r, "%s{\"dir\":\"", i ? "," : "");
+        xm_json_escape(r, (const uint8_t *)target->dir, strlen(target->dir));
+        xm_buf_printf(r, "\",\"status\":\"%s\",\"written\":%d}",
+                      target->err != XM_OK ? "failed" : written ? "cloned" : "unchanged", written);
+        failed += target->err != XM_OK;
+        free_book_files(target->files);
     }
+    xm_buf_putc(r, ']');
+
+    free_book_files(clone.source);
+    free(clone.targets);
+    return rc || failed > 0;
+}
+
+// -------------------------------------------------------------------
+// --undo=N: reverts the last N imports from the journal
+// -------------------------------------------------------------------
+static int undo_imports(int count)
+{
+    xm_txn *txn;
+    int undone = xm_txn_undo(XM_JOURNAL_PATH, count, &txn);
+    if (undone < 0)
+        XM_LOG(XM_LOG_ERROR, "Undo failed: %s.\n", xm_strerror(undone));
     else
+        XM_LOG(XM_LOG_DEBUG, "Undid %d of %d imports.\n", undone, count);
+
+    for (int i = 0; txn && i < xm_txn_count(txn); i++)
     {
-        DBG_PRINTF("  [DEBUG] macro has no 'name' field.\n");
+        if (xm_txn_status(txn, i) == XM_OK)
+            record_written(xm_txn_path(txn, i));
+        else
+            g_summary.failed++;
     }
+    xm_txn_free(txn);
+    print_summary();
+    free_summary();
+    return undone < 0;
 }
 
 // -------------------------------------------------------------------
-// For one file object:
-//   1) backups the file to macro_backup/<basename>
-//   2) loads into memory
-//   3) overwrites macros
-//   4) rewrites
+// --backups: lists the saves in the backup store, oldest first
 // -------------------------------------------------------------------
-static void import_one_file_object(cJSON *fileObj)
+static int list_backups(void)
 {
-    if (!cJSON_IsObject(fileObj))
+    xm_store_entry *entries;
+    int count;
+    int res = xm_store_list(XM_STORE_ROOT, &entries, &count);
+    if (res != XM_OK)
     {
-        DBG_PRINTF("[DEBUG] skipping fileObj - not object.\n");
-        return;
+        XM_LOG(XM_LOG_ERROR, "Could not list backups: %s.\n", xm_strerror(res));
+        xm_free(entries);
+        return 1;
     }
 
-    cJSON *fileNameItem = cJSON_GetObjectItemCaseSensitive(fileObj, "fileName");
-    if (!cJSON_IsString(fileNameItem))
+    printf("[");
+    for (int i = 0; i < count; i++)
+        printf("%s{\"id\":\"%s\",\"time\":%lld,\"files\":%d}",
+               i ? "," : "", entries[i].id, entries[i].time, entries[i].files);
+    printf("]\n");
+    fflush(stdout);
+    xm_free(entries);
+    return 0;
+}
+
+// -------------------------------------------------------------------
+// --restore=ID: puts every file of a save back as that save left it (or
+// as it found it, with --before). The restore is itself a journaled,
+// backed-up import, so it can be undone.
+// -------------------------------------------------------------------
+static int restore_backup(const char *id, int before)
+{
+    g_txn = xm_txn_begin(XM_JOURNAL_PATH);
+    if (!g_txn)
     {
-        DBG_PRINTF("[DEBUG] fileObj missing 'fileName' string.\n");
-        return;
+        XM_LOG(XM_LOG_ERROR, "Out of memory starting restore.\n");
+        return 1;
     }
-    const char *filename = fileNameItem->valuestring;
 
-    DBG_PRINTF("\n[DEBUG] Importing file: '%s'\n", filename);
+    int staged = xm_store_restore(XM_STORE_ROOT, id, before, g_txn);
+    if (staged < 0)
+        XM_LOG(XM_LOG_ERROR, "Could not restore '%s': %s.\n", id, xm_strerror(staged));
+    else
+        XM_LOG(XM_LOG_DEBUG, "Restoring %d files from '%s'.\n", staged, id);
 
-    // Backup
-    int backup_res = backup_file(filename);
-    if (backup_res != 0)
-    {
-        fprintf(stderr, "[DEBUG] Warning: Could not backup '%s' (err=%d)\n",
-                filename, backup_res);
-        // continue anyway if desired
-    }
+    // Files already as requested need no rewrite
+    if (staged > 0)
+        commit_import(0);
+    xm_txn_free(g_txn);
+    print_summary();
+    free_summary();
+    return staged < 0;
+}
+
+// -------------------------------------------------------------------
+// --prune: drops old saves and the contents only they referenced
+// -------------------------------------------------------------------
+static int prune_backups(int keep, long long max_age)
+{
+    int saves, objects;
+    int res = xm_store_prune(XM_STORE_ROOT, keep, max_age, &saves, &objects);
+    if (res != XM_OK)
+        XM_LOG(XM_LOG_ERROR, "Prune failed: %s.\n", xm_strerror(res));
 
-    // Read file into memory
-    FILE *fp = fopen(filename, "rb");
-    if (!fp)
+    // The journal's records undo the same saves, so they go with them
+    int records = xm_txn_trim(XM_JOURNAL_PATH, keep, max_age);
+    if (records < 0)
     {
-        fprintf(stderr, "[DEBUG] Could not open '%s' for reading.\n", filename);
-        return;
+        XM_LOG(XM_LOG_ERROR, "Journal trim failed: %s.\n", xm_strerror(records));
+        if (res == XM_OK)
+            res = records;
+        records = 0;
     }
+    printf("{\"removedSaves\":%d,\"removedObjects\":%d,\"removedRecords\":%d}\n", saves, objects,
+           records);
+    fflush(stdout);
+    return res != XM_OK;
+}
 
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    DBG_PRINTF("[DEBUG]   -> file_size=%ld\n", file_size);
+// -------------------------------------------------------------------
+// Main: read JSON from stdin, parse, import in the chosen mode
+// -------------------------------------------------------------------
+typedef enum
+{
+    IMPORT_FILES,
+    IMPORT_PATCH,
+    IMPORT_JSON_PATCH,
+    IMPORT_TRANSFER,
+    IMPORT_STREAM,
+    IMPORT_BINARY,
+    LIST_BACKUPS,
+    RESTORE_BACKUP,
+    PRUNE_BACKUPS,
+    REPLACE_TEXT,
+    CLONE_BOOK
+} import_mode;
 
-    if (file_size <= 0)
-    {
-        fclose(fp);
-        fprintf(stderr, "[DEBUG] File '%s' is empty or invalid.\n", filename);
-        return;
-    }
+int main(int argc, char *argv[])
+{
+    XM_TRACE_INIT("ximacro_i");
 
-    uint8_t *buffer = malloc(file_size);
-    if (!buffer)
+    import_mode mode = IMPORT_FILES;
+    int undo = 0;
+    const char *restore_id = NULL;
+    int restore_before = 0;
+    int keep = -1;
+    long long max_age = -1;
+    replace_job job = {0};
+    int book = -1;
+    const char *source_dir = NULL;
+    int bad = 0;
+    const char **dirs = calloc((size_t)argc, sizeof(*dirs));
+    int dir_count = 0;
+    for (int i = 1; i < argc; i++)
     {
-        fclose(fp);
-        fprintf(stderr, "[DEBUG] Out of memory reading '%s'.\n", filename);
-        return;
+        if (strcmp(argv[i], "--patch") == 0)
+            mode = IMPORT_PATCH;
+        else if (strcmp(argv[i], "--json-patch") == 0)
+            mode = IMPORT_JSON_PATCH;
+        else if (strcmp(argv[i], "--transfer") == 0)
+            mode = IMPORT_TRANSFER;
+        else if (strcmp(argv[i], "--stream") == 0)
+            mode = IMPORT_STREAM;
+        else if (strcmp(argv[i], "--format=bin") == 0)
+            mode = IMPORT_BINARY;
+        else if (strcmp(argv[i], "--format=json") == 0)
+            mode = IMPORT_FILES;
+        else if (strncmp(argv[i], "--undo=", 7) == 0 && atoi(argv[i] + 7) > 0)
+            undo = atoi(argv[i] + 7);
+        else if (strcmp(argv[i], "--backups") == 0)
+            mode = LIST_BACKUPS;
+        else if (strncmp(argv[i], "--restore=", 10) == 0 && argv[i][10])
+        {
+            mode = RESTORE_BACKUP;
+            restore_id = argv[i] + 10;
+        }
+        else if (strcmp(argv[i], "--before") == 0)
+            restore_before = 1;
+        else if (strcmp(argv[i], "--prune") == 0)
+            mode = PRUNE_BACKUPS;
+        else if (strncmp(argv[i], "--keep=", 7) == 0 && atoi(argv[i] + 7) >= 0)
+            keep = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--max-age-days=", 15) == 0 && atoi(argv[i] + 15) >= 0)
+            max_age = atoll(argv[i] + 15) * 86400;
+        else if (strcmp(argv[i], "--replace") == 0)
+            mode = REPLACE_TEXT;
+        else if (strncmp(argv[i], "--find=", 7) == 0)
+            job.find = (const uint8_t *)argv[i] + 7;
+        else if (strncmp(argv[i], "--with=", 7) == 0)
+            job.with = (const uint8_t *)argv[i] + 7;
+        else if (strcmp(argv[i], "--ignore-case") == 0)
+            job.fold = 1;
+        else if (strcmp(argv[i], "--dry-run") == 0)
+            job.dry_run = 1;
+        else if (strncmp(argv[i], "--clone-book=", 13) == 0 && argv[i][13])
+        {
+            mode = CLONE_BOOK;
+            book = atoi(argv[i] + 13);
+        }
+        else if (strncmp(argv[i], "--from=", 7) == 0 && argv[i][7])
+            source_dir = argv[i] + 7;
+        else if (dirs && strncmp(argv[i], "--", 2) != 0)
+            dirs[dir_count++] = argv[i];
+        else
+            bad = 1;
     }
-    size_t bytes_read = fread(buffer, 1, file_size, fp);
-    fclose(fp);
 
-    DBG_PRINTF("[DEBUG]   -> bytes_read=%zu\n", bytes_read);
-    if (bytes_read < (size_t)file_size)
+    int takes_dirs = mode == REPLACE_TEXT || mode == CLONE_BOOK;
+    if (bad || takes_dirs != (dir_count > 0) ||
+        (mode == REPLACE_TEXT && (!job.find || !job.find[0] || !job.with)) ||
+        (mode == CLONE_BOOK && (book < 0 || book >= BOOK_COUNT || !source_dir)))
     {
-        fprintf(stderr, "[DEBUG] Could not read entire file '%s'.\n", filename);
+        fprintf(stderr, "Usage: %s [--stream | --patch | --json-patch | --transfer] < input.json\n"
+                        "       %s --format=bin < input.xmb\n"
+                        "       %s --undo=N\n"
+                        "       %s --backups\n"
+                        "       %s --restore=ID [--before]\n"
+                        "       %s --prune [--keep=N] [--max-age-days=D]\n"
+                        "       %s --replace --find=TEXT --with=TEXT [--ignore-case] [--dry-run] <dir>...\n"
+                        "       %s --clone-book=N --from=DIR <dir>...\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        free(dirs);
+        return 1;
     }
 
-    // Overwrite macros from JSON
-    cJSON *macrosArray = cJSON_GetObjectItemCaseSensitive(fileObj, "macros");
-    if (!cJSON_IsArray(macrosArray))
-    {
-        DBG_PRINTF("[DEBUG]   -> no 'macros' array in fileObj.\n");
-    }
-    else
+    xm_buf_init(&g_summary.touched);
+    xm_buf_init(&g_summary.backups);
+    xm_buf_init(&g_summary.report);
+    if (mode == REPLACE_TEXT)
     {
-        DBG_PRINTF("[DEBUG]   -> Parsing macros array...\n");
-        cJSON *macroObj = NULL;
-        cJSON_ArrayForEach(macroObj, macrosArray)
+        // Encoded text is never longer than its UTF-8
+        size_t find_len = strlen((const char *)job.find);
+        size_t with_len = strlen((const char *)job.with);
+        uint8_t *find = malloc(find_len);
+        uint8_t *with = malloc(with_len + 1);
+        if (find && with)
         {
-            process_macro_object(macroObj, buffer, bytes_read);
+            job.find_len = xm_text_encode((const char *)job.find, find_len, find, find_len, NULL);
+            job.with_len = xm_text_encode((const char *)job.with, with_len, with, with_len, NULL);
+            job.find = find;
+            job.with = with;
+            g_txn = xm_txn_begin(XM_JOURNAL_PATH);
         }
+        int rc = g_txn ? replace_text(&job, dirs, dir_count) : 1;
+        if (g_txn && !job.dry_run)
+            commit_import(1);
+        xm_txn_free(g_txn);
+        free(find);
+        free(with);
+        free(dirs);
+        print_summary();
+        free_summary();
+        return rc;
     }
-
-    // Write updated data back
-    DBG_PRINTF("[DEBUG]   -> Rewriting file '%s'...\n", filename);
-    fp = fopen(filename, "wb");
-    if (!fp)
+    if (mode == CLONE_BOOK)
     {
-        fprintf(stderr, "[DEBUG] Could not open '%s' for writing.\n", filename);
-        free(buffer);
-        return;
+        g_txn = xm_txn_begin(XM_JOURNAL_PATH);
+        int rc = g_txn ? clone_book(book, source_dir, dirs, dir_count) : 1;
+        xm_txn_free(g_txn);
+        free(dirs);
+        print_summary();
+        free_summary();
+        return rc;
     }
+    free(dirs);
+    if (undo > 0)
+        return undo_imports(undo);
+    if (mode == LIST_BACKUPS)
+        return list_backups();
+    if (mode == RESTORE_BACKUP)
+        return restore_backup(restore_id, restore_before);
+    if (mode == PRUNE_BACKUPS)
+        return prune_backups(keep, max_age);
 
-    size_t written = fwrite(buffer, 1, bytes_read, fp);
-    fclose(fp);
-    free(buffer);
 
-    if (written < bytes_read)
-    {
-        fprintf(stderr, "[DEBUG] Could not write entire file '%s'.\n", filename);
-    }
-    else
+    XM_LOG(XM_LOG_DEBUG, "Starting import...\n");
+
+    if (mode == IMPORT_STREAM)
     {
-        DBG_PRINTF("[DEBUG]   -> Successfully wrote %zu bytes to '%s'.\n",
-                   written, filename);
+        g_txn = xm_txn_begin(XM_JOURNAL_PATH);
+        int rc = 1;
+        XM_SPAN("apply")
+        {
+            if (g_txn)
+                rc = import_stream(stdin);
+        }
+        if (g_txn)
+            commit_import(1);
+        xm_txn_free(g_txn);
+        print_summary();
+        free_summary();
+        XM_LOG(XM_LOG_DEBUG, "Finished import.\n");
+        fflush(stderr);
+        return rc;
     }
-}
-
-// -------------------------------------------------------------------
-// Main: read JSON from stdin, parse, import each file
-// -------------------------------------------------------------------
-int main(void)
-{
-    DBG_PRINTF("[DEBUG] Starting import...\n");
 
     // Read all input into a buffer first
+    if (mode == IMPORT_BINARY)
+        set_binary_mode(stdin);
     char buffer[4096];
     size_t total_size = 0;
     size_t capacity = 16384; // Start with 16KB
     char *json_text = malloc(capacity);
     
     if (!json_text) {
-        fprintf(stderr, "[DEBUG] Initial memory allocation failed.\n");
+        XM_LOG(XM_LOG_ERROR, "Initial memory allocation failed.\n");
         return 1;
     }
 
@@ -406,9 +2499,9 @@ int main(void)
             capacity *= 2;
             char *new_buffer = realloc(json_text, capacity);
             if (!new_buffer) {
-                fprintf(stderr, "[DEBUG] Memory reallocation failed.\n");
+                XM_LOG(XM_LOG_ERROR, "Memory reallocation failed.\n");
                 free(json_text);
-                return 1;
+                        return 1;
             }
             json_text = new_buffer;
         }
@@ -417,7 +2510,7 @@ int main(void)
     }
 
     if (total_size == 0) {
-        DBG_PRINTF("[DEBUG] No input received.\n");
+        XM_LOG(XM_LOG_WARN, "No input received.\n");
         free(json_text);
         return 1;
     }
@@ -426,7 +2519,7 @@ int main(void)
     if (total_size + 1 > capacity) {
         char *new_buffer = realloc(json_text, total_size + 1);
         if (!new_buffer) {
-            fprintf(stderr, "[DEBUG] Final buffer expansion failed.\n");
+            XM_LOG(XM_LOG_ERROR, "Final buffer expansion failed.\n");
             free(json_text);
             return 1;
         }
@@ -434,38 +2527,81 @@ int main(void)
     }
     json_text[total_size] = '\0';
 
-    DBG_PRINTF("[DEBUG] Total bytes read: %zu\n", total_size);
-    DBG_PRINTF("[DEBUG] First 100 bytes of input: %.100s\n", json_text);
+    if (mode == IMPORT_BINARY)
+    {
+        g_txn = xm_txn_begin(XM_JOURNAL_PATH);
+        int rc = 1;
+        XM_SPAN("apply")
+        {
+            if (g_txn)
+                rc = import_binary((const uint8_t *)json_text, total_size);
+        }
+        free(json_text);
+        if (g_txn)
+            commit_import(1);
+        xm_txn_free(g_txn);
+        print_summary();
+        free_summary();
+        XM_LOG(XM_LOG_DEBUG, "Finished import.\n");
+        fflush(stderr);
+        return rc;
+    }
+
+    XM_LOG(XM_LOG_DEBUG, "Total bytes read: %zu\n", total_size);
+    XM_LOG(XM_LOG_DEBUG, "First 100 bytes of input: %.100s\n", json_text);
 
-    cJSON *root = cJSON_Parse(json_text);
+    cJSON *root = NULL;
+    XM_SPAN("parse")
+    {
+        root = cJSON_Parse(json_text);
+    }
     if (!root) {
         const char *error_ptr = cJSON_GetErrorPtr();
         if (error_ptr) {
             size_t context_start = (error_ptr - json_text > 20) ? 20 : error_ptr - json_text;
-            DBG_PRINTF("[DEBUG] Parse error near: ...%.*s\n", 40, error_ptr - context_start);
+            XM_LOG(XM_LOG_WARN, "Parse error near: ...%.*s\n", 40, error_ptr - context_start);
         }
-        fprintf(stderr, "[DEBUG] JSON parse error.\n");
+        XM_LOG(XM_LOG_ERROR, "JSON parse error.\n");
         free(json_text);
         return 1;
     }
 
     free(json_text);
 
-    if (!cJSON_IsArray(root)) {
-        fprintf(stderr, "[DEBUG] Top-level JSON not an array.\n");
+    g_txn = xm_txn_begin(XM_JOURNAL_PATH);
+    if (!g_txn)
+    {
+        XM_LOG(XM_LOG_ERROR, "Out of memory starting import.\n");
         cJSON_Delete(root);
         return 1;
     }
 
-    DBG_PRINTF("[DEBUG] Processing file objects in array...\n");
-
-    cJSON *fileObj = NULL;
-    cJSON_ArrayForEach(fileObj, root) {
-        import_one_file_object(fileObj);
+    int rc = 0;
+    XM_SPAN("apply")
+    {
+        switch (mode)
+        {
+        case IMPORT_PATCH:
+            rc = import_patch(root);
+            break;
+        case IMPORT_JSON_PATCH:
+            rc = import_json_patch(root);
+            break;
+        case IMPORT_TRANSFER:
+            rc = import_transfer(root);
+            break;
+        default:
+            rc = import_files(root);
+            break;
+        }
     }
 
     cJSON_Delete(root);
-    DBG_PRINTF("[DEBUG] Finished import.\n");
+    commit_import(1);
+    xm_txn_free(g_txn);
+    print_summary();
+    free_summary();
+    XM_LOG(XM_LOG_DEBUG, "Finished import.\n");
     fflush(stderr);
-    return 0;
+    return rc;
 }
@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "./vendor/cJSON/cJSON.h"
+#include "ximacro.h"
+#include "xm_store.h"
+#include "xm_text.h"
+#include "xm_txn.h"
+
+// -------------------------------------------------------------------
+// One resident mcr*.dat file.
+//
+// 'data' is the working copy that edits are applied to. 'dirty_lo' and
+// 'dirty_hi' bound every byte changed since the last flush; several edits
+// to the same file are coalesced into one commit of it on flush. 'disk_hash'
+// is what the file held when loaded or last flushed; a flush won't write
+// over a file something else (e.g. the game) has changed since.
+// -------------------------------------------------------------------
+typedef struct
+{
+    int present;
+    char path[768];
+    uint8_t *data;
+    size_t size;
+    size_t dirty_lo;
+    size_t dirty_hi;
+    uint64_t disk_hash[2];
+} resident_file;
+
+static char g_dir[512];
+static resident_file g_files[XM_FILE_COUNT];
+
+// -------------------------------------------------------------------
+// JSON output helpers. Every response is a single line on stdout.
+// -------------------------------------------------------------------
+static xm_buf g_out;
+
+static void begin_response(const cJSON *id, int ok)
+{
+    g_out.len = 0;
+    xm_buf_puts(&g_out, ok ? "{\"ok\":true" : "{\"ok\":false");
+    if (cJSON_IsNumber(id))
+        xm_buf_printf(&g_out, ",\"id\":%d", id->valueint);
+    else if (cJSON_IsString(id))
+    {
+        xm_buf_puts(&g_out, ",\"id\":\"");
+        xm_json_escape(&g_out, (const uint8_t *)id->valuestring, strlen(id->valuestring));
+        xm_buf_putc(&g_out, '"');
+    }
+}
+
+static void end_response(void)
+{
+    xm_buf_append(&g_out, "}\n", 2);
+    xm_buf_write(&g_out, stdout);
+    fflush(stdout);
+}
+
+static void respond_error(const cJSON *id, const char *message)
+{
+    begin_response(id, 0);
+    xm_buf_puts(&g_out, ",\"error\":\"");
+    xm_json_escape(&g_out, (const uint8_t *)message, strlen(message));
+    xm_buf_putc(&g_out, '"');
+    end_response();
+}
+
+// -------------------------------------------------------------------
+// Loading and flushing
+// -------------------------------------------------------------------
+static void unload_all(void)
+{
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        xm_free(g_files[i].data);
+        memset(&g_files[i], 0, sizeof(g_files[i]));
+    }
+}
+
+static int load_one(int index)
+{
+    resident_file *f = &g_files[index];
+    if (xm_file_path(g_dir, index, f->path, sizeof(f->path)) != XM_OK ||
+        xm_read_file(f->path, &f->data, &f->size) != XM_OK)
+        return 0;
+
+    if (f->size <= XM_MACRO_START)
+    {
+        xm_free(f->data);
+        f->data = NULL;
+        f->size = 0;
+        return 0;
+    }
+
+    f->present = 1;
+    xm_hash128(f->data, f->size, f->disk_hash);
+    f->dirty_lo = f->size;
+    f->dirty_hi = 0;
+    return 1;
+}
+
+// Indexes of the files holding edits not yet flushed. Returns how many.
+static int dirty_files(int out[XM_FILE_COUNT])
+{
+    int count = 0;
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        if (g_files[i].present && g_files[i].dirty_hi > g_files[i].dirty_lo)
+            out[count++] = i;
+    }
+    return count;
+}
+
+static void put_file_list(const char *key, const int *files, int count)
+{
+    xm_buf_printf(&g_out, ",\"%s\":[", key);
+    for (int i = 0; i < count; i++)
+        xm_buf_printf(&g_out, i ? ",%d" : "%d", files[i]);
+    xm_buf_putc(&g_out, ']');
+}
+
+static int load_all(void)
+{
+    unload_all();
+    int count = 0;
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+        count += load_one(i);
+    return count;
+}
+
+// Commits every dirty file through one xm_txn (see xm_txn.h), like an
+// import by ximacro_i: staged next to its target, journaled for undo and
+// published by rename, so a crash mid-flush never leaves a torn file. Each
+// flush is also one save in the backup store; 'backup' gets its id (""
+// if nothing was stored). Files changed on disk since they were loaded
+// are left alone and counted in 'conflicts'; reload to pick up the new
+// contents. The indexes of the files written go to 'files'.
+static int flush_all(int files[XM_FILE_COUNT], int *failed, int *conflicts,
+                     char backup[XM_STORE_ID_SIZE])
+{
+    int staged[XM_FILE_COUNT];
+    int staged_count = 0;
+    int written = 0;
+    *failed = 0;
+    *conflicts = 0;
+    backup[0] = '\0';
+
+    xm_txn *txn = xm_txn_begin(XM_JOURNAL_PATH);
+    if (!txn)
+    {
+        *failed = dirty_files(staged);
+        return 0;
+    }
+    xm_store_save *save = xm_store_save_begin(XM_STORE_ROOT);
+
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        resident_file *f = &g_files[i];
+        if (!f->present || f->dirty_hi <= f->dirty_lo)
+            continue;
+
+        // The game checks the header MD5, so it follows the records
+        xm_header_update(f->data, f->size);
+
+        uint8_t *before;
+        size_t before_size;
+        int err = xm_read_file(f->path, &before, &before_size);
+        if (err != XM_OK)
+        {
+            fprintf(stderr, "Could not read '%s': %s.\n", f->path, xm_strerror(err));
+            (*failed)++;
+            continue;
+        }
+
+        uint64_t hash[2];
+        xm_hash128(before, before_size, hash);
+        if (hash[0] != f->disk_hash[0] || hash[1] != f->disk_hash[1])
+        {
+            fprintf(stderr, "'%s' changed on disk; not overwriting it.\n", f->path);
+            xm_free(before);
+            (*conflicts)++;
+            continue;
+        }
+
+        err = xm_txn_stage(txn, f->path, before, before_size, f->data, f->size);
+        if (err == XM_OK)
+        {
+            staged[staged_count++] = i;
+            int backup_res = save ? xm_store_save_add(save, f->path, before, before_size, f->data, f->size) : XM_OK;
+            if (backup_res != XM_OK)
+                fprintf(stderr, "Could not back up '%s': %s.\n", f->path, xm_strerror(backup_res));
+        }
+        else
+        {
+            fprintf(stderr, "Could not stage '%s': %s.\n", f->path, xm_strerror(err));
+            (*failed)++;
+        }
+        xm_free(before);
+    }
+
+    int res = staged_count > 0 ? xm_txn_commit(txn) : XM_OK;
+    if (res != XM_OK)
+        fprintf(stderr, "Flush incomplete: %s.\n", xm_strerror(res));
+
+    // Files are staged in index order, so file k of the transaction is staged[k]
+    for (int k = 0; k < staged_count; k++)
+    {
+        resident_file *f = &g_files[staged[k]];
+        int status = xm_txn_status(txn, k);
+        if (status != XM_OK)
+        {
+            fprintf(stderr, "Could not write '%s': %s.\n", f->path, xm_strerror(status));
+            (*failed)++;
+            if (save)
+                xm_store_save_forget(save, f->path);
+            continue;
+        }
+
+        xm_hash128(f->data, f->size, f->disk_hash);
+        f->dirty_lo = f->size;
+        f->dirty_hi = 0;
+        files[written++] = staged[k];
+    }
+
+    if (save)
+        xm_store_save_commit(save, backup);
+    xm_store_save_free(save);
+    xm_txn_free(txn);
+    return written;
+}
+
+// -------------------------------------------------------------------
+// Request handlers
+// -------------------------------------------------------------------
+static resident_file *lookup_file(const cJSON *req, const cJSON *id)
+{
+    const cJSON *fileItem = cJSON_GetObjectItemCaseSensitive(req, "file");
+    if (!cJSON_IsNumber(fileItem) || fileItem->valueint < 0 || fileItem->valueint >= XM_FILE_COUNT)
+    {
+        respond_error(id, "invalid 'file' index");
+        return NULL;
+    }
+    resident_file *f = &g_files[fileItem->valueint];
+    if (!f->present)
+    {
+        respond_error(id, "file not loaded");
+        return NULL;
+    }
+    return f;
+}
+
+// (Re)loads the folder 'dir'. Loading over edits that were never flushed
+// would lose them silently, so unless the request says "discard":true it is
+// refused and those files are listed under 'dirty'; with it, they are
+// dropped and listed under 'discarded'.
+static void load_and_respond(const cJSON *req, const cJSON *id, const char *dir)
+{
+    int dirty[XM_FILE_COUNT];
+    int dirty_count = dirty_files(dirty);
+    if (dirty_count > 0 && !cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(req, "discard")))
+    {
+        begin_response(id, 0);
+        xm_buf_puts(&g_out, ",\"error\":\"unflushed edits; flush them or pass 'discard'\"");
+        put_file_list("dirty", dirty, dirty_count);
+        end_response();
+        return;
+    }
+
+    if (dir != g_dir)
+        snprintf(g_dir, sizeof(g_dir), "%s", dir);
+    int count = load_all();
+    begin_response(id, 1);
+    xm_buf_printf(&g_out, ",\"files\":%d", count);
+    put_file_list("discarded", dirty, dirty_count);
+    end_response();
+}
+
+static void handle_load(const cJSON *req, const cJSON *id)
+{
+    const cJSON *dirItem = cJSON_GetObjectItemCaseSensitive(req, "dir");
+    if (!cJSON_IsString(dirItem))
+    {
+        respond_error(id, "missing 'dir'");
+        return;
+    }
+    load_and_respond(req, id, dirItem->valuestring);
+}
+
+static void handle_reload(const cJSON *req, const cJSON *id)
+{
+    if (!g_dir[0])
+    {
+        respond_error(id, "nothing loaded");
+        return;
+    }
+    load_and_respond(req, id, g_dir);
+}
+
+static void handle_list(const cJSON *id)
+{
+    begin_response(id, 1);
+    xm_buf_puts(&g_out, ",\"files\":[");
+    int count = 0;
+    for (int i = 0; i < XM_FILE_COUNT; i++)
+    {
+        if (!g_files[i].present)
+            continue;
+        xm_buf_printf(&g_out, count++ ? ",%d" : "%d", i);
+    }
+    xm_buf_putc(&g_out, ']');
+    end_response();
+}
+
+static void handle_page(const cJSON *req, const cJSON *id)
+{
+    resident_file *f = lookup_file(req, id);
+    if (!f)
+        return;
+    begin_response(id, 1);
+    xm_buf_puts(&g_out, ",\"page\":");
+    xm_json_file(&g_out, f->path, f->data, f->size);
+    end_response();
+}
+
+// {"op":"set","file":N,"macro":M,"line":L,"data":"..."} or
+// {"op":"set","file":N,"macro":M,"name":"..."}
+static void handle_set(const cJSON *req, const cJSON *id)
+{
+    resident_file *f = lookup_file(req, id);
+    if (!f)
+        return;
+
+    const cJSON *macroItem = cJSON_GetObjectItemCaseSensitive(req, "macro");
+    const cJSON *lineItem = cJSON_GetObjectItemCaseSensitive(req, "line");
+    const cJSON *dataItem = cJSON_GetObjectItemCaseSensitive(req, "data");
+    const cJSON *nameItem = cJSON_GetObjectItemCaseSensitive(req, "name");
+
+    if (!cJSON_IsNumber(macroItem))
+    {
+        respond_error(id, "invalid 'macro' index");
+        return;
+    }
+
+    int field;
+    const char *text;
+    if (cJSON_IsString(dataItem) && cJSON_IsNumber(lineItem))
+    {
+        // Negative indices must not alias XM_FIELD_NAME
+        field = lineItem->valueint < 0 ? XM_LINES_PER_MACRO : lineItem->valueint;
+        text = dataItem->valuestring;
+    }
+    else if (cJSON_IsString(nameItem))
+    {
+        field = XM_FIELD_NAME;
+        text = nameItem->valuestring;
+    }
+    else
+    {
+        respond_error(id, "expected 'line'+'data' or 'name'");
+        return;
+    }
+
+    size_t offset, field_size;
+    if (xm_field_span(f->size, macroItem->valueint, field, &offset, &field_size) != XM_OK)
+    {
+        respond_error(id, "macro/line out of range");
+        return;
+    }
+
+    int changed;
+    xm_text_write_field(f->data, f->size, offset, text, strlen(text), field_size, &changed);
+    if (changed)
+    {
+        if (offset < f->dirty_lo)
+            f->dirty_lo = offset;
+        if (offset + field_size > f->dirty_hi)
+            f->dirty_hi = offset + field_size;
+    }
+
+    begin_response(id, 1);
+    xm_buf_printf(&g_out, ",\"changed\":%s", changed ? "true" : "false");
+    end_response();
+}
+
+static void handle_flush(const cJSON *id)
+{
+    int files[XM_FILE_COUNT];
+    int failed, conflicts;
+    char backup[XM_STORE_ID_SIZE];
+    int written = flush_all(files, &failed, &conflicts, backup);
+    begin_response(id, failed == 0 && conflicts == 0);
+    xm_buf_printf(&g_out, ",\"written\":%d,\"failed\":%d,\"conflicts\":%d,\"backup\":\"%s\"",
+                  written, failed, conflicts, backup);
+    put_file_list("files", files, written);
+    end_response();
+}
+
+// -------------------------------------------------------------------
+// Reads one '\n'-terminated request. Returns NULL at end of input.
+// -------------------------------------------------------------------
+static char *read_request_line(char **buf, size_t *cap)
+{
+    size_t len = 0;
+    for (;;)
+    {
+        if (len + 1 >= *cap)
+        {
+            size_t new_cap = *cap ? *cap * 2 : 4096;
+            char *grown = realloc(*buf, new_cap);
+            if (!grown)
+                return NULL;
+            *buf = grown;
+            *cap = new_cap;
+        }
+        if (!fgets(*buf + len, (int)(*cap - len), stdin))
+            return len > 0 ? *buf : NULL;
+
+        len += strlen(*buf + len);
+        if (len > 0 && (*buf)[len - 1] == '\n')
+            return *buf;
+    }
+}
+
+// -------------------------------------------------------------------
+// Main: serve newline-framed JSON requests on stdin until "quit"/EOF.
+//
+//   {"id":1,"op":"load","dir":"C:\\...\\USER\\1234abcd"}
+//   {"id":2,"op":"list"}
+//   {"id":3,"op":"page","file":12}
+//   {"id":4,"op":"set","file":12,"macro":3,"line":0,"data":"/ma \"Cure\" <t>"}
+//   {"id":5,"op":"flush"}
+//   {"id":6,"op":"reload"}
+//   {"id":7,"op":"quit"}
+//
+// Each request gets exactly one single-line JSON response carrying "ok" and
+// the request's "id". Edits stay in memory until "flush", which commits
+// them like an import by ximacro_i (and --undo reverts it). "load" and
+// "reload" refuse to drop edits that were never flushed (listing their
+// files under "dirty") unless the request has "discard":true.
+// -------------------------------------------------------------------
+int main(void)
+{
+    char *line = NULL;
+    size_t cap = 0;
+    int running = 1;
+
+    while (running && read_request_line(&line, &cap))
+    {
+        if (line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+
+        cJSON *req = cJSON_Parse(line);
+        if (!req)
+        {
+            respond_error(NULL, "malformed request");
+            continue;
+        }
+
+        const cJSON *id = cJSON_GetObjectItemCaseSensitive(req, "id");
+        const cJSON *op = cJSON_GetObjectItemCaseSensitive(req, "op");
+        const char *name = cJSON_IsString(op) ? op->valuestring : "";
+
+        if (strcmp(name, "load") == 0)
+            handle_load(req, id);
+        else if (strcmp(name, "reload") == 0)
+            handle_reload(req, id);
+        else if (strcmp(name, "list") == 0)
+            handle_list(id);
+        else if (strcmp(name, "page") == 0)
+            handle_page(req, id);
+        else if (strcmp(name, "set") == 0)
+            handle_set(req, id);
+        else if (strcmp(name, "flush") == 0)
+            handle_flush(id);
+        else if (strcmp(name, "quit") == 0)
+        {
+            begin_response(id, 1);
+            end_response();
+            running = 0;
+        }
+        else
+            respond_error(id, "unknown op");
+
+        cJSON_Delete(req);
+    }
+
+    free(line);
+    unload_all();
+    xm_buf_free(&g_out);
+    return 0;
+}
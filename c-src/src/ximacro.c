@@ -0,0 +1,1218 @@
+#include "ximacro.h"
+#include "xm_simd.h"
+#include "xm_text.h"
+#include "xm_trace.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+int xm_api_version(void)
+{
+    return XM_API_VERSION;
+}
+
+const char *xm_strerror(int err)
+{
+    switch (err)
+    {
+    case XM_OK:
+        return "ok";
+    case XM_ERR_OPEN:
+        return "could not open file";
+    case XM_ERR_READ:
+        return "could not read file";
+    case XM_ERR_WRITE:
+        return "could not write file";
+    case XM_ERR_NOMEM:
+        return "out of memory";
+    case XM_ERR_RANGE:
+        return "out of range";
+    case XM_ERR_FORMAT:
+        return "invalid format";
+    default:
+        return "unknown error";
+    }
+}
+
+void xm_free(void *ptr)
+{
+    free(ptr);
+}
+
+double xm_now_ms(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+#endif
+}
+
+// -------------------------------------------------------------------
+// Paths
+// -------------------------------------------------------------------
+int xm_file_name(int index, char *out, size_t cap)
+{
+    if (index < 0 || index > XM_MAX_FILE_INDEX)
+        return XM_ERR_RANGE;
+
+    int n = (index == 0) ? snprintf(out, cap, "mcr.dat")
+                         : snprintf(out, cap, "mcr%d.dat", index);
+    return (n < 0 || (size_t)n >= cap) ? XM_ERR_RANGE : XM_OK;
+}
+
+int xm_file_path(const char *dir, int index, char *out, size_t cap)
+{
+    if (index < 0 || index > XM_MAX_FILE_INDEX)
+        return XM_ERR_RANGE;
+
+    int n = (index == 0) ? snprintf(out, cap, "%s" XM_PATH_SEP_STR "mcr.dat", dir)
+                         : snprintf(out, cap, "%s" XM_PATH_SEP_STR "mcr%d.dat", dir, index);
+    return (n < 0 || (size_t)n >= cap) ? XM_ERR_RANGE : XM_OK;
+}
+
+int xm_file_index(const char *basename)
+{
+    if (strncmp(basename, "mcr", 3) != 0)
+        return -1;
+
+    const char *p = basename + 3;
+    if (strcmp(p, ".dat") == 0)
+        return 0;
+
+    // mcr<1..400>.dat, no leading zeros
+    if (*p < '1' || *p > '9')
+        return -1;
+
+    int index = 0;
+    while (*p >= '0' && *p <= '9')
+    {
+        index = index * 10 + (*p - '0');
+        if (index > XM_MAX_FILE_INDEX)
+            return -1;
+        p++;
+    }
+    return strcmp(p, ".dat") == 0 ? index : -1;
+}
+
+const char *xm_basename(const char *path)
+{
+    const char *base = path;
+    for (const char *p = path; *p; p++)
+    {
+        if ((*p == '/' || *p == '\\') && p[1])
+            base = p + 1;
+    }
+    return base;
+}
+
+// -------------------------------------------------------------------
+// File I/O
+// -------------------------------------------------------------------
+long xm_file_size(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return XM_ERR_OPEN;
+    return (long)st.st_size;
+}
+
+int xm_file_stamp(const char *path, long long *size, long long *mtime_ns)
+{
+#if defined(_WIN32)
+    WIN32_FILE_ATTRIBUTE_DATA fad;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &fad))
+        return XM_ERR_OPEN;
+    ULARGE_INTEGER t;
+    t.LowPart = fad.ftLastWriteTime.dwLowDateTime;
+    t.HighPart = fad.ftLastWriteTime.dwHighDateTime;
+    *size = ((long long)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+    // 100 ns ticks since 1601 -> ns since 1970
+    *mtime_ns = ((long long)t.QuadPart - 116444736000000000LL) * 100;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return XM_ERR_OPEN;
+    *size = (long long)st.st_size;
+#if defined(__APPLE__)
+    *mtime_ns = (long long)st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+    *mtime_ns = (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+#endif
+    return XM_OK;
+}
+
+int xm_read_file_into(const char *path, uint8_t *data, size_t cap, size_t *size)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return XM_ERR_OPEN;
+
+    *size = fread(data, 1, cap, fp);
+    int err = ferror(fp) ? XM_ERR_READ : XM_OK;
+    fclose(fp);
+    XM_COUNT(XM_CTR_FILES_OPENED, 1);
+    XM_COUNT(XM_CTR_BYTES_READ, *size);
+    return err;
+}
+
+int xm_read_file(const char *path, uint8_t **data, size_t *size)
+{
+    *data = NULL;
+    *size = 0;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return XM_ERR_OPEN;
+
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (file_size < 0)
+    {
+        fclose(fp);
+        return XM_ERR_READ;
+    }
+
+    // One spare byte so empty files still get a valid pointer
+    uint8_t *buffer = malloc((size_t)file_size + 1);
+    if (!buffer)
+    {
+        fclose(fp);
+        return XM_ERR_NOMEM;
+    }
+
+    size_t bytes_read = fread(buffer, 1, (size_t)file_size, fp);
+    fclose(fp);
+    XM_COUNT(XM_CTR_FILES_OPENED, 1);
+    XM_COUNT(XM_CTR_BYTES_READ, bytes_read);
+
+    *data = buffer;
+    *size = bytes_read;
+    return XM_OK;
+}
+
+int xm_write_file(const char *path, const uint8_t *data, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return XM_ERR_OPEN;
+
+    size_t written = fwrite(data, 1, size, fp);
+    int close_err = fclose(fp);
+    XM_COUNT(XM_CTR_FILES_OPENED, 1);
+    XM_COUNT(XM_CTR_BYTES_WRITTEN, written);
+    return (written < size || close_err != 0) ? XM_ERR_WRITE : XM_OK;
+}
+
+int xm_ensure_dir(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) == 0)
+        return (st.st_mode & S_IFDIR) ? XM_OK : XM_ERR_OPEN;
+
+#if defined(_WIN32)
+    if (_mkdir(path) != 0)
+#else
+    if (mkdir(path, 0755) != 0)
+#endif
+        return XM_ERR_WRITE;
+    return XM_OK;
+}
+
+int xm_backup_file(const char *path)
+{
+    int err = xm_ensure_dir("macro_backup");
+    if (err != XM_OK)
+        return err;
+
+    char backup_path[1024];
+    snprintf(backup_path, sizeof(backup_path), "macro_backup/%s", xm_basename(path));
+
+    FILE *fin = fopen(path, "rb");
+    if (!fin)
+        return XM_ERR_OPEN;
+
+    FILE *fout = fopen(backup_path, "wb");
+    if (!fout)
+    {
+        fclose(fin);
+        return XM_ERR_WRITE;
+    }
+
+    char buf[8192];
+    size_t n;
+    err = XM_OK;
+    while ((n = fread(buf, 1, sizeof(buf), fin)) > 0)
+    {
+        if (fwrite(buf, 1, n, fout) != n)
+        {
+            err = XM_ERR_WRITE;
+            break;
+        }
+    }
+    fclose(fin);
+    if (fclose(fout) != 0)
+        err = XM_ERR_WRITE;
+    return err;
+}
+
+// -------------------------------------------------------------------
+// Hashing
+// -------------------------------------------------------------------
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Two multiply-rotate lanes over 8-byte words, finished as in MurmurHash3
+void xm_hash128(const void *data, size_t size, uint64_t out[2])
+{
+    const uint8_t *p = data;
+    uint64_t h1 = 0x9E3779B97F4A7C15ULL ^ size;
+    uint64_t h2 = 0xC2B2AE3D27D4EB4FULL + size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t k;
+        memcpy(&k, p + i, 8);
+        h1 = rotl64(h1 ^ (k * 0x87C37B91114253D5ULL), 27) * 0x4CF5AD432745937FULL + 0x52DCE729;
+        h2 = rotl64(h2 + (rotl64(k, 31) * 0x4CF5AD432745937FULL), 31) * 0x87C37B91114253D5ULL + 0x38495AB5;
+    }
+    if (i < size)
+    {
+        uint64_t k = 0;
+        memcpy(&k, p + i, size - i);
+        h1 = rotl64(h1 ^ (k * 0x87C37B91114253D5ULL), 27) * 0x4CF5AD432745937FULL + 0x52DCE729;
+        h2 = rotl64(h2 + (rotl64(k, 31) * 0x4CF5AD432745937FULL), 31) * 0x87C37B91114253D5ULL + 0x38495AB5;
+    }
+
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    out[0] = h1;
+    out[1] = h2;
+}
+
+void xm_hash128_hex(const uint64_t hash[2], char out[33])
+{
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < 32; i++)
+        out[i] = hex[(hash[i / 16] >> (60 - 4 * (i % 16))) & 0x0F];
+    out[32] = '\0';
+}
+
+// -------------------------------------------------------------------
+// MD5
+//
+// xm_md5_many() runs one buffer per 32-bit SIMD lane, 4 with SSE2 and 8
+// with AVX2, so a folder's worth of mcr*.dat files costs about as much as
+// a quarter or an eighth of them hashed one at a time. Each block's words
+// are transposed into the lanes; a lane whose buffer has run out of
+// blocks keeps its state while the others carry on.
+// -------------------------------------------------------------------
+
+// The 64 steps of a block: round function, registers, word, constant, rotation
+#define MD5_STEPS(STEP)                                                                 \
+    STEP(F, a, b, c, d,  0, 0xd76aa478,  7) STEP(F, d, a, b, c,  1, 0xe8c7b756, 12) \
+    STEP(F, c, d, a, b,  2, 0x242070db, 17) STEP(F, b, c, d, a,  3, 0xc1bdceee, 22) \
+    STEP(F, a, b, c, d,  4, 0xf57c0faf,  7) STEP(F, d, a, b, c,  5, 0x4787c62a, 12) \
+    STEP(F, c, d, a, b,  6, 0xa8304613, 17) STEP(F, b, c, d, a,  7, 0xfd469501, 22) \
+    STEP(F, a, b, c, d,  8, 0x698098d8,  7) STEP(F, d, a, b, c,  9, 0x8b44f7af, 12) \
+    STEP(F, c, d, a, b, 10, 0xffff5bb1, 17) STEP(F, b, c, d, a, 11, 0x895cd7be, 22) \
+    STEP(F, a, b, c, d, 12, 0x6b901122,  7) STEP(F, d, a, b, c, 13, 0xfd987193, 12) \
+    STEP(F, c, d, a, b, 14, 0xa679438e, 17) STEP(F, b, c, d, a, 15, 0x49b40821, 22) \
+    STEP(G, a, b, c, d,  1, 0xf61e2562,  5) STEP(G, d, a, b, c,  6, 0xc040b340,  9) \
+    STEP(G, c, d, a, b, 11, 0x265e5a51, 14) STEP(G, b, c, d, a,  0, 0xe9b6c7aa, 20) \
+    STEP(G, a, b, c, d,  5, 0xd62f105d,  5) STEP(G, d, a, b, c, 10, 0x02441453,  9) \
+    STEP(G, c, d, a, b, 15, 0xd8a1e681, 14) STEP(G, b, c, d, a,  4, 0xe7d3fbc8, 20) \
+    STEP(G, a, b, c, d,  9, 0x21e1cde6,  5) STEP(G, d, a, b, c, 14, 0xc33707d6,  9) \
+    STEP(G, c, d, a, b,  3, 0xf4d50d87, 14) STEP(G, b, c, d, a,  8, 0x455a14ed, 20) \
+    STEP(G, a, b, c, d, 13, 0xa9e3e905,  5) STEP(G, d, a, b, c,  2, 0xfcefa3f8,  9) \
+    STEP(G, c, d, a, b,  7, 0x676f02d9, 14) STEP(G, b, c, d, a, 12, 0x8d2a4c8a, 20) \
+    STEP(H, a, b, c, d,  5, 0xfffa3942,  4) STEP(H, d, a, b, c,  8, 0x8771f681, 11) \
+    STEP(H, c, d, a, b, 11, 0x6d9d6122, 16) STEP(H, b, c, d, a, 14, 0xfde5380c, 23) \
+    STEP(H, a, b, c, d,  1, 0xa4beea44,  4) STEP(H, d, a, b, c,  4, 0x4bdecfa9, 11) \
+    STEP(H, c, d, a, b,  7, 0xf6bb4b60, 16) STEP(H, b, c, d, a, 10, 0xbebfbc70, 23) \
+    STEP(H, a, b, c, d, 13, 0x289b7ec6,  4) STEP(H, d, a, b, c,  0, 0xeaa127fa, 11) \
+    STEP(H, c, d, a, b,  3, 0xd4ef3085, 16) STEP(H, b, c, d, a,  6, 0x04881d05, 23) \
+    STEP(H, a, b, c, d,  9, 0xd9d4d039,  4) STEP(H, d, a, b, c, 12, 0xe6db99e5, 11) \
+    STEP(H, c, d, a, b, 15, 0x1fa27cf8, 16) STEP(H, b, c, d, a,  2, 0xc4ac5665, 23) \
+    STEP(I, a, b, c, d,  0, 0xf4292244,  6) STEP(I, d, a, b, c,  7, 0x432aff97, 10) \
+    STEP(I, c, d, a, b, 14, 0xab9423a7, 15) STEP(I, b, c, d, a,  5, 0xfc93a039, 21) \
+    STEP(I, a, b, c, d, 12, 0x655b59c3,  6) STEP(I, d, a, b, c,  3, 0x8f0ccc92, 10) \
+    STEP(I, c, d, a, b, 10, 0xffeff47d, 15) STEP(I, b, c, d, a,  1, 0x85845dd1, 21) \
+    STEP(I, a, b, c, d,  8, 0x6fa87e4f,  6) STEP(I, d, a, b, c, 15, 0xfe2ce6e0, 10) \
+    STEP(I, c, d, a, b,  6, 0xa3014314, 15) STEP(I, b, c, d, a, 13, 0x4e0811a1, 21) \
+    STEP(I, a, b, c, d,  4, 0xf7537e82,  6) STEP(I, d, a, b, c, 11, 0xbd3af235, 10) \
+    STEP(I, c, d, a, b,  2, 0x2ad7d2bb, 15) STEP(I, b, c, d, a,  9, 0xeb86d391, 21)
+
+static const uint32_t MD5_INIT[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+// One buffer's blocks: whole blocks straight from the data, then the
+// last partial block with its padding and length (one or two blocks)
+typedef struct
+{
+    const uint8_t *data;
+    size_t blocks;
+    size_t tail_from;
+    uint8_t tail[128];
+} md5_stream;
+
+static void md5_stream_init(md5_stream *s, const uint8_t *data, size_t size)
+{
+    size_t full = size / 64;
+    size_t rem = size % 64;
+    size_t tail_blocks = rem < 56 ? 1 : 2;
+    uint64_t bits = (uint64_t)size * 8;
+
+    s->data = data;
+    s->tail_from = full;
+    s->blocks = full + tail_blocks;
+    memset(s->tail, 0, sizeof(s->tail));
+    if (rem > 0)
+        memcpy(s->tail, data + full * 64, rem);
+    s->tail[rem] = 0x80;
+    for (int i = 0; i < 8; i++)
+        s->tail[tail_blocks * 64 - 8 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+// Fed to lanes with nothing (left) to hash; their state is discarded
+static const uint8_t md5_idle_block[64];
+
+static const uint8_t *md5_stream_block(const md5_stream *s, size_t k)
+{
+    if (k >= s->blocks)
+        return md5_idle_block;
+    return k < s->tail_from ? s->data + k * 64 : s->tail + (k - s->tail_from) * 64;
+}
+
+static void md5_digest(const uint32_t state[4], uint8_t out[16])
+{
+    for (int i = 0; i < 16; i++)
+        out[i] = (uint8_t)(state[i / 4] >> (8 * (i % 4)));
+}
+
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_STEP(f, a, b, c, d, w, k, s)                     \
+    a += MD5_##f(b, c, d) + x[w] + (uint32_t)k;              \
+    a = b + ((a << s) | (a >> (32 - s)));
+
+static void md5_block(uint32_t state[4], const uint8_t *p)
+{
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++)
+        x[i] = (uint32_t)p[i * 4] | (uint32_t)p[i * 4 + 1] << 8 |
+               (uint32_t)p[i * 4 + 2] << 16 | (uint32_t)p[i * 4 + 3] << 24;
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    MD5_STEPS(MD5_STEP)
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+static void md5_scalar(const uint8_t *data, size_t size, uint8_t out[16])
+{
+    md5_stream s;
+    md5_stream_init(&s, data, size);
+    uint32_t state[4];
+    memcpy(state, MD5_INIT, sizeof(state));
+    for (size_t k = 0; k < s.blocks; k++)
+        md5_block(state, md5_stream_block(&s, k));
+    md5_digest(state, out);
+}
+
+#if defined(XM_HAVE_SSE2)
+#define MD5_F4(x, y, z) _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z)))
+#define MD5_G4(x, y, z) _mm_xor_si128(y, _mm_and_si128(z, _mm_xor_si128(x, y)))
+#define MD5_H4(x, y, z) _mm_xor_si128(_mm_xor_si128(x, y), z)
+#define MD5_I4(x, y, z) _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, ones)))
+#define MD5_STEP4(f, a, b, c, d, w, k, s)                                                        \
+    a = _mm_add_epi32(_mm_add_epi32(a, MD5_##f##4(b, c, d)),                                     \
+                      _mm_add_epi32(x[w], _mm_set1_epi32((int)(uint32_t)k)));                    \
+    a = _mm_add_epi32(b, _mm_or_si128(_mm_slli_epi32(a, s), _mm_srli_epi32(a, 32 - s)));
+
+// Words 0..15 of four blocks, one block per lane
+static void md5_transpose4(const uint8_t *const p[4], __m128i x[16])
+{
+    for (int g = 0; g < 4; g++)
+    {
+        __m128i r0 = _mm_loadu_si128((const __m128i *)(p[0] + g * 16));
+        __m128i r1 = _mm_loadu_si128((const __m128i *)(p[1] + g * 16));
+        __m128i r2 = _mm_loadu_si128((const __m128i *)(p[2] + g * 16));
+        __m128i r3 = _mm_loadu_si128((const __m128i *)(p[3] + g * 16));
+        __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+        __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+        __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+        __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+        x[g * 4 + 0] = _mm_unpacklo_epi64(t0, t1);
+        x[g * 4 + 1] = _mm_unpackhi_epi64(t0, t1);
+        x[g * 4 + 2] = _mm_unpacklo_epi64(t2, t3);
+        x[g * 4 + 3] = _mm_unpackhi_epi64(t2, t3);
+    }
+}
+
+static void md5_sse2(const md5_stream *s, int lanes, uint8_t (*out)[16])
+{
+    const __m128i ones = _mm_set1_epi32(-1);
+    __m128i state[4];
+    for (int i = 0; i < 4; i++)
+        state[i] = _mm_set1_epi32((int)MD5_INIT[i]);
+
+    size_t blocks = 0;
+    for (int l = 0; l < lanes; l++)
+        blocks = s[l].blocks > blocks ? s[l].blocks : blocks;
+
+    for (size_t k = 0; k < blocks; k++)
+    {
+        const uint8_t *p[4];
+        int32_t live[4];
+        for (int l = 0; l < 4; l++)
+        {
+            p[l] = l < lanes ? md5_stream_block(&s[l], k) : md5_idle_block;
+            live[l] = l < lanes && k < s[l].blocks ? -1 : 0;
+        }
+        __m128i x[16];
+        md5_transpose4(p, x);
+        __m128i mask = _mm_set_epi32(live[3], live[2], live[1], live[0]);
+
+        __m128i a = state[0], b = state[1], c = state[2], d = state[3];
+        MD5_STEPS(MD5_STEP4)
+        state[0] = _mm_add_epi32(state[0], _mm_and_si128(a, mask));
+        state[1] = _mm_add_epi32(state[1], _mm_and_si128(b, mask));
+        state[2] = _mm_add_epi32(state[2], _mm_and_si128(c, mask));
+        state[3] = _mm_add_epi32(state[3], _mm_and_si128(d, mask));
+    }
+
+    uint32_t words[4][4];
+    for (int i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i *)words[i], state[i]);
+    for (int l = 0; l < lanes; l++)
+    {
+        uint32_t lane[4] = {words[0][l], words[1][l], words[2][l], words[3][l]};
+        md5_digest(lane, out[l]);
+    }
+}
+#endif
+
+#if defined(XM_HAVE_AVX2)
+#define MD5_F8(x, y, z) _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z)))
+#define MD5_G8(x, y, z) _mm256_xor_si256(y, _mm256_and_si256(z, _mm256_xor_si256(x, y)))
+#define MD5_H8(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define MD5_I8(x, y, z) _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, ones)))
+#define MD5_STEP8(f, a, b, c, d, w, k, s)                                                        \
+    a = _mm256_add_epi32(_mm256_add_epi32(a, MD5_##f##8(b, c, d)),                               \
+                         _mm256_add_epi32(x[w], _mm256_set1_epi32((int)(uint32_t)k)));           \
+    a = _mm256_add_epi32(b, _mm256_or_si256(_mm256_slli_epi32(a, s), _mm256_srli_epi32(a, 32 - s)));
+
+// 8x8 transposes of 32-bit words, in the AVX2 encoding so no SSE code
+// runs between the 256-bit steps
+XM_TARGET_AVX2 static void md5_transpose8(const uint8_t *const p[8], __m256i x[16])
+{
+    for (int g = 0; g < 2; g++)
+    {
+        __m256i r[8], t[8], u[8];
+        for (int l = 0; l < 8; l++)
+            r[l] = _mm256_loadu_si256((const __m256i *)(p[l] + g * 32));
+        for (int l = 0; l < 8; l += 2)
+        {
+            t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+            t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+        }
+        for (int h = 0; h < 8; h += 4)
+        {
+            u[h] = _mm256_unpacklo_epi64(t[h], t[h + 2]);
+            u[h + 1] = _mm256_unpackhi_epi64(t[h], t[h + 2]);
+            u[h + 2] = _mm256_unpacklo_epi64(t[h + 1], t[h + 3]);
+            u[h + 3] = _mm256_unpackhi_epi64(t[h + 1], t[h + 3]);
+        }
+        // u[w] holds word w of lanes 0-3 low and word w+4 high; u[w+4] lanes 4-7
+        for (int w = 0; w < 4; w++)
+        {
+            x[g * 8 + w] = _mm256_permute2x128_si256(u[w], u[w + 4], 0x20);
+            x[g * 8 + w + 4] = _mm256_permute2x128_si256(u[w], u[w + 4], 0x31);
+        }
+    }
+}
+
+XM_TARGET_AVX2 static void md5_avx2(const md5_stream *s, int lanes, uint8_t (*out)[16])
+{
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i state[4];
+    for (int i = 0; i < 4; i++)
+        state[i] = _mm256_set1_epi32((int)MD5_INIT[i]);
+
+    size_t blocks = 0;
+    for (int l = 0; l < lanes; l++)
+        blocks = s[l].blocks > blocks ? s[l].blocks : blocks;
+
+    for (size_t k = 0; k < blocks; k++)
+    {
+        const uint8_t *p[8];
+        int32_t live[8];
+        for (int l = 0; l < 8; l++)
+        {
+            p[l] = l < lanes ? md5_stream_block(&s[l], k) : md5_idle_block;
+            live[l] = l < lanes && k < s[l].blocks ? -1 : 0;
+        }
+        __m256i x[16];
+        md5_transpose8(p, x);
+        __m256i mask = _mm256_loadu_si256((const __m256i *)live);
+
+        __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+        MD5_STEPS(MD5_STEP8)
+        state[0] = _mm256_add_epi32(state[0], _mm256_and_si256(a, mask));
+        state[1] = _mm256_add_epi32(state[1], _mm256_and_si256(b, mask));
+        state[2] = _mm256_add_epi32(state[2], _mm256_and_si256(c, mask));
+        state[3] = _mm256_add_epi32(state[3], _mm256_and_si256(d, mask));
+    }
+
+    uint32_t words[4][8];
+    for (int i = 0; i < 4; i++)
+        _mm256_storeu_si256((__m256i *)words[i], state[i]);
+    for (int l = 0; l < lanes; l++)
+    {
+        uint32_t lane[4] = {words[0][l], words[1][l], words[2][l], words[3][l]};
+        md5_digest(lane, out[l]);
+    }
+}
+#endif
+
+void xm_md5(const void *data, size_t size, uint8_t out[16])
+{
+    md5_scalar(data, size, out);
+}
+
+void xm_md5_many(const uint8_t *const *data, const size_t *sizes, size_t count, uint8_t (*out)[16])
+{
+    md5_stream s[8];
+    size_t i = 0;
+#if defined(XM_HAVE_AVX2)
+    if (count >= 5 && xm_cpu_has_avx2())
+    {
+        for (; i + 4 < count; i += 8)
+        {
+            int lanes = count - i < 8 ? (int)(count - i) : 8;
+            for (int l = 0; l < lanes; l++)
+                md5_stream_init(&s[l], data[i + l], sizes[i + l]);
+            md5_avx2(s, lanes, out + i);
+        }
+    }
+#endif
+#if defined(XM_HAVE_SSE2)
+    for (; i + 1 < count; i += 4)
+    {
+        int lanes = count - i < 4 ? (int)(count - i) : 4;
+        for (int l = 0; l < lanes; l++)
+            md5_stream_init(&s[l], data[i + l], sizes[i + l]);
+        md5_sse2(s, lanes, out + i);
+    }
+#endif
+    for (; i < count; i++)
+        md5_scalar(data[i], sizes[i], out[i]);
+}
+
+// -------------------------------------------------------------------
+// Header checksum: the MD5 of everything after the header, at
+// XM_HEADER_MD5. Files are hashed in batches through xm_md5_many().
+// -------------------------------------------------------------------
+#define HEADER_BATCH 64
+
+static void header_digests(const uint8_t *const *files, const size_t *sizes, size_t count,
+                           uint8_t (*digests)[16])
+{
+    const uint8_t *bodies[HEADER_BATCH];
+    size_t lens[HEADER_BATCH];
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t skip = sizes[i] < XM_HEADER_SIZE ? sizes[i] : XM_HEADER_SIZE;
+        bodies[i] = files[i] + skip;
+        lens[i] = sizes[i] - skip;
+    }
+    xm_md5_many(bodies, lens, count, digests);
+}
+
+void xm_header_check_many(const uint8_t *const *files, const size_t *sizes, size_t count, int *ok)
+{
+    uint8_t digests[HEADER_BATCH][16];
+    for (size_t from = 0; from < count; from += HEADER_BATCH)
+    {
+        size_t n = count - from < HEADER_BATCH ? count - from : HEADER_BATCH;
+        header_digests(files + from, sizes + from, n, digests);
+        for (size_t i = 0; i < n; i++)
+        {
+            ok[from + i] = sizes[from + i] >= XM_HEADER_SIZE &&
+                           memcmp(files[from + i] + XM_HEADER_MD5, digests[i], 16) == 0;
+        }
+    }
+}
+
+void xm_header_update_many(uint8_t *const *files, const size_t *sizes, size_t count, int *changed)
+{
+    uint8_t digests[HEADER_BATCH][16];
+    for (size_t from = 0; from < count; from += HEADER_BATCH)
+    {
+        size_t n = count - from < HEADER_BATCH ? count - from : HEADER_BATCH;
+        header_digests((const uint8_t *const *)(files + from), sizes + from, n, digests);
+        for (size_t i = 0; i < n; i++)
+        {
+            uint8_t *md5 = files[from + i] + XM_HEADER_MD5;
+            int differs = sizes[from + i] >= XM_HEADER_SIZE && memcmp(md5, digests[i], 16) != 0;
+            if (differs)
+                memcpy(md5, digests[i], 16);
+            if (changed)
+                changed[from + i] = differs;
+        }
+    }
+}
+
+int xm_header_update(uint8_t *data, size_t size)
+{
+    if (size < XM_HEADER_SIZE)
+        return XM_ERR_FORMAT;
+    int changed;
+    xm_header_update_many(&data, &size, 1, &changed);
+    return changed;
+}
+
+// -------------------------------------------------------------------
+// Search
+//
+// The vector paths compare a block of candidate positions at once
+// against the needle's first and last byte and only check the rest at
+// positions where both agree. With 'fold', letters are lowered by OR-ing
+// 0x20, which lets a few non-letters through the filter too; the full
+// comparison weeds those out.
+// -------------------------------------------------------------------
+static uint8_t fold_byte(uint8_t c)
+{
+    return c >= 'A' && c <= 'Z' ? (uint8_t)(c | 0x20) : c;
+}
+
+static int is_alpha(uint8_t c)
+{
+    c = fold_byte(c);
+    return c >= 'a' && c <= 'z';
+}
+
+static int matches_at(const uint8_t *hay, const uint8_t *needle, size_t len, int fold)
+{
+    if (!fold)
+        return memcmp(hay, needle, len) == 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (fold_byte(hay[i]) != fold_byte(needle[i]))
+            return 0;
+    }
+    return 1;
+}
+
+static size_t find_scalar(const uint8_t *hay, size_t hay_len, size_t from,
+                          const uint8_t *needle, size_t needle_len, int fold)
+{
+    for (size_t i = from; i + needle_len <= hay_len; i++)
+    {
+        if (matches_at(hay + i, needle, needle_len, fold))
+            return i;
+    }
+    return hay_len;
+}
+
+#if defined(XM_HAVE_SSE2)
+static size_t find_sse2(const uint8_t *hay, size_t hay_len, const uint8_t *needle, size_t needle_len, int fold)
+{
+    size_t last = needle_len - 1;
+    uint8_t first_byte = fold ? fold_byte(needle[0]) : needle[0];
+    uint8_t last_byte = fold ? fold_byte(needle[last]) : needle[last];
+    const __m128i first = _mm_set1_epi8((char)first_byte);
+    const __m128i final = _mm_set1_epi8((char)last_byte);
+    const __m128i first_case = _mm_set1_epi8(fold && is_alpha(first_byte) ? 0x20 : 0);
+    const __m128i final_case = _mm_set1_epi8(fold && is_alpha(last_byte) ? 0x20 : 0);
+
+    size_t i = 0;
+    for (; i + last + 16 <= hay_len; i += 16)
+    {
+        __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i *)(hay + i)), first_case);
+        __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i *)(hay + i + last)), final_case);
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, final)));
+        while (mask)
+        {
+            int bit = xm_ctz(mask);
+            if (matches_at(hay + i + bit, needle, needle_len, fold))
+                return i + (size_t)bit;
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(hay, hay_len, i, needle, needle_len, fold);
+}
+#endif
+
+#if defined(XM_HAVE_AVX2)
+XM_TARGET_AVX2 static size_t find_avx2(const uint8_t *hay, size_t hay_len, const uint8_t *needle,
+                                       size_t needle_len, int fold)
+{
+    size_t last = needle_len - 1;
+    uint8_t first_byte = fold ? fold_byte(needle[0]) : needle[0];
+    uint8_t last_byte = fold ? fold_byte(needle[last]) : needle[last];
+    const __m256i first = _mm256_set1_epi8((char)first_byte);
+    const __m256i final = _mm256_set1_epi8((char)last_byte);
+    const __m256i first_case = _mm256_set1_epi8(fold && is_alpha(first_byte) ? 0x20 : 0);
+    const __m256i final_case = _mm256_set1_epi8(fold && is_alpha(last_byte) ? 0x20 : 0);
+
+    size_t i = 0;
+    for (; i + last + 32 <= hay_len; i += 32)
+    {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(hay + i)), first_case);
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(hay + i + last)), final_case);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, final)));
+        while (mask)
+        {
+            int bit = xm_ctz((int)mask);
+            if (matches_at(hay + i + bit, needle, needle_len, fold))
+                return i + (size_t)bit;
+            mask &= mask - 1;
+        }
+    }
+    size_t rest = find_sse2(hay + i, hay_len - i, needle, needle_len, fold);
+    return i + rest;
+}
+#endif
+
+size_t xm_find(const uint8_t *hay, size_t hay_len, const uint8_t *needle, size_t needle_len, int fold)
+{
+    if (needle_len == 0)
+        return 0;
+    if (needle_len > hay_len)
+        return hay_len;
+#if defined(XM_HAVE_AVX2)
+    if (hay_len >= 32 + needle_len && xm_cpu_has_avx2())
+        return find_avx2(hay, hay_len, needle, needle_len, fold);
+#endif
+#if defined(XM_HAVE_SSE2)
+    return find_sse2(hay, hay_len, needle, needle_len, fold);
+#else
+    return find_scalar(hay, hay_len, 0, needle, needle_len, fold);
+#endif
+}
+
+// -------------------------------------------------------------------
+// Record access
+// -------------------------------------------------------------------
+size_t xm_macro_count(size_t size)
+{
+    if (size <= XM_MACRO_START)
+        return 0;
+    return (size - XM_MACRO_START + XM_MACRO_SIZE - 1) / XM_MACRO_SIZE;
+}
+
+int xm_field_span(size_t size, int macro, int field, size_t *offset, size_t *len)
+{
+    if (macro < 0 || (size_t)macro >= xm_macro_count(size))
+        return XM_ERR_RANGE;
+    if (field != XM_FIELD_NAME && (field < 0 || field >= XM_LINES_PER_MACRO))
+        return XM_ERR_RANGE;
+
+    size_t start = XM_MACRO_START + (size_t)macro * XM_MACRO_SIZE;
+    size_t field_size;
+    if (field == XM_FIELD_NAME)
+    {
+        start += XM_LINES_PER_MACRO * XM_LINE_SIZE;
+        field_size = XM_NAME_SIZE;
+    }
+    else
+    {
+        start += (size_t)field * XM_LINE_SIZE;
+        field_size = XM_LINE_SIZE;
+    }
+
+    if (start >= size)
+        return XM_ERR_RANGE;
+    if (field_size > size - start)
+        field_size = size - start;
+
+    *offset = start;
+    *len = field_size;
+    return XM_OK;
+}
+
+int xm_write_field(uint8_t *data, size_t size, size_t offset,
+                   const char *text, size_t text_len, size_t field_size,
+                   int *changed)
+{
+    if (changed)
+        *changed = 0;
+    if (offset >= size)
+        return XM_ERR_RANGE;
+
+    size_t space_available = size - offset;
+    if (field_size > space_available)
+        field_size = space_available;
+
+    size_t to_copy = (text_len < field_size) ? text_len : field_size;
+    size_t fill = field_size - to_copy;
+    uint8_t *dst = &data[offset];
+
+    if (changed)
+    {
+        int differs = memcmp(dst, text, to_copy) != 0;
+        for (size_t i = 0; !differs && i < fill; i++)
+            differs = dst[to_copy + i] != 0;
+        *changed = differs;
+    }
+
+    memcpy(dst, text, to_copy);
+    memset(dst + to_copy, 0, fill);
+    XM_COUNT(XM_CTR_FIELDS_PATCHED, 1);
+    return XM_OK;
+}
+
+int xm_set_field(uint8_t *data, size_t size, int macro, int field,
+                 const char *text, size_t text_len, int *changed)
+{
+    size_t offset, len;
+    int err = xm_field_span(size, macro, field, &offset, &len);
+    if (err != XM_OK)
+    {
+        if (changed)
+            *changed = 0;
+        return err;
+    }
+    return xm_write_field(data, size, offset, text, text_len, len, changed);
+}
+
+// -------------------------------------------------------------------
+// Output buffer
+// -------------------------------------------------------------------
+void xm_buf_init(xm_buf *b)
+{
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+    b->failed = 0;
+}
+
+void xm_buf_free(xm_buf *b)
+{
+    free(b->data);
+    xm_buf_init(b);
+}
+
+int xm_buf_reserve(xm_buf *b, size_t extra)
+{
+    if (b->failed)
+        return XM_ERR_NOMEM;
+    if (b->cap - b->len >= extra)
+        return XM_OK;
+
+    size_t new_cap = b->cap ? b->cap : 4096;
+    while (new_cap - b->len < extra)
+        new_cap *= 2;
+
+    char *grown = realloc(b->data, new_cap);
+    if (!grown)
+    {
+        b->failed = 1;
+        return XM_ERR_NOMEM;
+    }
+    b->data = grown;
+    b->cap = new_cap;
+    return XM_OK;
+}
+
+void xm_buf_append(xm_buf *b, const void *src, size_t n)
+{
+    if (xm_buf_reserve(b, n) != XM_OK)
+        return;
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+}
+
+void xm_buf_puts(xm_buf *b, const char *s)
+{
+    xm_buf_append(b, s, strlen(s));
+}
+
+void xm_buf_printf(xm_buf *b, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0 || xm_buf_reserve(b, (size_t)n + 1) != XM_OK)
+        return;
+
+    va_start(ap, fmt);
+    vsnprintf(b->data + b->len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    b->len += (size_t)n;
+}
+
+int xm_buf_write(const xm_buf *b, FILE *fp)
+{
+    if (b->failed)
+        return XM_ERR_NOMEM;
+    if (b->len > 0 && fwrite(b->data, 1, b->len, fp) != b->len)
+        return XM_ERR_WRITE;
+    return XM_OK;
+}
+
+// -------------------------------------------------------------------
+// JSON encoding
+// -------------------------------------------------------------------
+// Bytes that need escaping: controls (NUL included, which ends a field),
+// '"', '\' and anything outside printable ASCII. They are rare in macro
+// text, so the scan below looks for them a vector at a time and clean runs
+// are copied in bulk.
+static int needs_escape(uint8_t c)
+{
+    return c < 0x20 || c > 0x7E || c == '"' || c == '\\';
+}
+
+static size_t clean_run_scalar(const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+    while (i < n && !needs_escape(src[i]))
+        i++;
+    return i;
+}
+
+#if defined(XM_HAVE_SSE2)
+// Signed compares: bytes >= 0x80 are negative, so "< 0x20" catches them too
+static size_t clean_run_sse2(const uint8_t *src, size_t n)
+{
+    const __m128i lo = _mm_set1_epi8(0x20);
+    const __m128i hi = _mm_set1_epi8(0x7E);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i bad = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(v, lo), _mm_cmpgt_epi8(v, hi)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)));
+        int mask = _mm_movemask_epi8(bad);
+        if (mask)
+            return i + (size_t)xm_ctz(mask);
+    }
+    return i + clean_run_scalar(src + i, n - i);
+}
+#endif
+
+#if defined(XM_HAVE_AVX2)
+XM_TARGET_AVX2 static size_t clean_run_avx2(const uint8_t *src, size_t n)
+{
+    const __m256i lo = _mm256_set1_epi8(0x20);
+    const __m256i hi = _mm256_set1_epi8(0x7E);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i slash = _mm256_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i bad = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi8(lo, v), _mm256_cmpgt_epi8(v, hi)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, slash)));
+        int mask = _mm256_movemask_epi8(bad);
+        if (mask)
+            return i + (size_t)xm_ctz(mask);
+    }
+    return i + clean_run_sse2(src + i, n - i);
+}
+#endif
+
+/**
+ * Length of the leading run of 'src' that can be copied as-is.
+ */
+static size_t clean_run(const uint8_t *src, size_t n)
+{
+#if defined(XM_HAVE_AVX2)
+    if (n >= 32 && xm_cpu_has_avx2())
+        return clean_run_avx2(src, n);
+#endif
+#if defined(XM_HAVE_SSE2)
+    return clean_run_sse2(src, n);
+#else
+    return clean_run_scalar(src, n);
+#endif
+}
+
+void xm_json_escape(xm_buf *b, const uint8_t *src, size_t max_len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    // Worst case every byte becomes \u00XX
+    if (max_len > (SIZE_MAX - 1) / 6 || xm_buf_reserve(b, max_len * 6) != XM_OK)
+        return;
+    char *out = b->data + b->len;
+
+    size_t i = 0;
+    while (i < max_len)
+    {
+        size_t run = clean_run(src + i, max_len - i);
+        memcpy(out, src + i, run);
+        out += run;
+        i += run;
+        if (i >= max_len || src[i] == 0)
+            break;
+
+        uint8_t c = src[i++];
+        *out++ = '\\';
+        switch (c)
+        {
+        case '\"':
+            *out++ = '\"';
+            break;
+        case '\\':
+            *out++ = '\\';
+            break;
+        case '\b':
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = 'f';
+            break;
+        case '\n':
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = 't';
+            break;
+        default:
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex[c >> 4];
+            *out++ = hex[c & 0x0F];
+        }
+    }
+    b->len = (size_t)(out - b->data);
+}
+
+// Appends 'prefix' and then "0x%04zX" of 'value', without printf
+static void put_offset(xm_buf *b, const char *prefix, size_t prefix_len, size_t value)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char digits[2 * sizeof(size_t)];
+    int n = 0;
+    do
+    {
+        digits[n++] = hex[value & 0x0F];
+        value >>= 4;
+    } while (value || n < 4);
+
+    if (xm_buf_reserve(b, prefix_len + 2 + (size_t)n) != XM_OK)
+        return;
+    char *out = b->data + b->len;
+    memcpy(out, prefix, prefix_len);
+    out += prefix_len;
+    *out++ = '0';
+    *out++ = 'x';
+    while (n > 0)
+        *out++ = digits[--n];
+    b->len = (size_t)(out - b->data);
+}
+
+#define PUT_OFFSET(b, prefix, value) put_offset((b), prefix, sizeof(prefix) - 1, (value))
+
+void xm_json_macro(xm_buf *b, const uint8_t *macro, size_t start_offset, size_t chunk_size)
+{
+    PUT_OFFSET(b, "{\"offset\":\"", start_offset);
+    xm_buf_append(b, "\",\"lines\":[", 11);
+
+    for (int line = 0; line < XM_LINES_PER_MACRO; line++)
+    {
+        size_t in_macro = (size_t)line * XM_LINE_SIZE;
+        if (in_macro >= chunk_size)
+            break;
+
+        size_t can_print = chunk_size - in_macro;
+        if (can_print > XM_LINE_SIZE)
+            can_print = XM_LINE_SIZE;
+
+        if (line > 0)
+            xm_buf_putc(b, ',');
+        PUT_OFFSET(b, "{\"offset\":\"", start_offset + in_macro);
+        xm_buf_append(b, "\",\"data\":\"", 10);
+        xm_json_text(b, &macro[in_macro], can_print);
+        xm_buf_append(b, "\"}", 2);
+    }
+
+    xm_buf_putc(b, ']');
+
+    size_t name_start = XM_LINES_PER_MACRO * XM_LINE_SIZE;
+    if (chunk_size > name_start)
+    {
+        size_t name_len = chunk_size - name_start;
+        if (name_len > XM_NAME_SIZE)
+            name_len = XM_NAME_SIZE;
+
+        xm_buf_puts(b, ",\"name\":\"");
+        xm_json_text(b, &macro[name_start], name_len);
+        xm_buf_putc(b, '"');
+    }
+    xm_buf_putc(b, '}');
+}
+
+void xm_json_file(xm_buf *b, const char *file_name, const uint8_t *data, size_t size)
+{
+    xm_buf_puts(b, "{\"fileName\":\"");
+    xm_json_escape(b, (const uint8_t *)file_name, strlen(file_name));
+    xm_buf_printf(b, "\",\"fileSize\":%zu,\"macros\":[", size);
+
+    int macro_index = 0;
+    for (size_t offset = XM_MACRO_START; offset < size; offset += XM_MACRO_SIZE)
+    {
+        if (macro_index > 0)
+            xm_buf_putc(b, ',');
+        macro_index++;
+
+        size_t remain = size - offset;
+        size_t chunk_size = (remain < XM_MACRO_SIZE) ? remain : XM_MACRO_SIZE;
+        xm_json_macro(b, &data[offset], offset, chunk_size);
+    }
+
+    xm_buf_append(b, "]}", 2);
+    XM_COUNT(XM_CTR_RECORDS_PARSED, macro_index);
+}
@@ -0,0 +1,281 @@
+#ifndef XIMACRO_H
+#define XIMACRO_H
+
+/**
+ * libximacro - shared reading, patching and JSON encoding of FFXI mcr*.dat
+ * macro files, used by the ximacro_* tools and the ximacro.node addon.
+ *
+ * Functions return XM_OK (0) on success and a negative XM_ERR_* code on
+ * failure. Buffers handed out by the library are released with xm_free().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined(_WIN32) && defined(XIMACRO_BUILDING_DLL)
+#define XM_API __declspec(dllexport)
+#elif defined(_WIN32) && defined(XIMACRO_DLL)
+#define XM_API __declspec(dllimport)
+#else
+#define XM_API
+#endif
+
+#define XM_API_VERSION 1
+
+// -----------------
+// mcr*.dat LAYOUT
+// -----------------
+#define XM_LINES_PER_MACRO 6
+#define XM_LINE_SIZE 0x3D
+#define XM_NAME_SIZE 0x0E
+#define XM_MACRO_SIZE ((XM_LINES_PER_MACRO * XM_LINE_SIZE) + XM_NAME_SIZE)
+#define XM_MACRO_START 0x1C
+#define XM_MACROS_PER_FILE 20
+
+// The header ends with the MD5 of everything after it
+#define XM_HEADER_SIZE 0x18
+#define XM_HEADER_MD5 0x08
+
+// mcr.dat plus mcr1.dat ... mcr400.dat
+#define XM_MAX_FILE_INDEX 400
+#define XM_FILE_COUNT (XM_MAX_FILE_INDEX + 1)
+
+// Field selector for the macro name, in place of a line index
+#define XM_FIELD_NAME (-1)
+
+#if defined(_WIN32)
+#define XM_PATH_SEP '\\'
+#define XM_PATH_SEP_STR "\\"
+#else
+#define XM_PATH_SEP '/'
+#define XM_PATH_SEP_STR "/"
+#endif
+
+// -----------------
+// ERROR CODES
+// -----------------
+#define XM_OK 0
+#define XM_ERR_OPEN (-1)
+#define XM_ERR_READ (-2)
+#define XM_ERR_WRITE (-3)
+#define XM_ERR_NOMEM (-4)
+#define XM_ERR_RANGE (-5)
+#define XM_ERR_FORMAT (-6)
+
+XM_API int xm_api_version(void);
+XM_API const char *xm_strerror(int err);
+XM_API void xm_free(void *ptr);
+
+/**
+ * Monotonic clock in milliseconds, for timing stages.
+ */
+XM_API double xm_now_ms(void);
+
+// -----------------
+// PATHS
+// -----------------
+
+/**
+ * Writes "mcr.dat" (index 0) or "mcr<index>.dat" into 'out'.
+ */
+XM_API int xm_file_name(int index, char *out, size_t cap);
+
+/**
+ * Writes "<dir><sep>mcr<index>.dat" into 'out'.
+ */
+XM_API int xm_file_path(const char *dir, int index, char *out, size_t cap);
+
+/**
+ * Returns the file index for an mcr*.dat basename, or -1 if it isn't one.
+ */
+XM_API int xm_file_index(const char *basename);
+
+/**
+ * Returns the part of 'path' after the last '/' or '\'.
+ */
+XM_API const char *xm_basename(const char *path);
+
+// -----------------
+// FILE I/O
+// -----------------
+
+/**
+ * Returns the size of 'path' in bytes, or a negative XM_ERR_* code.
+ */
+XM_API long xm_file_size(const char *path);
+
+/**
+ * Size and last-write time (ns since 1970) of 'path', for change detection.
+ */
+XM_API int xm_file_stamp(const char *path, long long *size, long long *mtime_ns);
+
+/**
+ * Reads a whole file into a new buffer. Release '*data' with xm_free().
+ */
+XM_API int xm_read_file(const char *path, uint8_t **data, size_t *size);
+
+/**
+ * Reads up to 'cap' bytes of a file into caller-owned memory.
+ */
+XM_API int xm_read_file_into(const char *path, uint8_t *data, size_t cap, size_t *size);
+
+/**
+ * Replaces the contents of 'path' with 'size' bytes from 'data'.
+ */
+XM_API int xm_write_file(const char *path, const uint8_t *data, size_t size);
+
+/**
+ * Creates directory 'path' (one level) unless it already exists.
+ */
+XM_API int xm_ensure_dir(const char *path);
+
+/**
+ * Copies 'path' to macro_backup/<basename> in the working directory.
+ */
+XM_API int xm_backup_file(const char *path);
+
+// -----------------
+// RECORD ACCESS
+// -----------------
+
+/**
+ * Number of (possibly truncated) macro records in a file of 'size' bytes.
+ */
+XM_API size_t xm_macro_count(size_t size);
+
+/**
+ * Locates one line (0..5) or the name (XM_FIELD_NAME) of a macro record.
+ * The returned length is clipped to the end of the file.
+ */
+XM_API int xm_field_span(size_t size, int macro, int field, size_t *offset, size_t *len);
+
+/**
+ * Writes 'text' into a fixed-size field at 'offset', truncating to
+ * 'field_size' and zero-filling the remainder. Nothing is written past
+ * 'size'. Sets '*changed' (if given) when any byte differed.
+ */
+XM_API int xm_write_field(uint8_t *data, size_t size, size_t offset,
+                          const char *text, size_t text_len, size_t field_size,
+                          int *changed);
+
+/**
+ * xm_write_field() addressed by macro and line/name index.
+ */
+XM_API int xm_set_field(uint8_t *data, size_t size, int macro, int field,
+                        const char *text, size_t text_len, int *changed);
+
+// -----------------
+// HASHING
+// -----------------
+
+/**
+ * Fast non-cryptographic 128-bit hash of 'size' bytes, for content
+ * addressing and change detection (not stable across byte orders).
+ */
+XM_API void xm_hash128(const void *data, size_t size, uint64_t out[2]);
+
+/**
+ * Writes the 32 lowercase hex digits of a 128-bit hash and a NUL.
+ */
+XM_API void xm_hash128_hex(const uint64_t hash[2], char out[33]);
+
+/**
+ * MD5 digest of 'size' bytes.
+ */
+XM_API void xm_md5(const void *data, size_t size, uint8_t out[16]);
+
+/**
+ * MD5 digests of 'count' buffers, hashed several at a time in SIMD lanes
+ * (4 with SSE2, 8 with AVX2). Fastest when the sizes are alike.
+ */
+XM_API void xm_md5_many(const uint8_t *const *data, const size_t *sizes, size_t count, uint8_t (*out)[16]);
+
+/**
+ * Sets 'ok[i]' to 1 if file i's header holds the MD5 of its records, or
+ * 0 if it doesn't or the file is too short to have a header.
+ */
+XM_API void xm_header_check_many(const uint8_t *const *files, const size_t *sizes, size_t count, int *ok);
+
+/**
+ * Stores the MD5 of each file's records in its header. 'changed' (may be
+ * NULL) gets 1 for each file whose header was out of date.
+ */
+XM_API void xm_header_update_many(uint8_t *const *files, const size_t *sizes, size_t count, int *changed);
+
+/**
+ * xm_header_update_many() for one file: 1 if the header changed, 0 if it
+ * was current, XM_ERR_FORMAT if the file is too short.
+ */
+XM_API int xm_header_update(uint8_t *data, size_t size);
+
+// -----------------
+// SEARCH
+// -----------------
+
+/**
+ * Offset of the first occurrence of 'needle' in 'hay', or 'hay_len' if
+ * there is none. With 'fold', ASCII letters match regardless of case.
+ */
+XM_API size_t xm_find(const uint8_t *hay, size_t hay_len, const uint8_t *needle, size_t needle_len, int fold);
+
+// -----------------
+// OUTPUT BUFFER
+// -----------------
+typedef struct xm_buf
+{
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed; // set once an allocation fails; further appends are dropped
+} xm_buf;
+
+XM_API void xm_buf_init(xm_buf *b);
+XM_API void xm_buf_free(xm_buf *b);
+XM_API int xm_buf_reserve(xm_buf *b, size_t extra);
+XM_API void xm_buf_append(xm_buf *b, const void *src, size_t n);
+XM_API void xm_buf_puts(xm_buf *b, const char *s);
+XM_API void xm_buf_printf(xm_buf *b, const char *fmt, ...);
+XM_API int xm_buf_write(const xm_buf *b, FILE *fp);
+
+static inline void xm_buf_putc(xm_buf *b, char c)
+{
+    if (b->len < b->cap)
+        b->data[b->len++] = c;
+    else
+        xm_buf_append(b, &c, 1);
+}
+
+// -----------------
+// JSON ENCODING
+// -----------------
+
+/**
+ * Appends bytes up to the first NUL (or 'max_len') as JSON string content.
+ * Bytes outside 0x20..0x7E become \u00XX escapes. Macro text goes through
+ * xm_json_text() (xm_text.h) instead.
+ */
+XM_API void xm_json_escape(xm_buf *b, const uint8_t *src, size_t max_len);
+
+/**
+ * Appends one macro record: {"offset":..,"lines":[..],"name":..}, its
+ * text decoded by xm_json_text().
+ */
+XM_API void xm_json_macro(xm_buf *b, const uint8_t *macro, size_t start_offset, size_t chunk_size);
+
+/**
+ * Appends one file object as produced by ximacro_e:
+ * {"fileName":..,"fileSize":..,"macros":[..]}
+ */
+XM_API void xm_json_file(xm_buf *b, const char *file_name, const uint8_t *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XIMACRO_H
@@ -0,0 +1,208 @@
+#include "xm_bin.h"
+#include "xm_text.h"
+#include "xm_trace.h"
+
+#include <string.h>
+
+static void put_le(xm_buf *b, uint32_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        xm_buf_putc(b, (char)(v >> (8 * i)));
+}
+
+static uint32_t get_le(const uint8_t *p, int bytes)
+{
+    uint32_t v = 0;
+    for (int i = 0; i < bytes; i++)
+        v |= (uint32_t)p[i] << (8 * i);
+    return v;
+}
+
+int xm_bin_fields(size_t file_size, int macro, int *has_name)
+{
+    size_t start = XM_MACRO_START + (size_t)macro * XM_MACRO_SIZE;
+    size_t chunk = start < file_size ? file_size - start : 0;
+    if (chunk > XM_MACRO_SIZE)
+        chunk = XM_MACRO_SIZE;
+
+    int lines = (int)((chunk + XM_LINE_SIZE - 1) / XM_LINE_SIZE);
+    if (lines > XM_LINES_PER_MACRO)
+        lines = XM_LINES_PER_MACRO;
+    if (has_name)
+        *has_name = chunk > XM_LINES_PER_MACRO * XM_LINE_SIZE;
+    return lines;
+}
+
+// -------------------------------------------------------------------
+// Writing
+// -------------------------------------------------------------------
+void xm_bin_header(xm_buf *b, const char *dir)
+{
+    size_t len = strlen(dir);
+    if (len > UINT16_MAX)
+        len = UINT16_MAX;
+    xm_buf_append(b, XM_BIN_MAGIC, 4);
+    put_le(b, XM_BIN_VERSION, 2);
+    put_le(b, (uint32_t)len, 2);
+    xm_buf_append(b, dir, len);
+}
+
+static void put_field(xm_buf *b, const uint8_t *data, size_t size, int macro, int field)
+{
+    size_t offset, len;
+    if (xm_field_span(size, macro, field, &offset, &len) != XM_OK)
+        offset = len = 0;
+
+    // Length is patched in once the text is decoded
+    size_t at = b->len;
+    put_le(b, 0, 2);
+    xm_text_decode(b, data + offset, len);
+    if (!b->failed)
+    {
+        size_t text_len = b->len - at - 2;
+        b->data[at] = (char)text_len;
+        b->data[at + 1] = (char)(text_len >> 8);
+    }
+}
+
+void xm_bin_file(xm_buf *b, int index, const uint8_t *data, size_t size)
+{
+    int macros = (int)xm_macro_count(size);
+    if (macros == 0 || size > UINT32_MAX)
+        return;
+
+    // Length is patched in once the record is complete
+    size_t at = b->len;
+    put_le(b, 0, 4);
+    put_le(b, (uint32_t)index, 2);
+    put_le(b, (uint32_t)size, 4);
+    put_le(b, (uint32_t)macros, 2);
+    for (int m = 0; m < macros; m++)
+    {
+        int has_name;
+        int lines = xm_bin_fields(size, m, &has_name);
+        for (int line = 0; line < lines; line++)
+            put_field(b, data, size, m, line);
+        if (has_name)
+            put_field(b, data, size, m, XM_FIELD_NAME);
+    }
+
+    if (!b->failed)
+    {
+        uint32_t len = (uint32_t)(b->len - at - 4);
+        for (int i = 0; i < 4; i++)
+            b->data[at + i] = (char)(len >> (8 * i));
+    }
+    XM_COUNT(XM_CTR_RECORDS_PARSED, macros);
+}
+
+void xm_bin_end(xm_buf *b)
+{
+    put_le(b, 0, 4);
+}
+
+// -------------------------------------------------------------------
+// Reading
+// -------------------------------------------------------------------
+int xm_bin_open(xm_bin_reader *r, const uint8_t *data, size_t size)
+{
+    memset(r, 0, sizeof(*r));
+    if (size < 8 || memcmp(data, XM_BIN_MAGIC, 4) != 0)
+        return XM_ERR_FORMAT;
+    r->version = (int)get_le(data + 4, 2);
+    r->dir_len = get_le(data + 6, 2);
+    if (r->version < 1 || r->version > XM_BIN_VERSION || size - 8 < r->dir_len)
+        return XM_ERR_FORMAT;
+    r->dir = (const char *)data + 8;
+    r->p = data + 8 + r->dir_len;
+    r->end = data + size;
+    return XM_OK;
+}
+
+// Length prefix of a field: u8 in version 1, u16 since
+static size_t field_header(int version)
+{
+    return version == 1 ? 1 : 2;
+}
+
+/**
+ * Checks that 'len' bytes of fields hold exactly what 'macros' macros of
+ * a 'file_size'-byte file carry. Version 1 raw bytes must also fit their
+ * field; text is only clipped once encoded.
+ */
+static int check_fields(int version, const uint8_t *p, size_t len, size_t file_size, int macros)
+{
+    const uint8_t *end = p + len;
+    size_t header = field_header(version);
+    for (int m = 0; m < macros; m++)
+    {
+        int has_name;
+        int count = xm_bin_fields(file_size, m, &has_name) + has_name;
+        for (int f = 0; f < count; f++)
+        {
+            size_t limit = has_name && f == count - 1 ? XM_NAME_SIZE : XM_LINE_SIZE;
+            if ((size_t)(end - p) < header)
+                return XM_ERR_FORMAT;
+            size_t n = get_le(p, (int)header);
+            if ((version == 1 && n > limit) || (size_t)(end - p) - header < n)
+                return XM_ERR_FORMAT;
+            p += header + n;
+        }
+    }
+    return p == end ? XM_OK : XM_ERR_FORMAT;
+}
+
+int xm_bin_next(xm_bin_reader *r, xm_bin_record *rec)
+{
+    if (r->ended || r->end - r->p < 4)
+        return r->ended ? 0 : XM_ERR_FORMAT;
+    uint32_t len = get_le(r->p, 4);
+    r->p += 4;
+    if (len == 0)
+    {
+        r->ended = 1;
+        return 0;
+    }
+    if ((size_t)(r->end - r->p) < len || len < 8)
+        return XM_ERR_FORMAT;
+
+    const uint8_t *p = r->p;
+    rec->version = r->version;
+    rec->index = (int)get_le(p, 2);
+    rec->file_size = get_le(p + 2, 4);
+    rec->macros = (int)get_le(p + 6, 2);
+    rec->fields = p + 8;
+    rec->fields_len = len - 8;
+    if (rec->index > XM_MAX_FILE_INDEX || (size_t)rec->macros > xm_macro_count(rec->file_size) ||
+        check_fields(r->version, rec->fields, rec->fields_len, rec->file_size, rec->macros) != XM_OK)
+        return XM_ERR_FORMAT;
+
+    r->p += len;
+    return 1;
+}
+
+int xm_bin_apply(const xm_bin_record *rec, uint8_t *data, size_t size, int *changed)
+{
+    if (changed)
+        *changed = 0;
+    const uint8_t *p = rec->fields;
+    size_t header = field_header(rec->version);
+    for (int m = 0; m < rec->macros; m++)
+    {
+        int has_name;
+        int lines = xm_bin_fields(rec->file_size, m, &has_name);
+        for (int f = 0; f < lines + has_name; f++)
+        {
+            int field = f < lines ? f : XM_FIELD_NAME;
+            const char *text = (const char *)p + header;
+            size_t n = get_le(p, (int)header);
+            int differs = 0;
+            int err = rec->version == 1 ? xm_set_field(data, size, m, field, text, n, &differs)
+                                        : xm_text_set_field(data, size, m, field, text, n, &differs);
+            if (err == XM_OK && changed)
+                *changed |= differs;
+            p += header + n;
+        }
+    }
+    return XM_OK;
+}
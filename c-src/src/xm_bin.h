@@ -0,0 +1,93 @@
+#ifndef XM_BIN_H
+#define XM_BIN_H
+
+/**
+ * Compact binary interchange for the macros of one character folder, an
+ * alternative to the JSON of ximacro_e / ximacro_i. All integers are
+ * little-endian:
+ *
+ *   "XMMB" u16 version, u16 dir_len, dir
+ *   per file: u32 len (bytes that follow; 0 ends the stream),
+ *             u16 index, u32 file_size, u16 macros,
+ *             per macro: u16 len + text of each line, then the name
+ *   end:      u32 0
+ *
+ * Offsets are implicit: the file is <dir><sep><mcr name of index>, and
+ * lines and names sit where the record layout puts them. Field text is
+ * the UTF-8 of xm_text_decode(), exactly as in the JSON. A macro cut
+ * short by the end of the file only carries the fields the file holds,
+ * which both sides derive from 'file_size' (see xm_bin_fields()).
+ *
+ * Version 1 streams, which carried each field as u8 len + raw bytes, are
+ * still read.
+ */
+
+#include "ximacro.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define XM_BIN_MAGIC "XMMB"
+#define XM_BIN_VERSION 2
+
+typedef struct xm_bin_reader
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    int version;
+    const char *dir; // not NUL-terminated
+    size_t dir_len;
+    int ended;       // the end marker was read
+} xm_bin_reader;
+
+typedef struct xm_bin_record
+{
+    int version; // of the stream, which decides how fields are read
+    int index;
+    size_t file_size;
+    int macros;
+    const uint8_t *fields; // the per-macro fields, validated
+    size_t fields_len;
+} xm_bin_record;
+
+/**
+ * Number of lines (0-6) a macro of a 'file_size'-byte file holds, and
+ * whether it holds its name.
+ */
+XM_API int xm_bin_fields(size_t file_size, int macro, int *has_name);
+
+XM_API void xm_bin_header(xm_buf *b, const char *dir);
+
+/**
+ * Appends one file record; files too short to hold a macro are skipped.
+ */
+XM_API void xm_bin_file(xm_buf *b, int index, const uint8_t *data, size_t size);
+
+XM_API void xm_bin_end(xm_buf *b);
+
+/**
+ * Checks the header of a stream of 'size' bytes. XM_ERR_FORMAT unless it
+ * is a version this library reads.
+ */
+XM_API int xm_bin_open(xm_bin_reader *r, const uint8_t *data, size_t size);
+
+/**
+ * Reads the next record: 1 if there was one, 0 at the end marker, or
+ * XM_ERR_FORMAT for a malformed or truncated stream.
+ */
+XM_API int xm_bin_next(xm_bin_reader *r, xm_bin_record *rec);
+
+/**
+ * Writes every field of 'rec' into the file contents 'data' (zero-filling
+ * the rest of each field); fields past 'size' are skipped. Sets
+ * '*changed' (if given) when any byte differed.
+ */
+XM_API int xm_bin_apply(const xm_bin_record *rec, uint8_t *data, size_t size, int *changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_BIN_H
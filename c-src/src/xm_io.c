@@ -0,0 +1,524 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // copy_file_range()
+#endif
+
+#include "xm_io.h"
+#include "xm_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(_WIN32)
+#include "./vendor/dirent/dirent.h"
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(XM_HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(XM_HAVE_FICLONE)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+int xm_io_parse_backend(const char *name, xm_io_backend *out)
+{
+    if (strcmp(name, "mmap") == 0)
+        *out = XM_IO_MMAP;
+    else if (strcmp(name, "uring") == 0 || strcmp(name, "io_uring") == 0)
+        *out = XM_IO_URING;
+    else if (strcmp(name, "stdio") == 0)
+        *out = XM_IO_STDIO;
+    else
+        return XM_ERR_FORMAT;
+    return XM_OK;
+}
+
+const char *xm_io_backend_name(xm_io_backend backend)
+{
+    switch (backend)
+    {
+    case XM_IO_MMAP:
+        return "mmap";
+    case XM_IO_URING:
+        return "uring";
+    default:
+        return "stdio";
+    }
+}
+
+int xm_scan_macro_dir(const char *dir, uint8_t present[XM_FILE_COUNT])
+{
+    memset(present, 0, XM_FILE_COUNT);
+
+    DIR *dp = opendir(dir);
+    if (!dp)
+        return XM_ERR_OPEN;
+
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL)
+    {
+        int index = xm_file_index(entry->d_name);
+        if (index >= 0 && !present[index])
+        {
+            present[index] = 1;
+            count++;
+        }
+    }
+
+    closedir(dp);
+    return count;
+}
+
+// -------------------------------------------------------------------
+// stdio
+// -------------------------------------------------------------------
+static void load_stdio(const char *dir, xm_view *v)
+{
+    char path[768];
+    uint8_t *data;
+    size_t size;
+
+    v->err = xm_file_path(dir, v->index, path, sizeof(path));
+    if (v->err == XM_OK)
+        v->err = xm_read_file(path, &data, &size);
+    if (v->err != XM_OK)
+        return;
+
+    v->base = data;
+    v->data = data;
+    v->size = size;
+    v->owned = 1;
+}
+
+// -------------------------------------------------------------------
+// mmap / MapViewOfFile
+// -------------------------------------------------------------------
+#if defined(_WIN32)
+static int load_mmap(const char *dir, xm_view *v)
+{
+    char path[768];
+    if (xm_file_path(dir, v->index, path, sizeof(path)) != XM_OK)
+        return 0;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        v->err = XM_ERR_OPEN;
+        return 1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return 0;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return 0;
+
+    void *base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!base)
+        return 0;
+
+    v->base = base;
+    v->data = base;
+    v->size = (size_t)size.QuadPart;
+    v->map_len = v->size;
+    v->err = XM_OK;
+    return 1;
+}
+
+static void unmap_view(xm_view *v)
+{
+    UnmapViewOfFile(v->base);
+}
+#else
+// Returns 0 if the caller should fall back to stdio for this file.
+static int load_mmap(const char *dir, xm_view *v)
+{
+    char path[768];
+    if (xm_file_path(dir, v->index, path, sizeof(path)) != XM_OK)
+        return 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        v->err = XM_ERR_OPEN;
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return 0;
+
+    v->base = base;
+    v->data = base;
+    v->size = (size_t)st.st_size;
+    v->map_len = v->size;
+    v->err = XM_OK;
+    return 1;
+}
+
+static void unmap_view(xm_view *v)
+{
+    munmap(v->base, v->map_len);
+}
+#endif
+
+// -------------------------------------------------------------------
+// io_uring: open every file, then submit all reads in one batch
+// -------------------------------------------------------------------
+#if defined(XM_HAVE_IO_URING)
+typedef struct uring
+{
+    int fd;
+    unsigned sq_entries;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_sqe *sqes;
+    void *sq_ring;
+    size_t sq_ring_len;
+    void *cq_ring;
+    size_t cq_ring_len;
+    size_t sqes_len;
+} uring;
+
+static int uring_init(uring *r, unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0)
+        return -1;
+
+    r->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && r->cq_ring_len > r->sq_ring_len)
+        r->sq_ring_len = r->cq_ring_len;
+
+    r->sq_ring = mmap(NULL, r->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED)
+        goto fail;
+
+    if (single)
+    {
+        r->cq_ring = r->sq_ring;
+        r->cq_ring_len = 0;
+    }
+    else
+    {
+        r->cq_ring = mmap(NULL, r->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED)
+            goto fail;
+    }
+
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+        goto fail;
+
+    char *sq = r->sq_ring;
+    char *cq = r->cq_ring;
+    r->sq_entries = p.sq_entries;
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    if (r->sq_ring && r->sq_ring != MAP_FAILED)
+        munmap(r->sq_ring, r->sq_ring_len);
+    if (r->cq_ring && r->cq_ring != MAP_FAILED && r->cq_ring_len)
+        munmap(r->cq_ring, r->cq_ring_len);
+    close(r->fd);
+    return -1;
+}
+
+static void uring_free(uring *r)
+{
+    munmap(r->sqes, r->sqes_len);
+    if (r->cq_ring_len)
+        munmap(r->cq_ring, r->cq_ring_len);
+    munmap(r->sq_ring, r->sq_ring_len);
+    close(r->fd);
+}
+
+static int uring_enter(uring *r, unsigned submit, unsigned wait)
+{
+    return (int)syscall(__NR_io_uring_enter, r->fd, submit, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+// Completes a short or failed read synchronously.
+static void finish_with_pread(int fd, xm_view *v, size_t done)
+{
+    while (done < v->size)
+    {
+        ssize_t n = pread(fd, (uint8_t *)v->base + done, v->size - done, (off_t)done);
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+    v->size = done;
+}
+
+static int load_uring(const char *dir, xm_view *views, int count)
+{
+    unsigned entries = 1;
+    while (entries < (unsigned)count && entries < 4096)
+        entries <<= 1;
+
+    uring r;
+    if (uring_init(&r, entries) != 0)
+        return 0;
+
+    int *fds = malloc(sizeof(int) * (size_t)count);
+    if (!fds)
+    {
+        uring_free(&r);
+        return 0;
+    }
+
+    // Open and size everything first so the reads can go out as one batch
+    for (int i = 0; i < count; i++)
+    {
+        xm_view *v = &views[i];
+        char path[768];
+        struct stat st;
+
+        fds[i] = -1;
+        v->err = XM_ERR_OPEN;
+        if (xm_file_path(dir, v->index, path, sizeof(path)) != XM_OK)
+            continue;
+
+        fds[i] = open(path, O_RDONLY);
+        if (fds[i] < 0)
+            continue;
+        if (fstat(fds[i], &st) != 0)
+        {
+            v->err = XM_ERR_READ;
+            continue;
+        }
+        if ((v->base = malloc((size_t)st.st_size + 1)) == NULL)
+        {
+            v->err = XM_ERR_NOMEM;
+            continue;
+        }
+        v->data = v->base;
+        v->size = (size_t)st.st_size;
+        v->owned = 1;
+        v->err = XM_OK;
+    }
+
+    int next = 0;
+    while (next < count)
+    {
+        unsigned tail = *r.sq_tail;
+        unsigned queued = 0;
+        while (next < count && queued < r.sq_entries)
+        {
+            xm_view *v = &views[next];
+            if (v->err == XM_OK && v->size > 0)
+            {
+                unsigned slot = (tail + queued) & *r.sq_mask;
+                struct io_uring_sqe *sqe = &r.sqes[slot];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = fds[next];
+                sqe->addr = (uint64_t)(uintptr_t)v->base;
+                sqe->len = (uint32_t)v->size;
+                sqe->off = 0;
+                sqe->user_data = (uint64_t)next;
+                r.sq_array[slot] = slot;
+                queued++;
+            }
+            next++;
+        }
+        __atomic_store_n(r.sq_tail, tail + queued, __ATOMIC_RELEASE);
+
+        unsigned completed = 0;
+        unsigned submitted = queued;
+        while (completed < queued)
+        {
+            if (uring_enter(&r, submitted, 1) < 0 && errno != EINTR)
+                break;
+            submitted = 0;
+
+            unsigned head = *r.cq_head;
+            unsigned cq_tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != cq_tail; head++, completed++)
+            {
+                struct io_uring_cqe *cqe = &r.cqes[head & *r.cq_mask];
+                int i = (int)cqe->user_data;
+                size_t done = cqe->res > 0 ? (size_t)cqe->res : 0;
+                if (done < views[i].size)
+                    finish_with_pread(fds[i], &views[i], done);
+            }
+            __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        if (completed < queued)
+        {
+            // The ring failed mid-batch; read whatever is left synchronously
+            for (int i = 0; i < next; i++)
+                if (fds[i] >= 0 && views[i].err == XM_OK)
+                    finish_with_pread(fds[i], &views[i], 0);
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+        if (fds[i] >= 0)
+            close(fds[i]);
+    free(fds);
+    uring_free(&r);
+    return 1;
+}
+#endif
+
+// -------------------------------------------------------------------
+// Public entry points
+// -------------------------------------------------------------------
+static void count_loaded(const xm_view *views, int count)
+{
+    long long files = 0, bytes = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (views[i].data)
+        {
+            files++;
+            bytes += (long long)views[i].size;
+        }
+    }
+    XM_COUNT(XM_CTR_FILES_OPENED, files);
+    XM_COUNT(XM_CTR_BYTES_READ, bytes);
+}
+
+xm_io_backend xm_io_load(xm_io_backend backend, const char *dir, xm_view *views, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        views[i].data = NULL;
+        views[i].size = 0;
+        views[i].err = XM_ERR_OPEN;
+        views[i].base = NULL;
+        views[i].map_len = 0;
+        views[i].owned = 0;
+    }
+
+#if defined(XM_HAVE_IO_URING)
+    if (backend == XM_IO_URING && load_uring(dir, views, count))
+    {
+        count_loaded(views, count);
+        return XM_IO_URING;
+    }
+#endif
+    if (backend == XM_IO_URING)
+        backend = XM_IO_STDIO;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (backend == XM_IO_MMAP && load_mmap(dir, &views[i]))
+            continue;
+        load_stdio(dir, &views[i]);
+    }
+    count_loaded(views, count);
+    return backend;
+}
+
+void xm_io_release(xm_view *views, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        xm_view *v = &views[i];
+        if (v->owned)
+            xm_free(v->base);
+        else if (v->base)
+            unmap_view(v);
+        v->base = NULL;
+        v->data = NULL;
+        v->size = 0;
+    }
+}
+
+// -------------------------------------------------------------------
+// Whole-file copies
+// -------------------------------------------------------------------
+int xm_clone_file(const char *src, const char *dst, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    return CopyFileA(src, dst, FALSE) ? XM_OK : XM_ERR_WRITE;
+#elif defined(XM_HAVE_FICLONE) || defined(XM_HAVE_COPY_FILE_RANGE)
+    int in = open(src, O_RDONLY);
+    if (in < 0)
+        return XM_ERR_OPEN;
+    int out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int err = XM_ERR_WRITE;
+    if (out >= 0)
+    {
+#if defined(XM_HAVE_FICLONE)
+        if (ioctl(out, FICLONE, in) == 0)
+            err = XM_OK;
+#endif
+#if defined(XM_HAVE_COPY_FILE_RANGE)
+        size_t left = size;
+        while (err != XM_OK && left > 0)
+        {
+            ssize_t n = copy_file_range(in, NULL, out, NULL, left, 0);
+            if (n <= 0)
+                break;
+            left -= (size_t)n;
+        }
+        if (left == 0)
+            err = XM_OK;
+#endif
+        close(out);
+    }
+    close(in);
+    return err;
+#else
+    (void)src;
+    (void)dst;
+    (void)size;
+    return XM_ERR_WRITE;
+#endif
+}
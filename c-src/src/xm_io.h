@@ -0,0 +1,74 @@
+#ifndef XM_IO_H
+#define XM_IO_H
+
+/**
+ * Bulk loading of a character folder's mcr*.dat files.
+ *
+ * xm_scan_macro_dir() enumerates the folder once to find which files exist,
+ * then xm_io_load() brings them all into memory through one of several
+ * backends:
+ *
+ *   XM_IO_MMAP   map each file read-only (default)
+ *   XM_IO_URING  one batched io_uring submission for all reads (Linux)
+ *   XM_IO_STDIO  fopen/fread per file, as the tools always did
+ *
+ * Backends that aren't available fall back to XM_IO_STDIO.
+ */
+
+#include "ximacro.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum xm_io_backend
+{
+    XM_IO_MMAP = 0,
+    XM_IO_URING,
+    XM_IO_STDIO
+} xm_io_backend;
+
+typedef struct xm_view
+{
+    int index;           // file index: 0 = mcr.dat, N = mcrN.dat
+    const uint8_t *data; // NULL if the file could not be loaded
+    size_t size;
+    int err; // XM_OK or an XM_ERR_* code
+
+    // backend-private
+    void *base;
+    size_t map_len;
+    int owned;
+} xm_view;
+
+XM_API int xm_io_parse_backend(const char *name, xm_io_backend *out);
+XM_API const char *xm_io_backend_name(xm_io_backend backend);
+
+/**
+ * Marks present[i] for every mcr*.dat found in 'dir' with a single directory
+ * enumeration. Returns the number found or a negative XM_ERR_* code.
+ */
+XM_API int xm_scan_macro_dir(const char *dir, uint8_t present[XM_FILE_COUNT]);
+
+/**
+ * Loads 'count' files of 'dir' into 'views' (views[i].index must be set).
+ * Returns the backend actually used. Release with xm_io_release().
+ */
+XM_API xm_io_backend xm_io_load(xm_io_backend backend, const char *dir, xm_view *views, int count);
+
+XM_API void xm_io_release(xm_view *views, int count);
+
+/**
+ * Makes 'dst' a copy of 'src', which is 'size' bytes long, without passing
+ * the bytes through user space: a reflink (FICLONE) where the filesystem shares
+ * blocks, else copy_file_range(), or CopyFile() on Windows. XM_ERR_WRITE
+ * when none is available; the caller then writes the bytes itself.
+ */
+XM_API int xm_clone_file(const char *src, const char *dst, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_IO_H
@@ -0,0 +1,56 @@
+#ifndef XM_SIMD_H
+#define XM_SIMD_H
+
+/**
+ * SSE2 / AVX2 availability for the vectorized scans of libximacro.
+ * Internal to the library; not installed.
+ */
+
+// SSE2 is part of every x86-64 target; AVX2 is picked at run time
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define XM_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(XM_HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XM_HAVE_AVX2 1
+#define XM_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+static inline int xm_cpu_has_avx2(void)
+{
+    return __builtin_cpu_supports("avx2");
+}
+#elif defined(XM_HAVE_SSE2) && defined(_MSC_VER)
+#define XM_HAVE_AVX2 1
+#define XM_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+static inline int xm_cpu_has_avx2(void)
+{
+    static volatile int cached = -1;
+    if (cached < 0)
+    {
+        int regs[4];
+        __cpuid(regs, 1);
+        int avx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(regs, 7, 0);
+        cached = avx && (regs[1] & (1 << 5));
+    }
+    return cached;
+}
+#endif
+
+#if defined(XM_HAVE_SSE2)
+static inline int xm_ctz(int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, (unsigned long)mask);
+    return (int)index;
+#else
+    return __builtin_ctz((unsigned)mask);
+#endif
+}
+#endif
+
+#endif // XM_SIMD_H
@@ -0,0 +1,519 @@
+#include "xm_store.h"
+#include "xm_io.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include "./vendor/dirent/dirent.h"
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define MANIFEST_MAGIC "xmstore 1"
+
+typedef struct
+{
+    char *path;
+    char before[33];
+    char after[33];
+    int forgotten;
+} save_file;
+
+struct xm_store_save
+{
+    char *root;
+    save_file *files;
+    int count;
+    int cap;
+};
+
+static int join(char *out, size_t cap, const char *a, const char *b)
+{
+    int n = snprintf(out, cap, "%s/%s", a, b);
+    return (n < 0 || (size_t)n >= cap) ? XM_ERR_RANGE : XM_OK;
+}
+
+static int ensure_dirs(const char *root, const char *sub, const char *sub2)
+{
+    char path[1024];
+    int err = xm_ensure_dir(root);
+    if (err == XM_OK && sub && (err = join(path, sizeof(path), root, sub)) == XM_OK)
+        err = xm_ensure_dir(path);
+    if (err == XM_OK && sub2)
+    {
+        size_t len = strlen(path);
+        snprintf(path + len, sizeof(path) - len, "/%s", sub2);
+        err = xm_ensure_dir(path);
+    }
+    return err;
+}
+
+static int object_path(const char *root, const char *key, char *out, size_t cap)
+{
+    int n = snprintf(out, cap, "%s/objects/%.2s/%s", root, key, key);
+    return (n < 0 || (size_t)n >= cap) ? XM_ERR_RANGE : XM_OK;
+}
+
+// -------------------------------------------------------------------
+// Objects
+// -------------------------------------------------------------------
+
+// The file may have changed since it was read; only keep a clone whose
+// contents still hash to 'key'.
+static int clone_matches(const char *path, const char *key)
+{
+    uint8_t *data;
+    size_t size;
+    if (xm_read_file(path, &data, &size) != XM_OK)
+        return 0;
+
+    uint64_t hash[2];
+    char hex[33];
+    xm_hash128(data, size, hash);
+    xm_hash128_hex(hash, hex);
+    xm_free(data);
+    return strcmp(hex, key) == 0;
+}
+
+/**
+ * Stores 'data' under its key unless already present. 'clone_from' names a
+ * file expected to hold the same bytes, to copy from instead.
+ */
+static int put_object(const char *root, const uint8_t *data, size_t size,
+                      const char *clone_from, char key[33])
+{
+    uint64_t hash[2];
+    xm_hash128(data, size, hash);
+    xm_hash128_hex(hash, key);
+
+    char path[1024];
+    char temp[1024 + 8];
+    int err = object_path(root, key, path, sizeof(path));
+    if (err != XM_OK)
+        return err;
+
+    struct stat st;
+    if (stat(path, &st) == 0 && (size_t)st.st_size == size)
+        return XM_OK; // already stored
+
+    char sub[3] = {key[0], key[1], '\0'};
+    if ((err = ensure_dirs(root, "objects", sub)) != XM_OK)
+        return err;
+
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    if (!clone_from || xm_clone_file(clone_from, temp, size) != XM_OK || !clone_matches(temp, key))
+        err = xm_write_file(temp, data, size);
+    if (err == XM_OK && rename(temp, path) != 0)
+    {
+        // lost a race to store the same object
+        err = stat(path, &st) == 0 ? XM_OK : XM_ERR_WRITE;
+        remove(temp);
+    }
+    return err;
+}
+
+// -------------------------------------------------------------------
+// Manifests
+// -------------------------------------------------------------------
+typedef void (*manifest_fn)(void *ctx, const char *before, const char *after, const char *path);
+
+/**
+ * Reads a manifest, calling 'fn' per file. Returns the number of files, or
+ * XM_ERR_FORMAT for a manifest cut short (no "end" line).
+ */
+static int read_manifest(const char *path, long long *time_out, manifest_fn fn, void *ctx)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return XM_ERR_OPEN;
+
+    char line[1200];
+    int files = 0;
+    int ended = 0;
+    int valid = fgets(line, sizeof(line), fp) && strncmp(line, MANIFEST_MAGIC, strlen(MANIFEST_MAGIC)) == 0;
+    *time_out = 0;
+
+    while (valid && !ended && fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "time ", 5) == 0)
+            *time_out = strtoll(line + 5, NULL, 10);
+        else if (strcmp(line, "end") == 0)
+            ended = 1;
+        else if (strncmp(line, "file ", 5) == 0 && strlen(line) > 5 + 33 + 33)
+        {
+            // file <before> <after> <path>
+            line[5 + 32] = '\0';
+            line[5 + 33 + 32] = '\0';
+            if (fn)
+                fn(ctx, line + 5, line + 5 + 33, line + 5 + 66);
+            files++;
+        }
+    }
+    fclose(fp);
+    return valid && ended ? files : XM_ERR_FORMAT;
+}
+
+xm_store_save *xm_store_save_begin(const char *root)
+{
+    xm_store_save *save = calloc(1, sizeof(*save));
+    if (!save)
+        return NULL;
+    size_t n = strlen(root) + 1;
+    save->root = malloc(n);
+    if (!save->root)
+    {
+        free(save);
+        return NULL;
+    }
+    memcpy(save->root, root, n);
+    return save;
+}
+
+static save_file *find_save_file(xm_store_save *save, const char *path)
+{
+    for (int i = 0; i < save->count; i++)
+    {
+        if (strcmp(save->files[i].path, path) == 0)
+            return &save->files[i];
+    }
+    return NULL;
+}
+
+int xm_store_save_add(xm_store_save *save, const char *path,
+                      const uint8_t *before, size_t before_size,
+                      const uint8_t *after, size_t after_size)
+{
+    save_file *f = find_save_file(save, path);
+    if (f)
+        return put_object(save->root, after, after_size, NULL, f->after);
+
+    if (save->count == save->cap)
+    {
+        int cap = save->cap ? save->cap * 2 : 16;
+        save_file *grown = realloc(save->files, (size_t)cap * sizeof(*grown));
+        if (!grown)
+            return XM_ERR_NOMEM;
+        save->files = grown;
+        save->cap = cap;
+    }
+
+    f = &save->files[save->count];
+    memset(f, 0, sizeof(*f));
+    size_t n = strlen(path) + 1;
+    if (!(f->path = malloc(n)))
+        return XM_ERR_NOMEM;
+    memcpy(f->path, path, n);
+
+    int err = put_object(save->root, before, before_size, path, f->before);
+    if (err == XM_OK)
+        err = put_object(save->root, after, after_size, NULL, f->after);
+    if (err != XM_OK)
+    {
+        free(f->path);
+        return err;
+    }
+    save->count++;
+    return XM_OK;
+}
+
+void xm_store_save_forget(xm_store_save *save, const char *path)
+{
+    save_file *f = find_save_file(save, path);
+    if (f)
+        f->forgotten = 1;
+}
+
+int xm_store_save_commit(xm_store_save *save, char id[XM_STORE_ID_SIZE])
+{
+    id[0] = '\0';
+    int files = 0;
+    for (int i = 0; i < save->count; i++)
+        files += !save->files[i].forgotten;
+    if (files == 0)
+        return XM_OK;
+
+    int err = ensure_dirs(save->root, "manifests", NULL);
+    if (err != XM_OK)
+        return err;
+
+    // Claim the first free sequence number for this second
+    long long now = (long long)time(NULL);
+    char path[1024];
+    FILE *fp = NULL;
+    for (int seq = 0; seq < 1000 && !fp; seq++)
+    {
+        snprintf(id, XM_STORE_ID_SIZE, "%010lld-%03d", now, seq);
+        snprintf(path, sizeof(path), "%s/manifests/%s.txt", save->root, id);
+        fp = fopen(path, "wx");
+    }
+    if (!fp)
+    {
+        id[0] = '\0';
+        return XM_ERR_OPEN;
+    }
+
+    fprintf(fp, MANIFEST_MAGIC "\ntime %lld\n", now);
+    for (int i = 0; i < save->count; i++)
+    {
+        const save_file *f = &save->files[i];
+        if (!f->forgotten)
+            fprintf(fp, "file %s %s %s\n", f->before, f->after, f->path);
+    }
+    fputs("end\n", fp);
+    if (fclose(fp) != 0)
+    {
+        remove(path);
+        id[0] = '\0';
+        return XM_ERR_WRITE;
+    }
+    return XM_OK;
+}
+
+void xm_store_save_free(xm_store_save *save)
+{
+    if (!save)
+        return;
+    for (int i = 0; i < save->count; i++)
+        free(save->files[i].path);
+    free(save->files);
+    free(save->root);
+    free(save);
+}
+
+// -------------------------------------------------------------------
+// Listing, restore and pruning
+// -------------------------------------------------------------------
+static int compare_entries(const void *a, const void *b)
+{
+    return strcmp(((const xm_store_entry *)a)->id, ((const xm_store_entry *)b)->id);
+}
+
+int xm_store_list(const char *root, xm_store_entry **entries, int *count)
+{
+    *entries = NULL;
+    *count = 0;
+
+    char dir[1024];
+    int err = join(dir, sizeof(dir), root, "manifests");
+    if (err != XM_OK)
+        return err;
+    DIR *dp = opendir(dir);
+    if (!dp)
+        return XM_OK; // no saves yet
+
+    int cap = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL)
+    {
+        size_t len = strlen(entry->d_name);
+        if (len < 5 || len - 4 >= XM_STORE_ID_SIZE || strcmp(entry->d_name + len - 4, ".txt") != 0)
+            continue;
+
+        char path[1024 + 256];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        long long t;
+        int files = read_manifest(path, &t, NULL, NULL);
+        if (files < 0)
+            continue;
+
+        if (*count == cap)
+        {
+            cap = cap ? cap * 2 : 32;
+            xm_store_entry *grown = realloc(*entries, (size_t)cap * sizeof(*grown));
+            if (!grown)
+            {
+                err = XM_ERR_NOMEM;
+                break;
+            }
+            *entries = grown;
+        }
+        xm_store_entry *e = &(*entries)[(*count)++];
+        memcpy(e->id, entry->d_name, len - 4);
+        e->id[len - 4] = '\0';
+        e->time = t;
+        e->files = files;
+    }
+    closedir(dp);
+
+    if (*count > 1)
+        qsort(*entries, *count, sizeof(**entries), compare_entries);
+    return err;
+}
+
+typedef struct
+{
+    const char *root;
+    int before;
+    xm_txn *txn;
+    int staged;
+    int err;
+} restore_ctx;
+
+static void restore_file(void *ctx, const char *before, const char *after, const char *path)
+{
+    restore_ctx *rc = ctx;
+    const char *key = rc->before ? before : after;
+    if (rc->err != XM_OK)
+        return;
+
+    char obj[1024];
+    uint8_t *data;
+    size_t size;
+    if ((rc->err = object_path(rc->root, key, obj, sizeof(obj))) != XM_OK ||
+        (rc->err = xm_read_file(obj, &data, &size)) != XM_OK)
+        return;
+
+    uint64_t hash[2];
+    char hex[33];
+    xm_hash128(data, size, hash);
+    xm_hash128_hex(hash, hex);
+    if (strcmp(hex, key) != 0)
+    {
+        xm_free(data);
+        rc->err = XM_ERR_FORMAT; // damaged object
+        return;
+    }
+
+    uint8_t *current = NULL;
+    size_t current_size = 0;
+    xm_read_file(path, &current, &current_size); // may not exist any more
+    rc->err = xm_txn_stage(rc->txn, path, current, current_size, data, size);
+    xm_free(current);
+    xm_free(data);
+    rc->staged += rc->err == XM_OK;
+}
+
+int xm_store_restore(const char *root, const char *id, int before, xm_txn *txn)
+{
+    char path[1024];
+    int n = snprintf(path, sizeof(path), "%s/manifests/%s.txt", root, id);
+    if (n < 0 || (size_t)n >= sizeof(path) || strpbrk(id, "/\\"))
+        return XM_ERR_RANGE;
+
+    restore_ctx rc = {root, before, txn, 0, XM_OK};
+    long long t;
+    int files = read_manifest(path, &t, restore_file, &rc);
+    if (files < 0)
+        return files;
+    return rc.err == XM_OK ? rc.staged : rc.err;
+}
+
+typedef struct
+{
+    char (*keys)[33];
+    size_t count;
+    size_t cap;
+    int failed;
+} key_set;
+
+static void collect_keys(void *ctx, const char *before, const char *after, const char *path)
+{
+    key_set *set = ctx;
+    (void)path;
+    if (set->count + 2 > set->cap)
+    {
+        size_t cap = set->cap ? set->cap * 2 : 256;
+        char(*grown)[33] = realloc(set->keys, cap * sizeof(*grown));
+        if (!grown)
+        {
+            set->failed = 1;
+            return;
+        }
+        set->keys = grown;
+        set->cap = cap;
+    }
+    memcpy(set->keys[set->count++], before, 33);
+    memcpy(set->keys[set->count++], after, 33);
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+int xm_store_prune(const char *root, int keep, long long max_age,
+                   int *removed_saves, int *removed_objects)
+{
+    *removed_saves = 0;
+    *removed_objects = 0;
+
+    xm_store_entry *entries;
+    int count;
+    int err = xm_store_list(root, &entries, &count);
+    if (err != XM_OK)
+    {
+        xm_free(entries);
+        return err;
+    }
+
+    // Drop manifests first, collecting the keys of the ones that stay
+    long long now = (long long)time(NULL);
+    key_set live = {0};
+    char path[1024];
+    for (int i = 0; i < count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/manifests/%s.txt", root, entries[i].id);
+        int drop = (keep >= 0 && i < count - keep) || (max_age >= 0 && entries[i].time < now - max_age);
+        if (drop)
+        {
+            if (remove(path) == 0)
+                (*removed_saves)++;
+            continue;
+        }
+        long long t;
+        read_manifest(path, &t, collect_keys, &live);
+    }
+    xm_free(entries);
+    if (live.failed)
+    {
+        free(live.keys);
+        return XM_ERR_NOMEM;
+    }
+    if (live.count > 1)
+        qsort(live.keys, live.count, sizeof(*live.keys), compare_keys);
+
+    // Then sweep objects no manifest references
+    char objects[1024];
+    if (join(objects, sizeof(objects), root, "objects") == XM_OK)
+    {
+        DIR *top = opendir(objects);
+        struct dirent *sub;
+        while (top && (sub = readdir(top)) != NULL)
+        {
+            // Two hex digits; ".." would sweep the store root, journal and all
+            if (strlen(sub->d_name) != 2 || sub->d_name[0] == '.')
+                continue;
+            char subdir[1024 + 260];
+            snprintf(subdir, sizeof(subdir), "%s/%s", objects, sub->d_name);
+            DIR *dp = opendir(subdir);
+            struct dirent *obj;
+            while (dp && (obj = readdir(dp)) != NULL)
+            {
+                if (obj->d_name[0] == '.')
+                    continue;
+                if (strlen(obj->d_name) == 32 &&
+                    bsearch(obj->d_name, live.keys, live.count, sizeof(*live.keys), compare_keys))
+                    continue;
+                char file[1024 + 520];
+                snprintf(file, sizeof(file), "%s/%s", subdir, obj->d_name);
+                if (remove(file) == 0)
+                    (*removed_objects)++;
+            }
+            if (dp)
+                closedir(dp);
+        }
+        if (top)
+            closedir(top);
+    }
+
+    free(live.keys);
+    return XM_OK;
+}
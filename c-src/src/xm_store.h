@@ -0,0 +1,89 @@
+#ifndef XM_STORE_H
+#define XM_STORE_H
+
+/**
+ * Content-addressed backup store for mcr*.dat saves.
+ *
+ *   <root>/objects/<k0k1>/<key>   file contents, named by xm_hash128_hex()
+ *   <root>/manifests/<id>.txt     one per save: the before/after key of
+ *                                 every file it published
+ *
+ * Contents are stored once however many saves reference them, so backing
+ * up an unchanged file costs a hash and a stat. New objects are cloned
+ * (FICLONE) or copied in-kernel (copy_file_range) from the file on disk
+ * where the platform allows, else written from memory.
+ *
+ * Save ids sort by time: "<unix seconds, 10 digits>-<seq, 3 digits>".
+ */
+
+#include "ximacro.h"
+#include "xm_txn.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define XM_STORE_ROOT "macro_backup"
+#define XM_STORE_ID_SIZE 32
+
+typedef struct xm_store_save xm_store_save;
+
+typedef struct xm_store_entry
+{
+    char id[XM_STORE_ID_SIZE];
+    long long time; // unix seconds
+    int files;
+} xm_store_entry;
+
+/**
+ * Starts recording a save into the store at 'root'. NULL when out of memory.
+ */
+XM_API xm_store_save *xm_store_save_begin(const char *root);
+
+/**
+ * Stores the contents of 'path' before and after the save. 'before' must
+ * be what is on disk now. Adding a path again replaces its 'after' only.
+ */
+XM_API int xm_store_save_add(xm_store_save *save, const char *path,
+                             const uint8_t *before, size_t before_size,
+                             const uint8_t *after, size_t after_size);
+
+/**
+ * Leaves 'path' out of the manifest (e.g. its write failed).
+ */
+XM_API void xm_store_save_forget(xm_store_save *save, const char *path);
+
+/**
+ * Writes the manifest, if any file was added, and copies its id to 'id'
+ * ("" if none). Does not free 'save'.
+ */
+XM_API int xm_store_save_commit(xm_store_save *save, char id[XM_STORE_ID_SIZE]);
+
+XM_API void xm_store_save_free(xm_store_save *save);
+
+/**
+ * Lists saves oldest first. Release '*entries' with xm_free().
+ */
+XM_API int xm_store_list(const char *root, xm_store_entry **entries, int *count);
+
+/**
+ * Stages every file of save 'id' into 'txn' as it was after that save, or
+ * before it with 'before' set. Returns the number of files staged or a
+ * negative XM_ERR_* code.
+ */
+XM_API int xm_store_restore(const char *root, const char *id, int before, xm_txn *txn);
+
+/**
+ * Drops all but the newest 'keep' saves (keep < 0: no limit) and saves
+ * older than 'max_age' seconds (max_age < 0: no limit), then deletes
+ * objects no remaining save references.
+ */
+XM_API int xm_store_prune(const char *root, int keep, long long max_age,
+                          int *removed_saves, int *removed_objects);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_STORE_H
@@ -0,0 +1,509 @@
+#include "xm_text.h"
+#include "xm_simd.h"
+#include "xm_text_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define AT_MARK 0xFD
+#define AT_SIZE 6
+
+#define HALFWIDTH_FIRST 0xA1 // U+FF61 .. U+FF9F, one byte each
+#define HALFWIDTH_LAST 0xDF
+#define HALFWIDTH_UCS 0xFF61
+
+// Most text one byte decodes to: {xHH}, or \u00XX for a control in JSON
+#define MAX_TEXT_PER_BYTE 6
+
+static const char HEX[] = "0123456789ABCDEF";
+
+static int is_lead(uint8_t c)
+{
+    return (c >= 0x81 && c <= 0x9F) || (c >= 0xE0 && c <= 0xFC);
+}
+
+static unsigned pair_char(uint8_t lead, uint8_t trail)
+{
+    if (trail < SJIS_TRAIL_FIRST || trail - SJIS_TRAIL_FIRST >= SJIS_TRAILS)
+        return 0;
+    int row = lead <= 0x9F ? lead - 0x81 : lead - 0xE0 + (0x9F - 0x81 + 1);
+    return SJIS_TO_UCS[row][trail - SJIS_TRAIL_FIRST];
+}
+
+size_t xm_text_unit(const uint8_t *src, size_t len)
+{
+    if (len >= AT_SIZE && src[0] == AT_MARK && src[AT_SIZE - 1] == AT_MARK)
+        return AT_SIZE;
+    if (len >= 2 && is_lead(src[0]))
+        return 2;
+    return 1;
+}
+
+// -------------------------------------------------------------------
+// Tokens
+// -------------------------------------------------------------------
+static int hex_digit(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Length of the {AT:HHHHHHHH} or {xHH} token at the start of 'p' ('n'
+ * bytes), or 0 if there isn't one; its bytes go to 'bytes'. A token never
+ * stands for a NUL, which would end the field.
+ */
+static size_t parse_token(const uint8_t *p, size_t n, uint8_t bytes[AT_SIZE], size_t *count)
+{
+    const uint8_t *hex;
+    size_t digits;
+    if (n >= 5 && p[0] == '{' && p[1] == 'x')
+    {
+        hex = p + 2;
+        digits = 2;
+    }
+    else if (n >= 13 && memcmp(p, "{AT:", 4) == 0)
+    {
+        hex = p + 4;
+        digits = 8;
+    }
+    else
+    {
+        return 0;
+    }
+    if (hex[digits] != '}')
+        return 0;
+
+    uint8_t *dst = digits == 2 ? bytes : bytes + 1;
+    for (size_t i = 0; i < digits; i += 2)
+    {
+        int hi = hex_digit(hex[i]);
+        int lo = hex_digit(hex[i + 1]);
+        if (hi < 0 || lo < 0 || (hi | lo) == 0)
+            return 0;
+        dst[i / 2] = (uint8_t)((hi << 4) | lo);
+    }
+
+    if (digits == 2)
+    {
+        *count = 1;
+    }
+    else
+    {
+        bytes[0] = bytes[AT_SIZE - 1] = AT_MARK;
+        *count = AT_SIZE;
+    }
+    return (size_t)(hex + digits + 1 - p);
+}
+
+// -------------------------------------------------------------------
+// ASCII runs
+// -------------------------------------------------------------------
+// A run that can be copied as-is ends at a byte below 'lo' (compared
+// signed, so 0x80 and up as well), above 'hi', or one of 'stop'.
+typedef struct
+{
+    int8_t lo;
+    int8_t hi;
+    uint8_t stop[3];
+} run_set;
+
+// Plain text, either way: NUL, anything non-ASCII, and '{' (for tokens)
+static const run_set TEXT_RUN = {0x01, 0x7F, {'{', '{', '{'}};
+
+// Decoding to JSON: controls, '"' and '\' as well
+static const run_set JSON_RUN = {0x20, 0x7E, {'"', '\\', '{'}};
+
+static size_t run_scalar(const run_set *s, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+    while (i < n && (int8_t)src[i] >= s->lo && (int8_t)src[i] <= s->hi && src[i] != s->stop[0] &&
+           src[i] != s->stop[1] && src[i] != s->stop[2])
+        i++;
+    return i;
+}
+
+#if defined(XM_HAVE_SSE2)
+static size_t run_sse2(const run_set *s, const uint8_t *src, size_t n)
+{
+    const __m128i lo = _mm_set1_epi8(s->lo);
+    const __m128i hi = _mm_set1_epi8(s->hi);
+    const __m128i a = _mm_set1_epi8((char)s->stop[0]);
+    const __m128i b = _mm_set1_epi8((char)s->stop[1]);
+    const __m128i c = _mm_set1_epi8((char)s->stop[2]);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i bad = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi8(v, lo), _mm_cmpgt_epi8(v, hi)),
+                                   _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, b)),
+                                                _mm_cmpeq_epi8(v, c)));
+        int mask = _mm_movemask_epi8(bad);
+        if (mask)
+            return i + (size_t)xm_ctz(mask);
+    }
+    return i + run_scalar(s, src + i, n - i);
+}
+#endif
+
+#if defined(XM_HAVE_AVX2)
+XM_TARGET_AVX2 static size_t run_avx2(const run_set *s, const uint8_t *src, size_t n)
+{
+    const __m256i lo = _mm256_set1_epi8(s->lo);
+    const __m256i hi = _mm256_set1_epi8(s->hi);
+    const __m256i a = _mm256_set1_epi8((char)s->stop[0]);
+    const __m256i b = _mm256_set1_epi8((char)s->stop[1]);
+    const __m256i c = _mm256_set1_epi8((char)s->stop[2]);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i bad = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi8(lo, v), _mm256_cmpgt_epi8(v, hi)),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, a), _mm256_cmpeq_epi8(v, b)),
+                            _mm256_cmpeq_epi8(v, c)));
+        int mask = _mm256_movemask_epi8(bad);
+        if (mask)
+            return i + (size_t)xm_ctz(mask);
+    }
+    return i + run_sse2(s, src + i, n - i);
+}
+#endif
+
+static size_t ascii_run(const run_set *s, const uint8_t *src, size_t n)
+{
+#if defined(XM_HAVE_AVX2)
+    if (n >= 32 && xm_cpu_has_avx2())
+        return run_avx2(s, src, n);
+#endif
+#if defined(XM_HAVE_SSE2)
+    return run_sse2(s, src, n);
+#else
+    return run_scalar(s, src, n);
+#endif
+}
+
+// -------------------------------------------------------------------
+// Decoding
+// -------------------------------------------------------------------
+static char *put_byte_token(char *out, uint8_t c)
+{
+    *out++ = '{';
+    *out++ = 'x';
+    *out++ = HEX[c >> 4];
+    *out++ = HEX[c & 0x0F];
+    *out++ = '}';
+    return out;
+}
+
+static char *put_utf8(char *out, unsigned cp)
+{
+    if (cp < 0x800)
+    {
+        *out++ = (char)(0xC0 | (cp >> 6));
+    }
+    else
+    {
+        *out++ = (char)(0xE0 | (cp >> 12));
+        *out++ = (char)(0x80 | ((cp >> 6) & 0x3F));
+    }
+    *out++ = (char)(0x80 | (cp & 0x3F));
+    return out;
+}
+
+// The escapes of xm_json_escape()
+static char *put_json_escape(char *out, uint8_t c)
+{
+    *out++ = '\\';
+    switch (c)
+    {
+    case '"':
+    case '\\':
+        *out++ = (char)c;
+        break;
+    case '\b':
+        *out++ = 'b';
+        break;
+    case '\f':
+        *out++ = 'f';
+        break;
+    case '\n':
+        *out++ = 'n';
+        break;
+    case '\r':
+        *out++ = 'r';
+        break;
+    case '\t':
+        *out++ = 't';
+        break;
+    default:
+        *out++ = 'u';
+        *out++ = '0';
+        *out++ = '0';
+        *out++ = HEX[c >> 4];
+        *out++ = HEX[c & 0x0F];
+    }
+    return out;
+}
+
+static void decode(xm_buf *b, const uint8_t *src, size_t max_len, int json)
+{
+    const uint8_t *nul = memchr(src, '\0', max_len);
+    size_t len = nul ? (size_t)(nul - src) : max_len;
+    if (len > (SIZE_MAX - 1) / MAX_TEXT_PER_BYTE || xm_buf_reserve(b, len * MAX_TEXT_PER_BYTE) != XM_OK)
+        return;
+    char *out = b->data + b->len;
+    const run_set *set = json ? &JSON_RUN : &TEXT_RUN;
+
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t run = ascii_run(set, src + i, len - i);
+        memcpy(out, src + i, run);
+        out += run;
+        i += run;
+        if (i >= len)
+            break;
+
+        uint8_t c = src[i];
+        if (c == '{')
+        {
+            // Literal text that would read back as a token
+            uint8_t bytes[AT_SIZE];
+            size_t count;
+            if (parse_token(src + i, len - i, bytes, &count))
+                out = put_byte_token(out, c);
+            else
+                *out++ = '{';
+            i++;
+            continue;
+        }
+        if (c < 0x80)
+        {
+            if (json)
+                out = put_json_escape(out, c);
+            else
+                *out++ = (char)c;
+            i++;
+            continue;
+        }
+
+        // Multibyte text comes in runs; stay here until it ends
+        while (i < len && src[i] >= 0x80)
+        {
+            c = src[i];
+            size_t n = xm_text_unit(src + i, len - i);
+            unsigned cp = 0;
+            if (n == AT_SIZE)
+            {
+                memcpy(out, "{AT:", 4);
+                out += 4;
+                for (size_t k = 1; k < AT_SIZE - 1; k++)
+                {
+                    *out++ = HEX[src[i + k] >> 4];
+                    *out++ = HEX[src[i + k] & 0x0F];
+                }
+                *out++ = '}';
+                i += AT_SIZE;
+                continue;
+            }
+            if (n == 2)
+                cp = pair_char(c, src[i + 1]);
+            else if (c >= HALFWIDTH_FIRST && c <= HALFWIDTH_LAST)
+                cp = HALFWIDTH_UCS + (unsigned)(c - HALFWIDTH_FIRST);
+
+            if (cp)
+            {
+                out = put_utf8(out, cp);
+                i += n;
+            }
+            else
+            {
+                out = put_byte_token(out, c);
+                i++;
+            }
+        }
+    }
+    b->len = (size_t)(out - b->data);
+}
+
+void xm_text_decode(xm_buf *b, const uint8_t *src, size_t max_len)
+{
+    decode(b, src, max_len, 0);
+}
+
+void xm_json_text(xm_buf *b, const uint8_t *src, size_t max_len)
+{
+    decode(b, src, max_len, 1);
+}
+
+// -------------------------------------------------------------------
+// Encoding
+// -------------------------------------------------------------------
+// Length of the UTF-8 sequence at 's' and its code point, or 0 if it is
+// malformed, overlong or a surrogate
+static size_t get_utf8(const uint8_t *s, size_t n, unsigned *cp)
+{
+    size_t len;
+    unsigned min;
+    if (s[0] >= 0xC2 && s[0] <= 0xDF)
+    {
+        len = 2;
+        min = 0x80;
+        *cp = s[0] & 0x1Fu;
+    }
+    else if (s[0] >= 0xE0 && s[0] <= 0xEF)
+    {
+        len = 3;
+        min = 0x800;
+        *cp = s[0] & 0x0Fu;
+    }
+    else if (s[0] >= 0xF0 && s[0] <= 0xF4)
+    {
+        len = 4;
+        min = 0x10000;
+        *cp = s[0] & 0x07u;
+    }
+    else
+    {
+        return 0;
+    }
+    if (n < len)
+        return 0;
+
+    for (size_t i = 1; i < len; i++)
+    {
+        if ((s[i] & 0xC0) != 0x80)
+            return 0;
+        *cp = (*cp << 6) | (s[i] & 0x3Fu);
+    }
+    if (*cp < min || *cp > 0x10FFFF || (*cp >= 0xD800 && *cp <= 0xDFFF))
+        return 0;
+    return len;
+}
+
+// Bytes of 'cp' in 'out', or 0 if it has no encoding
+static size_t encode_char(unsigned cp, uint8_t out[2])
+{
+    if (cp >= HALFWIDTH_UCS && cp <= HALFWIDTH_UCS + (HALFWIDTH_LAST - HALFWIDTH_FIRST))
+    {
+        out[0] = (uint8_t)(HALFWIDTH_FIRST + (cp - HALFWIDTH_UCS));
+        return 1;
+    }
+
+    size_t lo = 0;
+    size_t hi = SJIS_PAIRS;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (UCS_TO_SJIS[mid][0] < cp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < SJIS_PAIRS && UCS_TO_SJIS[lo][0] == cp)
+    {
+        out[0] = (uint8_t)(UCS_TO_SJIS[lo][1] >> 8);
+        out[1] = (uint8_t)UCS_TO_SJIS[lo][1];
+        return 2;
+    }
+
+    if (cp < 0x100)
+    {
+        out[0] = (uint8_t)cp;
+        return 1;
+    }
+    return 0;
+}
+
+size_t xm_text_encode(const char *text, size_t len, uint8_t *out, size_t cap, size_t *unmapped)
+{
+    const uint8_t *s = (const uint8_t *)text;
+    size_t i = 0;
+    size_t n = 0;
+    size_t bad = 0;
+    while (i < len && n < cap)
+    {
+        size_t run = ascii_run(&TEXT_RUN, s + i, len - i < cap - n ? len - i : cap - n);
+        memcpy(out + n, s + i, run);
+        n += run;
+        i += run;
+        if (i >= len || n >= cap || s[i] == 0)
+            break;
+
+        uint8_t unit[AT_SIZE];
+        size_t count = 0;
+        size_t used = 0;
+        if (s[i] == '{')
+            used = parse_token(s + i, len - i, unit, &count);
+        if (!used)
+        {
+            unsigned cp = s[i];
+            used = s[i] == '{' ? 1 : get_utf8(s + i, len - i, &cp);
+            count = used ? encode_char(cp, unit) : 0;
+            if (!count)
+            {
+                unit[0] = '?';
+                count = 1;
+                used = used ? used : 1;
+                bad++;
+            }
+        }
+
+        if (count > cap - n)
+            break;
+        memcpy(out + n, unit, count);
+        n += count;
+        i += used;
+    }
+
+    if (unmapped)
+        *unmapped = bad;
+    return n;
+}
+
+int xm_text_write_field(uint8_t *data, size_t size, size_t offset,
+                        const char *text, size_t text_len, size_t field_size,
+                        int *changed)
+{
+    if (offset >= size)
+    {
+        if (changed)
+            *changed = 0;
+        return XM_ERR_RANGE;
+    }
+
+    // Fields are a few dozen bytes; larger ones are encoded on the heap
+    size_t cap = size - offset < field_size ? size - offset : field_size;
+    uint8_t stack[256];
+    uint8_t *bytes = cap <= sizeof(stack) ? stack : malloc(cap);
+    if (!bytes)
+        return XM_ERR_NOMEM;
+
+    size_t len = xm_text_encode(text, text_len, bytes, cap, NULL);
+    int err = xm_write_field(data, size, offset, (const char *)bytes, len, field_size, changed);
+    if (bytes != stack)
+        free(bytes);
+    return err;
+}
+
+int xm_text_set_field(uint8_t *data, size_t size, int macro, int field,
+                      const char *text, size_t text_len, int *changed)
+{
+    size_t offset, len;
+    int err = xm_field_span(size, macro, field, &offset, &len);
+    if (err != XM_OK)
+    {
+        if (changed)
+            *changed = 0;
+        return err;
+    }
+    return xm_text_write_field(data, size, offset, text, text_len, len, changed);
+}
@@ -0,0 +1,77 @@
+#ifndef XM_TEXT_H
+#define XM_TEXT_H
+
+/**
+ * Codec between the bytes of macro lines, names and book titles and the
+ * UTF-8 text the tools exchange. The game stores text as Shift-JIS (CP932)
+ * with auto-translate phrases embedded as 0xFD <4 bytes> 0xFD; as text,
+ *
+ *   {AT:HHHHHHHH}  is an auto-translate phrase (its four inner bytes)
+ *   {xHH}          is a byte that isn't part of any character
+ *
+ * and a '{' that would otherwise read as one of these is written {x7B}.
+ * Decoding and then encoding gives back the same bytes.
+ *
+ * Only CP932 pairs that encode back to themselves are decoded (see
+ * tools/gen_text_table.py); NEC/IBM duplicates and user-defined
+ * characters stay {xHH} bytes. Pure ASCII, the common case, is scanned a
+ * vector at a time and copied in bulk both ways.
+ */
+
+#include "ximacro.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Size of a buffer holding enough text to fill a 'bytes'-byte field:
+ * anything after it could not be encoded into the field anyway.
+ */
+#define XM_TEXT_CAP(bytes) ((bytes) * 6)
+
+/**
+ * Bytes taken by the character at the start of 'src' ('len' bytes): 6
+ * for an auto-translate phrase, 2 for a Shift-JIS pair, otherwise 1.
+ */
+XM_API size_t xm_text_unit(const uint8_t *src, size_t len);
+
+/**
+ * Appends the text of the bytes up to the first NUL (or 'max_len').
+ */
+XM_API void xm_text_decode(xm_buf *b, const uint8_t *src, size_t max_len);
+
+/**
+ * xm_text_decode() as JSON string content: '"', '\' and controls escaped.
+ */
+XM_API void xm_json_text(xm_buf *b, const uint8_t *src, size_t max_len);
+
+/**
+ * Encodes UTF-8 text, up to its first NUL or 'len' bytes, into at most
+ * 'cap' bytes of 'out'; a character that wouldn't fit whole ends it.
+ * Returns the bytes written. Characters with no encoding are written as
+ * '?' and counted in '*unmapped' (if given); U+0080..U+00FF without one
+ * become that byte, as exports before this codec wrote them.
+ */
+XM_API size_t xm_text_encode(const char *text, size_t len, uint8_t *out, size_t cap,
+                             size_t *unmapped);
+
+/**
+ * xm_write_field() of encoded text.
+ */
+XM_API int xm_text_write_field(uint8_t *data, size_t size, size_t offset,
+                               const char *text, size_t text_len, size_t field_size,
+                               int *changed);
+
+/**
+ * xm_set_field() of encoded text.
+ */
+XM_API int xm_text_set_field(uint8_t *data, size_t size, int macro, int field,
+                             const char *text, size_t text_len, int *changed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_TEXT_H
@@ -0,0 +1,111 @@
+#include "xm_thread.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef struct
+{
+    xm_task_fn fn;
+    void *ctx;
+    int tasks;
+#if defined(_WIN32)
+    volatile LONG next;
+#else
+    int next;
+#endif
+} pool;
+
+static int claim(pool *p)
+{
+#if defined(_WIN32)
+    return (int)InterlockedIncrement(&p->next) - 1;
+#else
+    return __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+static void drain(pool *p)
+{
+    int task;
+    while ((task = claim(p)) < p->tasks)
+        p->fn(p->ctx, task);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI worker(LPVOID arg)
+{
+    drain(arg);
+    return 0;
+}
+#else
+static void *worker(void *arg)
+{
+    drain(arg);
+    return NULL;
+}
+#endif
+
+int xm_cpu_count(void)
+{
+#if defined(_WIN32)
+    DWORD n = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    return n > 0 ? (int)n : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+int xm_parallel_for(int tasks, int threads, xm_task_fn fn, void *ctx)
+{
+    pool p = {fn, ctx, tasks, 0};
+    if (threads > tasks)
+        threads = tasks;
+
+    int extra = threads > 1 ? threads - 1 : 0;
+    int started = 0;
+    int err = XM_OK;
+
+#if defined(_WIN32)
+    HANDLE *handles = extra ? malloc(extra * sizeof(*handles)) : NULL;
+    for (int i = 0; handles && i < extra; i++)
+    {
+        handles[started] = CreateThread(NULL, 0, worker, &p, 0, NULL);
+        if (!handles[started])
+            break;
+        started++;
+    }
+#else
+    pthread_t *handles = extra ? malloc(extra * sizeof(*handles)) : NULL;
+    for (int i = 0; handles && i < extra; i++)
+    {
+        if (pthread_create(&handles[started], NULL, worker, &p) != 0)
+            break;
+        started++;
+    }
+#endif
+    if (started < extra)
+        err = XM_ERR_NOMEM;
+
+    drain(&p);
+
+#if defined(_WIN32)
+    for (int i = 0; i < started; i++)
+    {
+        WaitForSingleObject(handles[i], INFINITE);
+        CloseHandle(handles[i]);
+    }
+#else
+    for (int i = 0; i < started; i++)
+        pthread_join(handles[i], NULL);
+#endif
+    free(handles);
+    return err;
+}
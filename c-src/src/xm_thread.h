@@ -0,0 +1,37 @@
+#ifndef XM_THREAD_H
+#define XM_THREAD_H
+
+/**
+ * Minimal worker pool over pthreads / Win32 threads.
+ *
+ * xm_parallel_for() hands task indices 0..tasks-1 to up to 'threads'
+ * threads (the caller's included) through a shared atomic counter, and
+ * returns once every task has run.
+ */
+
+#include "ximacro.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef void (*xm_task_fn)(void *ctx, int task);
+
+/**
+ * Number of online processors (at least 1).
+ */
+XM_API int xm_cpu_count(void);
+
+/**
+ * Runs fn(ctx, task) for every task. If worker threads can't be started
+ * the remaining tasks still run on the calling thread and XM_ERR_NOMEM is
+ * returned.
+ */
+XM_API int xm_parallel_for(int tasks, int threads, xm_task_fn fn, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_THREAD_H
@@ -0,0 +1,265 @@
+#include "xm_trace.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MAX_STAGES 64
+#define MAX_EVENTS (1 << 20)
+
+typedef struct
+{
+    const char *name;
+    long long count;
+    double ms;
+} stage_total;
+
+typedef struct
+{
+    const char *name;
+    double start_ms;
+    double dur_ms;
+    unsigned tid;
+} trace_event;
+
+static const char *const LEVEL_NAMES[] = {"off", "error", "warn", "info", "debug", "trace"};
+static const char *const COUNTER_NAMES[XM_CTR_COUNT] = {
+    "filesOpened", "bytesRead", "bytesWritten", "recordsParsed", "fieldsPatched"};
+
+static int g_level = -1; // resolved from XIMACRO_LOG on first use
+static int g_timing;     // spans are timed (info and up, or a trace file)
+static const char *g_tool;
+static const char *g_trace_path;
+static double g_start_ms;
+static long long g_counters[XM_CTR_COUNT];
+
+// Stage totals and trace events, behind one lock taken once per span
+static stage_total g_stages[MAX_STAGES];
+static int g_stage_count;
+static trace_event *g_events;
+static size_t g_event_count, g_event_cap;
+
+#if defined(_WIN32)
+static SRWLOCK g_lock = SRWLOCK_INIT;
+#define LOCK() AcquireSRWLockExclusive(&g_lock)
+#define UNLOCK() ReleaseSRWLockExclusive(&g_lock)
+#else
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK() pthread_mutex_lock(&g_lock)
+#define UNLOCK() pthread_mutex_unlock(&g_lock)
+#endif
+
+static unsigned thread_id(void)
+{
+#if defined(_WIN32)
+    return (unsigned)GetCurrentThreadId();
+#else
+    static unsigned next_tid;
+    static _Thread_local unsigned tid;
+    if (tid == 0)
+        tid = __atomic_add_fetch(&next_tid, 1, __ATOMIC_RELAXED);
+    return tid;
+#endif
+}
+
+static int parse_level(const char *s)
+{
+    if (!s || !*s)
+        return XM_LOG_WARN;
+    if (s[0] >= '0' && s[0] <= '9')
+    {
+        int n = atoi(s);
+        return n > XM_LOG_TRACE ? XM_LOG_TRACE : n;
+    }
+    for (int i = 0; i <= XM_LOG_TRACE; i++)
+    {
+        if (strcmp(s, LEVEL_NAMES[i]) == 0)
+            return i;
+    }
+    return XM_LOG_WARN;
+}
+
+static void resolve_level(void)
+{
+    // Idempotent, so threads racing here agree
+    int level = parse_level(getenv("XIMACRO_LOG"));
+    const char *trace = getenv("XIMACRO_TRACE");
+    g_trace_path = (trace && *trace) ? trace : NULL;
+    g_timing = level >= XM_LOG_INFO || g_trace_path != NULL;
+    g_level = level;
+}
+
+int xm_log_enabled(int level)
+{
+    if (g_level < 0)
+        resolve_level();
+    return level <= g_level;
+}
+
+void xm_log(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+void xm_count(xm_counter counter, long long n)
+{
+#if defined(_WIN32)
+    InterlockedExchangeAdd64((volatile LONG64 *)&g_counters[counter], (LONG64)n);
+#else
+    __atomic_fetch_add(&g_counters[counter], n, __ATOMIC_RELAXED);
+#endif
+}
+
+long long xm_counter_value(xm_counter counter)
+{
+#if defined(_WIN32)
+    return (long long)InterlockedCompareExchange64((volatile LONG64 *)&g_counters[counter], 0, 0);
+#else
+    return __atomic_load_n(&g_counters[counter], __ATOMIC_RELAXED);
+#endif
+}
+
+xm_span xm_span_begin(const char *name)
+{
+    if (g_level < 0)
+        resolve_level();
+    xm_span span = {name, g_timing ? xm_now_ms() : -1.0, 1};
+    return span;
+}
+
+void xm_span_end(xm_span *span)
+{
+    span->open = 0;
+    if (span->start_ms < 0)
+        return;
+    double end = xm_now_ms();
+    unsigned tid = g_trace_path ? thread_id() : 0;
+
+    LOCK();
+    int i = 0;
+    while (i < g_stage_count && strcmp(g_stages[i].name, span->name) != 0)
+        i++;
+    if (i < MAX_STAGES)
+    {
+        if (i == g_stage_count)
+            g_stages[g_stage_count++].name = span->name;
+        g_stages[i].count++;
+        g_stages[i].ms += end - span->start_ms;
+    }
+
+    if (g_trace_path && g_event_count < MAX_EVENTS)
+    {
+        if (g_event_count == g_event_cap)
+        {
+            size_t cap = g_event_cap ? g_event_cap * 2 : 256;
+            trace_event *events = realloc(g_events, cap * sizeof(*events));
+            if (events)
+            {
+                g_events = events;
+                g_event_cap = cap;
+            }
+        }
+        if (g_event_count < g_event_cap)
+        {
+            trace_event *e = &g_events[g_event_count++];
+            e->name = span->name;
+            e->start_ms = span->start_ms;
+            e->dur_ms = end - span->start_ms;
+            e->tid = tid;
+        }
+    }
+    UNLOCK();
+}
+
+// -------------------------------------------------------------------
+// Exit reports
+// -------------------------------------------------------------------
+static void write_counters(xm_buf *b)
+{
+    for (int i = 0; i < XM_CTR_COUNT; i++)
+        xm_buf_printf(b, "%s\"%s\":%lld", i ? "," : "", COUNTER_NAMES[i], xm_counter_value(i));
+}
+
+static void print_summary(double end)
+{
+    xm_buf b;
+    xm_buf_init(&b);
+    xm_buf_printf(&b, "[%s] {\"ms\":%.3f,\"counters\":{", g_tool, end - g_start_ms);
+    write_counters(&b);
+    xm_buf_puts(&b, "},\"stages\":{");
+    for (int i = 0; i < g_stage_count; i++)
+    {
+        xm_buf_printf(&b, "%s\"%s\":{\"count\":%lld,\"ms\":%.3f}", i ? "," : "",
+                      g_stages[i].name, g_stages[i].count, g_stages[i].ms);
+    }
+    xm_buf_puts(&b, "}}\n");
+    xm_buf_write(&b, stderr);
+    xm_buf_free(&b);
+}
+
+// One complete ("X") event per span and the final counters ("C"), in
+// microseconds from xm_trace_init()
+static void write_trace(double end)
+{
+#if defined(_WIN32)
+    unsigned long pid = (unsigned long)GetCurrentProcessId();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    xm_buf b;
+    xm_buf_init(&b);
+    xm_buf_printf(&b, "{\"traceEvents\":[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,"
+                      "\"tid\":0,\"args\":{\"name\":\"%s\"}}", pid, g_tool);
+    for (size_t i = 0; i < g_event_count; i++)
+    {
+        const trace_event *e = &g_events[i];
+        xm_buf_printf(&b, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                          "\"pid\":%lu,\"tid\":%u}",
+                      e->name, g_tool, (e->start_ms - g_start_ms) * 1000.0, e->dur_ms * 1000.0, pid, e->tid);
+    }
+    xm_buf_printf(&b, ",\n{\"name\":\"counters\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%lu,\"tid\":0,\"args\":{",
+                  (end - g_start_ms) * 1000.0, pid);
+    write_counters(&b);
+    xm_buf_puts(&b, "}}\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    if (xm_write_file(g_trace_path, (const uint8_t *)b.data, b.len) != XM_OK)
+        fprintf(stderr, "[%s] Could not write trace '%s'\n", g_tool, g_trace_path);
+    xm_buf_free(&b);
+}
+
+static void trace_finish(void)
+{
+    double end = xm_now_ms();
+    LOCK();
+    if (g_level >= XM_LOG_INFO)
+        print_summary(end);
+    if (g_trace_path)
+        write_trace(end);
+    free(g_events);
+    g_events = NULL;
+    g_event_count = g_event_cap = 0;
+    UNLOCK();
+}
+
+void xm_trace_init(const char *tool)
+{
+    if (g_tool)
+        return;
+    g_tool = tool;
+    g_start_ms = xm_now_ms();
+    resolve_level();
+    if (g_timing)
+        atexit(trace_finish);
+}
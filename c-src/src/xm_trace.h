@@ -0,0 +1,119 @@
+#ifndef XM_TRACE_H
+#define XM_TRACE_H
+
+/**
+ * Leveled logging, counters and stage timers for the native tools.
+ *
+ *   XIMACRO_LOG=off|error|warn|info|debug|trace   log level (default warn);
+ *                                                 from info up, counters and
+ *                                                 stage times are printed to
+ *                                                 stderr when the tool exits
+ *   XIMACRO_TRACE=<file>                          also writes every timed
+ *                                                 stage as Chrome trace-event
+ *                                                 JSON (chrome://tracing,
+ *                                                 Perfetto)
+ *
+ * Use the XM_* macros rather than the functions: building with XM_TRACE=0
+ * (CMake -DXIMACRO_TRACE=OFF) turns all of them into nothing, except that
+ * errors and warnings are still logged.
+ *
+ *   XM_TRACE_INIT("ximacro_e");
+ *   XM_LOG(XM_LOG_DEBUG, "loaded %d files\n", n);
+ *   XM_COUNT(XM_CTR_BYTES_READ, size);
+ *   XM_SPAN("encode") { ...; }    // times the block; don't leave it
+ *                                 // with return, break or goto
+ *
+ * Counters are atomic and spans may run on any thread. Span names must
+ * outlive the process (string literals).
+ */
+
+#include "ximacro.h"
+
+#ifndef XM_TRACE
+#define XM_TRACE 1
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum
+{
+    XM_LOG_OFF = 0,
+    XM_LOG_ERROR,
+    XM_LOG_WARN,
+    XM_LOG_INFO,
+    XM_LOG_DEBUG,
+    XM_LOG_TRACE
+} xm_log_level;
+
+typedef enum
+{
+    XM_CTR_FILES_OPENED = 0,
+    XM_CTR_BYTES_READ,
+    XM_CTR_BYTES_WRITTEN,
+    XM_CTR_RECORDS_PARSED, // macro records decoded from file bytes
+    XM_CTR_FIELDS_PATCHED, // lines and names written into file bytes
+    XM_CTR_COUNT
+} xm_counter;
+
+typedef struct
+{
+    const char *name;
+    double start_ms; // negative when nothing is being timed
+    int open;
+} xm_span;
+
+/**
+ * Names the tool in log output and reads XIMACRO_LOG / XIMACRO_TRACE. The
+ * summary and trace file are written at exit. Without it the library
+ * still honours XIMACRO_LOG but reports nothing at exit.
+ */
+XM_API void xm_trace_init(const char *tool);
+
+/**
+ * Nonzero if messages at 'level' are printed.
+ */
+XM_API int xm_log_enabled(int level);
+
+/**
+ * printf() to stderr, unconditionally; XM_LOG() checks the level first.
+ */
+XM_API void xm_log(const char *fmt, ...);
+
+XM_API void xm_count(xm_counter counter, long long n);
+XM_API long long xm_counter_value(xm_counter counter);
+
+XM_API xm_span xm_span_begin(const char *name);
+XM_API void xm_span_end(xm_span *span);
+
+#if XM_TRACE
+#define XM_TRACE_INIT(tool) xm_trace_init(tool)
+#define XM_LOG(level, ...)              \
+    do                                  \
+    {                                   \
+        if (xm_log_enabled(level))      \
+            xm_log(__VA_ARGS__);        \
+    } while (0)
+#define XM_COUNT(counter, n) xm_count(counter, (long long)(n))
+#define XM_SPAN(name) for (xm_span xm_span_ = xm_span_begin(name); xm_span_.open; xm_span_end(&xm_span_))
+#else
+#define XM_TRACE_INIT(tool) ((void)0)
+// Errors and warnings only; still type-checks the arguments of the rest,
+// so they don't become unused
+#define XM_LOG(level, ...)                                   \
+    do                                                       \
+    {                                                        \
+        if ((level) <= XM_LOG_WARN && xm_log_enabled(level)) \
+            xm_log(__VA_ARGS__);                             \
+    } while (0)
+#define XM_COUNT(counter, n) ((void)sizeof(n))
+#define XM_SPAN(name)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_TRACE_H
@@ -0,0 +1,1080 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // syncfs()
+#endif
+
+#include "xm_txn.h"
+#include "xm_io.h"
+#include "xm_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// syncfs() flushes a whole filesystem in one call, so a commit costs one
+// barrier however many files it touches. Elsewhere each file is synced as
+// it is written.
+#if defined(__linux__)
+#define XM_TXN_GROUP_SYNC 1
+#else
+#define XM_TXN_GROUP_SYNC 0
+#endif
+
+#define TEMP_SUFFIX ".xmtmp"
+#define JOURNAL_FILE_MAGIC "XMJH"
+#define JOURNAL_FILE_HEADER 24 // magic, u32 0, u64 last_start, u64 end
+#define JOURNAL_MAGIC "XMJ1"
+#define JOURNAL_HEADER 8  // magic + body length
+#define JOURNAL_TRAILER 4 // FNV-1a of the body
+#define RANGE_GAP 8       // unchanged bytes absorbed into a range rather than splitting it
+
+// Past this size the oldest records are dropped, down to half of it, so a
+// rewrite of the journal happens once per half its size of new records
+#define JOURNAL_MAX_SIZE ((size_t)16 * 1024 * 1024)
+
+/**
+ * Journal, little-endian:
+ *
+ *   "XMJH" u32 0 u64 last_start u64 end  record*
+ *
+ * 'end' is where the valid records end and 'last_start' where the newest
+ * of them starts (both 24 when there are none), so an append only has to
+ * check that one record; anything after 'end' is a torn append. Journals
+ * written before the header existed start with their first record and are
+ * given one on the next append.
+ *
+ * Record:
+ *
+ *   "XMJ1" u32 body_len body u32 fnv1a(body)
+ *
+ *   body:  u64 unix_time, u32 file_count, file[file_count]
+ *   file:  u16 path_len, path, u32 old_size, u32 new_size,
+ *          u32 range_count, { u32 offset, u32 len, old bytes }[range_count]
+ *
+ * Files whose size changed store their whole old contents as one range.
+ */
+
+typedef struct xm_txn_file
+{
+    char *path;
+    uint8_t *old_data;
+    size_t old_size;
+    uint8_t *new_data;
+    size_t new_size;
+    char *copy_from; // new_data is this file's contents: clone it
+    int status;
+    int temp_written;
+} xm_txn_file;
+
+struct xm_txn
+{
+    char *journal_path;
+    xm_txn_file *files;
+    int count;
+    int cap;
+};
+
+static char *dup_str(const char *s)
+{
+    size_t n = strlen(s) + 1;
+    char *copy = malloc(n);
+    if (copy)
+        memcpy(copy, s, n);
+    return copy;
+}
+
+static uint8_t *dup_bytes(const uint8_t *src, size_t n)
+{
+    uint8_t *copy = malloc(n ? n : 1);
+    if (copy && n)
+        memcpy(copy, src, n);
+    return copy;
+}
+
+static int temp_path(const char *path, char *out, size_t cap)
+{
+    int n = snprintf(out, cap, "%s" TEMP_SUFFIX, path);
+    return (n < 0 || (size_t)n >= cap) ? XM_ERR_RANGE : XM_OK;
+}
+
+static xm_txn_file *find_file(const xm_txn *txn, const char *path)
+{
+    for (int i = 0; i < txn->count; i++)
+    {
+        if (strcmp(txn->files[i].path, path) == 0)
+            return &txn->files[i];
+    }
+    return NULL;
+}
+
+// -------------------------------------------------------------------
+// Durability helpers
+// -------------------------------------------------------------------
+static int sync_stream(FILE *fp)
+{
+#if defined(_WIN32)
+    return _commit(_fileno(fp)) == 0 ? XM_OK : XM_ERR_WRITE;
+#else
+    return fsync(fileno(fp)) == 0 ? XM_OK : XM_ERR_WRITE;
+#endif
+}
+
+static int write_stream(FILE *fp, const uint8_t *data, size_t size)
+{
+    int err = XM_OK;
+    if (fwrite(data, 1, size, fp) < size || fflush(fp) != 0)
+        err = XM_ERR_WRITE;
+    XM_COUNT(XM_CTR_FILES_OPENED, 1);
+    XM_COUNT(XM_CTR_BYTES_WRITTEN, size);
+    if (err == XM_OK && !XM_TXN_GROUP_SYNC)
+        err = sync_stream(fp);
+    if (fclose(fp) != 0)
+        err = XM_ERR_WRITE;
+    return err;
+}
+
+static int truncate_file(const char *path, size_t size)
+{
+#if defined(_WIN32)
+    int fd = _open(path, _O_RDWR | _O_BINARY);
+    if (fd < 0)
+        return XM_ERR_OPEN;
+    int res = _chsize_s(fd, (__int64)size);
+    _close(fd);
+    return res == 0 ? XM_OK : XM_ERR_WRITE;
+#else
+    return truncate(path, (off_t)size) == 0 ? XM_OK : XM_ERR_WRITE;
+#endif
+}
+
+/**
+ * One barrier per filesystem holding the journal and the temp files (or,
+ * with 'targets', the published files and so their directory entries).
+ */
+static int group_sync(const xm_txn *txn, int targets)
+{
+#if XM_TXN_GROUP_SYNC
+    dev_t seen[8];
+    int nseen = 0;
+    int err = XM_OK;
+
+    for (int i = -1; i < txn->count; i++)
+    {
+        char path[1024];
+        if (i < 0)
+        {
+            if (!txn->journal_path || targets)
+                continue;
+            snprintf(path, sizeof(path), "%s", txn->journal_path);
+        }
+        else if (targets)
+            snprintf(path, sizeof(path), "%s", txn->files[i].path);
+        else if (temp_path(txn->files[i].path, path, sizeof(path)) != XM_OK)
+            continue;
+
+        struct stat st;
+        if (stat(path, &st) != 0)
+            continue;
+
+        int known = 0;
+        for (int j = 0; j < nseen; j++)
+            known |= seen[j] == st.st_dev;
+        if (known)
+            continue;
+        if (nseen < (int)(sizeof(seen) / sizeof(seen[0])))
+            seen[nseen++] = st.st_dev;
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0 || syncfs(fd) != 0)
+            err = XM_ERR_WRITE;
+        if (fd >= 0)
+            close(fd);
+    }
+    return err;
+#elif defined(_WIN32)
+    // Files were committed as written; MOVEFILE_WRITE_THROUGH covers renames
+    (void)txn;
+    (void)targets;
+    return XM_OK;
+#else
+    // Files were synced as written; make the renames durable
+    if (!targets)
+        return XM_OK;
+    int err = XM_OK;
+    for (int i = 0; i < txn->count; i++)
+    {
+        const char *path = txn->files[i].path;
+        size_t len = (size_t)(xm_basename(path) - path);
+        char dir[1024];
+        snprintf(dir, sizeof(dir), "%.*s", len ? (int)len : 1, len ? path : ".");
+        int fd = open(dir, O_RDONLY);
+        if (fd < 0 || fsync(fd) != 0)
+            err = XM_ERR_WRITE;
+        if (fd >= 0)
+            close(fd);
+    }
+    return err;
+#endif
+}
+
+static int publish(const char *temp, const char *path)
+{
+#if defined(_WIN32)
+    return MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? XM_OK : XM_ERR_WRITE;
+#else
+    return rename(temp, path) == 0 ? XM_OK : XM_ERR_WRITE;
+#endif
+}
+
+static void remove_temps(xm_txn *txn)
+{
+    char temp[1024];
+    for (int i = 0; i < txn->count; i++)
+    {
+        xm_txn_file *f = &txn->files[i];
+        if (f->temp_written && temp_path(f->path, temp, sizeof(temp)) == XM_OK)
+            remove(temp);
+        f->temp_written = 0;
+    }
+}
+
+// -------------------------------------------------------------------
+// Journal encoding
+// -------------------------------------------------------------------
+static void put_u16(xm_buf *b, uint16_t v)
+{
+    uint8_t bytes[2] = {(uint8_t)v, (uint8_t)(v >> 8)};
+    xm_buf_append(b, bytes, sizeof(bytes));
+}
+
+static void put_u32(xm_buf *b, uint32_t v)
+{
+    uint8_t bytes[4] = {(uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24)};
+    xm_buf_append(b, bytes, sizeof(bytes));
+}
+
+static void put_u64(xm_buf *b, uint64_t v)
+{
+    put_u32(b, (uint32_t)v);
+    put_u32(b, (uint32_t)(v >> 32));
+}
+
+static void set_u32(xm_buf *b, size_t at, uint32_t v)
+{
+    if (b->failed)
+        return;
+    b->data[at] = (char)v;
+    b->data[at + 1] = (char)(v >> 8);
+    b->data[at + 2] = (char)(v >> 16);
+    b->data[at + 3] = (char)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static void set_u64(uint8_t *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t fnv1a(const uint8_t *p, size_t n)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+static void put_range(xm_buf *b, const uint8_t *old_data, size_t offset, size_t len)
+{
+    put_u32(b, (uint32_t)offset);
+    put_u32(b, (uint32_t)len);
+    xm_buf_append(b, old_data + offset, len);
+}
+
+static void encode_file(xm_buf *b, const xm_txn_file *f)
+{
+    size_t path_len = strlen(f->path);
+    put_u16(b, (uint16_t)path_len);
+    xm_buf_append(b, f->path, path_len);
+    put_u32(b, (uint32_t)f->old_size);
+    put_u32(b, (uint32_t)f->new_size);
+
+    size_t count_at = b->len;
+    uint32_t ranges = 0;
+    put_u32(b, 0);
+
+    if (f->old_size != f->new_size)
+    {
+        put_range(b, f->old_data, 0, f->old_size);
+        ranges = 1;
+    }
+    else
+    {
+        const uint8_t *o = f->old_data;
+        const uint8_t *n = f->new_data;
+        size_t size = f->old_size;
+        size_t i = 0;
+        while (i < size)
+        {
+            if (o[i] == n[i])
+            {
+                i++;
+                continue;
+            }
+
+            size_t start = i;
+            size_t end = i + 1;
+            for (i = end; i < size && i - end < RANGE_GAP; i++)
+            {
+                if (o[i] != n[i])
+                    end = i + 1;
+            }
+            put_range(b, o, start, end - start);
+            ranges++;
+            i = end;
+        }
+    }
+    set_u32(b, count_at, ranges);
+}
+
+static void encode_record(xm_buf *b, const xm_txn *txn)
+{
+    xm_buf_append(b, JOURNAL_MAGIC, 4);
+    put_u32(b, 0);
+    put_u64(b, (uint64_t)time(NULL));
+    put_u32(b, (uint32_t)txn->count);
+    for (int i = 0; i < txn->count; i++)
+        encode_file(b, &txn->files[i]);
+
+    if (b->failed)
+        return;
+    size_t body_len = b->len - JOURNAL_HEADER;
+    set_u32(b, 4, (uint32_t)body_len);
+    put_u32(b, fnv1a((const uint8_t *)b->data + JOURNAL_HEADER, body_len));
+}
+
+/**
+ * Finds the records of a journal image. Stops at the first torn or
+ * corrupt one, which a crash mid-append can leave behind.
+ */
+static int scan_journal(const uint8_t *data, size_t size, size_t **starts, int *count, size_t *valid_end)
+{
+    int cap = 16;
+    *count = 0;
+    *starts = malloc(cap * sizeof(**starts));
+    if (!*starts)
+        return XM_ERR_NOMEM;
+
+    size_t pos = 0;
+    while (size - pos >= JOURNAL_HEADER + JOURNAL_TRAILER && memcmp(data + pos, JOURNAL_MAGIC, 4) == 0)
+    {
+        size_t body_len = get_u32(data + pos + 4);
+        if (body_len > size - pos - JOURNAL_HEADER - JOURNAL_TRAILER)
+            break;
+        const uint8_t *body = data + pos + JOURNAL_HEADER;
+        if (fnv1a(body, body_len) != get_u32(body + body_len))
+            break;
+
+        if (*count == cap)
+        {
+            size_t *grown = realloc(*starts, (size_t)cap * 2 * sizeof(**starts));
+            if (!grown)
+                return XM_ERR_NOMEM;
+            *starts = grown;
+            cap *= 2;
+        }
+        (*starts)[(*count)++] = pos;
+        pos += JOURNAL_HEADER + body_len + JOURNAL_TRAILER;
+    }
+    *valid_end = pos;
+    return XM_OK;
+}
+
+/**
+ * Where the records of a journal image start, and where they end at the
+ * latest: past the header up to its 'end', or the whole image for a
+ * journal written before it had one.
+ */
+static void journal_bounds(const uint8_t *data, size_t size, size_t *base, size_t *limit)
+{
+    *base = 0;
+    *limit = size;
+    if (size >= JOURNAL_FILE_HEADER && memcmp(data, JOURNAL_FILE_MAGIC, 4) == 0)
+    {
+        uint64_t end = get_u64(data + 16);
+        *base = JOURNAL_FILE_HEADER;
+        *limit = end >= JOURNAL_FILE_HEADER && end < size ? (size_t)end : size;
+    }
+}
+
+// The header's offsets: where the newest record starts and the records end
+typedef struct
+{
+    size_t last;
+    size_t end;
+} journal_tail;
+
+static int read_tail(FILE *fp, journal_tail *tail)
+{
+    uint8_t h[JOURNAL_FILE_HEADER];
+    if (fseek(fp, 0, SEEK_SET) != 0 || fread(h, 1, sizeof(h), fp) != sizeof(h) ||
+        memcmp(h, JOURNAL_FILE_MAGIC, 4) != 0)
+        return 0;
+    uint64_t last = get_u64(h + 8);
+    uint64_t end = get_u64(h + 16);
+    if (last < JOURNAL_FILE_HEADER || last > end || end > JOURNAL_MAX_SIZE * 2)
+        return 0;
+    tail->last = (size_t)last;
+    tail->end = (size_t)end;
+    return 1;
+}
+
+static int write_tail(FILE *fp, const journal_tail *tail)
+{
+    uint8_t h[JOURNAL_FILE_HEADER] = {0};
+    memcpy(h, JOURNAL_FILE_MAGIC, 4);
+    set_u64(h + 8, tail->last);
+    set_u64(h + 16, tail->end);
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(h, 1, sizeof(h), fp) != sizeof(h) || fflush(fp) != 0)
+        return XM_ERR_WRITE;
+    return XM_OK;
+}
+
+/**
+ * Whether the header's newest record is whole and ends at its 'end'; only
+ * that record is read.
+ */
+static int tail_valid(FILE *fp, const journal_tail *tail)
+{
+    if (tail->last == tail->end)
+        return tail->end == JOURNAL_FILE_HEADER;
+
+    size_t len = tail->end - tail->last;
+    if (len < JOURNAL_HEADER + JOURNAL_TRAILER)
+        return 0;
+    uint8_t *rec = malloc(len);
+    size_t body_len = len - JOURNAL_HEADER - JOURNAL_TRAILER;
+    int ok = rec && fseek(fp, (long)tail->last, SEEK_SET) == 0 && fread(rec, 1, len, fp) == len &&
+             memcmp(rec, JOURNAL_MAGIC, 4) == 0 && get_u32(rec + 4) == body_len &&
+             fnv1a(rec + JOURNAL_HEADER, body_len) == get_u32(rec + len - JOURNAL_TRAILER);
+    free(rec);
+    return ok;
+}
+
+/**
+ * Replaces the journal at 'path' with a header and the records data[from,
+ * to), the newest starting at 'last', through a temp file and a rename.
+ */
+static int rewrite_journal(const char *path, const uint8_t *data, size_t from, size_t to, size_t last)
+{
+    char temp[1024];
+    int err = temp_path(path, temp, sizeof(temp));
+    if (err != XM_OK)
+        return err;
+    FILE *fp = fopen(temp, "wb");
+    if (!fp)
+        return XM_ERR_OPEN;
+
+    journal_tail tail = {JOURNAL_FILE_HEADER + (last - from), JOURNAL_FILE_HEADER + (to - from)};
+    err = write_tail(fp, &tail);
+    if (err == XM_OK && to > from && (fwrite(data + from, 1, to - from, fp) != to - from || fflush(fp) != 0))
+        err = XM_ERR_WRITE;
+    if (err == XM_OK)
+        err = sync_stream(fp);
+    if (fclose(fp) != 0)
+        err = XM_ERR_WRITE;
+    XM_COUNT(XM_CTR_BYTES_WRITTEN, JOURNAL_FILE_HEADER + (to - from));
+    if (err == XM_OK)
+        err = publish(temp, path);
+    if (err != XM_OK)
+        remove(temp);
+    return err;
+}
+
+/**
+ * Rewrites the journal with its valid records less the oldest ones: those
+ * beyond the newest 'keep' (keep < 0: no limit), those older than
+ * 'max_age' seconds (max_age < 0: no limit), and as many more as it takes
+ * for the rest plus 'room' bytes to fit in 'max_size'. A missing journal
+ * is created empty. '*removed' gets the number of records dropped.
+ */
+static int compact_journal(const char *path, int keep, long long max_age, size_t max_size, size_t room,
+                           int *removed)
+{
+    *removed = 0;
+    uint8_t *data;
+    size_t size;
+    int err = xm_read_file(path, &data, &size);
+    if (err == XM_ERR_OPEN)
+        return rewrite_journal(path, NULL, 0, 0, 0);
+    if (err != XM_OK)
+        return err;
+
+    size_t base, limit, valid_end;
+    size_t *starts;
+    int count;
+    journal_bounds(data, size, &base, &limit);
+    err = scan_journal(data + base, limit - base, &starts, &count, &valid_end);
+    if (err == XM_OK)
+    {
+        size_t end = base + valid_end;
+        long long now = (long long)time(NULL);
+        int first = keep >= 0 && count > keep ? count - keep : 0;
+        while (first < count && max_age >= 0 &&
+               now - (long long)get_u64(data + base + starts[first] + JOURNAL_HEADER) > max_age)
+            first++;
+        while (first < count && end - (base + starts[first]) + room > max_size)
+            first++;
+
+        size_t from = first < count ? base + starts[first] : end;
+        size_t last = first < count ? base + starts[count - 1] : end;
+        err = rewrite_journal(path, data, from, end, last);
+        if (err == XM_OK)
+            *removed = first;
+    }
+    free(starts);
+    xm_free(data);
+    return err;
+}
+
+/**
+ * Ends the journal at 'end', its newest record then starting at 'last'.
+ */
+static int cut_journal(const char *path, size_t base, size_t last, size_t end)
+{
+    if (base > 0)
+    {
+        FILE *fp = fopen(path, "r+b");
+        if (!fp)
+            return XM_ERR_OPEN;
+        journal_tail tail = {last, end};
+        int err = write_tail(fp, &tail);
+        if (fclose(fp) != 0)
+            err = XM_ERR_WRITE;
+        if (err != XM_OK)
+            return err;
+    }
+    return truncate_file(path, end);
+}
+
+/**
+ * Appends a record after the header's 'end' and moves it past the record.
+ * A journal that is new, has no header yet, was torn by a crash or would
+ * outgrow JOURNAL_MAX_SIZE is first rewritten (see compact_journal()).
+ * '*prev' receives the header before the append so an aborted commit can
+ * take the record back.
+ */
+static int append_journal(const char *path, const xm_buf *rec, journal_tail *prev)
+{
+    prev->last = prev->end = 0;
+
+    const char *base = xm_basename(path);
+    if (base != path)
+    {
+        char dir[1024];
+        snprintf(dir, sizeof(dir), "%.*s", (int)(base - path - 1), path);
+        int err = xm_ensure_dir(dir);
+        if (err != XM_OK)
+            return err;
+    }
+
+    journal_tail tail;
+    FILE *fp = fopen(path, "r+b");
+    int ok = fp && read_tail(fp, &tail) && tail_valid(fp, &tail);
+    if (!ok || tail.end + rec->len > JOURNAL_MAX_SIZE)
+    {
+        if (fp)
+            fclose(fp);
+        int removed;
+        int err = compact_journal(path, -1, -1, ok ? JOURNAL_MAX_SIZE / 2 : JOURNAL_MAX_SIZE, rec->len,
+                                  &removed);
+        if (err != XM_OK)
+            return err;
+        fp = fopen(path, "r+b");
+        if (!fp)
+            return XM_ERR_OPEN;
+        if (!read_tail(fp, &tail))
+        {
+            fclose(fp);
+            return XM_ERR_FORMAT;
+        }
+    }
+
+    journal_tail next = {tail.end, tail.end + rec->len};
+    int err = XM_OK;
+    if (fseek(fp, (long)tail.end, SEEK_SET) != 0 || fwrite(rec->data, 1, rec->len, fp) != rec->len ||
+        fflush(fp) != 0)
+        err = XM_ERR_WRITE;
+    if (err == XM_OK)
+        err = write_tail(fp, &next);
+    XM_COUNT(XM_CTR_FILES_OPENED, 1);
+    XM_COUNT(XM_CTR_BYTES_WRITTEN, rec->len);
+    if (err == XM_OK && !XM_TXN_GROUP_SYNC)
+        err = sync_stream(fp);
+    if (fclose(fp) != 0)
+        err = XM_ERR_WRITE;
+    *prev = tail;
+    return err;
+}
+
+// Takes back the record an aborted commit appended
+static void rollback_journal(const char *path, const journal_tail *prev)
+{
+    if (prev->end > 0)
+        cut_journal(path, JOURNAL_FILE_HEADER, prev->last, prev->end);
+}
+
+// -------------------------------------------------------------------
+// Transactions
+// -------------------------------------------------------------------
+xm_txn *xm_txn_begin(const char *journal_path)
+{
+    xm_txn *txn = calloc(1, sizeof(*txn));
+    if (!txn)
+        return NULL;
+    if (journal_path && !(txn->journal_path = dup_str(journal_path)))
+    {
+        free(txn);
+        return NULL;
+    }
+    return txn;
+}
+
+int xm_txn_stage(xm_txn *txn, const char *path,
+                 const uint8_t *old_data, size_t old_size,
+                 const uint8_t *new_data, size_t new_size)
+{
+    uint8_t *copy = dup_bytes(new_data, new_size);
+    if (!copy)
+        return XM_ERR_NOMEM;
+
+    xm_txn_file *f = find_file(txn, path);
+    if (f)
+    {
+        free(f->new_data);
+        free(f->copy_from);
+        f->new_data = copy;
+        f->new_size = new_size;
+        f->copy_from = NULL;
+        return XM_OK;
+    }
+
+    if (txn->count == txn->cap)
+    {
+        int cap = txn->cap ? txn->cap * 2 : 16;
+        xm_txn_file *grown = realloc(txn->files, (size_t)cap * sizeof(*grown));
+        if (!grown)
+        {
+            free(copy);
+            return XM_ERR_NOMEM;
+        }
+        txn->files = grown;
+        txn->cap = cap;
+    }
+
+    f = &txn->files[txn->count];
+    memset(f, 0, sizeof(*f));
+    f->path = dup_str(path);
+    f->old_data = dup_bytes(old_data, old_size);
+    if (!f->path || !f->old_data)
+    {
+        free(f->path);
+        free(f->old_data);
+        free(copy);
+        return XM_ERR_NOMEM;
+    }
+    f->old_size = old_size;
+    f->new_data = copy;
+    f->new_size = new_size;
+    f->status = XM_ERR_WRITE; // until published
+    txn->count++;
+    return XM_OK;
+}
+
+int xm_txn_stage_copy(xm_txn *txn, const char *path,
+                      const uint8_t *old_data, size_t old_size,
+                      const uint8_t *new_data, size_t new_size,
+                      const char *src_path)
+{
+    char *src = dup_str(src_path);
+    if (!src)
+        return XM_ERR_NOMEM;
+    int err = xm_txn_stage(txn, path, old_data, old_size, new_data, new_size);
+    xm_txn_file *f = err == XM_OK ? find_file(txn, path) : NULL;
+    if (!f)
+    {
+        free(src);
+        return err;
+    }
+    f->copy_from = src;
+    return XM_OK;
+}
+
+int xm_txn_staged(const xm_txn *txn, const char *path, const uint8_t **data, size_t *size)
+{
+    const xm_txn_file *f = find_file(txn, path);
+    if (!f)
+        return 0;
+    *data = f->new_data;
+    *size = f->new_size;
+    return 1;
+}
+
+// The temp file as an in-kernel copy of f->copy_from. Anything but an
+// exact copy of the staged bytes is left for the caller to write out.
+static int clone_stream(xm_txn_file *f, const char *temp)
+{
+    f->temp_written = 1;
+    if (xm_clone_file(f->copy_from, temp, f->new_size) != XM_OK || xm_file_size(temp) != (long)f->new_size)
+        return XM_ERR_WRITE;
+    XM_COUNT(XM_CTR_FILES_OPENED, 1);
+    XM_COUNT(XM_CTR_BYTES_WRITTEN, f->new_size);
+    if (XM_TXN_GROUP_SYNC)
+        return XM_OK;
+
+    FILE *fp = fopen(temp, "r+b");
+    if (!fp)
+        return XM_ERR_OPEN;
+    int err = sync_stream(fp);
+    return fclose(fp) != 0 ? XM_ERR_WRITE : err;
+}
+
+static int abort_commit(xm_txn *txn, int err)
+{
+    remove_temps(txn);
+    for (int i = 0; i < txn->count; i++)
+        txn->files[i].status = err;
+    return err;
+}
+
+int xm_txn_commit(xm_txn *txn)
+{
+    if (txn->count == 0)
+        return XM_OK;
+
+    // 1) New contents to temp files beside their targets
+    char temp[1024];
+    for (int i = 0; i < txn->count; i++)
+    {
+        xm_txn_file *f = &txn->files[i];
+        int err = temp_path(f->path, temp, sizeof(temp));
+        if (err == XM_OK && f->copy_from && clone_stream(f, temp) == XM_OK)
+            continue;
+        FILE *fp = err == XM_OK ? fopen(temp, "wb") : NULL;
+        if (err == XM_OK && !fp)
+            err = XM_ERR_OPEN;
+        if (fp)
+        {
+            f->temp_written = 1;
+            err = write_stream(fp, f->new_data, f->new_size);
+        }
+        if (err != XM_OK)
+            return abort_commit(txn, err);
+    }
+
+    // 2) The old bytes of every changed range, as one journal record
+    journal_tail journal_prev = {0, 0};
+    if (txn->journal_path)
+    {
+        xm_buf rec;
+        xm_buf_init(&rec);
+        encode_record(&rec, txn);
+        int err = rec.failed ? XM_ERR_NOMEM : append_journal(txn->journal_path, &rec, &journal_prev);
+        xm_buf_free(&rec);
+        if (err != XM_OK)
+        {
+            rollback_journal(txn->journal_path, &journal_prev);
+            return abort_commit(txn, err);
+        }
+    }
+
+    // 3) One barrier before anything becomes visible
+    int err = group_sync(txn, 0);
+    if (err != XM_OK)
+    {
+        if (txn->journal_path)
+            rollback_journal(txn->journal_path, &journal_prev);
+        return abort_commit(txn, err);
+    }
+
+    // 4) Publish
+    int result = XM_OK;
+    for (int i = 0; i < txn->count; i++)
+    {
+        xm_txn_file *f = &txn->files[i];
+        temp_path(f->path, temp, sizeof(temp));
+        f->status = publish(temp, f->path);
+        if (f->status == XM_OK)
+            f->temp_written = 0;
+        else
+            result = f->status;
+    }
+
+    // 5) The renames themselves; published files stay so, but a failed
+    // barrier means they may not survive a crash, which the caller hears
+    err = group_sync(txn, 1);
+    if (result == XM_OK)
+        result = err;
+    remove_temps(txn);
+    return result;
+}
+
+int xm_txn_update_headers(xm_txn *txn)
+{
+    if (txn->count == 0)
+        return 0;
+    uint8_t **data = malloc((size_t)txn->count * sizeof(*data));
+    size_t *sizes = malloc((size_t)txn->count * sizeof(*sizes));
+    int *changed = malloc((size_t)txn->count * sizeof(*changed));
+    if (!data || !sizes || !changed)
+    {
+        free(data);
+        free(sizes);
+        free(changed);
+        return XM_ERR_NOMEM;
+    }
+
+    for (int i = 0; i < txn->count; i++)
+    {
+        data[i] = txn->files[i].new_data;
+        sizes[i] = txn->files[i].new_size;
+    }
+    xm_header_update_many(data, sizes, (size_t)txn->count, changed);
+
+    int updated = 0;
+    for (int i = 0; i < txn->count; i++)
+    {
+        updated += changed[i];
+        if (changed[i])
+        {
+            free(txn->files[i].copy_from);
+            txn->files[i].copy_from = NULL;
+        }
+    }
+    free(data);
+    free(sizes);
+    free(changed);
+    return updated;
+}
+
+int xm_txn_count(const xm_txn *txn)
+{
+    return txn->count;
+}
+
+const char *xm_txn_path(const xm_txn *txn, int i)
+{
+    return txn->files[i].path;
+}
+
+void xm_txn_data(const xm_txn *txn, int i,
+                 const uint8_t **old_data, size_t *old_size,
+                 const uint8_t **new_data, size_t *new_size)
+{
+    const xm_txn_file *f = &txn->files[i];
+    *old_data = f->old_data;
+    *old_size = f->old_size;
+    *new_data = f->new_data;
+    *new_size = f->new_size;
+}
+
+int xm_txn_status(const xm_txn *txn, int i)
+{
+    return txn->files[i].status;
+}
+
+void xm_txn_free(xm_txn *txn)
+{
+    if (!txn)
+        return;
+    remove_temps(txn);
+    for (int i = 0; i < txn->count; i++)
+    {
+        free(txn->files[i].path);
+        free(txn->files[i].old_data);
+        free(txn->files[i].new_data);
+        free(txn->files[i].copy_from);
+    }
+    free(txn->files);
+    free(txn->journal_path);
+    free(txn);
+}
+
+// -------------------------------------------------------------------
+// Undo
+// -------------------------------------------------------------------
+typedef struct
+{
+    const uint8_t *p;
+    size_t len;
+    size_t pos;
+    int bad;
+} reader;
+
+static const uint8_t *take(reader *r, size_t n)
+{
+    if (r->bad || n > r->len - r->pos)
+    {
+        r->bad = 1;
+        return NULL;
+    }
+    const uint8_t *p = r->p + r->pos;
+    r->pos += n;
+    return p;
+}
+
+static uint32_t take_u32(reader *r)
+{
+    const uint8_t *p = take(r, 4);
+    return p ? get_u32(p) : 0;
+}
+
+static uint16_t take_u16(reader *r)
+{
+    const uint8_t *p = take(r, 2);
+    return p ? (uint16_t)(p[0] | (p[1] << 8)) : 0;
+}
+
+/**
+ * Rolls the staged contents of each file in one record back to the state
+ * before that record's commit. Records are reverted newest first, so a file
+ * in several of them ends up as it was before the oldest.
+ */
+static int revert_record(xm_txn *txn, const uint8_t *body, size_t body_len)
+{
+    reader r = {body, body_len, 0, 0};
+    take(&r, 8); // unix_time
+    uint32_t files = take_u32(&r);
+
+    for (uint32_t i = 0; i < files && !r.bad; i++)
+    {
+        char path[1024];
+        uint16_t path_len = take_u16(&r);
+        const uint8_t *path_bytes = take(&r, path_len);
+        uint32_t old_size = take_u32(&r);
+        uint32_t new_size = take_u32(&r);
+        uint32_t ranges = take_u32(&r);
+        if (r.bad || path_len >= sizeof(path))
+            return XM_ERR_FORMAT;
+        memcpy(path, path_bytes, path_len);
+        path[path_len] = '\0';
+
+        xm_txn_file *f = find_file(txn, path);
+        if (!f)
+        {
+            uint8_t *cur;
+            size_t cur_size;
+            int err = xm_read_file(path, &cur, &cur_size);
+            if (err != XM_OK)
+                return err;
+            err = xm_txn_stage(txn, path, cur, cur_size, cur, cur_size);
+            xm_free(cur);
+            if (err != XM_OK)
+                return err;
+            f = find_file(txn, path);
+        }
+
+        // The file must still be the size this commit left it at
+        if (f->new_size != new_size)
+            return XM_ERR_FORMAT;
+        if (old_size != new_size)
+        {
+            uint8_t *resized = realloc(f->new_data, old_size ? old_size : 1);
+            if (!resized)
+                return XM_ERR_NOMEM;
+            f->new_data = resized;
+            f->new_size = old_size;
+        }
+
+        for (uint32_t k = 0; k < ranges; k++)
+        {
+            uint32_t offset = take_u32(&r);
+            uint32_t len = take_u32(&r);
+            const uint8_t *bytes = take(&r, len);
+            if (r.bad || offset > old_size || len > old_size - offset)
+                return XM_ERR_FORMAT;
+            memcpy(f->new_data + offset, bytes, len);
+        }
+    }
+    return r.bad ? XM_ERR_FORMAT : XM_OK;
+}
+
+int xm_txn_undo(const char *journal_path, int count, xm_txn **out)
+{
+    xm_txn *txn = xm_txn_begin(NULL);
+    *out = txn;
+    if (!txn)
+        return XM_ERR_NOMEM;
+
+    uint8_t *data;
+    size_t size;
+    int err = xm_read_file(journal_path, &data, &size);
+    if (err == XM_ERR_OPEN)
+        return 0; // nothing committed yet
+    if (err != XM_OK)
+        return err;
+
+    size_t base, limit, valid_end;
+    size_t *starts;
+    int records;
+    journal_bounds(data, size, &base, &limit);
+    err = scan_journal(data + base, limit - base, &starts, &records, &valid_end);
+
+    int n = count < 0 ? 0 : (count < records ? count : records);
+    for (int i = records - 1; err == XM_OK && i >= records - n; i--)
+    {
+        size_t body_len = get_u32(data + base + starts[i] + 4);
+        err = revert_record(txn, data + base + starts[i] + JOURNAL_HEADER, body_len);
+    }
+
+    if (err == XM_OK && n > 0)
+    {
+        err = xm_txn_commit(txn);
+
+        // Once every file is back, its records go, even if the final
+        // barrier failed: reverting them again would find the files moved on
+        int published = 1;
+        for (int i = 0; i < txn->count; i++)
+            published &= txn->files[i].status == XM_OK;
+        if (published)
+        {
+            size_t end = base + starts[records - n];
+            size_t last = records > n ? base + starts[records - n - 1] : end;
+            int cut = cut_journal(journal_path, base, last, end);
+            if (err == XM_OK)
+                err = cut;
+        }
+    }
+
+    free(starts);
+    xm_free(data);
+    return err == XM_OK ? n : err;
+}
+
+int xm_txn_trim(const char *journal_path, int keep, long long max_age)
+{
+    if (xm_file_size(journal_path) < 0)
+        return 0; // nothing committed yet
+    int removed;
+    int err = compact_journal(journal_path, keep, max_age, JOURNAL_MAX_SIZE, 0, &removed);
+    return err == XM_OK ? removed : err;
+}
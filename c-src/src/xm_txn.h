@@ -0,0 +1,115 @@
+#ifndef XM_TXN_H
+#define XM_TXN_H
+
+/**
+ * Crash-safe group commit of rewritten mcr*.dat files, with an undo journal.
+ *
+ *   xm_txn_stage()   queues the new contents of a file in memory
+ *   xm_txn_commit()  writes every file to "<path>.xmtmp", appends one
+ *                    journal record holding the old bytes of the ranges that
+ *                    change, makes all of it durable with one grouped sync,
+ *                    then publishes each file with an atomic rename
+ *   xm_txn_undo()    reverts the newest N journal records
+ *
+ * A crash before the renames leaves every target untouched; a crash during
+ * them leaves a journal record that undoes whichever files were published.
+ * The journal is appended to, except that undo truncates the records it
+ * reverts, xm_txn_trim() drops old ones, and past 16 MB the oldest are
+ * dropped as new ones are added.
+ */
+
+#include "ximacro.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define XM_JOURNAL_PATH "macro_backup/journal.bin"
+
+typedef struct xm_txn xm_txn;
+
+/**
+ * Starts a transaction journaled to 'journal_path' (NULL for none).
+ * Returns NULL when out of memory.
+ */
+XM_API xm_txn *xm_txn_begin(const char *journal_path);
+
+/**
+ * Queues 'new_data' as the next contents of 'path', whose current contents
+ * are 'old_data'. Staging the same path again replaces its new contents but
+ * keeps the old ones from the first call.
+ */
+XM_API int xm_txn_stage(xm_txn *txn, const char *path,
+                        const uint8_t *old_data, size_t old_size,
+                        const uint8_t *new_data, size_t new_size);
+
+/**
+ * xm_txn_stage() for new contents that are byte for byte those of the file
+ * 'src_path' ('new_data' holds them too). The commit then copies that file
+ * in the kernel (see xm_clone_file()) instead of writing the bytes, unless
+ * they change again before it.
+ */
+XM_API int xm_txn_stage_copy(xm_txn *txn, const char *path,
+                             const uint8_t *old_data, size_t old_size,
+                             const uint8_t *new_data, size_t new_size,
+                             const char *src_path);
+
+/**
+ * Returns 1 and the staged contents of 'path' if it is part of 'txn'.
+ */
+XM_API int xm_txn_staged(const xm_txn *txn, const char *path, const uint8_t **data, size_t *size);
+
+/**
+ * Recomputes the header MD5 (see xm_header_update_many()) of every staged
+ * file's new contents. Returns how many changed, or XM_ERR_NOMEM.
+ */
+XM_API int xm_txn_update_headers(xm_txn *txn);
+
+/**
+ * Commits every staged file. Returns XM_OK if all of them were published
+ * and made durable; otherwise check xm_txn_status() per file (a file
+ * can be published, XM_OK, while the barrier after the renames failed).
+ */
+XM_API int xm_txn_commit(xm_txn *txn);
+
+XM_API int xm_txn_count(const xm_txn *txn);
+XM_API const char *xm_txn_path(const xm_txn *txn, int i);
+
+/**
+ * Old (as staged first) and new contents of file 'i'.
+ */
+XM_API void xm_txn_data(const xm_txn *txn, int i,
+                        const uint8_t **old_data, size_t *old_size,
+                        const uint8_t **new_data, size_t *new_size);
+
+/**
+ * XM_OK once file 'i' has been published, else the XM_ERR_* that stopped it.
+ */
+XM_API int xm_txn_status(const xm_txn *txn, int i);
+
+/**
+ * Releases 'txn', removing any temp files it left unpublished.
+ */
+XM_API void xm_txn_free(xm_txn *txn);
+
+/**
+ * Reverts the newest 'count' records of the journal at 'journal_path' and
+ * removes them from it. '*out' receives the committed restore transaction
+ * (free with xm_txn_free()) for per-file results. Returns the number of
+ * records reverted or a negative XM_ERR_* code.
+ */
+XM_API int xm_txn_undo(const char *journal_path, int count, xm_txn **out);
+
+/**
+ * Drops the journal's records beyond the newest 'keep' (keep < 0: no
+ * limit) and those older than 'max_age' seconds (max_age < 0: no limit).
+ * Returns the number of records dropped or a negative XM_ERR_* code.
+ */
+XM_API int xm_txn_trim(const char *journal_path, int keep, long long max_age);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_TXN_H
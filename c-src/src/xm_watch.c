@@ -0,0 +1,250 @@
+#include "xm_watch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(XM_HAVE_INOTIFY)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+static const char *const TTL_NAMES[XM_WATCH_TTL_COUNT] = {"mcr.ttl", "mcr_2.ttl"};
+
+// A folder that never goes quiet is still reported this often
+#define DEBOUNCE_CAP_FACTOR 10
+
+typedef struct
+{
+    long long size; // -1: absent
+    long long mtime_ns;
+} stamp;
+
+struct xm_watch
+{
+    char dir[768];
+    xm_watch_backend backend;
+    int poll_ms;
+    int fd; // inotify
+    stamp stamps[XM_WATCH_SLOTS]; // polling
+};
+
+static void sleep_ms(int ms)
+{
+#if defined(_WIN32)
+    Sleep((DWORD)ms);
+#else
+    struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static int slot_of(const char *name)
+{
+    int index = xm_file_index(name);
+    if (index >= 0)
+        return index;
+    for (int i = 0; i < XM_WATCH_TTL_COUNT; i++)
+    {
+        if (strcmp(name, TTL_NAMES[i]) == 0)
+            return XM_WATCH_TTL_SLOT + i;
+    }
+    return -1;
+}
+
+int xm_watch_slot_path(const char *dir, int slot, char *out, size_t cap)
+{
+    if (slot < 0 || slot >= XM_WATCH_SLOTS)
+        return XM_ERR_RANGE;
+    if (slot < XM_WATCH_TTL_SLOT)
+        return xm_file_path(dir, slot, out, cap);
+
+    int n = snprintf(out, cap, "%s" XM_PATH_SEP_STR "%s", dir, TTL_NAMES[slot - XM_WATCH_TTL_SLOT]);
+    return (n < 0 || (size_t)n >= cap) ? XM_ERR_RANGE : XM_OK;
+}
+
+const char *xm_watch_backend_name(xm_watch_backend backend)
+{
+    return backend == XM_WATCH_INOTIFY ? "inotify" : "poll";
+}
+
+xm_watch_backend xm_watch_backend_used(const xm_watch *w)
+{
+    return w->backend;
+}
+
+// -------------------------------------------------------------------
+// Polling
+// -------------------------------------------------------------------
+static int poll_round(xm_watch *w, uint8_t changed[XM_WATCH_SLOTS])
+{
+    char path[1024];
+    int count = 0;
+    for (int slot = 0; slot < XM_WATCH_SLOTS; slot++)
+    {
+        stamp now = {-1, 0};
+        if (xm_watch_slot_path(w->dir, slot, path, sizeof(path)) == XM_OK)
+            xm_file_stamp(path, &now.size, &now.mtime_ns);
+
+        stamp *was = &w->stamps[slot];
+        if (now.size != was->size || now.mtime_ns != was->mtime_ns)
+        {
+            *was = now;
+            if (changed)
+            {
+                count += !changed[slot];
+                changed[slot] = 1;
+            }
+        }
+    }
+    return count;
+}
+
+static int poll_next(xm_watch *w, int debounce_ms, uint8_t changed[XM_WATCH_SLOTS])
+{
+    int count = 0;
+    while (count == 0)
+    {
+        sleep_ms(w->poll_ms);
+        count = poll_round(w, changed);
+    }
+
+    int step = debounce_ms < w->poll_ms ? debounce_ms : w->poll_ms;
+    double start = xm_now_ms();
+    double last = start;
+    while (xm_now_ms() - last < debounce_ms && xm_now_ms() - start < (double)debounce_ms * DEBOUNCE_CAP_FACTOR)
+    {
+        sleep_ms(step > 0 ? step : 1);
+        int more = poll_round(w, changed);
+        if (more > 0)
+            last = xm_now_ms();
+        count += more;
+    }
+    return count;
+}
+
+// -------------------------------------------------------------------
+// inotify
+// -------------------------------------------------------------------
+#if defined(XM_HAVE_INOTIFY)
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+// Reads whatever events are queued; XM_ERR_OPEN once the folder is gone
+static int inotify_drain(xm_watch *w, uint8_t changed[XM_WATCH_SLOTS], int *count)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(w->fd, buf, sizeof(buf));
+    if (len <= 0)
+        return XM_ERR_READ;
+
+    for (char *p = buf; p < buf + len;)
+    {
+        const struct inotify_event *ev = (const struct inotify_event *)p;
+        if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT))
+            return XM_ERR_OPEN;
+        int slot = ev->len > 0 ? slot_of(ev->name) : -1;
+        if (slot >= 0 && !changed[slot])
+        {
+            changed[slot] = 1;
+            (*count)++;
+        }
+        p += sizeof(*ev) + ev->len;
+    }
+    return XM_OK;
+}
+
+static int inotify_next(xm_watch *w, int debounce_ms, uint8_t changed[XM_WATCH_SLOTS])
+{
+    struct pollfd pfd = {w->fd, POLLIN, 0};
+    int count = 0;
+    int err;
+    while (count == 0)
+    {
+        if (poll(&pfd, 1, -1) < 0)
+            return XM_ERR_READ;
+        if ((err = inotify_drain(w, changed, &count)) != XM_OK)
+            return err;
+    }
+
+    double start = xm_now_ms();
+    while (xm_now_ms() - start < (double)debounce_ms * DEBOUNCE_CAP_FACTOR)
+    {
+        int ready = poll(&pfd, 1, debounce_ms);
+        if (ready == 0)
+            break; // quiet for a whole debounce period
+        if (ready < 0 || (err = inotify_drain(w, changed, &count)) != XM_OK)
+            return ready < 0 ? XM_ERR_READ : err;
+    }
+    return count;
+}
+#endif
+
+// -------------------------------------------------------------------
+// Public API
+// -------------------------------------------------------------------
+xm_watch *xm_watch_open(const char *dir, xm_watch_backend backend, int poll_ms)
+{
+    xm_watch *w = calloc(1, sizeof(*w));
+    if (!w)
+        return NULL;
+    snprintf(w->dir, sizeof(w->dir), "%s", dir);
+    w->poll_ms = poll_ms > 0 ? poll_ms : 500;
+    w->fd = -1;
+    w->backend = XM_WATCH_POLL;
+
+#if defined(XM_HAVE_INOTIFY)
+    if (backend == XM_WATCH_INOTIFY)
+    {
+        w->fd = inotify_init1(IN_CLOEXEC);
+        if (w->fd >= 0 && inotify_add_watch(w->fd, dir, INOTIFY_MASK) >= 0)
+        {
+            w->backend = XM_WATCH_INOTIFY;
+            return w;
+        }
+        if (w->fd >= 0)
+            close(w->fd);
+        w->fd = -1;
+    }
+#else
+    (void)backend;
+#endif
+
+    // Baseline stamps, so only later changes are reported
+    for (int slot = 0; slot < XM_WATCH_SLOTS; slot++)
+        w->stamps[slot].size = -1;
+    poll_round(w, NULL);
+    if (xm_file_size(dir) < 0)
+    {
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+int xm_watch_next(xm_watch *w, int debounce_ms, uint8_t changed[XM_WATCH_SLOTS])
+{
+    memset(changed, 0, XM_WATCH_SLOTS);
+#if defined(XM_HAVE_INOTIFY)
+    if (w->backend == XM_WATCH_INOTIFY)
+        return inotify_next(w, debounce_ms, changed);
+#endif
+    return poll_next(w, debounce_ms, changed);
+}
+
+void xm_watch_close(xm_watch *w)
+{
+    if (!w)
+        return;
+#if defined(XM_HAVE_INOTIFY)
+    if (w->fd >= 0)
+        close(w->fd);
+#endif
+    free(w);
+}
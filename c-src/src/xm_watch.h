@@ -0,0 +1,64 @@
+#ifndef XM_WATCH_H
+#define XM_WATCH_H
+
+/**
+ * Change notification for one character folder: every mcr*.dat plus the
+ * book title files mcr.ttl and mcr_2.ttl.
+ *
+ *   XM_WATCH_INOTIFY  kernel events on the folder (Linux)
+ *   XM_WATCH_POLL     size/mtime of every file, re-checked each interval
+ *
+ * A write is reported once the folder has been quiet for the debounce
+ * time, so a client saving many files at once yields a single batch.
+ * Reports are hints: a file may come back unchanged (same bytes
+ * rewritten), so compare contents before acting on them.
+ */
+
+#include "ximacro.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Slots 0..XM_MAX_FILE_INDEX are the mcr*.dat files, then the .ttl files
+#define XM_WATCH_TTL_SLOT XM_FILE_COUNT
+#define XM_WATCH_TTL_COUNT 2
+#define XM_WATCH_SLOTS (XM_FILE_COUNT + XM_WATCH_TTL_COUNT)
+
+typedef enum xm_watch_backend
+{
+    XM_WATCH_INOTIFY = 0,
+    XM_WATCH_POLL
+} xm_watch_backend;
+
+typedef struct xm_watch xm_watch;
+
+/**
+ * Starts watching 'dir'. 'backend' falls back to XM_WATCH_POLL when it
+ * isn't available; 'poll_ms' is the polling interval. NULL on failure.
+ */
+XM_API xm_watch *xm_watch_open(const char *dir, xm_watch_backend backend, int poll_ms);
+
+XM_API xm_watch_backend xm_watch_backend_used(const xm_watch *w);
+XM_API const char *xm_watch_backend_name(xm_watch_backend backend);
+
+/**
+ * Blocks until some slot changes and then 'debounce_ms' pass without
+ * further changes. Sets changed[slot] for each one and returns how many,
+ * or a negative XM_ERR_* code (e.g. the folder was removed).
+ */
+XM_API int xm_watch_next(xm_watch *w, int debounce_ms, uint8_t changed[XM_WATCH_SLOTS]);
+
+/**
+ * Writes "<dir><sep><file>" for a slot into 'out'.
+ */
+XM_API int xm_watch_slot_path(const char *dir, int slot, char *out, size_t cap);
+
+XM_API void xm_watch_close(xm_watch *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XM_WATCH_H
@@ -0,0 +1,42 @@
+# Runs one tool and compares its stdout with a checked-in expected file.
+#
+#   cmake -DTOOL=<exe> -DARGS="<args>" -DWORKDIR=<dir> -DEXPECTED=<file>
+#         -DACTUAL=<file> -P golden.cmake
+#
+# ARGS is split like a shell command line. The output is kept in ACTUAL
+# for inspection. With XIMACRO_UPDATE_GOLDEN set in the environment, the
+# output is copied over EXPECTED instead of compared, for changes to the
+# output that are intended.
+
+separate_arguments(args UNIX_COMMAND "${ARGS}")
+execute_process(
+    COMMAND "${TOOL}" ${args}
+    WORKING_DIRECTORY "${WORKDIR}"
+    OUTPUT_FILE "${ACTUAL}"
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${TOOL} ${ARGS} failed (${result}):\n${errors}")
+endif()
+
+# Paths in text output are joined with the native separator; the expected
+# files use '/'
+if(CMAKE_HOST_WIN32 AND NOT ACTUAL MATCHES "\\.xmb$")
+    file(READ "${ACTUAL}" output)
+    string(REPLACE "\\\\mcr" "/mcr" output "${output}")
+    file(WRITE "${ACTUAL}" "${output}")
+endif()
+
+if(DEFINED ENV{XIMACRO_UPDATE_GOLDEN})
+    execute_process(COMMAND "${CMAKE_COMMAND}" -E copy "${ACTUAL}" "${EXPECTED}")
+    message(STATUS "Updated ${EXPECTED}")
+    return()
+endif()
+
+execute_process(
+    COMMAND "${CMAKE_COMMAND}" -E compare_files "${ACTUAL}" "${EXPECTED}"
+    RESULT_VARIABLE differs)
+if(differs)
+    message(FATAL_ERROR "Output of ${TOOL} ${ARGS} differs from ${EXPECTED} (see ${ACTUAL}); "
+                        "set XIMACRO_UPDATE_GOLDEN=1 to accept it")
+endif()
@@ -0,0 +1,76 @@
+# Patches one line of the corpus' mcr.dat (Shift-JIS text and phrases on
+# the same page) with ximacro_i --json-patch and checks that every other
+# byte of the file, bar the header's MD5, is unchanged.
+#
+#   cmake -DTOOL=<ximacro_i> -DCORPUS=<USER/golden> -DWORKDIR=<dir>
+#         -P json_patch.cmake
+#
+# The patch's "test" ops compare against the decoded text of the export.
+
+set(macro_start 28)  # XM_MACRO_START
+set(line_size 61)    # XM_LINE_SIZE
+set(macro_size 380)  # XM_MACRO_SIZE
+set(md5_start 8)     # the header's MD5, 0x08..0x18
+set(md5_end 24)
+
+# Macro 13, line 5
+math(EXPR field_start "${macro_start} + 13 * ${macro_size} + 5 * ${line_size}")
+math(EXPR field_end "${field_start} + ${line_size}")
+
+file(REMOVE_RECURSE "${WORKDIR}")
+file(MAKE_DIRECTORY "${WORKDIR}/USER/patch")
+file(COPY "${CORPUS}/mcr.dat" DESTINATION "${WORKDIR}/USER/patch")
+
+file(WRITE "${WORKDIR}/patch.json" [=[
+{
+  "dir": "USER/patch",
+  "patch": [
+    {"op": "test", "path": "/0/macros/13/lines/0", "value": "/ma \"ケアル\" <t>"},
+    {"op": "test", "path": "/0/macros/13/lines/2", "value": "/p {AT:02020501} please {AT:0202130A}"},
+    {"op": "test", "path": "/0/macros/13/lines/3", "value": "{x7B}x41} {x7B}AT:01020304} {x00} {AT:0102030} { {{x7B}x7B}"},
+    {"op": "replace", "path": "/0/macros/13/lines/5", "value": "/echo patched"}
+  ]
+}
+]=])
+
+execute_process(
+    COMMAND "${TOOL}" --json-patch
+    WORKING_DIRECTORY "${WORKDIR}"
+    INPUT_FILE "${WORKDIR}/patch.json"
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${TOOL} --json-patch failed (${result}):\n${output}${errors}")
+endif()
+
+file(READ "${CORPUS}/mcr.dat" before HEX)
+file(READ "${WORKDIR}/USER/patch/mcr.dat" after HEX)
+string(LENGTH "${before}" before_len)
+string(LENGTH "${after}" after_len)
+if(NOT before_len EQUAL after_len)
+    message(FATAL_ERROR "The patch changed the size of mcr.dat:\n${output}${errors}")
+endif()
+
+# Compares the bytes [from, to) of both files (two hex digits a byte)
+function(check_unchanged from to what)
+    math(EXPR at "${from} * 2")
+    math(EXPR len "(${to} - ${from}) * 2")
+    string(SUBSTRING "${before}" ${at} ${len} old)
+    string(SUBSTRING "${after}" ${at} ${len} new)
+    if(NOT old STREQUAL new)
+        message(FATAL_ERROR "The patch changed ${what} of mcr.dat:\n${output}${errors}")
+    endif()
+endfunction()
+
+math(EXPR file_end "${before_len} / 2")
+check_unchanged(0 ${md5_start} "the header")
+check_unchanged(${md5_end} ${field_start} "fields before the patched line")
+check_unchanged(${field_end} ${file_end} "fields after the patched line")
+
+math(EXPR at "${field_start} * 2")
+string(SUBSTRING "${after}" ${at} 26 patched)
+string(TOLOWER "${patched}" patched)
+if(NOT patched STREQUAL "2f6563686f2070617463686564")  # "/echo patched"
+    message(FATAL_ERROR "The patched line was not written:\n${output}${errors}")
+endif()
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ximacro.h"
+
+// -------------------------------------------------------------------
+// ximacro_test_corpus: writes the small, fixed character folder the
+// golden-output tests export, as <USER directory>/golden.
+//
+//   ximacro_test_corpus <USER directory>
+//
+// The folder is the same on every run and platform, and covers what the
+// encoders have to get right: JSON escapes and control bytes, every byte
+// value at many positions and alignments, fields filled to the last byte
+// with no NUL, Shift-JIS text and auto-translate phrases, '{' next to
+// token-shaped text, a file cut short mid-macro, pages in two books and
+// a title file.
+// -------------------------------------------------------------------
+
+#define FILE_SIZE (XM_HEADER_SIZE + XM_MACROS_PER_FILE * XM_MACRO_SIZE)
+#define TTL_SIZE (XM_HEADER_SIZE + 20 * 16)
+#define TITLE_SIZE 16
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef struct
+{
+    int macro;
+    int field; // 0-5, or XM_FIELD_NAME
+    const char *text;
+} field_text;
+
+// Page 0: the hand-picked cases
+static const field_text PAGE0[] = {
+    {0, 0, "/ma \"Cure\" <t>"},
+    {0, 1, "/echo back\\slash \"quoted\" and /slash"},
+    {0, 2, "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0A\x0B\x0C\x0D\x0E\x0F\x10"
+           "\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1A\x1B\x1C\x1D\x1E\x1F\x7F end"},
+    {0, 3, "/p 0123456789012345678901234567890123456789012345678901234567"}, // 61 bytes
+    {0, 5, "/wait 1"},
+    {0, XM_FIELD_NAME, "Cure"},
+
+    // Shift-JIS: ケアル, 日本語, half-width ｱｲｳ, and a phrase
+    {13, 0, "/ma \"\x83\x50\x83\x41\x83\x8B\" <t>"},
+    {13, 1, "\x93\xFA\x96\x7B\x8C\xEA \xB1\xB2\xB3"},
+    {13, 2, "/p \xFD\x02\x02\x05\x01\xFD please \xFD\x02\x02\x13\x0A\xFD"},
+    // Text that reads like the escapes of decoded text
+    {13, 3, "{x41} {AT:01020304} {x00} {AT:0102030} { {{x7B}"},
+    // A pair, a phrase and stray bytes that are not characters
+    {13, 4, "\x82\x20 \x81 \xFD\x01\x02\xFD \x80\xA0\xFF\xFE"},
+    {13, XM_FIELD_NAME, "\x96\xBC\x91\x4F"},
+
+    // Cut by the end of the field: a pair, then a phrase
+    {14, 0, "/p 012345678901234567890123456789012345678901234567890123456\x82"},
+    {14, 1, "/p 0123456789012345678901234567890123456789012345678901\xFD\x02\x02\x05\x01\xFD"},
+    {14, XM_FIELD_NAME, "ABCDEFGHIJKLMN"}, // 14 bytes
+
+    {19, XM_FIELD_NAME, "Last"},
+};
+
+static const field_text PAGE1[] = {
+    {0, 0, "/ja \"Fire\" <t>"},
+    {0, XM_FIELD_NAME, "Fire"},
+    {1, 0, "/ja \"Blizzard\" <t>"},
+    {1, 1, "/wait 2"},
+    {1, 2, "/p cut short here"},
+};
+
+static const field_text PAGE12[] = {
+    {0, 0, "/equipset 12"},
+    {0, XM_FIELD_NAME, "Set12"},
+    {7, 3, "/echo book 2, page 3"},
+};
+
+static const char *const TITLES[20] = {
+    "Main",
+    "Quote \"x\"",
+    "SixteenCharTitle",
+    "\x93\xFA\x96\x7B",
+    "back\\slash",
+};
+
+static void set_fields(uint8_t *data, size_t size, const field_text *fields, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const field_text *f = &fields[i];
+        xm_set_field(data, size, f->macro, f->field, f->text, strlen(f->text), NULL);
+    }
+}
+
+// Macros 1-12 of page 0: every byte value 1-255 in turn, each line and name
+// starting where the last left off, so values land at many offsets
+static void set_byte_sweep(uint8_t *data, size_t size)
+{
+    unsigned value = 0;
+    for (int m = 1; m <= 12; m++)
+    {
+        for (int field = 0; field <= XM_LINES_PER_MACRO; field++)
+        {
+            char text[XM_LINE_SIZE];
+            size_t len = field < XM_LINES_PER_MACRO ? XM_LINE_SIZE : XM_NAME_SIZE;
+            for (size_t j = 0; j < len; j++)
+                text[j] = (char)(1 + value++ % 255);
+            xm_set_field(data, size, m, field < XM_LINES_PER_MACRO ? field : XM_FIELD_NAME, text, len, NULL);
+        }
+    }
+}
+
+static int write_page(const char *dir, int index, size_t size, const field_text *fields, size_t count,
+                      int sweep)
+{
+    static uint8_t data[FILE_SIZE];
+    char path[1024];
+    memset(data, 0, sizeof(data));
+    data[0] = 1; // version
+    set_fields(data, size, fields, count);
+    if (sweep)
+        set_byte_sweep(data, size);
+    xm_header_update(data, size);
+
+    int err = xm_file_path(dir, index, path, sizeof(path));
+    return err == XM_OK ? xm_write_file(path, data, size) : err;
+}
+
+static int write_titles(const char *dir)
+{
+    uint8_t data[TTL_SIZE] = {0};
+    char path[1024];
+    for (int i = 0; i < 20; i++)
+    {
+        char fallback[TITLE_SIZE];
+        const char *title = TITLES[i];
+        if (!title)
+        {
+            snprintf(fallback, sizeof(fallback), "Book %d", i + 1);
+            title = fallback;
+        }
+        size_t len = strlen(title);
+        memcpy(data + XM_HEADER_SIZE + i * TITLE_SIZE, title, len < TITLE_SIZE ? len : TITLE_SIZE);
+    }
+    int n = snprintf(path, sizeof(path), "%s" XM_PATH_SEP_STR "mcr.ttl", dir);
+    if (n < 0 || (size_t)n >= sizeof(path))
+        return XM_ERR_RANGE;
+    return xm_write_file(path, data, sizeof(data));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <USER directory>\n", argv[0]);
+        return 1;
+    }
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s" XM_PATH_SEP_STR "golden", argv[1]);
+
+    // Page 1 stops two lines and a bit into its second macro
+    size_t short_size = XM_MACRO_START + XM_MACRO_SIZE + 2 * XM_LINE_SIZE + 10;
+
+    int err = xm_ensure_dir(argv[1]);
+    if (err == XM_OK)
+        err = xm_ensure_dir(dir);
+    if (err == XM_OK)
+        err = write_page(dir, 0, FILE_SIZE, PAGE0, COUNT_OF(PAGE0), 1);
+    if (err == XM_OK)
+        err = write_page(dir, 1, short_size, PAGE1, COUNT_OF(PAGE1), 0);
+    if (err == XM_OK)
+        err = write_page(dir, 12, FILE_SIZE, PAGE12, COUNT_OF(PAGE12), 0);
+    if (err == XM_OK)
+        err = write_titles(dir);
+
+    if (err != XM_OK)
+    {
+        fprintf(stderr, "Could not write the corpus to '%s': %s.\n", dir, xm_strerror(err));
+        return 1;
+    }
+    return 0;
+}
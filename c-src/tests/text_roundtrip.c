@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "xm_text.h"
+
+// -------------------------------------------------------------------
+// ximacro_test_text: checks that decoding a field to text and encoding
+// the text gives back the field's bytes (up to its first NUL).
+//
+//   ximacro_test_text             run the checks
+//   ximacro_test_text --vectors   print the shared test vectors
+//
+// The checks put every byte value at every position of a line and a
+// name, after each kind of text that changes how it reads (ASCII, a
+// Shift-JIS lead, 0xFD, '{' and the starts of tokens); every lead and
+// trail pair, whole and cut by the field end; every byte inside an
+// auto-translate phrase; and '{' next to token-shaped text.
+//
+// Each field is also checked in the form of a version 1 binary stream,
+// as src/lib/macro-binary.ts decodes it: ASCII as is, other bytes as
+// {xHH}, and a '{' that would read as a token as {x7B}.
+//
+// The vectors (golden/text-vectors.jsonl) are a sample of the same cases
+// as JSON lines of the bytes, their text and their version 1 text. The
+// TypeScript codec's tests check it against them, so both sides agree.
+// -------------------------------------------------------------------
+
+#define AT_MARK 0xFD
+
+static const char HEX[] = "0123456789ABCDEF";
+
+static long g_checks;
+static long g_failures;
+
+// Version 1 text of 'len' bytes: each ASCII run decodes as it does in a
+// field, since it has no characters but tokens to escape
+static void raw_text(xm_buf *b, const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t run = 0;
+        while (i + run < len && src[i + run] < 0x80)
+            run++;
+        xm_text_decode(b, src + i, run);
+        i += run;
+        if (i < len)
+        {
+            char token[] = {'{', 'x', HEX[src[i] >> 4], HEX[src[i] & 0x0F], '}'};
+            xm_buf_append(b, token, sizeof(token));
+            i++;
+        }
+    }
+}
+
+static void print_hex(FILE *fp, const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        fprintf(fp, "%02X", src[i]);
+}
+
+static void fail(const char *what, const uint8_t *field, size_t size, const xm_buf *text)
+{
+    if (++g_failures > 20)
+        return;
+    fprintf(stderr, "%s: ", what);
+    print_hex(stderr, field, size);
+    fprintf(stderr, " -> \"%.*s\"\n", (int)text->len, text->data);
+}
+
+// Encodes 'text' back into a 'size'-byte field and compares it with the
+// field's first 'len' bytes
+static int encodes_to(const xm_buf *text, const uint8_t *field, size_t len, size_t size)
+{
+    uint8_t out[XM_LINE_SIZE];
+    size_t unmapped = 0;
+    size_t n = xm_text_encode(text->data, text->len, out, size, &unmapped);
+    return unmapped == 0 && n == len && memcmp(out, field, len) == 0;
+}
+
+static void check_field(const uint8_t *field, size_t size)
+{
+    const uint8_t *nul = memchr(field, '\0', size);
+    size_t len = nul ? (size_t)(nul - field) : size;
+    xm_buf text;
+    xm_buf raw;
+    xm_buf_init(&text);
+    xm_buf_init(&raw);
+
+    xm_text_decode(&text, field, size);
+    raw_text(&raw, field, len);
+    g_checks++;
+    if (text.failed || raw.failed)
+        fail("Out of memory", field, size, &text);
+    else if (!encodes_to(&text, field, len, size))
+        fail("Text does not encode back", field, size, &text);
+    else if (!encodes_to(&raw, field, len, size))
+        fail("Version 1 text does not encode back", field, size, &raw);
+
+    xm_buf_free(&text);
+    xm_buf_free(&raw);
+}
+
+// -------------------------------------------------------------------
+// Cases
+// -------------------------------------------------------------------
+// What comes right before the byte under test
+static const char *const CONTEXTS[] = {
+    "", "a", "\x82", "\xFD", "\xFD\x01\x02", "{", "{x", "{x4", "{AT:0102030", "{AT:",
+};
+
+// Every byte after each context, the pair ending at every position of a
+// line and a name; the rest of the field is filled with 'a' or NULs
+static void check_bytes(void)
+{
+    static const size_t SIZES[] = {XM_LINE_SIZE, XM_NAME_SIZE};
+    for (size_t s = 0; s < 2; s++)
+    {
+        size_t size = SIZES[s];
+        for (size_t c = 0; c < sizeof(CONTEXTS) / sizeof(CONTEXTS[0]); c++)
+        {
+            size_t clen = strlen(CONTEXTS[c]);
+            for (size_t end = clen; end < size; end++)
+            {
+                for (int fill = 0; fill < 2; fill++)
+                {
+                    for (unsigned value = 0; value < 256; value++)
+                    {
+                        uint8_t field[XM_LINE_SIZE];
+                        memset(field, fill ? 'a' : 0, size);
+                        memset(field, 'a', end - clen);
+                        memcpy(field + end - clen, CONTEXTS[c], clen);
+                        field[end] = (uint8_t)value;
+                        check_field(field, size);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Every lead and trail pair, at the start and cut by the end of a line
+static void check_pairs(void)
+{
+    for (unsigned lead = 0x80; lead < 256; lead++)
+    {
+        for (unsigned trail = 0; trail < 256; trail++)
+        {
+            uint8_t field[XM_LINE_SIZE];
+            memset(field, 'a', sizeof(field));
+            field[0] = (uint8_t)lead;
+            field[1] = (uint8_t)trail;
+            field[XM_LINE_SIZE - 3] = (uint8_t)trail;
+            field[XM_LINE_SIZE - 2] = (uint8_t)lead;
+            field[XM_LINE_SIZE - 1] = (uint8_t)lead;
+            check_field(field, sizeof(field));
+        }
+    }
+}
+
+// Every byte at each place inside a phrase, closed or not, whole and cut
+// by the end of a line
+static void check_phrases(void)
+{
+    for (size_t at = 1; at < 6; at++)
+    {
+        for (unsigned value = 0; value < 256; value++)
+        {
+            uint8_t phrase[6] = {AT_MARK, 0x02, 0x02, 0x05, 0x01, AT_MARK};
+            phrase[at] = (uint8_t)value;
+            for (size_t start = 0; start < XM_LINE_SIZE; start++)
+            {
+                uint8_t field[XM_LINE_SIZE];
+                size_t n = XM_LINE_SIZE - start < 6 ? XM_LINE_SIZE - start : 6;
+                memset(field, 'a', sizeof(field));
+                memcpy(field + start, phrase, n);
+                check_field(field, sizeof(field));
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------------------
+// Vectors
+// -------------------------------------------------------------------
+static void put_vector(const uint8_t *bytes, size_t len)
+{
+    xm_buf line;
+    xm_buf_init(&line);
+    xm_buf_puts(&line, "{\"bytes\":\"");
+    for (size_t i = 0; i < len; i++)
+    {
+        xm_buf_putc(&line, HEX[bytes[i] >> 4]);
+        xm_buf_putc(&line, HEX[bytes[i] & 0x0F]);
+    }
+    xm_buf_puts(&line, "\",\"text\":\"");
+    xm_json_text(&line, bytes, len);
+
+    // The version 1 text is ASCII; escaped as JSON like the rest
+    xm_buf raw;
+    xm_buf_init(&raw);
+    raw_text(&raw, bytes, len);
+    xm_buf_puts(&line, "\",\"raw\":\"");
+    xm_json_escape(&line, (const uint8_t *)raw.data, raw.len);
+    xm_buf_puts(&line, "\"}\n");
+    xm_buf_free(&raw);
+
+    xm_buf_write(&line, stdout);
+    xm_buf_free(&line);
+}
+
+static void put_text_vector(const char *text)
+{
+    put_vector((const uint8_t *)text, strlen(text));
+}
+
+static void print_vectors(void)
+{
+    uint8_t full[XM_LINE_SIZE];
+
+    // Every byte alone, before ASCII, and last in a full line
+    for (unsigned value = 1; value < 256; value++)
+    {
+        uint8_t pair[2] = {(uint8_t)value, 'a'};
+        put_vector(pair, 1);
+        put_vector(pair, 2);
+        memset(full, 'a', sizeof(full));
+        full[XM_LINE_SIZE - 1] = (uint8_t)value;
+        put_vector(full, sizeof(full));
+    }
+
+    // Each lead with trails on and around the edges of the trail range
+    static const uint8_t TRAILS[] = {0x3F, 0x40, 0x7E, 0x7F, 0x80, 0xFC, 0xFD, 0xFF};
+    for (unsigned lead = 0x80; lead < 256; lead++)
+    {
+        for (size_t t = 0; t < sizeof(TRAILS); t++)
+        {
+            uint8_t pair[2] = {(uint8_t)lead, TRAILS[t]};
+            put_vector(pair, 2);
+        }
+    }
+
+    // Phrases, whole, unclosed, nested and cut by the end of the line
+    put_text_vector("\xFD\x01\x02\x03\x04\xFD");
+    put_text_vector("/p \xFD\x02\x02\x05\x01\xFD please");
+    put_text_vector("\xFD\x7B\x7B\x7B\x7B\xFD");
+    put_text_vector("\xFD\x80\xFF\x20\x7D\xFD");
+    put_text_vector("\xFD\xFD\x01\x02\xFD\xFD");
+    put_text_vector("\xFD\x01\x02\xFD\x04\xFD");
+    put_text_vector("\xFD\x01\x02\x03\x04");
+    put_text_vector("\xFD\xFD\xFD\xFD\xFD\xFD\xFD");
+    memset(full, 'a', sizeof(full));
+    memcpy(full + XM_LINE_SIZE - 6, "\xFD\x02\x02\x05\x01\xFD", 6);
+    put_vector(full, sizeof(full));
+    memset(full, 'a', sizeof(full));
+    memcpy(full + XM_LINE_SIZE - 4, "\xFD\x02\x02\x05", 4);
+    put_vector(full, sizeof(full));
+
+    // '{' next to text shaped like a token
+    static const char *const BRACES[] = {
+        "{x41}", "{x7B}", "{xff}", "{xFf}", "{X41}", "{x00}", "{x4G}", "{x41",
+        "{x", "{{x41}", "{{{", "{}", "{AT:01020304}", "{at:01020304}", "{AT:00000000}",
+        "{AT:00010203}", "{AT:0102030}", "{AT:0102030G}", "{AT:", "{x41}{x42}",
+        "{x4\x82\xA0", "{\xFD\x01\x02\x03\x04\xFD", "\x82{x41}", "{x41}\x82",
+    };
+    for (size_t i = 0; i < sizeof(BRACES) / sizeof(BRACES[0]); i++)
+        put_text_vector(BRACES[i]);
+    memset(full, 'a', sizeof(full));
+    memcpy(full + XM_LINE_SIZE - 5, "{x41}", 5);
+    put_vector(full, sizeof(full));
+    memset(full, 'a', sizeof(full));
+    memcpy(full + XM_LINE_SIZE - 4, "{x41", 4);
+    put_vector(full, sizeof(full));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 && strcmp(argv[1], "--vectors") == 0)
+    {
+        print_vectors();
+        return 0;
+    }
+    if (argc != 1)
+    {
+        fprintf(stderr, "Usage: %s [--vectors]\n", argv[0]);
+        return 1;
+    }
+
+    check_bytes();
+    check_pairs();
+    check_phrases();
+
+    printf("%ld fields checked, %ld failed\n", g_checks, g_failures);
+    return g_failures ? 1 : 0;
+}
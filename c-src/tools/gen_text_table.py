@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Generates src/xm_text_table.h, the Shift-JIS tables of xm_text.c.
+
+Only CP932 pairs that encode back to themselves are kept, so every decoded
+character has exactly one byte form. NEC/IBM duplicates and the
+user-defined rows (which map into the Private Use Area) are left out;
+xm_text.c passes those bytes through as {xHH}.
+
+    python3 tools/gen_text_table.py > src/xm_text_table.h
+"""
+
+LEADS = list(range(0x81, 0xA0)) + list(range(0xE0, 0xFD))
+TRAIL_FIRST, TRAIL_LAST = 0x40, 0xFC
+
+
+def pair_char(lead, trail):
+    try:
+        ch = bytes([lead, trail]).decode('cp932')
+    except UnicodeDecodeError:
+        return 0
+    cp = ord(ch)
+    if len(ch) != 1 or 0xE000 <= cp <= 0xF8FF or ch.encode('cp932') != bytes([lead, trail]):
+        return 0
+    return cp
+
+
+def main():
+    rows = [[pair_char(lead, trail) for trail in range(TRAIL_FIRST, TRAIL_LAST + 1)] for lead in LEADS]
+    pairs = sorted((cp, (LEADS[r] << 8) | (TRAIL_FIRST + t))
+                   for r, row in enumerate(rows) for t, cp in enumerate(row) if cp)
+
+    out = ['// Generated by tools/gen_text_table.py from the CP932 mapping; do not edit.',
+           '#ifndef XM_TEXT_TABLE_H',
+           '#define XM_TEXT_TABLE_H',
+           '',
+           '#include <stdint.h>',
+           '',
+           '#define SJIS_LEADS %d' % len(LEADS),
+           '#define SJIS_TRAILS %d // 0x%02X-0x%02X; 0x7F is never a trail' % (
+               TRAIL_LAST - TRAIL_FIRST + 1, TRAIL_FIRST, TRAIL_LAST),
+           '#define SJIS_TRAIL_FIRST 0x%02X' % TRAIL_FIRST,
+           '#define SJIS_PAIRS %d' % len(pairs),
+           '',
+           '// Code point of each pair by lead (0x81-0x9F, then 0xE0-0xFC) and',
+           '// trail; 0 where the pair isn\'t decoded',
+           'static const uint16_t SJIS_TO_UCS[SJIS_LEADS][SJIS_TRAILS] = {']
+    for lead, row in zip(LEADS, rows):
+        out.append('    // 0x%02X' % lead)
+        out.append('    {')
+        for i in range(0, len(row), 12):
+            out.append('        ' + ', '.join('0x%04X' % cp for cp in row[i:i + 12]) + ',')
+        out.append('    },')
+    out.append('};')
+    out.append('')
+    out.append('// {code point, pair} sorted by code point, for encoding')
+    out.append('static const uint16_t UCS_TO_SJIS[SJIS_PAIRS][2] = {')
+    for i in range(0, len(pairs), 6):
+        out.append('    ' + ' '.join('{0x%04X, 0x%04X},' % p for p in pairs[i:i + 6]))
+    out.append('};')
+    out.append('')
+    out.append('#endif // XM_TEXT_TABLE_H')
+    print('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
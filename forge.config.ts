@@ -18,6 +18,9 @@ const config: ForgeConfig = {
 			'./bin/ximacro_e.exe',
 			'./bin/ximacro_c.exe',
 			'./bin/ximacro_b.exe',
+			'./bin/ximacro_s.exe',
+			'./bin/ximacro_f.exe',
+			'./bin/ximacro.node',
 		],
 	},
 	rebuildConfig: {},
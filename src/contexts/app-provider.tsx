@@ -3,9 +3,16 @@ import React, {
 	useContext,
 	useState,
 	useEffect,
+	useRef,
 	type ReactNode,
 } from 'react';
 import Loading from '@/components/loading';
+import {
+	applyWatchEvent,
+	macroEdits,
+	macroFileDir,
+	parseImportSummary,
+} from '@/lib/format';
 
 import { ToastContainer, toast } from 'react-toastify';
 
@@ -35,6 +42,11 @@ export interface MacroItem {
 	fileName: string;
 	fileSize: number;
 	macros: Macro[];
+	// Position as exported by ximacro_e: file index (mcr.dat is 0), book
+	// and page within it, all 0-based
+	index: number;
+	book: number;
+	page: number;
 }
 
 interface AppContextType {
@@ -114,6 +126,8 @@ export const AppProvider: React.FC<{ children: ReactNode }> = ({ children }) =>
 	const [copiedMacroPage, setCopiedMacroPage] = useState<MacroItem | null>(null);
 	const [saveMacroSignal, setSaveMacroSignal] = useState(0);
 	const [deleteMacroSignal, setDeleteMacroSignal] = useState(0);
+	// Bumped by every loadMacros; batches of an older load are dropped
+	const macroLoadGeneration = useRef(0);
 
 	const elec = window.electronAPI;
 
@@ -140,6 +154,28 @@ export const AppProvider: React.FC<{ children: ReactNode }> = ({ children }) =>
 		setBackButtonCallback(undefined);
 	}, [screen]);
 
+	// Keep the open character in sync with changes made outside the app
+	// (e.g. the game saving on logout), one changed file at a time.
+	useEffect(() => {
+		if (!ffxiDirectory || !selectedCharacter) return;
+
+		const unsubscribe = elec.onMacroWatchEvent(ev => {
+			if (ev.event === 'books') {
+				loadBooks();
+			} else if (ev.event === 'error') {
+				setError(ev.error);
+			} else {
+				setMacros(prev => applyWatchEvent(prev, ev));
+			}
+		});
+		elec.watchMacros(`${ffxiDirectory}\\USER\\${selectedCharacter.folder}`);
+
+		return () => {
+			unsubscribe();
+			elec.unwatchMacros();
+		};
+	}, [ffxiDirectory, selectedCharacter]);
+
 	const loadStore = async () => {
 		const path = await elec.getStore('ffxiPath');
 		if (path) {
@@ -218,17 +254,23 @@ export const AppProvider: React.FC<{ children: ReactNode }> = ({ children }) =>
 		}
 		const path = `${ffxiDirectory}\\USER\\${selectedCharacter.folder}`;
 
+		// Pages arrive in file order, a batch at a time, so books fill in as
+		// they are read. Starting a load stops the previous one's stream, and
+		// anything it still delivers is ignored.
+		const generation = ++macroLoadGeneration.current;
+		const current = () => generation === macroLoadGeneration.current;
 		window.loadingMessage = 'Loading macros...';
-		const data = await elec.readMacros(path);
-		window.loadingMessage = undefined;
-
+		setMacros([]);
 		try {
-			const macros = JSON.parse(data);
-			setMacros(macros);
-
-			return;
+			await elec.streamMacros(path, pages => {
+				if (!current()) return;
+				window.loadingMessage = undefined;
+				setMacros(prev => [...prev, ...pages]);
+			});
 		} catch {
-			setError('Failed to parse macros.');
+			if (current()) setError('Failed to parse macros.');
+		} finally {
+			if (current()) window.loadingMessage = undefined;
 		}
 	};
 
@@ -274,10 +316,27 @@ export const AppProvider: React.FC<{ children: ReactNode }> = ({ children }) =>
 		setSelectedMacro(newMacro);
 		setMacros(newMacros);
 
+		// Only the edited macro needs to go to disk, as positional edits to
+		// the resident macro service; a file whose bytes wouldn't change
+		// isn't written.
 		window.loadingMessage = 'Saving macros...';
-		await elec.writeMacros(newMacros);
-		window.loadingMessage = undefined;
+		let result: string;
+		try {
+			result = await elec.patchMacros(
+				macroFileDir(newMacro.fileName),
+				macroEdits(newMacro, macroItemIndex, selectedMacroItem),
+			);
+		} catch (error) {
+			result = String(error);
+		} finally {
+			window.loadingMessage = undefined;
+		}
 
+		const summary = parseImportSummary(result);
+		if (!summary || summary.failed > 0 || summary.rejected) {
+			setError(`Failed to save the macro: ${result}`);
+			return;
+		}
 		toast.success('Macro saved!');
 	};
 
@@ -1,12 +1,30 @@
-import { ipcMain, dialog } from 'electron';
+import { app, ipcMain, dialog } from 'electron';
 import Store from 'electron-store';
 import fs from 'fs';
 import path, { resolve } from 'path';
-import { exec } from 'child_process';
+import { execFile, spawn, type ChildProcess } from 'child_process';
 import log from 'electron-log/main';
-import os from 'os';
+
+import { MacroService } from '@/ipc/macro-service';
+import { parseImportSummary, selectionArgs } from '@/lib/format';
+import { encodeMacroBinary } from '@/lib/macro-binary';
 
 import type { MacroItem } from '@/contexts/app-provider';
+import type {
+	BookClone,
+	BookCloneSummary,
+	BookTitle,
+	CharacterSummary,
+	ImportSummary,
+	MacroEdit,
+	MacroReplace,
+	MacroSearch,
+	MacroSearchResult,
+	MacroSelection,
+	MacroTransfer,
+	MacroWatchEvent,
+	ReplaceSummary,
+} from '@/lib/format';
 
 const BOOK_FILENAMES = ['mcr.ttl', 'mcr_2.ttl'];
 
@@ -18,6 +36,8 @@ const executables = {
 	export: 'ximacro_e.exe',
 	chars: 'ximacro_c.exe',
 	books: 'ximacro_b.exe',
+	service: 'ximacro_s.exe',
+	find: 'ximacro_f.exe',
 };
 
 /**
@@ -46,13 +66,115 @@ const getExecutablePath = (executableName: string): string => {
 		: path.join(process.resourcesPath, executableName);
 };
 
+/**
+ * Resident macro service, started on first use, and the character folder
+ * it holds.
+ */
+let macroService: MacroService | null = null;
+let macroServiceDir: string | null = null;
+
+const getMacroService = (): MacroService => {
+	if (!macroService) {
+		macroService = new MacroService(getExecutablePath(executables.service));
+	}
+	return macroService;
+};
+
+/**
+ * Flushes and stops the resident macro service, if it was started.
+ */
+export const stopMacroService = async (): Promise<void> => {
+	await macroService?.stop();
+	macroService = null;
+	macroServiceDir = null;
+};
+
+/**
+ * Applies positional edits to the folder `dir` through the resident
+ * service and flushes them (one journaled commit, like `ximacro_i
+ * --patch`). Other writers (imports, transfers, the game) change files
+ * under the service, so when a flush finds one changed, or an edit names
+ * a file it doesn't hold, the folder is reloaded and the edits applied
+ * again, once. Resolves with the summary `ximacro_i` would print.
+ */
+const patchThroughService = async (
+	dir: string,
+	edits: MacroEdit[],
+): Promise<ImportSummary> => {
+	const service = getMacroService();
+	const load = async () => {
+		const response = await service.request({ op: 'load', dir, discard: true });
+		if (!response.ok) throw new Error(response.error ?? 'Could not load the folder.');
+		macroServiceDir = dir;
+	};
+
+	if (macroServiceDir !== dir) await load();
+	for (let attempt = 1; ; attempt++) {
+		let rejected = 0;
+		let missing = 0;
+		for (const [file, macro, field, text] of edits) {
+			const response = await service.request(
+				field === 'name'
+					? { op: 'set', file, macro, name: text }
+					: { op: 'set', file, macro, line: field, data: text },
+			);
+			if (response.ok) continue;
+			if (response.error === 'file not loaded') missing++;
+			else rejected++;
+		}
+
+		const flush = await service.request({ op: 'flush' });
+		const conflicts = Number(flush.conflicts ?? 0);
+		if (attempt === 1 && (missing > 0 || conflicts > 0)) {
+			await load();
+			continue;
+		}
+
+		const written = (flush.files as number[] | undefined) ?? [];
+		const failed = Number(flush.failed ?? 0) + conflicts + missing;
+		const files = new Set(edits.map(([file]) => file)).size;
+		return {
+			written: written.length,
+			skipped: Math.max(files - written.length - failed, 0),
+			failed,
+			rejected,
+			touched: written.map(file =>
+				path.join(dir, file === 0 ? 'mcr.dat' : `mcr${file}.dat`),
+			),
+			backups: flush.backup ? [String(flush.backup)] : [],
+		};
+	}
+};
+
+/**
+ * `ximacro_e --watch` process for the open character folder, if any.
+ */
+let macroWatcher: ChildProcess | null = null;
+
+export const stopMacroWatch = () => {
+	macroWatcher?.kill();
+	macroWatcher = null;
+};
+
+/**
+ * The running `ximacro_e --format=ndjson` of each window, by webContents id.
+ */
+const macroStreams = new Map<number, ChildProcess>();
+
 /**
  * Arguments for the read-macros function.
  */
 interface ReadMacrosArgs {
 	path: string;
+	selection?: MacroSelection;
 }
 
+/**
+ * Points `ximacro_e` at its parse cache under userData; its default,
+ * macro_cache, is relative to whatever directory the app was started in.
+ */
+const cacheArg = () => `--cache=${path.join(app.getPath('userData'), 'macro_cache')}`;
+
 /**
  * Registers IPC handlers for Electron main process.
  */
@@ -65,7 +187,18 @@ export const registerHandlers = () => {
 	ipcMain.removeHandler('store:get');
 	ipcMain.removeHandler('store:clear');
 	ipcMain.removeHandler('read-macros');
+	ipcMain.removeHandler('read-macros:stream');
 	ipcMain.removeHandler('list-directories');
+	ipcMain.removeHandler('patch-macros');
+	ipcMain.removeHandler('transfer-macros');
+	ipcMain.removeHandler('scan-characters');
+	ipcMain.removeHandler('search-macros');
+	ipcMain.removeHandler('replace-macros');
+	ipcMain.removeHandler('clone-book');
+	ipcMain.removeHandler('macro-watch:start');
+	ipcMain.removeHandler('macro-watch:stop');
+	ipcMain.removeHandler('read-books');
+	ipcMain.removeHandler('write-books');
 
 	/**
 	 * Opens a dialog to select the FFXI installation folder.
@@ -127,39 +260,123 @@ export const registerHandlers = () => {
 	});
 
 	/**
-	 * Reads macros from a file using an external executable.
+	 * Reads macros from a file using an external executable, as the compact
+	 * binary stream of `ximacro_e --format=bin`. With a selection only that
+	 * book or page range is read. Files that haven't changed since the last
+	 * read come from its parse cache.
 	 */
 	ipcMain.handle(
 		'read-macros',
-		async (_event, args: ReadMacrosArgs): Promise<string> => {
+		async (_event, args: ReadMacrosArgs): Promise<Uint8Array> => {
 			return new Promise((resolve, reject) => {
-				const { path: filePath } = args;
+				const { path: filePath, selection } = args;
 
 				const exePath: string = getExecutablePath(executables.export);
 
-				const command: string = `"${exePath}" "${filePath}"`;
-
 				// Create a timeout to prevent hanging
 				const timeout = setTimeout(() => {
 					reject('Operation timed out after 30 seconds');
 				}, 30000);
 
-				exec(command, (error: Error | null, stdout: string, stderr: string) => {
-					// Clear the timeout since the operation completed
-					clearTimeout(timeout);
+				// The binary stream is decoded by the renderer (see lib/macro-binary)
+				execFile(
+					exePath,
+					[cacheArg(), '--format=bin', ...selectionArgs(selection), filePath],
+					{ encoding: 'buffer', maxBuffer: 1024 * 1024 * 10 },
+					(error, stdout) => {
+						// Clear the timeout since the operation completed
+						clearTimeout(timeout);
 
-					if (error) {
-						reject(`Error running the executable: ${error.message}`);
-						return;
+						if (error) {
+							reject(`Error running the executable: ${error.message}`);
+							return;
+						}
+
+						resolve(new Uint8Array(stdout));
+					},
+				);
+			});
+		},
+	);
+
+	interface StreamMacrosArgs extends ReadMacrosArgs {
+		requestId: string;
+	}
+
+	/**
+	 * Streams macros from `ximacro_e --format=ndjson`: each batch of complete
+	 * lines is forwarded to the renderer as 'read-macros:pages' while later
+	 * files are still being read. Resolves with the number of pages sent.
+	 * Replaces (and stops) any stream the window still has running, which
+	 * then resolves with what it had sent.
+	 */
+	ipcMain.handle(
+		'read-macros:stream',
+		(event, args: StreamMacrosArgs): Promise<number> => {
+			return new Promise((resolve, reject) => {
+				const { path: filePath, selection, requestId } = args;
+				const sender = event.sender;
+				macroStreams.get(sender.id)?.kill();
+
+				const child = spawn(
+					getExecutablePath(executables.export),
+					[
+						cacheArg(),
+						'--format=ndjson',
+						...selectionArgs(selection),
+						filePath,
+					],
+					{ windowsHide: true },
+				);
+				macroStreams.set(sender.id, child);
+				let buffered = '';
+				let count = 0;
+
+				// Create a timeout to prevent hanging
+				const timeout = setTimeout(() => {
+					child.kill();
+					reject('Operation timed out after 30 seconds');
+				}, 30000);
+
+				child.stdout.setEncoding('utf8');
+				child.stdout.on('data', (chunk: string) => {
+					if (child.killed) return;
+					buffered += chunk;
+					const end = buffered.lastIndexOf('\n');
+					if (end < 0) return;
+
+					const pages: MacroItem[] = [];
+					for (const line of buffered.slice(0, end).split('\n')) {
+						if (!line.trim()) continue;
+						try {
+							pages.push(JSON.parse(line) as MacroItem);
+						} catch {
+							log.error(`ximacro_e --format=ndjson: unparseable line: ${line}`);
+						}
 					}
+					buffered = buffered.slice(end + 1);
 
-					const output: string = stdout.trim();
-					if (!output) {
-						resolve('No output from the executable.');
+					count += pages.length;
+					if (pages.length && !sender.isDestroyed()) {
+						sender.send('read-macros:pages', requestId, pages);
+					}
+				});
+				child.stderr.on('data', (chunk: Buffer) =>
+					log.warn(`ximacro_e --format=ndjson: ${chunk}`),
+				);
+				child.on('error', error => {
+					clearTimeout(timeout);
+					reject(`Error running the executable: ${error.message}`);
+				});
+				child.on('close', code => {
+					clearTimeout(timeout);
+					if (macroStreams.get(sender.id) === child)
+						macroStreams.delete(sender.id);
+					if (code && !child.killed) {
+						reject(`ximacro_e exited with code ${code}`);
 						return;
 					}
-
-					resolve(output);
+					resolve(count);
 				});
 			});
 		},
@@ -172,123 +389,422 @@ export const registerHandlers = () => {
 	ipcMain.handle(
 		'write-macros',
 		async (_event, args: WriteMacrosArgs): Promise<string> => {
-			const { macros } = args;
-
-			const json = JSON.stringify(macros);
-
-			// Write to windows temp folder
-			const tempFilePath = path.join(os.tmpdir(), 'macros.json');
-			fs.writeFileSync(tempFilePath, json);
-
+			const data = encodeMacroBinary(args.macros);
 			const exePath: string = getExecutablePath(executables.import);
 
-			const command: string = `type "${tempFilePath}" | "${exePath}"`;
-
 			return new Promise((resolve, reject) => {
 				// Create a timeout to prevent hanging
 				const timeout = setTimeout(() => {
 					reject('Operation timed out after 30 seconds');
 				}, 30000);
 
-				exec(
-					command,
+				const child = execFile(
+					exePath,
+					['--format=bin'],
 					{ maxBuffer: 1024 * 1024 * 10 },
-					(error, stdout, stderr) => {
+					(error, stdout) => {
 						// Clear the timeout since the operation completed
 						clearTimeout(timeout);
 
-						if (error) {
-							reject(`Error running the executable: ${error.message}`);
-							return;
-						}
-
 						const output: string = stdout.trim();
-						if (!output) {
-							resolve('No output from the executable.');
+						if (error && !output) {
+							reject(`Error running the executable: ${error.message}`);
 							return;
 						}
 
-						resolve(output);
+						resolve(output || 'No output from the executable.');
 					},
 				);
+
+				child.stdin?.end(data);
 			});
 		},
 	);
 
-	interface ReadBooksArgs {
-		dataFolder: string;
+	interface PatchMacrosArgs {
+		dir: string;
+		edits: MacroEdit[];
 	}
 
 	/**
-	 * Reads macro book names from a file using an external executable.
+	 * Applies positional edits through the resident macro service, so an
+	 * edit costs neither a process spawn nor a reparse of the folder.
+	 * Resolves with the summary `ximacro_i --patch` prints.
 	 */
 	ipcMain.handle(
-		'read-books',
-		async (_event, args: ReadBooksArgs): Promise<string[] | string> => {
-			const { dataFolder } = args;
+		'patch-macros',
+		async (_event, args: PatchMacrosArgs): Promise<string> => {
+			try {
+				return JSON.stringify(await patchThroughService(args.dir, args.edits));
+			} catch (error) {
+				throw `Error running the macro service: ${error}`;
+			}
+		},
+	);
+
+	/**
+	 * Copies, moves or swaps whole pages and single macros with
+	 * `ximacro_i --transfer`; the bytes never leave the native side.
+	 */
+	ipcMain.handle(
+		'transfer-macros',
+		async (_event, ops: MacroTransfer[]): Promise<string> => {
+			const exePath: string = getExecutablePath(executables.import);
+
+			return new Promise((resolve, reject) => {
+				const timeout = setTimeout(() => {
+					reject('Operation timed out after 30 seconds');
+				}, 30000);
+
+				const child = execFile(exePath, ['--transfer'], (error, stdout) => {
+					clearTimeout(timeout);
+
+					const output: string = stdout.trim();
+					if (error && !output) {
+						reject(`Error running the executable: ${error.message}`);
+						return;
+					}
+
+					resolve(output || 'No output from the executable.');
+				});
+
+				child.stdin?.end(JSON.stringify(ops));
+			});
+		},
+	);
+
+	/**
+	 * Bulk find-and-replace with `ximacro_i --replace` over the selected
+	 * characters. Fields the new text would overflow are reported, not
+	 * truncated; with `dryRun` the changes are only listed.
+	 */
+	ipcMain.handle(
+		'replace-macros',
+		async (
+			_event,
+			{ characters, find, replace, ignoreCase, dryRun }: MacroReplace,
+		): Promise<ReplaceSummary | string> => {
 			const ffxiDirectory = store.get('ffxiPath') as string | undefined;
 
 			if (!ffxiDirectory) {
 				return 'FFXI directory not set.';
 			}
+			if (!find || characters.length === 0) {
+				return 'Nothing to replace.';
+			}
 
-			const exePath: string = getExecutablePath(executables.books);
+			const exePath: string = getExecutablePath(executables.import);
+			const args = ['--replace', `--find=${find}`, `--with=${replace}`];
+			if (ignoreCase) args.push('--ignore-case');
+			if (dryRun) args.push('--dry-run');
+			args.push(...characters.map(name => path.join(ffxiDirectory, 'USER', name)));
 
-			try {
-				// Create an array of promises for each file execution
-				const bookPromises = BOOK_FILENAMES.map(filename => {
-					return new Promise<string[]>((resolve, reject) => {
-						const filePath = path.join(
-							ffxiDirectory,
-							'USER',
-							dataFolder,
-							filename,
+			return new Promise(resolve => {
+				const timeout = setTimeout(() => {
+					resolve('Operation timed out after 30 seconds');
+				}, 30000);
+
+				execFile(
+					exePath,
+					args,
+					{ maxBuffer: 1024 * 1024 * 50 },
+					(error, stdout) => {
+						clearTimeout(timeout);
+
+						const summary = parseImportSummary(stdout.trim());
+						if (!summary) {
+							resolve(
+								error
+									? `Error running the executable: ${error.message}`
+									: 'Failed to parse replace summary.',
+							);
+							return;
+						}
+						resolve(summary as ReplaceSummary);
+					},
+				);
+			});
+		},
+	);
+
+	/**
+	 * Copies one book to many characters with `ximacro_i --clone-book`; the
+	 * targets are prepared in parallel and committed one by one.
+	 */
+	ipcMain.handle(
+		'clone-book',
+		async (
+			_event,
+			{ book, from, to }: BookClone,
+		): Promise<BookCloneSummary | string> => {
+			const ffxiDirectory = store.get('ffxiPath') as string | undefined;
+
+			if (!ffxiDirectory) {
+				return 'FFXI directory not set.';
+			}
+			if (to.length === 0) {
+				return 'No characters to copy the book to.';
+			}
+
+			const userDir = path.join(ffxiDirectory, 'USER');
+			const exePath: string = getExecutablePath(executables.import);
+			const args = [
+				`--clone-book=${book}`,
+				`--from=${path.join(userDir, from)}`,
+				...to.map(name => path.join(userDir, name)),
+			];
+
+			return new Promise(resolve => {
+				const timeout = setTimeout(() => {
+					resolve('Operation timed out after 30 seconds');
+				}, 30000);
+
+				execFile(exePath, args, (error, stdout) => {
+					clearTimeout(timeout);
+
+					const summary = parseImportSummary(stdout.trim());
+					if (!summary) {
+						resolve(
+							error
+								? `Error running the executable: ${error.message}`
+								: 'Failed to parse clone summary.',
 						);
-						const command: string = `"${exePath}" "${filePath}"`;
-
-						// Create a timeout to prevent hanging
-						const timeout = setTimeout(() => {
-							reject('Operation timed out after 30 seconds');
-						}, 30000);
-
-						exec(command, (error, stdout, stderr) => {
-							// Clear the timeout since the operation completed
-							clearTimeout(timeout);
-
-							if (error) {
-								reject(`Error running the executable: ${error.message}`);
-								return;
-							}
-
-							const output: string = stdout.trim();
-							if (!output) {
-								resolve([]);
-								return;
-							}
-
-							try {
-								const json = JSON.parse(output);
-								resolve(json);
-							} catch (parseError) {
-								reject('Failed to parse book names.');
-							}
-						});
-					});
+						return;
+					}
+					resolve(summary as BookCloneSummary);
 				});
+			});
+		},
+	);
 
-				// Wait for all executions to complete
-				const results = await Promise.all(bookPromises);
+	/**
+	 * Searches the lines and names of every character's macros with
+	 * `ximacro_f`. Its trigram index lives in userData and is brought up
+	 * to date first, re-reading only the files changed since last time.
+	 */
+	ipcMain.handle(
+		'search-macros',
+		async (
+			_,
+			{ query, prefix, matchCase, limit }: MacroSearch,
+		): Promise<MacroSearchResult | string> => {
+			const ffxiDirectory = store.get('ffxiPath') as string | undefined;
+
+			if (!ffxiDirectory) {
+				return 'FFXI directory not set.';
+			}
 
-				// Flatten the results array and remove duplicates
-				const bookNames = [...new Set(results.flat())];
+			const exePath: string = getExecutablePath(executables.find);
+			const indexPath = path.join(app.getPath('userData'), 'search.idx');
+			const userDir = path.join(ffxiDirectory, 'USER');
 
-				return bookNames;
-			} catch (error) {
-				return String(error);
+			const args = [`--index=${indexPath}`];
+			if (prefix) args.push('--prefix');
+			if (matchCase) args.push('--case');
+			if (limit !== undefined) args.push(`--limit=${limit}`);
+			args.push(userDir, '--', query);
+
+			return new Promise(resolve => {
+				const timeout = setTimeout(() => {
+					resolve('Operation timed out after 30 seconds');
+				}, 30000);
+
+				execFile(
+					exePath,
+					args,
+					{ maxBuffer: 1024 * 1024 * 50 },
+					(error, stdout) => {
+						clearTimeout(timeout);
+
+						if (error) {
+							resolve(`Error running the executable: ${error.message}`);
+							return;
+						}
+
+						try {
+							resolve(JSON.parse(stdout) as MacroSearchResult);
+						} catch (parseError) {
+							resolve('Failed to parse search results.');
+						}
+					},
+				);
+			});
+		},
+	);
+
+	/**
+	 * Summarizes every character folder under USER in one `ximacro_c --scan`
+	 * walk. The index it keeps in userData means only files changed since
+	 * the last scan are read again.
+	 */
+	ipcMain.handle(
+		'scan-characters',
+		async (): Promise<CharacterSummary[] | string> => {
+			const ffxiDirectory = store.get('ffxiPath') as string | undefined;
+
+			if (!ffxiDirectory) {
+				return 'FFXI directory not set.';
 			}
+
+			const exePath: string = getExecutablePath(executables.chars);
+			const indexPath = path.join(app.getPath('userData'), 'chars.idx');
+			const userDir = path.join(ffxiDirectory, 'USER');
+
+			return new Promise(resolve => {
+				const timeout = setTimeout(() => {
+					resolve('Operation timed out after 30 seconds');
+				}, 30000);
+
+				execFile(
+					exePath,
+					['--scan', `--index=${indexPath}`, userDir],
+					{ maxBuffer: 1024 * 1024 * 10 },
+					(error, stdout) => {
+						clearTimeout(timeout);
+
+						if (error) {
+							resolve(`Error running the executable: ${error.message}`);
+							return;
+						}
+
+						try {
+							resolve(JSON.parse(stdout) as CharacterSummary[]);
+						} catch (parseError) {
+							resolve('Failed to parse character summaries.');
+						}
+					},
+				);
+			});
 		},
 	);
 
+	/**
+	 * Watches a character folder with `ximacro_e --watch` and forwards each
+	 * change event to the renderer as 'macro-watch:event'. Replaces any
+	 * previous watch.
+	 */
+	ipcMain.handle('macro-watch:start', (event, dir: string): boolean => {
+		stopMacroWatch();
+
+		const child = spawn(getExecutablePath(executables.export), ['--watch', dir], {
+			windowsHide: true,
+		});
+		const sender = event.sender;
+		let buffered = '';
+
+		const forward = (ev: MacroWatchEvent) => {
+			if (!sender.isDestroyed()) sender.send('macro-watch:event', ev);
+		};
+
+		child.stdout.setEncoding('utf8');
+		child.stdout.on('data', (chunk: string) => {
+			buffered += chunk;
+			let newline: number;
+			while ((newline = buffered.indexOf('\n')) >= 0) {
+				const line = buffered.slice(0, newline);
+				buffered = buffered.slice(newline + 1);
+				if (!line.trim()) continue;
+				try {
+					forward(JSON.parse(line) as MacroWatchEvent);
+				} catch {
+					log.error(`ximacro_e --watch: unparseable event: ${line}`);
+				}
+			}
+		});
+		child.stderr.on('data', (chunk: Buffer) => log.warn(`ximacro_e --watch: ${chunk}`));
+		child.on('exit', code => {
+			if (macroWatcher !== child) return;
+			macroWatcher = null;
+			if (code) forward({ event: 'error', error: `Watcher exited with code ${code}` });
+		});
+
+		macroWatcher = child;
+		return true;
+	});
+
+	ipcMain.handle('macro-watch:stop', (): boolean => {
+		stopMacroWatch();
+		return true;
+	});
+
+	interface ReadBooksArgs {
+		dataFolder: string;
+	}
+
+	interface WriteBooksArgs extends ReadBooksArgs {
+		titles: BookTitle[];
+	}
+
+	/**
+	 * Runs `ximacro_b` once over every title file of a character, with
+	 * `--set` piping `titles` to it first. Returns the titles indexed by
+	 * book; a missing file leaves its books out rather than failing the
+	 * rest.
+	 */
+	const runBooks = (
+		dataFolder: string,
+		titles?: BookTitle[],
+	): Promise<string[] | string> => {
+		const ffxiDirectory = store.get('ffxiPath') as string | undefined;
+
+		if (!ffxiDirectory) {
+			return Promise.resolve('FFXI directory not set.');
+		}
+
+		const exePath: string = getExecutablePath(executables.books);
+		const files = BOOK_FILENAMES.map(filename =>
+			path.join(ffxiDirectory, 'USER', dataFolder, filename),
+		);
+		const args = titles ? ['--set', ...files] : files;
+
+		return new Promise(resolve => {
+			const timeout = setTimeout(() => {
+				resolve('Operation timed out after 30 seconds');
+			}, 30000);
+
+			const child = execFile(exePath, args, (error, stdout) => {
+				clearTimeout(timeout);
+
+				const output: string = stdout.trim();
+				if (error && !output) {
+					resolve(`Error running the executable: ${error.message}`);
+					return;
+				}
+
+				try {
+					const bookNames: string[] = [];
+					for (const { book, title } of JSON.parse(output) as BookTitle[]) {
+						bookNames[book] = title;
+					}
+					resolve(Array.from(bookNames, title => title ?? ''));
+				} catch (parseError) {
+					resolve('Failed to parse book names.');
+				}
+			});
+
+			if (titles) child.stdin?.end(JSON.stringify(titles));
+		});
+	};
+
+	/**
+	 * Reads the titles of all of a character's macro books.
+	 */
+	ipcMain.handle(
+		'read-books',
+		async (_event, args: ReadBooksArgs): Promise<string[] | string> =>
+			runBooks(args.dataFolder),
+	);
+
+	/**
+	 * Renames books in place, patching only the changed title slots, and
+	 * returns every title as read back afterwards.
+	 */
+	ipcMain.handle(
+		'write-books',
+		async (_event, args: WriteBooksArgs): Promise<string[] | string> =>
+			runBooks(args.dataFolder, args.titles),
+	);
+
 	/**
 	 * Lists directories inside the given directory path.
 	 */
@@ -0,0 +1,116 @@
+import { spawn, type ChildProcessWithoutNullStreams } from 'child_process';
+import log from 'electron-log/main';
+
+/**
+ * A request understood by the resident `ximacro_s` process.
+ */
+export type MacroServiceRequest =
+	| { op: 'load'; dir: string; discard?: boolean }
+	| { op: 'reload'; discard?: boolean }
+	| { op: 'list' }
+	| { op: 'page'; file: number }
+	| { op: 'set'; file: number; macro: number; line: number; data: string }
+	| { op: 'set'; file: number; macro: number; name: string }
+	| { op: 'flush' }
+	| { op: 'quit' };
+
+/**
+ * A response from `ximacro_s`. Extra fields depend on the request's op.
+ */
+export interface MacroServiceResponse {
+	ok: boolean;
+	id?: number;
+	error?: string;
+	[key: string]: unknown;
+}
+
+interface PendingRequest {
+	resolve: (response: MacroServiceResponse) => void;
+	reject: (reason: string) => void;
+}
+
+/**
+ * Keeps one `ximacro_s` process alive and exchanges newline-framed JSON
+ * requests with it, so edits don't pay for a process spawn and a full reparse.
+ */
+export class MacroService {
+	private child: ChildProcessWithoutNullStreams | null = null;
+	private pending = new Map<number, PendingRequest>();
+	private nextId = 1;
+	private stdoutBuffer = '';
+
+	constructor(private readonly exePath: string) {}
+
+	/**
+	 * Sends a request and resolves with the matching response.
+	 */
+	request(request: MacroServiceRequest): Promise<MacroServiceResponse> {
+		const child = this.ensureStarted();
+		const id = this.nextId++;
+
+		return new Promise((resolve, reject) => {
+			this.pending.set(id, { resolve, reject });
+			child.stdin.write(`${JSON.stringify({ id, ...request })}\n`);
+		});
+	}
+
+	/**
+	 * Flushes pending edits and stops the process.
+	 */
+	async stop(): Promise<void> {
+		if (!this.child) return;
+		try {
+			await this.request({ op: 'flush' });
+			await this.request({ op: 'quit' });
+		} finally {
+			this.child?.stdin.end();
+			this.child = null;
+		}
+	}
+
+	private ensureStarted(): ChildProcessWithoutNullStreams {
+		if (this.child) return this.child;
+
+		const child = spawn(this.exePath, [], { windowsHide: true });
+		child.stdout.setEncoding('utf8');
+		child.stdout.on('data', (chunk: string) => this.onStdout(chunk));
+		child.stderr.on('data', (chunk: Buffer) => log.warn(`ximacro_s: ${chunk}`));
+		child.on('exit', code => {
+			this.child = null;
+			this.stdoutBuffer = '';
+			for (const { reject } of this.pending.values()) {
+				reject(`Macro service exited with code ${code}`);
+			}
+			this.pending.clear();
+		});
+
+		this.child = child;
+		return child;
+	}
+
+	private onStdout(chunk: string) {
+		this.stdoutBuffer += chunk;
+
+		let newline: number;
+		while ((newline = this.stdoutBuffer.indexOf('\n')) >= 0) {
+			const line = this.stdoutBuffer.slice(0, newline);
+			this.stdoutBuffer = this.stdoutBuffer.slice(newline + 1);
+			if (!line.trim()) continue;
+
+			let response: MacroServiceResponse;
+			try {
+				response = JSON.parse(line);
+			} catch {
+				log.error(`ximacro_s: unparseable response: ${line}`);
+				continue;
+			}
+
+			const pending =
+				typeof response.id === 'number' ? this.pending.get(response.id) : undefined;
+			if (!pending) continue;
+
+			this.pending.delete(response.id as number);
+			pending.resolve(response);
+		}
+	}
+}
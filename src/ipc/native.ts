@@ -0,0 +1,52 @@
+import log from 'electron-log/main';
+
+/**
+ * Layout constants reported by libximacro.
+ */
+export interface MacroLayout {
+	API_VERSION: number;
+	LINES_PER_MACRO: number;
+	LINE_SIZE: number;
+	NAME_SIZE: number;
+	MACRO_SIZE: number;
+	MACRO_START: number;
+	MACROS_PER_FILE: number;
+	MAX_FILE_INDEX: number;
+}
+
+/**
+ * The ximacro.node N-API addon. Field functions take a line index 0-5, or -1
+ * for the macro name, and operate on the Buffer in place.
+ */
+export interface XimacroAddon {
+	layout: MacroLayout;
+	readFile: (path: string) => Buffer;
+	writeFile: (path: string, data: Buffer) => void;
+	fieldSpan: (data: Buffer, macro: number, line: number) => [number, number];
+	getField: (data: Buffer, macro: number, line: number) => string;
+	setField: (data: Buffer, macro: number, line: number, value: string) => boolean;
+	updateHeader: (data: Buffer) => boolean;
+	fileName: (index: number) => string;
+	macroCount: (size: number) => number;
+}
+
+export const NAME_FIELD = -1;
+
+let addon: XimacroAddon | null | undefined;
+
+/**
+ * Loads the addon once. Returns null when it isn't available (e.g. it wasn't
+ * built), in which case callers fall back to the ximacro_* executables.
+ */
+export const loadNativeAddon = (addonPath: string): XimacroAddon | null => {
+	if (addon !== undefined) return addon;
+
+	try {
+		// eslint-disable-next-line @typescript-eslint/no-var-requires
+		addon = require(addonPath) as XimacroAddon;
+	} catch (error) {
+		log.warn(`ximacro.node not available: ${error}`);
+		addon = null;
+	}
+	return addon;
+};
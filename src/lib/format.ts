@@ -1,4 +1,6 @@
-export const extractMacroNumber = (fileName: string) => {
+import type { MacroItem } from '@/contexts/app-provider';
+
+const extractMacroNumber = (fileName: string) => {
 	const fn = fileName.split('\\').pop() || fileName;
 	let macroNumber = 0;
 	const match = fn.match(/(\d+)/);
@@ -7,3 +9,259 @@ export const extractMacroNumber = (fileName: string) => {
 	}
 	return macroNumber;
 };
+
+const PAGES_PER_BOOK = 10;
+
+/**
+ * Position tags of file `index` (mcr.dat is 0), as ximacro_e writes them.
+ */
+export const pageTags = (index: number) => ({
+	index,
+	book: Math.floor(index / PAGES_PER_BOOK),
+	page: index % PAGES_PER_BOOK,
+});
+
+/**
+ * Pages of a JSON file exported before pages were tagged get their tags
+ * from their fileName; everything else already carries them.
+ */
+export const tagPages = (items: MacroItem[]): MacroItem[] =>
+	items.map(item =>
+		typeof item.index === 'number'
+			? item
+			: { ...item, ...pageTags(extractMacroNumber(item.fileName)) },
+	);
+
+/**
+ * Summary printed by ximacro_i after an import.
+ */
+export interface ImportSummary {
+	written: number;
+	skipped: number;
+	failed: number;
+	rejected?: number;
+	touched: string[];
+	backups?: string[];
+}
+
+export const parseImportSummary = (output: string): ImportSummary | null => {
+	try {
+		const summary = JSON.parse(output);
+		return typeof summary?.written === 'number' ? summary : null;
+	} catch {
+		return null;
+	}
+};
+
+/**
+ * A `replace-macros` request: replaces `find` with `replace` in every line
+ * and name of the given character folders (names under USER).
+ */
+export interface MacroReplace {
+	characters: string[];
+	find: string;
+	replace: string;
+	ignoreCase?: boolean;
+	dryRun?: boolean;
+}
+
+/**
+ * One field changed (or, with `length` and `limit`, one that would
+ * overflow and was left alone) by `ximacro_i --replace`.
+ */
+export interface ReplaceChange {
+	file: string;
+	macro: number;
+	line: number | 'name';
+	before: string;
+	after: string;
+	length?: number;
+	limit?: number;
+}
+
+/**
+ * Summary printed by `ximacro_i --replace`. Nothing is written when
+ * `dryRun` is set.
+ */
+export interface ReplaceSummary extends ImportSummary {
+	dryRun: boolean;
+	matches: number;
+	files: number;
+	changes: ReplaceChange[];
+	overflows: ReplaceChange[];
+}
+
+/**
+ * Part of a folder for `ximacro_e` to export: one book (0-based), or an
+ * inclusive range of file indexes (mcr.dat is 0).
+ */
+export type MacroSelection = { book: number } | { pages: [number, number] };
+
+export const selectionArgs = (selection?: MacroSelection): string[] => {
+	if (!selection) return [];
+	if ('book' in selection) return [`--book=${selection.book}`];
+	return [`--pages=${selection.pages[0]}-${selection.pages[1]}`];
+};
+
+/**
+ * A `clone-book` request: copies book `book` (0-based), its ten pages and
+ * its title, from one character folder to others (names under USER).
+ */
+export interface BookClone {
+	book: number;
+	from: string;
+	to: string[];
+}
+
+/**
+ * How `ximacro_i --clone-book` left one target; every target is committed
+ * on its own.
+ */
+export interface BookCloneTarget {
+	dir: string;
+	status: 'cloned' | 'unchanged' | 'failed';
+	written: number;
+}
+
+export interface BookCloneSummary extends ImportSummary {
+	book: number;
+	targets: BookCloneTarget[];
+}
+
+/**
+ * One character folder as summarized by `ximacro_c --scan`.
+ */
+export interface CharacterSummary {
+	name: string;
+	mtime: number;
+	macros: number;
+	pages: number[];
+	books: string[];
+}
+
+/**
+ * One book title as printed by `ximacro_b`; `book` is 0-based across
+ * mcr.ttl (0-19) and mcr_2.ttl (20-39).
+ */
+export interface BookTitle {
+	book: number;
+	title: string;
+}
+
+/**
+ * A `search-macros` request. Matching ignores ASCII case unless
+ * `matchCase`; `prefix` only matches at the start of a line or name.
+ */
+export interface MacroSearch {
+	query: string;
+	prefix?: boolean;
+	matchCase?: boolean;
+	limit?: number;
+}
+
+/**
+ * One match of `ximacro_f`. `book` and `page` are 0-based, from the file
+ * index; `line` is 0-5 or 'name'.
+ */
+export interface MacroSearchHit {
+	character: string;
+	file: string;
+	book: number;
+	page: number;
+	macro: number;
+	line: number | 'name';
+	text: string;
+}
+
+/**
+ * `total` counts every match, `hits` at most the requested limit.
+ */
+export interface MacroSearchResult {
+	query: string;
+	total: number;
+	hits: MacroSearchHit[];
+}
+
+/**
+ * One line of `ximacro_e --watch` output. Only files whose bytes actually
+ * changed are reported; `books` carries the titles of mcr.ttl (ttl 0) or
+ * mcr_2.ttl (ttl 1).
+ */
+export type MacroWatchEvent =
+	| { event: 'ready'; backend: 'inotify' | 'poll' }
+	| { event: 'change'; index: number; file: MacroItem | null }
+	| { event: 'remove'; index: number }
+	| { event: 'books'; ttl: number; titles: string[] }
+	| { event: 'error'; error: string };
+
+/**
+ * Applies a change/remove event to a loaded page list, keeping file order.
+ * The changed file is tagged with the event's index.
+ */
+export const applyWatchEvent = (macros: MacroItem[], ev: MacroWatchEvent): MacroItem[] => {
+	if (ev.event !== 'change' && ev.event !== 'remove') return macros;
+
+	const rest = macros.filter(item => item.index !== ev.index);
+	if (ev.event === 'remove' || !ev.file) return rest;
+
+	const file = { ...ev.file, ...pageTags(ev.index) };
+	const at = rest.findIndex(item => item.index > ev.index);
+	return at < 0 ? [...rest, file] : [...rest.slice(0, at), file, ...rest.slice(at)];
+};
+
+/**
+ * One positional edit for `ximacro_i --patch`:
+ * [file index, macro index, line index or 'name', text].
+ */
+export type MacroEdit = [number, number, number | 'name', string];
+
+/**
+ * Edits that rewrite every line and the name of one macro of a page.
+ */
+export const macroEdits = (
+	page: MacroItem,
+	macroIndex: number,
+	macro: { lines: { data: string }[]; name: string },
+): MacroEdit[] => {
+	const file = page.index;
+	return [
+		...macro.lines.map(
+			(line, i): MacroEdit => [file, macroIndex, i, line.data],
+		),
+		[file, macroIndex, 'name', macro.name],
+	];
+};
+
+/**
+ * Folder part of an exported fileName ("<dir>\\mcrN.dat").
+ */
+export const macroFileDir = (fileName: string) =>
+	fileName.slice(0, Math.max(fileName.lastIndexOf('\\'), fileName.lastIndexOf('/')));
+
+/**
+ * A page (mcrN.dat) or, with `macro`, one macro slot of it.
+ */
+export interface MacroLocation {
+	dir: string;
+	file: number;
+	macro?: number;
+}
+
+/**
+ * Native page/macro transfer for `ximacro_i --transfer`; "move" blanks the
+ * source afterwards.
+ */
+export interface MacroTransfer {
+	op: 'copy' | 'move' | 'swap';
+	from: MacroLocation;
+	to: MacroLocation;
+}
+
+/**
+ * Location of a page, or of one of its macros.
+ */
+export const macroLocation = (page: MacroItem, macro?: number): MacroLocation => ({
+	dir: macroFileDir(page.fileName),
+	file: page.index,
+	...(macro === undefined ? {} : { macro }),
+});
@@ -0,0 +1,107 @@
+import assert from 'node:assert/strict';
+import { readFileSync } from 'node:fs';
+import path from 'node:path';
+import test from 'node:test';
+
+import type { MacroItem } from '@/contexts/app-provider';
+import { decodeMacroBinary, encodeMacroBinary } from './macro-binary';
+
+/**
+ * Checks the codec against the text vectors of the C codec's tests
+ * (c-src/tests/text_roundtrip.c, which keeps the file current): the
+ * bytes of a field, their text, and their version 1 text, which encodes
+ * back to the same bytes.
+ */
+
+interface Vector {
+	bytes: string;
+	text: string;
+	raw: string;
+}
+
+const vectors: Vector[] = readFileSync(
+	path.join(__dirname, '../../c-src/tests/golden/text-vectors.jsonl'),
+	'utf8',
+)
+	.split('\n')
+	.filter(line => line !== '')
+	.map(line => JSON.parse(line));
+
+const MACRO_START = 0x1c;
+const LINE_SIZE = 0x3d;
+const NAME_SIZE = 0x0e;
+const MACRO_SIZE = 6 * LINE_SIZE + NAME_SIZE;
+
+const hexBytes = (hex: string) =>
+	Uint8Array.from(hex.match(/../g) ?? [], pair => parseInt(pair, 16));
+
+// A version 1 stream of one page holding one macro, with 'field' as its
+// first line and, when it fits, its name
+const version1Stream = (field: Uint8Array) => {
+	const out: number[] = [];
+	const le = (value: number, bytes: number) => {
+		for (let i = 0; i < bytes; i++) out.push((value >>> (8 * i)) & 0xff);
+	};
+	const dir = 'USER/test';
+	out.push(...Buffer.from('XMMB'));
+	le(1, 2);
+	le(dir.length, 2);
+	out.push(...Buffer.from(dir));
+
+	const empty = new Uint8Array();
+	const name = field.length <= NAME_SIZE ? field : empty;
+	const fields = [field, empty, empty, empty, empty, empty, name];
+	const record: number[] = [];
+	for (const f of fields) record.push(f.length, ...f);
+	le(8 + record.length, 4);
+	le(0, 2);
+	le(MACRO_START + MACRO_SIZE, 4);
+	le(1, 2);
+	out.push(...record);
+	le(0, 4);
+	return Uint8Array.from(out);
+};
+
+test('version 1 fields decode to their version 1 text', () => {
+	for (const v of vectors) {
+		const bytes = hexBytes(v.bytes);
+		const [page] = decodeMacroBinary(version1Stream(bytes));
+		const [macro] = page.macros;
+		assert.equal(macro.lines[0].data, v.raw, v.bytes);
+		assert.equal(macro.name, bytes.length <= NAME_SIZE ? v.raw : '', v.bytes);
+	}
+});
+
+test('ASCII fields decode to the text of the export', () => {
+	for (const v of vectors) {
+		if (hexBytes(v.bytes).every(byte => byte < 0x80)) {
+			assert.equal(v.raw, v.text, v.bytes);
+		}
+	}
+});
+
+test('text survives a version 2 stream', () => {
+	const page: MacroItem = {
+		fileName: 'USER/test/mcr12.dat',
+		fileSize: MACRO_START + vectors.length * MACRO_SIZE,
+		index: 12,
+		book: 1,
+		page: 2,
+		macros: vectors.map(v => ({
+			offset: '',
+			lines: [0, 1, 2, 3, 4, 5].map(line => ({
+				offset: '',
+				data: line === 0 ? v.text : v.raw,
+			})),
+			name: v.text,
+		})),
+	};
+	const [decoded] = decodeMacroBinary(encodeMacroBinary([page]));
+	assert.equal(decoded.fileName, page.fileName);
+	assert.equal(decoded.index, 12);
+	decoded.macros.forEach((macro, m) => {
+		assert.equal(macro.lines[0].data, vectors[m].text);
+		assert.equal(macro.lines[1].data, vectors[m].raw);
+		assert.equal(macro.name, vectors[m].text);
+	});
+});
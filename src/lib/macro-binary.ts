@@ -0,0 +1,250 @@
+import type { Macro, MacroItem } from '@/contexts/app-provider';
+
+/**
+ * Codec for the binary interchange of `ximacro_e --format=bin` and
+ * `ximacro_i --format=bin` (layout in c-src/src/xm_bin.h). It carries the
+ * same content as the JSON export in a fraction of the bytes: offsets are
+ * implied by position and each field is a u16 length and its UTF-8 text.
+ *
+ * Field text is the decoded text of the JSON export (Shift-JIS characters,
+ * {AT:HHHHHHHH} phrases and {xHH} bytes; see c-src/src/xm_text.h), so
+ * decoding a stream yields the same `MacroItem[]` as parsing the JSON.
+ * Version 1 streams carried raw bytes; those decode with every byte
+ * outside ASCII as {xHH}, which the importer writes back unchanged.
+ */
+
+const MAGIC = 'XMMB';
+const VERSION = 2;
+const FIELD_MAX = 0xffff;
+
+const MACRO_START = 0x1c;
+const LINE_SIZE = 0x3d;
+const NAME_SIZE = 0x0e;
+const LINES_PER_MACRO = 6;
+const MACRO_SIZE = LINES_PER_MACRO * LINE_SIZE + NAME_SIZE;
+const PAGES_PER_BOOK = 10;
+
+const hexOffset = (value: number) =>
+	`0x${value.toString(16).toUpperCase().padStart(4, '0')}`;
+
+// Every page has the same layout, so its offset strings are built once
+const offsetCache: string[] = [];
+const cachedOffset = (value: number) => (offsetCache[value] ??= hexOffset(value));
+
+const macroFileName = (index: number) => (index === 0 ? 'mcr.dat' : `mcr${index}.dat`);
+
+const macroCount = (fileSize: number) =>
+	fileSize <= MACRO_START ? 0 : Math.ceil((fileSize - MACRO_START) / MACRO_SIZE);
+
+/**
+ * Lines a macro of a `fileSize`-byte file holds, and whether it holds its
+ * name; a file cut short ends mid-macro.
+ */
+const macroFields = (fileSize: number, macro: number) => {
+	const start = MACRO_START + macro * MACRO_SIZE;
+	const chunk = Math.min(Math.max(fileSize - start, 0), MACRO_SIZE);
+	return {
+		lines: Math.min(Math.ceil(chunk / LINE_SIZE), LINES_PER_MACRO),
+		hasName: chunk > LINES_PER_MACRO * LINE_SIZE,
+	};
+};
+
+const textEncoder = new TextEncoder();
+const textDecoder = new TextDecoder();
+
+/**
+ * UTF-8 of a field's text, clipped to what its u16 length can carry; the
+ * importer encodes it and drops whatever doesn't fit the field.
+ */
+const textBytes = (text: string): Uint8Array => {
+	const bytes = textEncoder.encode(text);
+	return bytes.length > FIELD_MAX ? bytes.subarray(0, FIELD_MAX) : bytes;
+};
+
+// Bytes (a token's length at most) from 'at', as byte-valued characters
+const latin1 = (data: Uint8Array, at: number, to: number) =>
+	String.fromCharCode(...data.subarray(at, Math.min(at + 13, to)));
+
+const TOKEN = /^\{(?:AT:([0-9A-Fa-f]{8})|x([0-9A-Fa-f]{2}))\}/;
+
+// Whether text starts with a token; none stands for a 0x00 byte
+const isToken = (text: string) => {
+	const match = TOKEN.exec(text);
+	const hex = match ? (match[1] ?? match[2]) : '';
+	return hex !== '' && !/^(?:..)*00/.test(hex);
+};
+
+/**
+ * Text of a version 1 field's raw bytes: ASCII as is, other bytes as
+ * {xHH}, and a '{' that would read as a token as {x7B}.
+ */
+const rawText = (data: Uint8Array, from: number, to: number): string => {
+	let text = '';
+	for (let i = from; i < to; i++) {
+		const byte = data[i];
+		if (byte >= 0x80 || (byte === 0x7b && isToken(latin1(data, i, to)))) {
+			text += `{x${byte.toString(16).toUpperCase().padStart(2, '0')}}`;
+		} else {
+			text += String.fromCharCode(byte);
+		}
+	}
+	return text;
+};
+
+class Writer {
+	private buf = new Uint8Array(64 * 1024);
+	length = 0;
+
+	private reserve(n: number) {
+		if (this.length + n <= this.buf.length) return;
+		let size = this.buf.length * 2;
+		while (size < this.length + n) size *= 2;
+		const next = new Uint8Array(size);
+		next.set(this.buf.subarray(0, this.length));
+		this.buf = next;
+	}
+
+	le(value: number, bytes: number) {
+		this.reserve(bytes);
+		for (let i = 0; i < bytes; i++) this.buf[this.length++] = (value >>> (8 * i)) & 0xff;
+	}
+
+	bytes(data: ArrayLike<number>) {
+		this.reserve(data.length);
+		this.buf.set(data, this.length);
+		this.length += data.length;
+	}
+
+	patch(at: number, value: number) {
+		for (let i = 0; i < 4; i++) this.buf[at + i] = (value >>> (8 * i)) & 0xff;
+	}
+
+	result() {
+		return this.buf.slice(0, this.length);
+	}
+}
+
+/**
+ * Encodes the pages of one character folder (the folder of the first
+ * page's `fileName`). Each page's macros are taken in order, as exported.
+ */
+export const encodeMacroBinary = (pages: MacroItem[]): Uint8Array => {
+	const w = new Writer();
+	const first = pages[0]?.fileName ?? '';
+	const dir = first.slice(0, Math.max(first.lastIndexOf('\\'), first.lastIndexOf('/')));
+	const dirBytes = textEncoder.encode(dir);
+
+	w.bytes(textEncoder.encode(MAGIC));
+	w.le(VERSION, 2);
+	w.le(dirBytes.length, 2);
+	w.bytes(dirBytes);
+
+	for (const page of pages) {
+		const { index } = page;
+		const macros = Math.min(page.macros.length, macroCount(page.fileSize));
+		if (index < 0 || macros === 0) continue;
+
+		const at = w.length;
+		w.le(0, 4);
+		w.le(index, 2);
+		w.le(page.fileSize, 4);
+		w.le(macros, 2);
+		for (let m = 0; m < macros; m++) {
+			const macro = page.macros[m];
+			const { lines, hasName } = macroFields(page.fileSize, m);
+			for (let line = 0; line < lines; line++) {
+				const bytes = textBytes(macro.lines[line]?.data ?? '');
+				w.le(bytes.length, 2);
+				w.bytes(bytes);
+			}
+			if (hasName) {
+				const bytes = textBytes(macro.name ?? '');
+				w.le(bytes.length, 2);
+				w.bytes(bytes);
+			}
+		}
+		w.patch(at, w.length - at - 4);
+	}
+
+	w.le(0, 4);
+	return w.result();
+};
+
+/**
+ * Decodes a stream into the same `MacroItem[]` the JSON export parses to,
+ * position tags included.
+ * Throws on a malformed or truncated stream.
+ */
+export const decodeMacroBinary = (data: Uint8Array): MacroItem[] => {
+	const le = (at: number, bytes: number) => {
+		let value = 0;
+		for (let i = 0; i < bytes; i++) value += data[at + i] * 2 ** (8 * i);
+		return value;
+	};
+
+	if (data.length < 8 || latin1(data, 0, 4) !== MAGIC) {
+		throw new Error('Not a macro stream.');
+	}
+	const version = le(4, 2);
+	if (version < 1 || version > VERSION) {
+		throw new Error('Unsupported macro stream version.');
+	}
+	const header = version === 1 ? 1 : 2;
+	const dirLen = le(6, 2);
+	let p = 8 + dirLen;
+	const dir = textDecoder.decode(data.subarray(8, p));
+	const sep = dir.includes('\\') ? '\\' : '/';
+
+	const pages: MacroItem[] = [];
+	for (;;) {
+		if (p + 4 > data.length) throw new Error('Truncated macro stream.');
+		const len = le(p, 4);
+		p += 4;
+		if (len === 0) break;
+		const end = p + len;
+		if (len < 8 || end > data.length) throw new Error('Truncated macro stream.');
+		const index = le(p, 2);
+		const fileSize = le(p + 2, 4);
+		const count = le(p + 6, 2);
+		p += 8;
+
+		// Field by field: length (u8 in version 1, else u16), then the
+		// bytes, all within the record
+		const macros: Macro[] = [];
+		for (let m = 0; m < count; m++) {
+			const offset = MACRO_START + m * MACRO_SIZE;
+			const { lines, hasName } = macroFields(fileSize, m);
+			const macro = { offset: cachedOffset(offset), lines: [] } as unknown as Macro;
+			for (let f = 0; f < lines + Number(hasName); f++) {
+				if (p + header > end) throw new Error('Malformed macro stream.');
+				const n = le(p, header);
+				const next = p + header + n;
+				if (next > end || (version === 1 && n > (f < lines ? LINE_SIZE : NAME_SIZE))) {
+					throw new Error('Malformed macro stream.');
+				}
+				const text =
+					version === 1
+						? rawText(data, p + 1, next)
+						: textDecoder.decode(data.subarray(p + header, next));
+				p = next;
+				if (f < lines) {
+					macro.lines.push({ offset: cachedOffset(offset + f * LINE_SIZE), data: text });
+				} else {
+					macro.name = text;
+				}
+			}
+			macros.push(macro);
+		}
+		if (p !== end) throw new Error('Malformed macro stream.');
+
+		pages.push({
+			fileName: `${dir}${sep}${macroFileName(index)}`,
+			fileSize,
+			macros,
+			index,
+			book: Math.floor(index / PAGES_PER_BOOK),
+			page: index % PAGES_PER_BOOK,
+		});
+	}
+	return pages;
+};
@@ -1,7 +1,7 @@
 import { app, BrowserWindow } from 'electron';
 import path from 'node:path';
 import started from 'electron-squirrel-startup';
-import { registerHandlers } from '@/ipc/handlers';
+import { registerHandlers, stopMacroService, stopMacroWatch } from '@/ipc/handlers';
 
 // These are injected by Vite
 declare const MAIN_WINDOW_VITE_DEV_SERVER_URL: string | undefined;
@@ -55,6 +55,18 @@ app.on('window-all-closed', () => {
 	}
 });
 
+// Write back any edits still held by the resident macro service before exiting.
+let macroServiceStopped = false;
+app.on('will-quit', event => {
+	if (macroServiceStopped) return;
+	event.preventDefault();
+	stopMacroWatch();
+	stopMacroService().finally(() => {
+		macroServiceStopped = true;
+		app.quit();
+	});
+});
+
 app.on('activate', () => {
 	// On OS X it's common to re-create a window in the app when the
 	// dock icon is clicked and there are no other windows open.
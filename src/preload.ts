@@ -1,6 +1,20 @@
 import { contextBridge, ipcRenderer } from 'electron';
 
 import type { MacroItem } from '@/contexts/app-provider';
+import type {
+	BookClone,
+	BookCloneSummary,
+	BookTitle,
+	CharacterSummary,
+	MacroEdit,
+	MacroReplace,
+	MacroSearch,
+	MacroSearchResult,
+	MacroSelection,
+	MacroTransfer,
+	MacroWatchEvent,
+	ReplaceSummary,
+} from '@/lib/format';
 
 contextBridge.exposeInMainWorld('electronAPI', {
 	setStore: <K extends keyof StoreValues>(
@@ -15,15 +29,69 @@ contextBridge.exposeInMainWorld('electronAPI', {
 
 	selectFolder: (): Promise<string | null> => ipcRenderer.invoke('select-folder'),
 
-	readMacros: (path: string): Promise<string> =>
-		ipcRenderer.invoke('read-macros', { path }),
+	readMacros: (path: string, selection?: MacroSelection): Promise<Uint8Array> =>
+		ipcRenderer.invoke('read-macros', { path, selection }),
+
+	streamMacros: (
+		path: string,
+		onPages: (pages: MacroItem[]) => void,
+		selection?: MacroSelection,
+	): Promise<number> => {
+		const requestId = `${Date.now()}-${Math.random().toString(36).slice(2)}`;
+		const listener = (_event: Electron.IpcRendererEvent, id: string, pages: MacroItem[]) => {
+			if (id === requestId) onPages(pages);
+		};
+		ipcRenderer.on('read-macros:pages', listener);
+		return (
+			ipcRenderer.invoke('read-macros:stream', {
+				path,
+				selection,
+				requestId,
+			}) as Promise<number>
+		).finally(() => ipcRenderer.removeListener('read-macros:pages', listener));
+	},
 
 	writeMacros: (macros: MacroItem[]): Promise<string> =>
 		ipcRenderer.invoke('write-macros', { macros }),
 
+	patchMacros: (dir: string, edits: MacroEdit[]): Promise<string> =>
+		ipcRenderer.invoke('patch-macros', { dir, edits }),
+
+	transferMacros: (ops: MacroTransfer[]): Promise<string> =>
+		ipcRenderer.invoke('transfer-macros', ops),
+
 	readBooks: (dataFolder: string): Promise<string | string[]> =>
 		ipcRenderer.invoke('read-books', { dataFolder }) as Promise<string | string[]>,
 
+	writeBooks: (dataFolder: string, titles: BookTitle[]): Promise<string | string[]> =>
+		ipcRenderer.invoke('write-books', { dataFolder, titles }) as Promise<
+			string | string[]
+		>,
+
+	scanCharacters: (): Promise<CharacterSummary[] | string> =>
+		ipcRenderer.invoke('scan-characters') as Promise<CharacterSummary[] | string>,
+
+	cloneBook: (request: BookClone): Promise<BookCloneSummary | string> =>
+		ipcRenderer.invoke('clone-book', request) as Promise<BookCloneSummary | string>,
+
+	searchMacros: (search: MacroSearch): Promise<MacroSearchResult | string> =>
+		ipcRenderer.invoke('search-macros', search) as Promise<MacroSearchResult | string>,
+
+	replaceMacros: (request: MacroReplace): Promise<ReplaceSummary | string> =>
+		ipcRenderer.invoke('replace-macros', request) as Promise<ReplaceSummary | string>,
+
 	listDirectories: (dirPath: string): Promise<string | string[]> =>
 		ipcRenderer.invoke('list-directories', dirPath) as Promise<string | string[]>,
+
+	watchMacros: (dir: string): Promise<boolean> => ipcRenderer.invoke('macro-watch:start', dir),
+
+	unwatchMacros: (): Promise<boolean> => ipcRenderer.invoke('macro-watch:stop'),
+
+	onMacroWatchEvent: (callback: (ev: MacroWatchEvent) => void): (() => void) => {
+		const listener = (_event: Electron.IpcRendererEvent, ev: MacroWatchEvent) => callback(ev);
+		ipcRenderer.on('macro-watch:event', listener);
+		return () => {
+			ipcRenderer.removeListener('macro-watch:event', listener);
+		};
+	},
 });
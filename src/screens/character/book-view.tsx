@@ -6,7 +6,6 @@ import MacroGrid from '@/screens/character/macro-grid';
 import MacroForm from '@/screens/character/macro-form';
 
 import { useApp } from '@/contexts/app-provider';
-import { extractMacroNumber } from '@/lib/format';
 import { cn } from '@/lib/utils';
 
 import { BiCollapseVertical } from 'react-icons/bi';
@@ -14,8 +13,6 @@ import { BsClipboard2CheckFill } from 'react-icons/bs';
 
 import type { MacroItem } from '@/contexts/app-provider';
 
-const PAGES_PER_BOOK = 10;
-
 export default function BookView() {
 	const {
 		books,
@@ -45,10 +42,10 @@ export default function BookView() {
 	useEffect(() => {
 		if (!initialLoadRef.current) {
 			initialLoadRef.current = true;
+			// Macros stream in after the titles; books render as their pages arrive
 			loadBooks().then(() => {
-				loadMacros().then(() => {
-					setBooksLoaded(true);
-				});
+				setBooksLoaded(true);
+				loadMacros();
 			});
 		}
 	}, []);
@@ -58,19 +55,18 @@ export default function BookView() {
 			const newBookPages: MacroItem[][] = [];
 
 			for (const macro of macros) {
-				const macroNumber = extractMacroNumber(macro.fileName);
-				const page = Math.floor(macroNumber / PAGES_PER_BOOK);
+				const book = macro.book;
 
-				// Initialize the page array if it doesn't exist yet
-				if (!newBookPages[page]) {
-					newBookPages[page] = [];
+				// Initialize the book's page array if it doesn't exist yet
+				if (!newBookPages[book]) {
+					newBookPages[book] = [];
 				}
 
-				newBookPages[page].push(macro);
+				newBookPages[book].push(macro);
 			}
 			setBookPages(newBookPages);
 		}
-	}, [booksLoaded]);
+	}, [booksLoaded, macros]);
 
 	const handleMacroClick = (macro: MacroItem) => {
 		setSelectedMacro(macro);
@@ -123,7 +119,6 @@ export default function BookView() {
 										key={macroIndex}
 										macro={macro}
 										onClick={() => handleMacroClick(macro)}
-										bookIndex={index}
 										isSelected={
 											selectedMacro?.fileName === macro.fileName
 										}
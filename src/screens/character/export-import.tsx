@@ -2,13 +2,15 @@ import React, { useState } from 'react';
 import { useApp } from '@/contexts/app-provider';
 import Button from '@/components/button';
 import { FaFileExport, FaFileImport } from 'react-icons/fa';
+import { parseImportSummary, tagPages } from '@/lib/format';
+import { decodeMacroBinary, encodeMacroBinary } from '@/lib/macro-binary';
 
 export default function ExportImport() {
 	const { macros, setMacros, openDialog } = useApp();
 	const [importPreview, setImportPreview] = useState<any>(null);
 	const [importError, setImportError] = useState<string | null>(null);
 
-	const handleExport = () => {
+	const handleExport = (binary: boolean) => {
 		if (!macros || macros.length === 0) {
 			openDialog({
 				title: 'Export Error',
@@ -18,16 +20,16 @@ export default function ExportImport() {
 			return;
 		}
 
-		// Create a blob with all macro data
-		const blob = new Blob([JSON.stringify(macros, null, 2)], {
-			type: 'application/json',
-		});
+		// Create a blob with all macro data; the binary form is a fraction of the size
+		const blob = binary
+			? new Blob([encodeMacroBinary(macros)], { type: 'application/octet-stream' })
+			: new Blob([JSON.stringify(macros, null, 2)], { type: 'application/json' });
 
 		// Create a download link
 		const url = window.URL.createObjectURL(blob);
 		const a = document.createElement('a');
 		a.href = url;
-		a.download = `all_macros.json`;
+		a.download = binary ? 'all_macros.xmb' : 'all_macros.json';
 		document.body.appendChild(a);
 		a.click();
 		window.URL.revokeObjectURL(url);
@@ -39,20 +41,27 @@ export default function ExportImport() {
 		if (!target.files?.length) return;
 
 		const file = target.files[0];
+		const binary = file.name.toLowerCase().endsWith('.xmb');
 		const reader = new FileReader();
 
 		reader.onload = event => {
 			try {
-				const json = JSON.parse(event.target?.result as string);
+				const result = event.target?.result;
+				const json = binary
+					? decodeMacroBinary(new Uint8Array(result as ArrayBuffer))
+					: tagPages(JSON.parse(result as string));
 				setImportPreview(json);
 				setImportError(null);
 			} catch (error) {
-				setImportError('Invalid JSON file format.');
+				setImportError(
+					binary ? 'Invalid binary file format.' : 'Invalid JSON file format.',
+				);
 				setImportPreview(null);
 			}
 		};
 
-		reader.readAsText(file);
+		if (binary) reader.readAsArrayBuffer(file);
+		else reader.readAsText(file);
 	};
 
 	const handleImport = async () => {
@@ -64,10 +73,11 @@ export default function ExportImport() {
 
 			// Then write to disk
 			const result = await window.electronAPI.writeMacros(importPreview);
-			if (result === 'No output from the executable.') {
+			const summary = parseImportSummary(result);
+			if (summary && summary.failed === 0) {
 				openDialog({
 					title: 'Import Success',
-					message: 'All macros imported successfully!',
+					message: `All macros imported successfully! ${summary.written} file(s) updated, ${summary.skipped} unchanged.`,
 					confirmLabel: 'OK',
 				});
 				// Clear the preview after successful import
@@ -89,19 +99,27 @@ export default function ExportImport() {
 			<h2 className="text-xl font-bold">Export / Import All Macros</h2>
 			<div className="flex gap-4">
 				<Button
-					onClick={handleExport}
+					onClick={() => handleExport(false)}
 					variant="default"
 					disabled={!macros || macros.length === 0}
 				>
 					<FaFileExport />
 					Export All Macros
 				</Button>
+				<Button
+					onClick={() => handleExport(true)}
+					variant="default"
+					disabled={!macros || macros.length === 0}
+				>
+					<FaFileExport />
+					Export Binary
+				</Button>
 				<div className="flex flex-col gap-2">
 					<Button
 						onClick={() => {
 							const input = document.createElement('input');
 							input.type = 'file';
-							input.accept = '.json';
+							input.accept = '.json,.xmb';
 							input.onchange = handleFileSelect;
 							input.click();
 						}}
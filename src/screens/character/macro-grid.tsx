@@ -3,6 +3,7 @@ import Button from '@/components/button';
 
 import { useApp } from '@/contexts/app-provider';
 
+import { macroLocation, parseImportSummary } from '@/lib/format';
 import { cn } from '@/lib/utils';
 
 import { FaSave, FaCheckCircle, FaTrash } from 'react-icons/fa';
@@ -26,12 +27,14 @@ export default function MacroGrid(props: MacroGridProps) {
 		setSelectedMacroItemIndex,
 		setSelectedMacroItem,
 		setCopiedMacroPage,
-		setSaveMacroSignal,
 		setSelectedMacro,
+		macros,
+		setMacros,
 		copiedMacroPage,
 		deleteMacroSignal,
 		setDeleteMacroSignal,
 		openDialog,
+		setError,
 	} = useApp();
 
 	if (!selectedMacro || selectedMacroIndex === null) return null;
@@ -49,16 +52,42 @@ export default function MacroGrid(props: MacroGridProps) {
 		});
 	};
 
-	const handlePastePage = () => {
-		if (copiedMacroPage) {
-			// Create a new macro object with the same structure but with the copied macros
-			const updatedMacro = {
-				...selectedMacro,
-				macros: [...copiedMacroPage.macros],
-			};
-			setSelectedMacro(updatedMacro);
-			setSaveMacroSignal(1); // Trigger save
+	const handlePastePage = async () => {
+		if (!copiedMacroPage) return;
+
+		// The page is copied file to file by ximacro_i, so every macro of it
+		// lands on disk, byte for byte, without a round trip through JSON
+		window.loadingMessage = 'Pasting page...';
+		let result: string;
+		try {
+			result = await window.electronAPI.transferMacros([
+				{
+					op: 'copy',
+					from: macroLocation(copiedMacroPage),
+					to: macroLocation(selectedMacro),
+				},
+			]);
+		} catch (error) {
+			result = String(error);
+		} finally {
+			window.loadingMessage = undefined;
+		}
+
+		// Only show the pasted page once it is on disk
+		const summary = parseImportSummary(result);
+		if (!summary || summary.failed > 0 || summary.rejected) {
+			setError(`Failed to paste the page: ${result}`);
+			return;
 		}
+
+		const updatedMacro = {
+			...selectedMacro,
+			macros: [...copiedMacroPage.macros],
+		};
+		const newMacros = [...macros];
+		newMacros[selectedMacroIndex] = updatedMacro;
+		setSelectedMacro(updatedMacro);
+		setMacros(newMacros);
 	};
 
 	return (
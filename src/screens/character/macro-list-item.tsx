@@ -1,25 +1,18 @@
-import { extractMacroNumber } from '@/lib/format';
-
 import { cn } from '@/lib/utils';
 
 import type { MacroItem } from '@/contexts/app-provider';
 
 interface MacroListProps {
 	macro: MacroItem;
-	bookIndex: number;
 	onClick: () => void;
 	isSelected: boolean;
 }
 
 export default function MacroListItem(props: MacroListProps) {
-	const { macro, bookIndex, onClick, isSelected } = props;
-
-	const subtract = bookIndex * 10;
+	const { macro, onClick, isSelected } = props;
 
 	if (!macro) return null;
 
-	const macroNumber = extractMacroNumber(macro.fileName);
-
 	return (
 		<div
 			onClick={onClick}
@@ -28,7 +21,7 @@ export default function MacroListItem(props: MacroListProps) {
 				isSelected && 'bg-blue-500 text-white hover:bg-blue-400',
 			)}
 		>
-			<h3 className="text-lg font-medium">Page {macroNumber - subtract + 1}</h3>
+			<h3 className="text-lg font-medium">Page {macro.page + 1}</h3>
 		</div>
 	);
 }
@@ -1,3 +1,18 @@
+import type {
+	BookClone,
+	BookCloneSummary,
+	BookTitle,
+	CharacterSummary,
+	MacroEdit,
+	MacroReplace,
+	MacroSearch,
+	MacroSearchResult,
+	MacroSelection,
+	MacroTransfer,
+	MacroWatchEvent,
+	ReplaceSummary,
+} from '@/lib/format';
+
 declare global {
 	interface StoreValues {
 		ffxiPath: string;
@@ -24,10 +39,25 @@ export interface ElectronAPI {
 	) => Promise<StoreValues[K] | undefined>;
 	clearStore: () => Promise<void>;
 	selectFolder: () => Promise<string | null>;
-	readMacros: (path: string) => Promise<string>;
+	readMacros: (path: string, selection?: MacroSelection) => Promise<Uint8Array>;
+	streamMacros: (
+		path: string,
+		onPages: (pages: MacroItem[]) => void,
+		selection?: MacroSelection,
+	) => Promise<number>;
 	writeMacros: (macros: MacroItem[]) => Promise<string>;
+	patchMacros: (dir: string, edits: MacroEdit[]) => Promise<string>;
+	transferMacros: (ops: MacroTransfer[]) => Promise<string>;
 	readBooks: (dataFolder: string) => Promise<string | string[]>;
+	writeBooks: (dataFolder: string, titles: BookTitle[]) => Promise<string | string[]>;
+	scanCharacters: () => Promise<CharacterSummary[] | string>;
+	searchMacros: (search: MacroSearch) => Promise<MacroSearchResult | string>;
+	replaceMacros: (request: MacroReplace) => Promise<ReplaceSummary | string>;
+	cloneBook: (request: BookClone) => Promise<BookCloneSummary | string>;
 	listDirectories: (dirPath: string) => Promise<string | string[]>;
+	watchMacros: (dir: string) => Promise<boolean>;
+	unwatchMacros: () => Promise<boolean>;
+	onMacroWatchEvent: (callback: (ev: MacroWatchEvent) => void) => () => void;
 	readBooks: (dataFolder: string) => Promise<string | string[]>;
 }
 